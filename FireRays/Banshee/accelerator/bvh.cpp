@@ -1,4 +1,7 @@
 #include "bvh.h"
+#include "../util/renderstats.h"
+#include "../util/profiler.h"
+#include "../util/memoryreport.h"
 
 #include <algorithm>
 #include <thread>
@@ -7,6 +10,7 @@
 #include <cassert>
 #include <vector>
 #include <future>
+#include <stdexcept>
 
 static bool is_nan(float v)
 {
@@ -15,9 +19,30 @@ static bool is_nan(float v)
 
 void Bvh::Build(std::vector<std::unique_ptr<ShapeBundle>> const& bundles)
 {
+    PROFILE_SCOPE("Bvh::Build");
+
     //
     assert(bundles.size());
     
+    size_t sum = SetBundles(bundles);
+    
+    // Allocate bounds
+    bounds_.resize(sum);
+    
+    // Collect bounds
+    for(size_t i = 0; i < bundles_.size(); ++i)
+    {
+        for (size_t j = 0; j < bundles_[i]->GetNumShapes(); ++j)
+        {
+            bounds_[bundlestartidx_[i] + j] = bundles_[i]->GetShapeWorldBounds(j);
+        }
+    }
+    
+    BuildImpl(&bounds_[0], sum);
+}
+
+size_t Bvh::SetBundles(std::vector<std::unique_ptr<ShapeBundle>> const& bundles)
+{
     // We need to know total number of shapes in all bundles
     // as well as ranges of shape indices for bundles
     bundlestartidx_.resize(bundles.size());
@@ -38,21 +63,118 @@ void Bvh::Build(std::vector<std::unique_ptr<ShapeBundle>> const& bundles)
         sum += v;
     }
     
-    // Allocate bounds
-    bounds_.resize(sum);
+    return sum;
+}
+
+void Bvh::Pack(std::vector<PackedNode>& nodes, std::vector<int>& primids) const
+{
+    assert(root_);
     
-    // Collect bounds
-    for(size_t i = 0; i < bundles_.size(); ++i)
+    nodes.resize(nodecnt_);
+    
+    for (int i = 0; i < (int)nodecnt_; ++i)
     {
-        for (size_t j = 0; j < bundles_[i]->GetNumShapes(); ++j)
+        Node const& node = nodes_[i];
+        
+        nodes[i].bounds = node.bounds;
+        nodes[i].type = node.type;
+        
+        if (node.type == kInternal)
         {
-            bounds_[bundlestartidx_[i] + j] = bundles_[i]->GetShapeWorldBounds(j);
+            nodes[i].first = (int)(node.lc - &nodes_[0]);
+            nodes[i].second = (int)(node.rc - &nodes_[0]);
+        }
+        else
+        {
+            nodes[i].first = node.startidx;
+            nodes[i].second = node.numprims;
         }
     }
     
-    BuildImpl(&bounds_[0], sum);
+    primids = primids_;
+}
+
+void Bvh::Unpack(std::vector<std::unique_ptr<ShapeBundle>> const& bundles,
+                 PackedNode const* nodes, int numnodes,
+                 int const* primids, int numprimids)
+{
+    size_t sum = SetBundles(bundles);
+    
+    if (numnodes == 0 || (size_t)numprimids != sum)
+    {
+        throw std::runtime_error("Bvh: packed hierarchy does not match the shapes");
+    }
+    
+    // Bounds are only needed to build, keep the array empty
+    bounds_.clear();
+    primids_.assign(primids, primids + numprimids);
+    
+    for (auto id : primids_)
+    {
+        if (id < 0 || (size_t)id >= sum)
+        {
+            throw std::runtime_error("Bvh: packed hierarchy does not match the shapes");
+        }
+    }
+    
+    InitNodeAllocator(numnodes);
+    
+    for (int i = 0; i < numnodes; ++i)
+    {
+        Node& node = *AllocateNode();
+        
+        node.bounds = nodes[i].bounds;
+        node.type = (NodeType)nodes[i].type;
+        
+        // Links must stay inside the arrays, children are allocated after parents
+        bool valid = nodes[i].first >= 0 && nodes[i].second >= 0 &&
+            (node.type == kInternal ?
+             nodes[i].first > i && nodes[i].second > i && nodes[i].first < numnodes && nodes[i].second < numnodes :
+             node.type == kLeaf && nodes[i].first + nodes[i].second <= numprimids);
+        
+        if (!valid)
+        {
+            throw std::runtime_error("Bvh: packed hierarchy is corrupted");
+        }
+        
+        if (node.type == kInternal)
+        {
+            node.lc = &nodes_[nodes[i].first];
+            node.rc = &nodes_[nodes[i].second];
+        }
+        else
+        {
+            node.startidx = nodes[i].first;
+            node.numprims = nodes[i].second;
+        }
+    }
+    
+    root_ = &nodes_[0];
+    buildpeak_ = 0;
 }
 
+int Bvh::GetNumNodes() const
+{
+    return nodecnt_;
+}
+
+void Bvh::GetMemoryUsage(MemoryReport& report) const
+{
+    report.Add("bvh.nodes", nodes_.capacity() * sizeof(Node));
+    report.Add("bvh.primids", primids_.capacity() * sizeof(int));
+    report.Add("bvh.bounds", bounds_.capacity() * sizeof(bbox));
+    report.Add("bvh.bundles", bundles_.capacity() * sizeof(ShapeBundle*) + bundlestartidx_.capacity() * sizeof(int));
+    report.AddPeak("bvh.build", buildpeak_);
+}
+
+std::size_t Bvh::GetSizeInBytes() const
+{
+    return nodes_.capacity() * sizeof(Node) +
+           primids_.capacity() * sizeof(int) +
+           bundles_.capacity() * sizeof(ShapeBundle*) +
+           bounds_.capacity() * sizeof(bbox) +
+           bundlestartidx_.capacity() * sizeof(int);
+}
 
 void  Bvh::InitNodeAllocator(size_t maxnum)
 {
@@ -493,6 +615,9 @@ void Bvh::BuildImpl(bbox const* bounds, size_t numbounds)
     
     // Set root_ pointer
     root_ = &nodes_[0];
+    
+    // Centroids are the only temporaries on top of the hierarchy itself
+    buildpeak_ = GetSizeInBytes() + centroids.capacity() * sizeof(float3);
 }
 
 
@@ -515,12 +640,17 @@ bool Bvh::Intersect(ray const& r, ShapeBundle::Hit& hit) const
     Node* node = root_;
     // Hit flag
     bool bhit = false;
+    // Closest intersection, shading data is filled once traversal is done
+    ShapeBundle::Intersection isect;
+    isect.t = hit.t;
     // Start processing nodes
     // Changing the code to use more flow control
     // and skip push\pop when possible
     // This gives some perf boost
     for(;;)
     {
+        STATS_ADD(kNodes, 1);
+
         if (node->type == kLeaf)
         {
             size_t bundleidx = -1;
@@ -531,7 +661,7 @@ bool Bvh::Intersect(ray const& r, ShapeBundle::Hit& hit) const
                 bundleidx = GetShapeBundleIdx(primids_[i]);
                 shapeidx = GetShapeIndexInBundle(bundleidx, primids_[i]);
                 
-                if (bundles_[bundleidx]->IntersectShape(shapeidx, r, hit))
+                if (bundles_[bundleidx]->IntersectShape(shapeidx, r, isect))
                 {
                     bhit = true;
                 }
@@ -539,8 +669,8 @@ bool Bvh::Intersect(ray const& r, ShapeBundle::Hit& hit) const
         }
         else
         {
-            bool addleft =  intersects(r, invrd, node->lc->bounds, dirneg, hit.t);
-            bool addright = intersects(r, invrd, node->rc->bounds, dirneg, hit.t);
+            bool addleft =  intersects(r, invrd, node->lc->bounds, dirneg, isect.t);
+            bool addright = intersects(r, invrd, node->rc->bounds, dirneg, isect.t);
             
             if (addleft)
             {
@@ -569,6 +699,11 @@ bool Bvh::Intersect(ray const& r, ShapeBundle::Hit& hit) const
         }
     }
     
+    if (bhit)
+    {
+        isect.bundle->FillHit(isect, r, hit);
+    }
+    
     return bhit;
 }
 
@@ -595,6 +730,8 @@ bool Bvh::Intersect(ray const& r) const
     // This gives some perf boost
     for(;;)
     {
+        STATS_ADD(kNodes, 1);
+
         if (node->type == kLeaf)
         {
             size_t bundleidx = -1;
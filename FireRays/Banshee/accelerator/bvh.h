@@ -57,6 +57,7 @@ public:
     Bvh(bool usesah = false)
     : root_(nullptr)
     , usesah_(usesah)
+    , buildpeak_(0)
     {
     }
     
@@ -72,7 +73,31 @@ public:
     // Intersection check test
     bool Intersect(ray const& r) const;
     
+    // Number of nodes in the hierarchy
+    int GetNumNodes() const;
+    // Memory held by the hierarchy in bytes
+    std::size_t GetSizeInBytes() const;
+    // Report hierarchy arrays and peak memory during the build
+    void GetMemoryUsage(MemoryReport& report) const;
 
+    // Node as stored outside of the hierarchy, child links are node indices
+    struct PackedNode
+    {
+        bbox bounds;
+        int type;
+        // Left child or starting primitive index for leaves
+        int first;
+        // Right child or number of primitives for leaves
+        int second;
+    };
+
+    // Flatten hierarchy built to store it along with the scene
+    void Pack(std::vector<PackedNode>& nodes, std::vector<int>& primids) const;
+    // Restore hierarchy packed for the same bundles instead of building it
+    void Unpack(std::vector<std::unique_ptr<ShapeBundle>> const& bundles,
+                PackedNode const* nodes, int numnodes,
+                int const* primids, int numprimids);
+    
     
 protected:
     // Build function
@@ -83,6 +108,9 @@ protected:
     virtual Node* AllocateNode();
     virtual void  InitNodeAllocator(size_t maxnum);
     
+    // Set bundles to trace and their shape ranges, returns total number of shapes
+    size_t SetBundles(std::vector<std::unique_ptr<ShapeBundle>> const& bundles);
+
     size_t GetShapeBundleIdx(size_t shapeidx) const;
     size_t GetShapeIndexInBundle(size_t bundleidx, size_t globalshapeidx) const;
     
@@ -143,6 +171,8 @@ protected:
     Node* root_;
     // SAH flag
     bool usesah_;
+    // Memory used during the last build in bytes
+    std::size_t buildpeak_;
     
     
 private:
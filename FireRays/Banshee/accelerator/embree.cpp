@@ -3,6 +3,7 @@
 #include "embree.h"
 #include "../primitive/mesh.h"
 #include "../math/mathutils.h"
+#include "../util/profiler.h"
 
 #include <map>
 
@@ -33,6 +34,8 @@ Embree::~Embree()
 // Build function: pass bounding boxes and
 void Embree::Build(std::vector<std::unique_ptr<ShapeBundle>> const& bundles)
 {
+    PROFILE_SCOPE("Embree::Build");
+
     for (size_t i = 0; i < bundles.size(); ++i)
     {
         Mesh* mesh = dynamic_cast<Mesh*>(bundles[i].get());
@@ -112,7 +115,7 @@ bool Embree::Intersect(ray const& r, ShapeBundle::Hit& hit) const
     {
         Mesh* mesh = embreedata_->geom2mesh[er.geomID];
         
-        mesh->FillHit(er.primID, er.tfar, er.u, er.v, hit);
+        mesh->FillHit(er.primID, r, er.tfar, er.u, er.v, hit);
         
         return true;
     }
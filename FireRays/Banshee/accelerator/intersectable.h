@@ -37,6 +37,7 @@
 #include "../primitive/shapebundle.h"
 
 class ray;
+class MemoryReport;
 
 class Intersectable
 {
@@ -46,6 +47,9 @@ public:
     virtual bool Intersect(ray const& r, ShapeBundle::Hit& hit) const = 0;
     // Intersection check test
     virtual bool Intersect(ray const& r) const = 0;
+    // Report memory held by the accelerator
+    // Default implementation reports nothing
+    virtual void GetMemoryUsage(MemoryReport& report) const {}
 };
 
 inline Intersectable::~Intersectable()
@@ -0,0 +1,54 @@
+#include "aov.h"
+
+static char const* g_names[AovSample::kLight0] =
+{
+    "depth",
+    "normal",
+    "albedo",
+    "emission",
+    "direct",
+    "indirect",
+    "background",
+#ifdef RENDER_STATS
+    "stat_nodes",
+    "stat_triangles",
+    "stat_shadowrays",
+    "stat_pathvertices",
+    "stat_time",
+#endif
+};
+
+std::string AovSample::GetName(int channel)
+{
+    if (channel < kLight0)
+    {
+        return g_names[channel];
+    }
+
+    return "light" + std::to_string(channel - kLight0);
+}
+
+int AovSample::Find(std::string const& name)
+{
+    for (int i = 0; i < kNumChannels; ++i)
+    {
+        if (GetName(i) == name)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int AovSample::GetNumComponents(int channel)
+{
+#ifdef RENDER_STATS
+    if (channel >= kStatNodes && channel <= kStatTime)
+    {
+        return 1;
+    }
+#endif
+
+    return channel == kDepth ? 1 : 3;
+}
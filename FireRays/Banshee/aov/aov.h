@@ -0,0 +1,132 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+
+#ifndef AOV_H
+#define AOV_H
+
+#include <string>
+
+#include "../math/float3.h"
+
+///< AovSample holds arbitrary output variables a tracer emits for a single
+///< camera sample alongside radiance: primary hit data, lighting components
+///< and per-light contributions. Channels are addressed by index, names
+///< are only used to select them and to label output layers.
+///< Only the channels enabled in the mask are kept, so tracers write them
+///< unconditionally and the cost is a bit test when AOVs are off.
+///<
+class AovSample
+{
+public:
+    // Channels
+    enum Channel
+    {
+        // Distance to the primary hit
+        kDepth,
+        // Shading normal at the primary hit
+        kNormal,
+        // Albedo at the primary hit
+        kAlbedo,
+        // Directly visible emission
+        kEmission,
+        // Light reflected once
+        kDirect,
+        // Light reflected more than once
+        kIndirect,
+        // Environment and background seen directly
+        kBackground,
+#ifdef RENDER_STATS
+        // Render cost per camera sample, see RenderStats
+        kStatNodes,
+        kStatTriangles,
+        kStatShadowRays,
+        kStatPathVertices,
+        // Sample time in microseconds
+        kStatTime,
+#endif
+        // Contribution of light i through all the paths goes to kLight0 + i
+        kLight0
+    };
+
+    // Lights having their own channel
+    static const int kMaxLights = 16;
+    // Total number of channels
+    static const int kNumChannels = kLight0 + kMaxLights;
+
+    // Only channels with their bit set in mask are kept
+    explicit AovSample(unsigned int mask = 0)
+        : mask_(mask)
+    {
+    }
+
+    // Enabled channels
+    unsigned int mask() const { return mask_; }
+
+    // Check if the channel is kept
+    bool IsEnabled(int channel) const
+    {
+        return channel < kNumChannels && ((mask_ >> channel) & 0x1);
+    }
+
+    // Add contribution to the channel, ignored if the channel is disabled
+    void Add(int channel, float3 const& value)
+    {
+        if (IsEnabled(channel))
+        {
+            values_[channel] += value;
+        }
+    }
+
+    // Value of the channel
+    float3 const& Get(int channel) const { return values_[channel]; }
+
+    // Channel name: depth, normal, albedo, emission, direct, indirect, background, light0...
+    // render stats builds also have stat_nodes, stat_triangles, stat_shadowrays, stat_pathvertices and stat_time
+    static std::string GetName(int channel);
+
+    // Channel by name, -1 if there is no such channel
+    static int Find(std::string const& name);
+
+    // Number of meaningful components: 1 for depth and stats, 3 for the rest
+    static int GetNumComponents(int channel);
+
+private:
+    // Enabled channels
+    unsigned int mask_;
+    // Channel values
+    float3 values_[kNumChannels];
+};
+
+static_assert(AovSample::kNumChannels <= 32, "AOV mask is limited to 32 channels");
+
+#endif // AOV_H
@@ -39,7 +39,12 @@
 #include <condition_variable>
 #include <atomic>
 #include <future>
+#include <algorithm>
 #include <iostream>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <functional>
 
 ///< An implementation of a concurrent queue
 ///< which is providing the means to wait until 
@@ -79,6 +84,19 @@ public:
         queue_.pop();
     }
 
+    // Wait until there are elements to process or timeout expires.
+    // Returns true if element has been popped, false on timeout
+    template <typename Rep, typename Period>
+    bool wait_and_pop(T& t, std::chrono::duration<Rep, Period> const& timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!cv_.wait_for(lock, timeout, [this](){return !queue_.empty();}))
+            return false;
+        t = std::move(queue_.front());
+        queue_.pop();
+        return true;
+    }
+
     // Try to pop element. Returns true if element has been popped, 
     // false if there are no element in the queue
     bool try_pop(T& t)
@@ -99,20 +117,30 @@ private:
 
 
 ///< Thread pool implementation which is using concurrency
-///< available in the system
+///< available in the system or the number of workers given.
+///< Each worker keeps track of the time it spent running tasks,
+///< so the callers can measure how long workers wait at barriers.
 ///<
 template <typename RetType> class thread_pool
 {
 public:
-    thread_pool() 
+    // num_threads <= 0 means one worker per hardware thread
+    explicit thread_pool(int num_threads = 0)
     {
         done_ = false;
-        int num_threads = std::thread::hardware_concurrency();
+        num_threads = num_threads > 0 ? num_threads : std::thread::hardware_concurrency();
         num_threads = num_threads == 0 ? 2 : num_threads;
 
+        busy_time_.reset(new std::atomic<long long>[num_threads]);
+
+        for (int i=0; i < num_threads; ++i)
+        {
+            busy_time_[i] = 0;
+        }
+
         for (int i=0; i < num_threads; ++i)
         {
-            threads_.push_back(std::thread(&thread_pool::run_loop, this));
+            threads_.push_back(std::thread(&thread_pool::run_loop, this, i));
         }
     }
 
@@ -126,26 +154,81 @@ public:
     // order for caller to track the execution of the task
     std::future<RetType> submit(std::function<RetType()>&& f)
     {
-        std::packaged_task<RetType()> task(std::move(f));
+        // Busy time is accounted before the future is ready,
+        // so it is up to date once the caller is done waiting
+        std::function<RetType()> task_func(std::move(f));
+        std::packaged_task<RetType()> task([this, task_func]()->RetType
+        {
+            busy_timer timer(busy_time_[worker_index()]);
+            return task_func();
+        });
         auto future = task.get_future();
         work_queue_.push(std::move(task));
         return future;
     }
 
+    // Number of worker threads
+    int num_threads() const
+    {
+        return (int)threads_.size();
+    }
+
+    // Seconds the worker spent running tasks since creation or reset_busy_time
+    double busy_time(int thread) const
+    {
+        return busy_time_[thread] * 1e-9;
+    }
+
+    void reset_busy_time()
+    {
+        for (int i=0; i < num_threads(); ++i)
+        {
+            busy_time_[i] = 0;
+        }
+    }
+
 private:
-    void run_loop()
+    // Adds the lifetime of the object to the counter
+    class busy_timer
     {
+    public:
+        explicit busy_timer(std::atomic<long long>& counter)
+            : counter_(counter)
+            , starttime_(std::chrono::high_resolution_clock::now())
+        {
+        }
+
+        ~busy_timer()
+        {
+            auto endtime = std::chrono::high_resolution_clock::now();
+            counter_ += std::chrono::duration_cast<std::chrono::nanoseconds>(endtime - starttime_).count();
+        }
+
+    private:
+        std::atomic<long long>& counter_;
+        std::chrono::high_resolution_clock::time_point starttime_;
+    };
+
+    // Index of the calling worker, a thread belongs to a single pool
+    static int& worker_index()
+    {
+        static thread_local int index = 0;
+        return index;
+    }
+
+    void run_loop(int thread)
+    {
+        worker_index() = thread;
+
         std::packaged_task<RetType()> f;
         while(!done_)
         {
-            if (work_queue_.try_pop(f))
+            // Timeout only bounds the time to notice shutdown,
+            // submitted tasks wake the worker up right away
+            if (work_queue_.wait_and_pop(f, std::chrono::milliseconds(50)))
             {
                 f();
             }
-            else
-            {
-                std::this_thread::sleep_for(std::chrono::milliseconds(50));
-            }
         }
     }
 
@@ -153,6 +236,8 @@ private:
     thread_safe_queue<std::packaged_task<RetType()> > work_queue_;
     std::atomic_bool done_;
     std::vector<std::thread> threads_;
+    // Nanoseconds each worker spent running tasks
+    std::unique_ptr<std::atomic<long long>[]> busy_time_;
 };
 
 
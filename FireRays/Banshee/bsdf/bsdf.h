@@ -35,12 +35,17 @@
 
 #include "../primitive/shapebundle.h"
 #include "../texture/texturesystem.h"
+#include "shading_context.h"
+#include "closure.h"
 
 #include <string>
 
 // The macro uses texture to get value if available, otherwise sets to constant value
-#define GET_VALUE(val,tex,uv) ((tex).empty()) ? (val):texturesys_.Sample((tex), (uv), float2(0,0))
-#define MAP_NORMAL(tex, isect) if(!(tex).empty())MapNormal((tex),(isect))
+// Textures are referenced by handles resolved once at construction, negative handle means no texture
+// Values fetched in Prepare are read from the shading context, hit UV footprint selects MIP level
+#define GET_VALUE(val,tex,ctx) ((ctx).GetValue(texturesys_, (val), (tex)))
+#define FETCH_VALUE(tex,ctx) ((ctx).Fetch(texturesys_, (tex)))
+#define MAP_NORMAL(tex, isect) if((tex) >= 0)MapNormal((tex),(isect))
 
 ///< Bsdf is an abstraction for all BSDFs in the system
 ///<
@@ -69,23 +74,32 @@ public:
     // Destructor
     virtual ~Bsdf() {}
 
+    // Resolve textured inputs and shading frame at the hit point, called once per hit before any queries
+    virtual void Prepare(ShadingContext& ctx) const {}
+
     // Sample material and return outgoing ray direction along with combined BSDF value
-    virtual float3 Sample(ShapeBundle::Hit& isect, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const = 0;
+    virtual float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const = 0;
 
     // Evaluate combined BSDF value
-    virtual float3 Evaluate(ShapeBundle::Hit& isect, float3 const& wi, float3 const& wo) const = 0;
+    virtual float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const = 0;
+
+    // PDF of a given direction sampled from ctx.p
+    virtual float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const = 0;
 
-    // PDF of a given direction sampled from isect.p
-    virtual float GetPdf(ShapeBundle::Hit& isect, float3 const& wi, float3 const& wo) const = 0;
+    // Append BSDF lobes to flattened closure, false if the BSDF can't be expressed by closure lobes
+    virtual bool Compile(Closure& closure) const { return false; }
 
     // Get BSDF type
     int GetType() const { return type_; }
 
     TextureSystem const& GetTextureSystem() const { return texturesys_; }
 
+    // Apply normal mapping using given texture system
+    static void MapNormal(TextureSystem const& texturesys, int nmap, ShapeBundle::Hit& isect);
+
 protected:
     // Apply normal mapping
-    void MapNormal(std::string const& nmap, ShapeBundle::Hit& isect) const;
+    void MapNormal(int nmap, ShapeBundle::Hit& isect) const { MapNormal(texturesys_, nmap, isect); }
     
     // Texture system interface
     TextureSystem const& texturesys_;
@@ -94,7 +108,7 @@ protected:
     int type_;
 };
 
-inline void Bsdf::MapNormal(std::string const& nmap, ShapeBundle::Hit& isect) const
+inline void Bsdf::MapNormal(TextureSystem const& texturesys, int nmap, ShapeBundle::Hit& isect)
 {
     // We dont need bilinear interpolation while fetching normals
     // Use point instead
@@ -105,11 +119,13 @@ inline void Bsdf::MapNormal(std::string const& nmap, ShapeBundle::Hit& isect) co
     
     float3 du = normalize(isect.dpdu -  ndotdu * n);
     
-    float dudotdv = dot(du, isect.dpdv);
+    float3 dpdv = isect.dpdv();
+    
+    float dudotdv = dot(du, dpdv);
     
-    float3 dv = normalize(isect.dpdv - ndotdu * n - dudotdv * du);
+    float3 dv = normalize(dpdv - ndotdu * n - dudotdv * du);
     
-    float3 normal = normalize(2.f * texturesys_.Sample(nmap, isect.uv, float2(0,0), opts) - float3(1.f, 1.f, 1.f));
+    float3 normal = normalize(2.f * texturesys.Sample(nmap, isect.uv, isect.duv, opts) - float3(1.f, 1.f, 1.f));
     
     isect.n = normalize(n * normal.z + du * normal.x - dv * normal.y);
 }
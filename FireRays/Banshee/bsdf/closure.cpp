@@ -0,0 +1,420 @@
+#include "closure.h"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <math.h>
+
+#include "bsdf.h"
+#include "fresnel.h"
+#include "lambert.h"
+#include "orennayar.h"
+#include "microfacet.h"
+#include "perfect_reflect.h"
+#include "perfect_refract.h"
+
+namespace
+{
+    // Lobe kernels specialized per lobe type, k and r are resolved color and roughness
+    template <int Type> struct LobeKernel;
+
+    template <> struct LobeKernel<Closure::kLambert>
+    {
+        static float3 Sample(Closure::Lobe const& lobe, float3 const& k, float r, ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf)
+        {
+            return Lambert::SampleLobe(k, ctx, sample, wi, wo, pdf);
+        }
+
+        static float3 Evaluate(Closure::Lobe const& lobe, float3 const& k, float r, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
+        {
+            return Lambert::EvaluateLobe(k, ctx, wi, wo);
+        }
+
+        static float GetPdf(Closure::Lobe const& lobe, float r, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
+        {
+            return Lambert::GetLobePdf(ctx, wi, wo);
+        }
+    };
+
+    template <> struct LobeKernel<Closure::kOrenNayar>
+    {
+        static float3 Sample(Closure::Lobe const& lobe, float3 const& k, float r, ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf)
+        {
+            return OrenNayar::SampleLobe(k, r, ctx, sample, wi, wo, pdf);
+        }
+
+        static float3 Evaluate(Closure::Lobe const& lobe, float3 const& k, float r, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
+        {
+            return OrenNayar::EvaluateLobe(k, r, ctx, wi, wo);
+        }
+
+        static float GetPdf(Closure::Lobe const& lobe, float r, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
+        {
+            return OrenNayar::GetLobePdf(ctx, wi, wo);
+        }
+    };
+
+    // Microfacet kernels share the code, distribution is a local object of a concrete type
+    template <class Distribution> struct MicrofacetKernel
+    {
+        static float3 Sample(Closure::Lobe const& lobe, float3 const& k, float r, ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf)
+        {
+            Distribution md(r);
+            FresnelDielectric fresnel;
+            return Microfacet::SampleLobe(md, fresnel, lobe.eta, k, ctx, sample, wi, wo, pdf);
+        }
+
+        static float3 Evaluate(Closure::Lobe const& lobe, float3 const& k, float r, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
+        {
+            Distribution md(r);
+            FresnelDielectric fresnel;
+            return Microfacet::EvaluateLobe(md, fresnel, lobe.eta, k, ctx, wi, wo);
+        }
+
+        static float GetPdf(Closure::Lobe const& lobe, float r, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
+        {
+            Distribution md(r);
+            return Microfacet::GetLobePdf(md, ctx, wi, wo);
+        }
+    };
+
+    template <> struct LobeKernel<Closure::kMicrofacetBlinn> : public MicrofacetKernel<BlinnDistribution> {};
+    template <> struct LobeKernel<Closure::kMicrofacetBeckmann> : public MicrofacetKernel<BeckmannDistribution> {};
+    template <> struct LobeKernel<Closure::kMicrofacetGgx> : public MicrofacetKernel<GgxDistribution> {};
+
+    // Specular kernels, delta lobes evaluate to zero
+    template <class SpecularBsdf> struct SpecularKernel
+    {
+        static float3 Sample(Closure::Lobe const& lobe, float3 const& k, float r, ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf)
+        {
+            FresnelDielectric fresnel;
+            return SpecularBsdf::SampleLobe(lobe.fresnel ? &fresnel : nullptr, lobe.eta, k, ctx, sample, wi, wo, pdf);
+        }
+
+        static float3 Evaluate(Closure::Lobe const& lobe, float3 const& k, float r, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
+        {
+            return float3(0.f, 0.f, 0.f);
+        }
+
+        static float GetPdf(Closure::Lobe const& lobe, float r, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
+        {
+            return 0.f;
+        }
+    };
+
+    template <> struct LobeKernel<Closure::kSpecularReflect> : public SpecularKernel<PerfectReflect> {};
+    template <> struct LobeKernel<Closure::kSpecularRefract> : public SpecularKernel<PerfectRefract> {};
+
+    // Resolve lobe roughness
+    inline float GetRoughness(TextureSystem const& texsys, Closure::Lobe const& lobe, ShadingContext const& ctx)
+    {
+        return lobe.rmap < 0 ? lobe.r : ctx.GetValue(texsys, float3(lobe.r, lobe.r, lobe.r), lobe.rmap).x;
+    }
+
+    float3 SampleLobe(TextureSystem const& texsys, Closure::Lobe const& lobe, ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf)
+    {
+        float3 k = ctx.GetValue(texsys, lobe.k, lobe.kmap);
+        float r = GetRoughness(texsys, lobe, ctx);
+
+        switch (lobe.type)
+        {
+        case Closure::kLambert:
+            return LobeKernel<Closure::kLambert>::Sample(lobe, k, r, ctx, sample, wi, wo, pdf);
+        case Closure::kOrenNayar:
+            return LobeKernel<Closure::kOrenNayar>::Sample(lobe, k, r, ctx, sample, wi, wo, pdf);
+        case Closure::kMicrofacetBlinn:
+            return LobeKernel<Closure::kMicrofacetBlinn>::Sample(lobe, k, r, ctx, sample, wi, wo, pdf);
+        case Closure::kMicrofacetBeckmann:
+            return LobeKernel<Closure::kMicrofacetBeckmann>::Sample(lobe, k, r, ctx, sample, wi, wo, pdf);
+        case Closure::kMicrofacetGgx:
+            return LobeKernel<Closure::kMicrofacetGgx>::Sample(lobe, k, r, ctx, sample, wi, wo, pdf);
+        case Closure::kSpecularReflect:
+            return LobeKernel<Closure::kSpecularReflect>::Sample(lobe, k, r, ctx, sample, wi, wo, pdf);
+        case Closure::kSpecularRefract:
+            return LobeKernel<Closure::kSpecularRefract>::Sample(lobe, k, r, ctx, sample, wi, wo, pdf);
+        }
+
+        pdf = 0.f;
+        return float3(0.f, 0.f, 0.f);
+    }
+
+    float3 EvaluateLobe(TextureSystem const& texsys, Closure::Lobe const& lobe, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
+    {
+        float3 k = ctx.GetValue(texsys, lobe.k, lobe.kmap);
+        float r = GetRoughness(texsys, lobe, ctx);
+
+        switch (lobe.type)
+        {
+        case Closure::kLambert:
+            return LobeKernel<Closure::kLambert>::Evaluate(lobe, k, r, ctx, wi, wo);
+        case Closure::kOrenNayar:
+            return LobeKernel<Closure::kOrenNayar>::Evaluate(lobe, k, r, ctx, wi, wo);
+        case Closure::kMicrofacetBlinn:
+            return LobeKernel<Closure::kMicrofacetBlinn>::Evaluate(lobe, k, r, ctx, wi, wo);
+        case Closure::kMicrofacetBeckmann:
+            return LobeKernel<Closure::kMicrofacetBeckmann>::Evaluate(lobe, k, r, ctx, wi, wo);
+        case Closure::kMicrofacetGgx:
+            return LobeKernel<Closure::kMicrofacetGgx>::Evaluate(lobe, k, r, ctx, wi, wo);
+        case Closure::kSpecularReflect:
+            return LobeKernel<Closure::kSpecularReflect>::Evaluate(lobe, k, r, ctx, wi, wo);
+        case Closure::kSpecularRefract:
+            return LobeKernel<Closure::kSpecularRefract>::Evaluate(lobe, k, r, ctx, wi, wo);
+        }
+
+        return float3(0.f, 0.f, 0.f);
+    }
+
+    float GetLobePdf(TextureSystem const& texsys, Closure::Lobe const& lobe, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
+    {
+        float r = GetRoughness(texsys, lobe, ctx);
+
+        switch (lobe.type)
+        {
+        case Closure::kLambert:
+            return LobeKernel<Closure::kLambert>::GetPdf(lobe, r, ctx, wi, wo);
+        case Closure::kOrenNayar:
+            return LobeKernel<Closure::kOrenNayar>::GetPdf(lobe, r, ctx, wi, wo);
+        case Closure::kMicrofacetBlinn:
+            return LobeKernel<Closure::kMicrofacetBlinn>::GetPdf(lobe, r, ctx, wi, wo);
+        case Closure::kMicrofacetBeckmann:
+            return LobeKernel<Closure::kMicrofacetBeckmann>::GetPdf(lobe, r, ctx, wi, wo);
+        case Closure::kMicrofacetGgx:
+            return LobeKernel<Closure::kMicrofacetGgx>::GetPdf(lobe, r, ctx, wi, wo);
+        case Closure::kSpecularReflect:
+            return LobeKernel<Closure::kSpecularReflect>::GetPdf(lobe, r, ctx, wi, wo);
+        case Closure::kSpecularRefract:
+            return LobeKernel<Closure::kSpecularRefract>::GetPdf(lobe, r, ctx, wi, wo);
+        }
+
+        return 0.f;
+    }
+}
+
+Closure::Closure()
+: texturesys_(nullptr)
+, numbrdfs_(0)
+, numbtdfs_(0)
+, nmap_(-1)
+, eta_(1.f)
+{
+}
+
+void Closure::Clear()
+{
+    texturesys_ = nullptr;
+    numbrdfs_ = 0;
+    numbtdfs_ = 0;
+    nmap_ = -1;
+    eta_ = 1.f;
+}
+
+bool Closure::AddLobe(TextureSystem const& texsys, Lobe const& lobe)
+{
+    // All the textures should come from the same texture system
+    if (texturesys_ && texturesys_ != &texsys)
+        return false;
+
+    texturesys_ = &texsys;
+
+    if (lobe.flags & Bsdf::REFLECTION)
+    {
+        if (numbrdfs_ == kMaxLobes)
+            return false;
+
+        brdfs_[numbrdfs_++] = lobe;
+    }
+    else
+    {
+        if (numbtdfs_ == kMaxLobes)
+            return false;
+
+        btdfs_[numbtdfs_++] = lobe;
+    }
+
+    return true;
+}
+
+bool Closure::SetNormalMap(int nmap)
+{
+    if (nmap_ >= 0 && nmap_ != nmap)
+        return false;
+
+    nmap_ = nmap;
+    return true;
+}
+
+void Closure::Prepare(ShapeBundle::Hit const& hit, ShadingContext& ctx) const
+{
+    ctx.Reset(hit);
+
+    if (!texturesys_)
+        return;
+
+    // Alter normal if needed
+    if (nmap_ >= 0)
+    {
+        Bsdf::MapNormal(*texturesys_, nmap_, ctx);
+    }
+
+    // Fetch lobe textures
+    for (int i = 0; i < numbrdfs_; ++i)
+    {
+        ctx.Fetch(*texturesys_, brdfs_[i].kmap);
+        ctx.Fetch(*texturesys_, brdfs_[i].rmap);
+    }
+
+    for (int i = 0; i < numbtdfs_; ++i)
+    {
+        ctx.Fetch(*texturesys_, btdfs_[i].kmap);
+        ctx.Fetch(*texturesys_, btdfs_[i].rmap);
+    }
+}
+
+float3 Closure::Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf, int& type) const
+{
+    float reflectpdf = 0.f;
+    float transmitpdf = 0.f;
+    GetSelectionPdf(ctx, wi, reflectpdf, transmitpdf);
+
+    if (reflectpdf + transmitpdf == 0.f)
+    {
+        pdf = 0.f;
+        type = 0;
+        return float3(0.f, 0.f, 0.f);
+    }
+
+    // The first sample component is reused for lobe selection
+    float2 s = sample;
+    float selectionpdf = 0.f;
+    Lobe const* lobes = nullptr;
+    int numlobes = 0;
+
+    // Split between reflection and transmission based on Fresnel
+    if (s.x < reflectpdf)
+    {
+        s.x = s.x / reflectpdf;
+        selectionpdf = reflectpdf;
+        lobes = brdfs_;
+        numlobes = numbrdfs_;
+    }
+    else
+    {
+        s.x = (s.x - reflectpdf) / transmitpdf;
+        selectionpdf = transmitpdf;
+        lobes = btdfs_;
+        numlobes = numbtdfs_;
+    }
+
+    // Choose the lobe uniformly
+    int idx = std::min((int)(s.x * numlobes), numlobes - 1);
+    s.x = std::min(s.x * numlobes - idx, 0.99999f);
+
+    Lobe const& lobe = lobes[idx];
+    type = lobe.flags;
+
+    float3 f = SampleLobe(*texturesys_, lobe, ctx, s, wi, wo, pdf);
+
+    // Delta lobes can't be hit by the others, only selection probability applies
+    if (lobe.flags & Bsdf::SPECULAR)
+    {
+        pdf *= selectionpdf / numlobes;
+        return f;
+    }
+
+    if (pdf <= 0.f)
+    {
+        return f;
+    }
+
+    // Direction could have been sampled by any of the lobes,
+    // return value and PDF of the whole mixture as GetPdf does
+    for (int i = 0; i < numlobes; ++i)
+    {
+        if (i != idx)
+        {
+            f += EvaluateLobe(*texturesys_, lobes[i], ctx, wi, wo);
+        }
+    }
+
+    pdf = GetPdf(ctx, wi, wo);
+
+    return f;
+}
+
+float3 Closure::Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
+{
+    Lobe const* lobes = nullptr;
+    int numlobes = SelectLobes(ctx, wi, lobes);
+
+    float3 f;
+    for (int i = 0; i < numlobes; ++i)
+    {
+        f += EvaluateLobe(*texturesys_, lobes[i], ctx, wi, wo);
+    }
+
+    return f;
+}
+
+float Closure::GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
+{
+    // Same lobe selection probabilities Sample uses
+    float reflectpdf = 0.f;
+    float transmitpdf = 0.f;
+    GetSelectionPdf(ctx, wi, reflectpdf, transmitpdf);
+
+    float pdf = 0.f;
+
+    if (reflectpdf > 0.f)
+    {
+        float brdfpdf = 0.f;
+        for (int i = 0; i < numbrdfs_; ++i)
+        {
+            brdfpdf += GetLobePdf(*texturesys_, brdfs_[i], ctx, wi, wo);
+        }
+
+        pdf += reflectpdf * brdfpdf / numbrdfs_;
+    }
+
+    if (transmitpdf > 0.f)
+    {
+        float btdfpdf = 0.f;
+        for (int i = 0; i < numbtdfs_; ++i)
+        {
+            btdfpdf += GetLobePdf(*texturesys_, btdfs_[i], ctx, wi, wo);
+        }
+
+        pdf += transmitpdf * btdfpdf / numbtdfs_;
+    }
+
+    return pdf;
+}
+
+void Closure::GetSelectionPdf(ShadingContext const& ctx, float3 const& wi, float& reflectpdf, float& transmitpdf) const
+{
+    if (numbrdfs_ > 0 && numbtdfs_ > 0)
+    {
+        FresnelDielectric fresnel;
+        reflectpdf = fresnel.Evaluate(1.f, eta_, dot(ctx.n, wi));
+        transmitpdf = 1.f - reflectpdf;
+    }
+    else
+    {
+        reflectpdf = numbrdfs_ > 0 ? 1.f : 0.f;
+        transmitpdf = numbrdfs_ > 0 || numbtdfs_ == 0 ? 0.f : 1.f;
+    }
+}
+
+int Closure::SelectLobes(ShadingContext const& ctx, float3 const& wi, Lobe const*& lobes) const
+{
+    // Lobes handle both hemispheres themselves if there is only one set
+    if (numbtdfs_ == 0 || (numbrdfs_ > 0 && dot(ctx.n, wi) > 0.f))
+    {
+        lobes = brdfs_;
+        return numbrdfs_;
+    }
+    else
+    {
+        lobes = btdfs_;
+        return numbtdfs_;
+    }
+}
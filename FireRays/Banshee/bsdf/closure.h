@@ -0,0 +1,144 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+#ifndef CLOSURE_H
+#define CLOSURE_H
+
+#include "../texture/texturesystem.h"
+#include "shading_context.h"
+
+///< Closure is a flattened form of a material: short lists of reflection and transmission lobes
+///< stored by value. Queries switch on lobe type and call kernels specialized for concrete
+///< microfacet distribution and Fresnel, so there are no virtual calls through Bsdf,
+///< MicrofacetDistribution and Fresnel objects. Materials compile their BSDFs into it at load time.
+///<
+class Closure
+{
+public:
+    // Lobe types, each one has its own kernel
+    enum LobeType
+    {
+        kLambert,
+        kOrenNayar,
+        kMicrofacetBlinn,
+        kMicrofacetBeckmann,
+        kMicrofacetGgx,
+        kSpecularReflect,
+        kSpecularRefract
+    };
+
+    // Lobe parameters, meaning of the fields depends on the type
+    struct Lobe
+    {
+        // Lobe type
+        LobeType type;
+        // BSDF type flags
+        int flags;
+        // Diffuse albedo or specular color
+        float3 k;
+        // Color texture
+        int kmap;
+        // OrenNayar roughness, Blinn exponent or Beckmann/GGX width
+        float r;
+        // Roughness texture
+        int rmap;
+        // Refractive index
+        float eta;
+        // Whether dielectric Fresnel is applied
+        bool fresnel;
+
+        Lobe(LobeType t = kLambert, int f = 0)
+        : type(t)
+        , flags(f)
+        , k(1.f, 1.f, 1.f)
+        , kmap(-1)
+        , r(0.f)
+        , rmap(-1)
+        , eta(1.f)
+        , fresnel(false)
+        {
+        }
+    };
+
+    // Max number of reflection or transmission lobes
+    static const int kMaxLobes = 4;
+
+    // Constructor
+    Closure();
+
+    // Remove all the lobes
+    void Clear();
+
+    // Append lobe, returns false if there is no space left
+    bool AddLobe(TextureSystem const& texsys, Lobe const& lobe);
+
+    // Set normal map for all the lobes, returns false if another normal map has been set already
+    bool SetNormalMap(int nmap);
+
+    // Set refractive index used to split samples between reflection and transmission lobes
+    void SetEta(float eta) { eta_ = eta; }
+
+    // Fill shading context for the hit: map the normal and fetch lobe textures
+    void Prepare(ShapeBundle::Hit const& hit, ShadingContext& ctx) const;
+
+    // Sample closure and return outgoing ray direction along with BSDF value and sampled lobe type.
+    // For non-delta lobes PDF is the one of the whole lobe mixture, the same GetPdf returns.
+    float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf, int& type) const;
+
+    // Evaluate combined BSDF value
+    float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const;
+
+    // PDF of a given direction sampled from ctx.p
+    float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const;
+
+private:
+    // Probabilities of sampling reflection and transmission lobes, split by Fresnel if there are both
+    void GetSelectionPdf(ShadingContext const& ctx, float3 const& wi, float& reflectpdf, float& transmitpdf) const;
+
+    // Lobes wi is evaluated against: reflection lobes if wi is above the surface, transmission otherwise
+    int SelectLobes(ShadingContext const& ctx, float3 const& wi, Lobe const*& lobes) const;
+
+    // Texture system lobe textures belong to
+    TextureSystem const* texturesys_;
+    // Reflection lobes
+    Lobe brdfs_[kMaxLobes];
+    int numbrdfs_;
+    // Transmission lobes
+    Lobe btdfs_[kMaxLobes];
+    int numbtdfs_;
+    // Normal map
+    int nmap_;
+    // Refractive index for reflection/transmission split
+    float eta_;
+};
+
+#endif // CLOSURE_H
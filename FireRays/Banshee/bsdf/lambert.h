@@ -57,16 +57,49 @@ public:
             )
     : Bsdf(texturesys, REFLECTION | DIFFUSE)
     , kd_(kd)
-    , kdmap_(kdmap)
-    , nmap_(nmap)
+    , kdmap_(texturesys_.GetHandle(kdmap))
+    , nmap_(texturesys_.GetHandle(nmap))
     {
     }
     
+    // Fetch textured inputs once per hit
+    void Prepare(ShadingContext& ctx) const
+    {
+        FETCH_VALUE(kdmap_, ctx);
+    }
+    
+    // Flatten into closure lobe
+    bool Compile(Closure& closure) const
+    {
+        Closure::Lobe lobe(Closure::kLambert, GetType());
+        lobe.k = kd_;
+        lobe.kmap = kdmap_;
+        return closure.AddLobe(texturesys_, lobe);
+    }
+    
     // Sample material and return outgoing ray direction along with combined BSDF value
-    float3 Sample(ShapeBundle::Hit& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    {
+        return SampleLobe(GET_VALUE(kd_, kdmap_, ctx), ctx, sample, wi, wo, pdf);
+    }
+
+    // Evaluate combined BSDF value
+    float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
+    {
+        return EvaluateLobe(GET_VALUE(kd_, kdmap_, ctx), ctx, wi, wo);
+    }
+    
+    // Return pdf for wo to be sampled for wi
+    float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
+    {
+        return GetLobePdf(ctx, wi, wo);
+    }
+    
+    // Lobe kernels work on resolved inputs, Closure calls them directly
+    static float3 SampleLobe(float3 const& kd, ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf)
     {
         // Revert normal based on geometric normal
-        float3 n = dot(wi, hit.ng) >= 0.f ? hit.n : -hit.n;
+        float3 n = dot(wi, ctx.ng) >= 0.f ? ctx.n : -ctx.n;
         
         // Map random sample to hemisphere getting cosine weigted distribution
         wo = map_to_hemisphere(n, sample, 1.f);
@@ -76,27 +109,20 @@ public:
         
         // PDF proportional to cos
         pdf = dot(n, wo) * invpi;
-        
-        // Diffuse albedo
-        float3 kd = GET_VALUE(kd_, kdmap_, hit.uv);
        
         // Return constant diffuse albedo
         return invpi * kd;
     }
-
-    // Evaluate combined BSDF value
-    float3 Evaluate(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    
+    static float3 EvaluateLobe(float3 const& kd, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
     {
         // If wi and wo are on the same side of the surface return 1 / PI, otherwise 0.f
-        float sameside = dot(wi, hit.ng) * dot(wo, hit.ng) ;
+        float sameside = dot(wi, ctx.ng) * dot(wo, ctx.ng) ;
         
         if (sameside > 0.f)
         {
             float invpi = 1.f / PI;
             
-            // Diffuse albedo
-            float3 kd = GET_VALUE(kd_, kdmap_, hit.uv);
-            
             return invpi * kd;
         }
         else
@@ -105,16 +131,15 @@ public:
         }
     }
     
-    // Return pdf for wo to be sampled for wi
-    float GetPdf(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    static float GetLobePdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo)
     {
         // If wi and wo are on the same side of the surface return dot(n, wo) / PI, otherwise 0.f
-        float sameside = dot(wi, hit.ng) * dot(wo, hit.ng) ;
+        float sameside = dot(wi, ctx.ng) * dot(wo, ctx.ng) ;
         
         if (sameside > 0.f)
         {
             
-            float3 n = dot(wi, hit.ng) >= 0.f ? hit.n : -hit.n;
+            float3 n = dot(wi, ctx.ng) >= 0.f ? ctx.n : -ctx.n;
             
             float invpi = 1.f / PI;
             
@@ -129,9 +154,9 @@ public:
     // Diffuse color
     float3 kd_;
     // Diffuse texture
-    std::string kdmap_;
+    int kdmap_;
     // Normal texture
-    std::string nmap_;
+    int nmap_;
 };
 
 
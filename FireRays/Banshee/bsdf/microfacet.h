@@ -69,46 +69,97 @@ public:
     : Bsdf(texturesys, REFLECTION | GLOSSY)
     , eta_(eta)
     , ks_(ks)
-    , ksmap_(ksmap)
-    , nmap_(nmap)
+    , ksmap_(texturesys_.GetHandle(ksmap))
+    , nmap_(texturesys_.GetHandle(nmap))
     , fresnel_(fresnel ? fresnel : new FresnelDielectric())
     , md_(md ? md : new BlinnDistribution(10.f))
     {
     }
     
-    // Sample material and return outgoing ray direction along with combined BSDF value
-    float3 Sample(ShapeBundle::Hit& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    // Fetch textured inputs once per hit
+    void Prepare(ShadingContext& ctx) const
     {
-        ShapeBundle::Hit hitlocal = hit;
+        FETCH_VALUE(ksmap_, ctx);
+    }
+    
+    // Flatten into closure lobe, only known distributions and dielectric Fresnel are supported
+    bool Compile(Closure& closure) const
+    {
+        if (!dynamic_cast<FresnelDielectric const*>(fresnel_.get()))
+            return false;
         
-        // Revert normal if needed
-        if (dot(hit.n, wi) < 0.f)
+        Closure::Lobe lobe(Closure::kMicrofacetBlinn, GetType());
+        
+        if (BlinnDistribution const* blinn = dynamic_cast<BlinnDistribution const*>(md_.get()))
+        {
+            lobe.r = blinn->e_;
+        }
+        else if (BeckmannDistribution const* beckmann = dynamic_cast<BeckmannDistribution const*>(md_.get()))
+        {
+            lobe.type = Closure::kMicrofacetBeckmann;
+            lobe.r = beckmann->a_;
+        }
+        else if (GgxDistribution const* ggx = dynamic_cast<GgxDistribution const*>(md_.get()))
+        {
+            lobe.type = Closure::kMicrofacetGgx;
+            lobe.r = ggx->a_;
+        }
+        else
         {
-            hitlocal.n = -hitlocal.n;
-            hitlocal.dpdu = -hitlocal.dpdu;
-            hitlocal.dpdv = -hitlocal.dpdv;
+            return false;
         }
         
+        lobe.k = ks_;
+        lobe.kmap = ksmap_;
+        lobe.eta = eta_;
+        lobe.fresnel = true;
+        return closure.AddLobe(texturesys_, lobe);
+    }
+    
+    // Sample material and return outgoing ray direction along with combined BSDF value
+    float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    {
+        return SampleLobe(*md_, *fresnel_, eta_, GET_VALUE(ks_, ksmap_, ctx), ctx, sample, wi, wo, pdf);
+    }
+    
+    // Evaluate combined BSDF value
+    float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
+    {
+        return EvaluateLobe(*md_, *fresnel_, eta_, GET_VALUE(ks_, ksmap_, ctx), ctx, wi, wo);
+    }
+    
+    // Return pdf for wo to be sampled for wi
+    float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
+    {
+        return GetLobePdf(*md_, ctx, wi, wo);
+    }
+    
+    // Lobe kernels work on resolved inputs, Closure calls them directly
+    // Instantiated with concrete distribution and Fresnel types they do not need virtual calls
+    template <class Distribution, class FresnelType>
+    static float3 SampleLobe(Distribution const& md, FresnelType& fresnel, float eta, float3 const& ks, ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf)
+    {
+        // Revert shading frame if needed
+        float side = dot(ctx.n, wi) < 0.f ? -1.f : 1.f;
+        
         // Sample distribution
-        md_->Sample(hitlocal, sample, wi, wo, pdf);
+        md.Sample(side * ctx.n, side * ctx.dpdu, side * ctx.dpdv(), sample, wi, wo, pdf);
         
         // Evaluate
-        return Evaluate(hit, wi, wo);
+        return EvaluateLobe(md, fresnel, eta, ks, ctx, wi, wo);
     }
     
-    // Evaluate combined BSDF value
-    float3 Evaluate(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    template <class Distribution, class FresnelType>
+    static float3 EvaluateLobe(Distribution const& md, FresnelType& fresnel, float eta, float3 const& ks, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
     {
         // Return 0 if wo and wi are on different sides
-        float sameside = dot(wi, hit.n) * dot(wo, hit.n);
+        float sameside = dot(wi, ctx.n) * dot(wo, ctx.n);
         
         if (sameside < 0.f)
             return float3(0, 0, 0);
         
-        ShapeBundle::Hit hitlocal = hit;
-        
         // Revert normal if needed
-        float3 n = dot(hit.n, wi) < 0.f ? -hitlocal.n : hitlocal.n;
+        float3 n = dot(ctx.n, wi) < 0.f ? -ctx.n : ctx.n;
         
         // Incident and reflected zenith angles
         float cos_theta_o = dot(n, wo);
@@ -121,32 +172,24 @@ public:
         float3 wh = normalize(wi + wo);
         
         // Calc Fresnel for wh faced microfacets
-        float fresnel = fresnel_->Evaluate(1.f, eta_, dot(wi, wh));
-        
-        float3 ks = GET_VALUE(ks_, ksmap_, hit.uv);
+        float f = fresnel.Evaluate(1.f, eta, dot(wi, wh));
         
         // F(wi,wo) = D(wh)*Fresnel(wh, n)*G(wi, wo, n)/(4 * cos_theta_i * cos_theta_o)
-        return ks * (md_->D(wh, n) * md_->G(wi, wo, wh, n) * fresnel / (4.f * cos_theta_i * cos_theta_o));
+        return ks * (md.D(wh, n) * md.G(wi, wo, wh, n) * f / (4.f * cos_theta_i * cos_theta_o));
     }
     
-    // Return pdf for wo to be sampled for wi
-    float GetPdf(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    template <class Distribution>
+    static float GetLobePdf(Distribution const& md, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
     {
         // Return 0 if wo and wi are on different sides
-        float sameside = dot(wi, hit.n) * dot(wo, hit.n);
+        float sameside = dot(wi, ctx.n) * dot(wo, ctx.n);
         if (sameside < 0.f)
             return 0.f;
         
-        ShapeBundle::Hit hitlocal = hit;
-        
-        if (dot(hitlocal.n, wi) < 0)
-        {
-            hitlocal.n = -hitlocal.n;
-            hitlocal.dpdu = -hitlocal.dpdu;
-            hitlocal.dpdv = -hitlocal.dpdv;
-        }
+        // Revert normal if needed
+        float3 n = dot(ctx.n, wi) < 0.f ? -ctx.n : ctx.n;
         
-        return md_->GetPdf(hitlocal, wi, wo);
+        return md.GetPdf(n, wi, wo);
     }
     
 private:
@@ -156,9 +199,9 @@ private:
     // IOR
     float eta_;
     // Diffuse texture
-    std::string ksmap_;
+    int ksmap_;
     // Normal texture
-    std::string nmap_;
+    int nmap_;
     // Fresnel component
     std::unique_ptr<Fresnel> fresnel_;
     // Microfacet distribution
@@ -13,10 +13,10 @@ public:
     virtual ~MicrofacetDistribution(){}
     // w - microfacet orientation (normal), n - surface normal
     virtual float D(float3 const& w, float3 const& n) const = 0;
-    // Sample the direction accordingly to this distribution
-    virtual void Sample(ShapeBundle::Hit const& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const = 0;
+    // Sample the direction accordingly to this distribution, n, dpdu and dpdv form the shading frame
+    virtual void Sample(float3 const& n, float3 const& dpdu, float3 const& dpdv, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const = 0;
     // PDF of the given direction
-    virtual float GetPdf(ShapeBundle::Hit const& hit, float3 const& wi, float3 const& wo) const = 0;
+    virtual float GetPdf(float3 const& n, float3 const& wi, float3 const& wo) const = 0;
     // Shadowing function also depends on microfacet distribution
     virtual float G(float3 const& wi, float3 const& wo, float3 const& wh, float3 const& n ) const = 0;
 };
@@ -41,7 +41,7 @@ public:
     }
     
     // Sample the distribution
-    void Sample(ShapeBundle::Hit const& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    void Sample(float3 const& n, float3 const& dpdu, float3 const& dpdv, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
     {
         // Sample halfway vector first, then reflect wi around that
         float costheta = std::pow(sample.x, 1.f / (e_ + 1.f));
@@ -52,22 +52,22 @@ public:
         float sinphi = std::sin(2.f*PI*sample.y);
         
         // Calculate wh
-        float3 wh = normalize(hit.dpdu * sintheta * cosphi + hit.dpdv * sintheta * sinphi + hit.n * costheta);
+        float3 wh = normalize(dpdu * sintheta * cosphi + dpdv * sintheta * sinphi + n * costheta);
         
         // Reflect wi around wh
         wo = -wi + 2.f*dot(wi, wh) * wh;
         
         // Calc pdf
-        pdf = GetPdf(hit, wi, wo);
+        pdf = GetPdf(n, wi, wo);
     }
     
     // PDF of the given direction
-    float GetPdf(ShapeBundle::Hit const& hit, float3 const& wi, float3 const& wo) const
+    float GetPdf(float3 const& n, float3 const& wi, float3 const& wo) const
     {
         // We need to convert pdf(wh)->pdf(wo)
         float3 wh = normalize(wi + wo);
         // costheta
-        float ndotwh = dot(hit.n, wh);
+        float ndotwh = dot(n, wh);
         // See Humphreys and Pharr for derivation
         return ((e_ + 1.f) * std::pow(ndotwh, e_)) / (2.f * PI * 4.f * dot (wo,wh));
     }
@@ -120,7 +120,7 @@ public:
     }
     
     // Sample the distribution
-    void Sample(ShapeBundle::Hit const& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    void Sample(float3 const& n, float3 const& dpdu, float3 const& dpdv, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
     {
         // Sample halfway vector first, then reflect wi around that
         float temp = std::atan(std::sqrt(-a_*a_*std::log(1.f - sample.x)));
@@ -134,22 +134,22 @@ public:
         float sinphi = std::sin(2.f*PI*sample.y);
         
         // Calculate wh
-        float3 wh = normalize(hit.dpdu * sintheta * cosphi + hit.dpdv * sintheta * sinphi + hit.n * costheta);
+        float3 wh = normalize(dpdu * sintheta * cosphi + dpdv * sintheta * sinphi + n * costheta);
         
         // Reflect wi around wh
         wo = -wi + 2.f*dot(wi, wh) * wh;
         
         // Calc pdf
-        pdf = GetPdf(hit, wi, wo);
+        pdf = GetPdf(n, wi, wo);
     }
     
     // PDF of the given direction
-    float GetPdf(ShapeBundle::Hit const& hit, float3 const& wi, float3 const& wo) const
+    float GetPdf(float3 const& n, float3 const& wi, float3 const& wo) const
     {
         // We need to convert pdf(wh)->pdf(wo)
         float3 m = normalize(wi + wo);
         //
-        float mpdf = D(m, hit.n) * std::abs(dot(hit.n, m));
+        float mpdf = D(m, n) * std::abs(dot(n, m));
         // See Humphreys and Pharr for derivation
         //assert(!isnan(mpdf));
         return mpdf / (4.f * dot (wo, m));
@@ -221,7 +221,7 @@ public:
     }
     
     // Sample the distribution
-    void Sample(ShapeBundle::Hit const& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    void Sample(float3 const& n, float3 const& dpdu, float3 const& dpdv, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
     {
         // Sample halfway vector first, then reflect wi around that
         float temp = std::atan(a_ * std::sqrt(sample.x) / std::sqrt(1.f - sample.x));
@@ -235,22 +235,22 @@ public:
         float sinphi = std::sin(2.f*PI*sample.y);
         
         // Calculate wh
-        float3 wh = normalize(hit.dpdu * sintheta * cosphi + hit.dpdv * sintheta * sinphi + hit.n * costheta);
+        float3 wh = normalize(dpdu * sintheta * cosphi + dpdv * sintheta * sinphi + n * costheta);
         
         // Reflect wi around wh
         wo = -wi + 2.f*dot(wi, wh) * wh;
         
         // Calc pdf
-        pdf = GetPdf(hit, wi, wo);
+        pdf = GetPdf(n, wi, wo);
     }
     
     // PDF of the given direction
-    float GetPdf(ShapeBundle::Hit const& hit, float3 const& wi, float3 const& wo) const
+    float GetPdf(float3 const& n, float3 const& wi, float3 const& wo) const
     {
         // We need to convert pdf(wh)->pdf(wo)
         float3 m = normalize(wi + wo);
         //
-        float mpdf = D(m, hit.n) * std::abs(dot(hit.n, m));
+        float mpdf = D(m, n) * std::abs(dot(n, m));
         // See Humphreys and Pharr for derivation
         //assert(!isnan(mpdf));
         return mpdf / (4.f * dot (wo, m));
@@ -49,36 +49,41 @@ public:
                   )
     : Bsdf(bsdf->GetTextureSystem(), bsdf->GetType())
     , bsdf_(bsdf)
-    , nmap_(nmap)
+    , nmap_(texturesys_.GetHandle(nmap))
     {
     }
     
-    // Sample material and return outgoing ray direction along with combined BSDF value
-    float3 Sample(ShapeBundle::Hit& isect, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    // Map the normal once per hit, enclosed BSDF sees the mapped shading frame
+    void Prepare(ShadingContext& ctx) const
     {
         // Alter normal if needed
-        MAP_NORMAL(nmap_, isect);
+        MAP_NORMAL(nmap_, ctx);
         //
-        return bsdf_->Sample(isect, sample, wi, wo, pdf);
+        bsdf_->Prepare(ctx);
+    }
+    
+    // Flatten enclosed BSDF, normal map applies to the whole closure
+    bool Compile(Closure& closure) const
+    {
+        return bsdf_->Compile(closure) && (nmap_ < 0 || closure.SetNormalMap(nmap_));
+    }
+    
+    // Sample material and return outgoing ray direction along with combined BSDF value
+    float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    {
+        return bsdf_->Sample(ctx, sample, wi, wo, pdf);
     }
     
     // Evaluate combined BSDF value
-    float3 Evaluate(ShapeBundle::Hit& isect, float3 const& wi, float3 const& wo) const
+    float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
     {
-        // Alter normal if needed
-        MAP_NORMAL(nmap_, isect);
-        //
-        return bsdf_->Evaluate(isect, wi, wo);
+        return bsdf_->Evaluate(ctx, wi, wo);
     }
     
-    // PDF of a given direction sampled from isect.p
-    float GetPdf(ShapeBundle::Hit& isect, float3 const& wi, float3 const& wo) const
+    // PDF of a given direction sampled from ctx.p
+    float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
     {
-        ShapeBundle::Hit isectlocal = isect;
-        // Alter normal if needed
-        MAP_NORMAL(nmap_, isectlocal);
-        //
-        return bsdf_->GetPdf(isectlocal, wi, wo);
+        return bsdf_->GetPdf(ctx, wi, wo);
     }
     
     // Get BSDF type
@@ -87,7 +92,7 @@ public:
 protected:
     Bsdf* bsdf_;
     //
-    std::string nmap_;
+    int nmap_;
     
 };
 
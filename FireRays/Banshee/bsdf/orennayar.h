@@ -64,17 +64,53 @@ public:
     : Bsdf(texturesys, REFLECTION | DIFFUSE)
     , kd_(kd)
     , kr_(kr)
-    , kdmap_(kdmap)
-    , krmap_(krmap)
-    , nmap_(nmap)
+    , kdmap_(texturesys_.GetHandle(kdmap))
+    , krmap_(texturesys_.GetHandle(krmap))
+    , nmap_(texturesys_.GetHandle(nmap))
     {
     }
     
+    // Fetch textured inputs once per hit
+    void Prepare(ShadingContext& ctx) const
+    {
+        FETCH_VALUE(kdmap_, ctx);
+        FETCH_VALUE(krmap_, ctx);
+    }
+    
+    // Flatten into closure lobe
+    bool Compile(Closure& closure) const
+    {
+        Closure::Lobe lobe(Closure::kOrenNayar, GetType());
+        lobe.k = kd_;
+        lobe.kmap = kdmap_;
+        lobe.r = kr_;
+        lobe.rmap = krmap_;
+        return closure.AddLobe(texturesys_, lobe);
+    }
+    
     // Sample material and return outgoing ray direction along with combined BSDF value
-    float3 Sample(ShapeBundle::Hit& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    {
+        return SampleLobe(GET_VALUE(kd_, kdmap_, ctx), GET_VALUE(kr_, krmap_, ctx).x, ctx, sample, wi, wo, pdf);
+    }
+    
+    // Evaluate combined BSDF value
+    float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
+    {
+        return EvaluateLobe(GET_VALUE(kd_, kdmap_, ctx), GET_VALUE(kr_, krmap_, ctx).x, ctx, wi, wo);
+    }
+    
+    // Return pdf for wo to be sampled for wi
+    float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
+    {
+        return GetLobePdf(ctx, wi, wo);
+    }
+    
+    // Lobe kernels work on resolved inputs, Closure calls them directly
+    static float3 SampleLobe(float3 const& kd, float kr, ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf)
     {
         // Revert normal based on ORIGINAL normal, not mapped one
-        float3 n = dot(wi, hit.n) >= 0.f ? hit.n : -hit.n;
+        float3 n = dot(wi, ctx.n) >= 0.f ? ctx.n : -ctx.n;
         
         // Map random sample to hemisphere getting cosine weigted distribution
         wo = map_to_hemisphere(n, sample, 1.f);
@@ -86,31 +122,28 @@ public:
         pdf = dot(n, wo) * invpi;
         
         // Evaluate
-        return Evaluate(hit, wi, wo);
+        return EvaluateLobe(kd, kr, ctx, wi, wo);
     }
     
-    // Evaluate combined BSDF value
-    float3 Evaluate(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    static float3 EvaluateLobe(float3 const& kd, float kr, ShadingContext const& ctx, float3 const& wi, float3 const& wo)
     {
         // Return 0 if wo and wi are on different sides
-        float sameside = dot(wi, hit.n) * dot(wo, hit.n) ;
+        float sameside = dot(wi, ctx.n) * dot(wo, ctx.n) ;
         if (sameside < 0.f)
             return float3(0, 0, 0);
         
-        float3 n = hit.n;
-        float3 s = hit.dpdu;
-        float3 t = hit.dpdv;
+        float3 n = ctx.n;
+        float3 s = ctx.dpdu;
+        float3 t = ctx.dpdv();
         
         // Revert normal based on ORIGINAL normal, not mapped one
-        if (dot(wi, hit.n) < 0.f)
+        if (dot(wi, ctx.n) < 0.f)
         {
             n = -n;
             s = -s;
             t = -t;
         }
         
-        // Get roughness value
-        float kr = GET_VALUE(kr_, krmap_, hit.uv).x;
         float invpi = 1.f / PI;
         float r2 = kr*kr;
         
@@ -151,20 +184,17 @@ public:
             tan_beta = sin_theta_o / cos_theta_o;
         }
         
-        float3 kd = GET_VALUE(kd_, kdmap_, hit.uv);
-        
         return kd * float3(invpi, invpi, invpi) * (a + b * maxcos * sin_alpha * tan_beta);
     }
     
-    // Return pdf for wo to be sampled for wi
-    float GetPdf(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    static float GetLobePdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo)
     {
         // If wi and wo are on the same side of the surface
-        float sameside = dot(wi, hit.n) * dot(wo, hit.n);
+        float sameside = dot(wi, ctx.n) * dot(wo, ctx.n);
         
         if (sameside > 0.f)
         {
-            float3 n = dot(wi, hit.n) >= 0.f ? hit.n : -hit.n;
+            float3 n = dot(wi, ctx.n) >= 0.f ? ctx.n : -ctx.n;
             
             float invpi = 1.f / PI;
             
@@ -182,11 +212,11 @@ private:
     // Roughness value
     float kr_;
     // Diffuse texture
-    std::string kdmap_;
+    int kdmap_;
     // Roughness map
-    std::string krmap_;
+    int krmap_;
     // Normal texture
-    std::string nmap_;
+    int nmap_;
 };
 
 
@@ -70,18 +70,60 @@ public:
     : Bsdf(texturesys, REFLECTION | SPECULAR)
     , eta_(eta)
     , ks_(ks)
-    , ksmap_(ksmap)
-    , nmap_(nmap)
+    , ksmap_(texturesys_.GetHandle(ksmap))
+    , nmap_(texturesys_.GetHandle(nmap))
     , fresnel_(fresnel)
     {
         
     }
     
+    // Fetch textured inputs once per hit
+    void Prepare(ShadingContext& ctx) const
+    {
+        FETCH_VALUE(ksmap_, ctx);
+    }
+    
+    // Flatten into closure lobe, only dielectric Fresnel is supported
+    bool Compile(Closure& closure) const
+    {
+        if (fresnel_ && !dynamic_cast<FresnelDielectric const*>(fresnel_.get()))
+            return false;
+        
+        Closure::Lobe lobe(Closure::kSpecularReflect, GetType());
+        lobe.k = ks_;
+        lobe.kmap = ksmap_;
+        lobe.eta = eta_;
+        lobe.fresnel = fresnel_ != nullptr;
+        return closure.AddLobe(texturesys_, lobe);
+    }
+    
     // Sample material and return outgoing ray direction along with combined BSDF value
-    float3 Sample(ShapeBundle::Hit& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    {
+        return SampleLobe(fresnel_.get(), eta_, GET_VALUE(ks_, ksmap_, ctx), ctx, sample, wi, wo, pdf);
+    }
+    
+    // Evaluate combined BSDF value
+    float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
+    {
+        // Delta function, so 0.f
+        return float3(0.f, 0.f, 0.f);
+    }
+    
+    // Return pdf for wo to be sampled for wi
+    float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
+    {
+        // Delta function, so 0.f
+        return 0.f;
+    }
+    
+    // Lobe kernel works on resolved inputs, Closure calls it directly
+    // Fresnel is optional, pass nullptr to disable it
+    template <class FresnelType>
+    static float3 SampleLobe(FresnelType* fresnel, float eta, float3 const& ks, ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf)
     {
         // Revert normal based on ORIGINAL normal, not mapped one
-        float3 n = dot(wi, hit.n) >= 0.f ? hit.n : -hit.n;
+        float3 n = dot(wi, ctx.n) >= 0.f ? ctx.n : -ctx.n;
         
         // Mirror reflect wi
         wo = normalize(2.f * dot(n, wi) * n - wi);
@@ -90,39 +132,22 @@ public:
         // so set it to 1.f
         pdf = 1.f;
 
-        // Get reflect color value
-        float3 ks = GET_VALUE(ks_, ksmap_, hit.uv);
-
         // If Fresnel is used calculate Fresnel reflectance using ORIGINAL normal to
         // correctly determine reflected and transmitted parts
-        float reflectance = fresnel_ ? fresnel_->Evaluate(1.f, eta_, dot(wi, hit.n)) : 1.f;
+        float reflectance = fresnel ? fresnel->Evaluate(1.f, eta, dot(wi, ctx.n)) : 1.f;
 
         float ndotwi = dot(n, wi);
 
         // Return reflectance value
         return ndotwi > FLT_EPSILON ? (reflectance * ks * (1.f / ndotwi)) : float3(0.f, 0.f, 0.f);
     }
-
-    // Evaluate combined BSDF value
-    float3 Evaluate(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
-    {
-        // Delta function, so 0.f
-        return float3(0.f, 0.f, 0.f);
-    }
-    
-    // Return pdf for wo to be sampled for wi
-    float GetPdf(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
-    {
-        // Delta function, so 0.f
-        return 0.f;
-    }
     
     // Specular reflect color
     float3 ks_;
     // Specular reflect texture
-    std::string ksmap_;
+    int ksmap_;
     // Normal texture
-    std::string nmap_;
+    int nmap_;
     // Fresnel component
     std::unique_ptr<Fresnel> fresnel_;
     // Refractive index
@@ -36,6 +36,7 @@
 #include "../math/mathutils.h"
 
 #include "bsdf.h"
+#include "fresnel.h"
 ///< In optics, refraction is a phenomenon that often occurs when waves travel 
 ///< from a medium with a given refractive index to a medium with another at an oblique angle.
 ///< At the boundary between the media, the wave's phase velocity is altered, usually causing a change in direction. 
@@ -64,36 +65,78 @@ public:
     : Bsdf(texturesys, TRANSMISSION | SPECULAR)
     , eta_(eta)
     , ks_(ks)
-    , ksmap_(ksmap)
-    , nmap_(nmap)
+    , ksmap_(texturesys_.GetHandle(ksmap))
+    , nmap_(texturesys_.GetHandle(nmap))
     , fresnel_(fresnel)
     {
     }
 
+    // Fetch textured inputs once per hit
+    void Prepare(ShadingContext& ctx) const
+    {
+        FETCH_VALUE(ksmap_, ctx);
+    }
+    
+    // Flatten into closure lobe, only dielectric Fresnel is supported
+    bool Compile(Closure& closure) const
+    {
+        if (fresnel_ && !dynamic_cast<FresnelDielectric const*>(fresnel_.get()))
+            return false;
+        
+        Closure::Lobe lobe(Closure::kSpecularRefract, GetType());
+        lobe.k = ks_;
+        lobe.kmap = ksmap_;
+        lobe.eta = eta_;
+        lobe.fresnel = fresnel_ != nullptr;
+        return closure.AddLobe(texturesys_, lobe);
+    }
+    
     // Sample material and return outgoing ray direction along with combined BSDF value
-    float3 Sample(ShapeBundle::Hit& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf) const
+    {
+        return SampleLobe(fresnel_.get(), eta_, GET_VALUE(ks_, ksmap_, ctx), ctx, sample, wi, wo, pdf);
+    }
+    
+    // Evaluate combined BSDF value
+    float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
+    {
+        // Delta function, return 0
+        return float3(0.f, 0.f, 0.f);
+    }
+    
+    // Return pdf for wo to be sampled for wi
+    float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
+    {
+        // Delta function, return 0
+        return 0.f;
+    }
+
+    // Lobe kernel works on resolved inputs, Closure calls it directly
+    // Fresnel is optional, pass nullptr to disable it
+    template <class FresnelType>
+    static float3 SampleLobe(FresnelType* fresnel, float etat, float3 const& ks, ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf)
     {
         // Revert normal based on ORIGINAL normal, not mapped one
         float3 n;
         float eta;
-        float ndotwi = dot(wi, hit.n);
+        float ndotwi = dot(wi, ctx.n);
         
         // Revert normal and eta if needed
         if (ndotwi >= 0.f)
         {
-            n = hit.n;
-            eta = eta_;
+            n = ctx.n;
+            eta = etat;
         }
         else
         {
-            n = -hit.n;
-            eta = 1 / eta_;
+            n = -ctx.n;
+            eta = 1 / etat;
             ndotwi = -ndotwi;
         }
 
-        // Use original hit.n here to make sure IOR ordering is correct
+        // Use original ctx.n here to make sure IOR ordering is correct
         // as we could have reverted normal and eta
-        float reflectance = fresnel_ ? fresnel_->Evaluate(1.f, eta_, dot(wi, hit.n)) : 0.f;
+        float reflectance = fresnel ? fresnel->Evaluate(1.f, etat, dot(wi, ctx.n)) : 0.f;
 
         // If not TIR return transmitance BSDF
         if (reflectance < 1.f)
@@ -108,9 +151,6 @@ public:
             // so set it to 1.f
             pdf = 1.f;
             
-            // Get refract color value
-            float3 ks = GET_VALUE(ks_, ksmap_, hit.uv);
-            
             // Account for reflectance
             return ndotwi > FLT_EPSILON ? ((1.f/(eta*eta)) * (1.f - reflectance)*ks*(1.f / ndotwi)) : float3(0.f, 0.f, 0.f);
         }
@@ -122,27 +162,13 @@ public:
             return float3(0.f, 0.f, 0.f);
         }
     }
-
-    // Evaluate combined BSDF value
-    float3 Evaluate(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
-    {
-        // Delta function, return 0
-        return float3(0.f, 0.f, 0.f);
-    }
     
-    // Return pdf for wo to be sampled for wi
-    float GetPdf(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
-    {
-        // Delta function, return 0
-        return 0.f;
-    }
-
     // Specular refract color
     float3 ks_;
     // Specular refract texture
-    std::string ksmap_;
+    int ksmap_;
     // Normal texture
-    std::string nmap_;
+    int nmap_;
     // Fresnel component
     std::unique_ptr<Fresnel> fresnel_;
     // Refractive index
@@ -0,0 +1,106 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+#ifndef SHADING_CONTEXT_H
+#define SHADING_CONTEXT_H
+
+#include "../primitive/shapebundle.h"
+#include "../texture/texturesystem.h"
+
+///< ShadingContext is a hit point prepared for shading. Material fills it once per hit:
+///< the normal is replaced with the mapped one and material textures are fetched into a small cache,
+///< so all subsequent Sample/Evaluate/GetPdf queries at this point do not go to the texture system.
+///<
+class ShadingContext : public ShapeBundle::Hit
+{
+public:
+    // Max number of distinct textures cached per hit
+    static const int kMaxValues = 8;
+
+    // Constructor
+    ShadingContext()
+    : numvalues_(0)
+    {
+    }
+
+    // Start shading a new hit point, drops cached values
+    void Reset(ShapeBundle::Hit const& hit)
+    {
+        static_cast<ShapeBundle::Hit&>(*this) = hit;
+        numvalues_ = 0;
+    }
+
+    // Fetch texture value at the hit point and keep it, no-op for negative handles and cached textures
+    void Fetch(TextureSystem const& texsys, int tex)
+    {
+        if (tex < 0 || Find(tex) >= 0 || numvalues_ == kMaxValues)
+            return;
+
+        handles_[numvalues_] = tex;
+        values_[numvalues_] = texsys.Sample(tex, uv, duv);
+        ++numvalues_;
+    }
+
+    // Get cached texture value, val if there is no texture
+    // Textures which have not been fetched are sampled directly
+    float3 GetValue(TextureSystem const& texsys, float3 const& val, int tex) const
+    {
+        if (tex < 0)
+            return val;
+
+        int idx = Find(tex);
+
+        return idx >= 0 ? values_[idx] : texsys.Sample(tex, uv, duv);
+    }
+
+private:
+    // Find cache slot holding the texture, -1 if none
+    int Find(int tex) const
+    {
+        for (int i = 0; i < numvalues_; ++i)
+        {
+            if (handles_[i] == tex)
+                return i;
+        }
+
+        return -1;
+    }
+
+    // Cached texture handles
+    int handles_[kMaxValues];
+    // Cached texture values
+    float3 values_[kMaxValues];
+    // Number of cached values
+    int numvalues_;
+};
+
+#endif // SHADING_CONTEXT_H
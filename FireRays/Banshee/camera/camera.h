@@ -51,6 +51,13 @@ public:
 
     ///< sample is a value in [0,1] square describing where to sample the image plane
     virtual void GenerateRay(float2 const& sample, ray& r) const = 0;
+
+    ///< dsample is the size of the pixel footprint in the same [0,1] space,
+    ///< the camera uses it to fill in ray cone of the generated ray
+    virtual void GenerateRay(float2 const& sample, float2 const& dsample, ray& r) const
+    {
+        GenerateRay(sample, r);
+    }
 };
 
 #endif // CAMERA_H
\ No newline at end of file
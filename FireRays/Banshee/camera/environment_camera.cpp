@@ -3,6 +3,7 @@
 #include "../math/mathutils.h"
 
 #include <cmath>
+#include <algorithm>
 
 EnvironmentCamera::EnvironmentCamera(float3 const& eye, float3 const& at, float3 const& up, float2 const& zcap)
 : p_(eye)
@@ -45,3 +46,15 @@ void EnvironmentCamera::GenerateRay(float2 const& sample, ray& r) const
     // Zcap == (znear,zfar)
     r.t = float2(zcap_.x, zcap_.y);
 }
+
+void EnvironmentCamera::GenerateRay(float2 const& sample, float2 const& dsample, ray& r) const
+{
+    GenerateRay(sample, r);
+
+    // Pixel spans 2*PI*dx in phi and PI*dy in theta,
+    // phi extent shrinks with sin(theta) towards the poles
+    float thetha = PI - sample.y * PI;
+
+    r.width = 0.f;
+    r.spread = std::max(2 * PI * dsample.x * sinf(thetha), PI * dsample.y);
+}
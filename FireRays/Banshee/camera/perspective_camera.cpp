@@ -1,6 +1,7 @@
 #include "perspective_camera.h"
 
 #include <cmath>
+#include <algorithm>
 
 PerscpectiveCamera::PerscpectiveCamera(float3 const& eye, float3 const& at, float3 const& up, 
                        float2 const& zcap, float fovy, float aspect) 
@@ -35,4 +36,25 @@ void PerscpectiveCamera::GenerateRay(float2 const& sample, ray& r) const
     r.d = normalize(zcap_.x * forward_ + csample.x * right_ + csample.y * up_);
     // Zcap == (znear,zfar)
     r.t = float2(zcap_.x, zcap_.y);
+}
+
+void PerscpectiveCamera::GenerateRay(float2 const& sample, float2 const& dsample, ray& r) const
+{
+    GenerateRay(sample, r);
+
+    // Unnormalized direction and its differentials along image plane axes
+    float2 csample = (sample - float2(0.5f, 0.5f)) * dim_;
+    float3 v = zcap_.x * forward_ + csample.x * right_ + csample.y * up_;
+    float3 dvdx = dsample.x * dim_.x * right_;
+    float3 dvdy = dsample.y * dim_.y * up_;
+
+    // d(v/|v|) = (dv * |v|^2 - v * dot(v, dv)) / |v|^3
+    float vv = dot(v, v);
+    float invlen3 = 1.f / (vv * std::sqrt(vv));
+    float3 dddx = (dvdx * vv - v * dot(v, dvdx)) * invlen3;
+    float3 dddy = (dvdy * vv - v * dot(v, dvdy)) * invlen3;
+
+    // Pinhole: zero width, spread is the angular size of the pixel
+    r.width = 0.f;
+    r.spread = std::max(std::sqrt(dddx.sqnorm()), std::sqrt(dddy.sqnorm()));
 }
\ No newline at end of file
@@ -53,6 +53,9 @@ public:
     ///< sample is a value in [0,1] square describing where to sample the image plane
     void GenerateRay(float2 const& sample, ray& r) const;
 
+    ///< dsample is the size of the pixel footprint, ray gets its cone filled in
+    void GenerateRay(float2 const& sample, float2 const& dsample, ray& r) const;
+
 protected:
     // Camera coordinate frame
     float3 forward_;
@@ -0,0 +1,139 @@
+#include "atrous_denoiser.h"
+
+#include "../math/sseutils.h"
+
+#include <cmath>
+#include <algorithm>
+#include <future>
+
+// Number of rows processed by a single task
+#define BANDSIZE 16
+
+// Squared distance between xyz parts of two vectors
+static float SqDistance(float3 const& a, float3 const& b)
+{
+    __m128 d = _mm_sub_ps(_mm_loadu_ps(&a.x), _mm_loadu_ps(&b.x));
+    d = _mm_mul_ps(d, d);
+    // w lane is not a part of the distance
+    d = _mm_and_ps(d, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)));
+    d = _mm_add_ps(d, _mm_movehl_ps(d, d));
+    d = _mm_add_ss(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(d);
+}
+
+void AtrousDenoiser::Apply(FeatureBuffer const& features, std::vector<float3>& color) const
+{
+    int2 res = features.resolution();
+    int numpixels = res.x * res.y;
+
+    // Resolve features once for all the iterations
+    std::vector<float3> albedo(numpixels);
+    std::vector<float3> normal(numpixels);
+    std::vector<float> depth(numpixels);
+
+    for (int i = 0; i < numpixels; ++i)
+    {
+        albedo[i] = features.albedo(i);
+        normal[i] = features.normal(i);
+        depth[i] = features.depth(i);
+    }
+
+    // B3 spline
+    static const float kernel[5] = { 1.f / 16, 1.f / 4, 3.f / 8, 1.f / 4, 1.f / 16 };
+
+    std::vector<float3> temp(numpixels);
+    std::vector<float3>* src = &color;
+    std::vector<float3>* dst = &temp;
+
+    float colorsigma = colorsigma_;
+
+    for (int iter = 0; iter < numiterations_; ++iter)
+    {
+        int step = 1 << iter;
+
+        float colorscale = 1.f / (colorsigma * colorsigma);
+        float albedoscale = 1.f / (albedosigma_ * albedosigma_);
+        float normalscale = 1.f / (normalsigma_ * normalsigma_);
+
+        std::vector<float3> const& in = *src;
+        std::vector<float3>& out = *dst;
+
+        std::vector<std::future<int> > futures;
+
+        for (int band = 0; band < res.y; band += BANDSIZE)
+        {
+            futures.push_back(threadpool_.submit([&, band, step, colorscale, albedoscale, normalscale]()->int
+            {
+                for (int y = band; y < std::min(band + BANDSIZE, res.y); ++y)
+                    for (int x = 0; x < res.x; ++x)
+                    {
+                        int idx = y * res.x + x;
+
+                        float3 const& cp = in[idx];
+                        float3 const& ap = albedo[idx];
+                        float3 const& np = normal[idx];
+                        float zp = depth[idx];
+
+                        __m128 sum = _mm_setzero_ps();
+                        float weightsum = 0.f;
+
+                        for (int j = -2; j <= 2; ++j)
+                        {
+                            int yy = y + j * step;
+
+                            if (yy < 0 || yy >= res.y)
+                                continue;
+
+                            for (int i = -2; i <= 2; ++i)
+                            {
+                                int xx = x + i * step;
+
+                                if (xx < 0 || xx >= res.x)
+                                    continue;
+
+                                int q = yy * res.x + xx;
+
+                                // Background only blends with background
+                                float zq = depth[q];
+                                if ((zp > 0.f) != (zq > 0.f))
+                                    continue;
+
+                                float e = SqDistance(cp, in[q]) * colorscale;
+                                e += SqDistance(ap, albedo[q]) * albedoscale;
+                                e += SqDistance(np, normal[q]) * normalscale;
+
+                                if (zp > 0.f)
+                                {
+                                    e += std::abs(zp - zq) / (depthsigma_ * zp * step * std::max(std::abs(i), std::abs(j)) + 1e-5f);
+                                }
+
+                                float w = kernel[i + 2] * kernel[j + 2] * std::exp(-e);
+
+                                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w), _mm_loadu_ps(&in[q].x)));
+                                weightsum += w;
+                            }
+                        }
+
+                        // Center tap has weight > 0, so the sum is never empty
+                        float3 result;
+                        _mm_storeu_ps(&result.x, _mm_mul_ps(sum, _mm_set1_ps(1.f / weightsum)));
+                        result.w = cp.w;
+                        out[idx] = result;
+                    }
+
+                return 0;
+            }));
+        }
+
+        std::for_each(futures.begin(), futures.end(), std::mem_fun_ref(&std::future<int>::wait));
+
+        std::swap(src, dst);
+        colorsigma *= 0.5f;
+    }
+
+    // Result of the last iteration might be in the temporary buffer
+    if (src != &color)
+    {
+        color.swap(*src);
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+
+#ifndef ATROUS_DENOISER_H
+#define ATROUS_DENOISER_H
+
+#include "../async/thread_pool.h"
+#include "denoiser.h"
+
+///< Edge-avoiding a-trous wavelet filter
+///< H. Dammertz et al., "Edge-Avoiding A-Trous Wavelet Transform for fast Global Illumination Filtering", 2010
+///< Each iteration applies 5x5 B3 spline kernel with taps spread 2^i pixels apart,
+///< tap weights are damped by color, albedo, normal and depth differences.
+///< Color sigma is halved every iteration, so once the noise is gone
+///< the filter stops blurring the remaining detail. Rows are processed in
+///< parallel and pixel differences are computed with SSE.
+///<
+class AtrousDenoiser : public Denoiser
+{
+public:
+    // Sigmas control how fast tap weight falls off with the difference:
+    // color and albedo ones are absolute, normal one is for the distance between unit normals,
+    // depth one is relative to the depth of the pixel and the distance to the tap.
+    // numthreads <= 0 uses all hardware threads
+    AtrousDenoiser(int numiterations = 5,
+                   float colorsigma = 0.5f,
+                   float albedosigma = 0.1f,
+                   float normalsigma = 0.2f,
+                   float depthsigma = 0.05f,
+                   int numthreads = 0)
+        : numiterations_(numiterations)
+        , colorsigma_(colorsigma)
+        , albedosigma_(albedosigma)
+        , normalsigma_(normalsigma)
+        , depthsigma_(depthsigma)
+        , threadpool_(numthreads)
+    {
+    }
+
+    // Denoise linear color in place
+    void Apply(FeatureBuffer const& features, std::vector<float3>& color) const;
+
+private:
+    // Number of filter iterations
+    int numiterations_;
+    // Edge stopping sigmas
+    float colorsigma_;
+    float albedosigma_;
+    float normalsigma_;
+    float depthsigma_;
+    // Thread pool for row bands
+    mutable thread_pool<int> threadpool_;
+};
+
+#endif // ATROUS_DENOISER_H
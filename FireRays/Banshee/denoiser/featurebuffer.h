@@ -0,0 +1,119 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+
+#ifndef FEATUREBUFFER_H
+#define FEATUREBUFFER_H
+
+#include <vector>
+
+#include "../math/float3.h"
+#include "../math/int2.h"
+
+///< FeatureBuffer collects auxiliary per-pixel data of the primary hits:
+///< albedo, shading normal and depth, averaged over pixel samples.
+///< Denoisers use it to tell geometric and texture edges from noise.
+///< Pixels are stored row by row starting from y = 0.
+///<
+class FeatureBuffer
+{
+public:
+    FeatureBuffer(int2 const& res)
+        : res_(res)
+        , albedo_(res.x * res.y)
+        , normal_(res.x * res.y)
+    {
+    }
+
+    // Drop all the samples
+    void Clear()
+    {
+        std::fill(albedo_.begin(), albedo_.end(), float3(0.f, 0.f, 0.f, 0.f));
+        std::fill(normal_.begin(), normal_.end(), float3(0.f, 0.f, 0.f, 0.f));
+    }
+
+    // Add primary hit data of a pixel sample, rays which missed the geometry
+    // should pass zero normal and depth
+    void AddSample(int2 const& pos, float3 const& albedo, float3 const& normal, float depth)
+    {
+        if (pos.x < 0 || pos.y < 0 || pos.x >= res_.x || pos.y >= res_.y)
+            return;
+
+        int idx = pos.y * res_.x + pos.x;
+        // Sample count goes into w of the albedo and depth into w of the normal
+        albedo_[idx] += albedo;
+        albedo_[idx].w += 1.f;
+        normal_[idx] += normal;
+        normal_[idx].w += depth;
+    }
+
+    // Resolution
+    int2 resolution() const { return res_; }
+
+    // Memory held by the buffers in bytes
+    std::size_t GetSizeInBytes() const
+    {
+        return (albedo_.capacity() + normal_.capacity()) * sizeof(float3);
+    }
+
+    // Average albedo of the pixel
+    float3 albedo(int idx) const
+    {
+        float w = albedo_[idx].w;
+        return w > 0.f ? float3(albedo_[idx].x / w, albedo_[idx].y / w, albedo_[idx].z / w) : float3();
+    }
+
+    // Average normal of the pixel, zero if all the samples missed the geometry
+    float3 normal(int idx) const
+    {
+        float3 n = float3(normal_[idx].x, normal_[idx].y, normal_[idx].z);
+        n.normalize();
+        return n;
+    }
+
+    // Average depth of the pixel
+    float depth(int idx) const
+    {
+        float w = albedo_[idx].w;
+        return w > 0.f ? normal_[idx].w / w : 0.f;
+    }
+
+private:
+    // Resolution
+    int2 res_;
+    // Albedo sums and sample counts
+    std::vector<float3> albedo_;
+    // Normal and depth sums
+    std::vector<float3> normal_;
+};
+
+#endif // FEATUREBUFFER_H
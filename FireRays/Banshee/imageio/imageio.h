@@ -36,6 +36,8 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <stdexcept>
 
 class ImageIo
 {
@@ -57,15 +59,87 @@ public:
         }
     };
 
+    // Named layer of a multi-layer image, pixels are interleaved
+    struct Layer
+    {
+        std::string name;
+        unsigned nchannels;
+        std::vector<float> data;
+
+        Layer()
+        {
+        }
+
+        Layer(std::string const& n, unsigned nc)
+            : name(n)
+            , nchannels(nc)
+        {
+        }
+    };
+
     ImageIo(){}
     virtual ~ImageIo(){}
     virtual void Read(std::string const& name,  std::vector<float>& data, ImageDesc& desc) = 0;
     virtual void Write(std::string const& name, std::vector<float> const& data, ImageDesc const& desc) = 0;
 
+    // Read image resolution and number of channels without decoding pixels
+    // Default implementation reads the whole image
+    virtual void ReadInfo(std::string const& name, ImageDesc& desc);
+
+    // Read pixels of [x0,x1)x[y0,y1) region, desc receives region size
+    // Default implementation reads the whole image and crops it
+    virtual void ReadRegion(std::string const& name, unsigned x0, unsigned y0, unsigned x1, unsigned y1, std::vector<float>& data, ImageDesc& desc);
+
+    // Write layers of the same resolution as a single multi-layer image
+    // Default implementation writes a file per layer adding layer name
+    // before the extension: image.exr -> image.normal.exr
+    virtual void WriteLayers(std::string const& name, std::vector<Layer> const& layers, unsigned xres, unsigned yres);
+
 protected:
     ImageIo(ImageIo const&);
     ImageIo& operator = (ImageIo const&);
 };
 
+inline void ImageIo::ReadInfo(std::string const& name, ImageDesc& desc)
+{
+    std::vector<float> data;
+    Read(name, data, desc);
+}
+
+inline void ImageIo::ReadRegion(std::string const& name, unsigned x0, unsigned y0, unsigned x1, unsigned y1, std::vector<float>& data, ImageDesc& desc)
+{
+    std::vector<float> image;
+    ImageDesc imagedesc;
+    Read(name, image, imagedesc);
+
+    x1 = std::min(x1, imagedesc.xres);
+    y1 = std::min(y1, imagedesc.yres);
+
+    if (x0 >= x1 || y0 >= y1)
+    {
+        throw std::runtime_error("Invalid image region");
+    }
+
+    unsigned nc = imagedesc.nchannels;
+    desc = ImageDesc(x1 - x0, y1 - y0, nc);
+    data.resize(desc.xres * desc.yres * nc);
+
+    for (unsigned y = y0; y < y1; ++y)
+    {
+        std::copy(image.begin() + (y * imagedesc.xres + x0) * nc, image.begin() + (y * imagedesc.xres + x1) * nc, data.begin() + (y - y0) * desc.xres * nc);
+    }
+}
+
+inline void ImageIo::WriteLayers(std::string const& name, std::vector<Layer> const& layers, unsigned xres, unsigned yres)
+{
+    std::string::size_type dot = name.find_last_of('.');
+    std::string stem = dot == std::string::npos ? name : name.substr(0, dot);
+    std::string ext = dot == std::string::npos ? "" : name.substr(dot);
+
+    for (auto& layer : layers)
+    {
+        Write(stem + "." + layer.name + ext, layer.data, ImageDesc(xres, yres, layer.nchannels));
+    }
+}
 
 #endif // IMAGEIO_H
\ No newline at end of file
@@ -1,5 +1,11 @@
 #include "oiioimageio.h"
 
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "../util/profiler.h"
+
 #ifndef __linux__
 #include "OpenImageIO/imageio.h"
 #else
@@ -9,8 +15,41 @@
 
 OIIO_NAMESPACE_USING
 
+// Image kept open for region reads
+struct OiioImageIo::OpenFile
+{
+    OpenFile(ImageInput* i)
+        : in(i)
+        , nextscanline(0)
+        , lastuse(0)
+    {
+    }
+
+    ~OpenFile()
+    {
+        in->close ();
+        delete in;
+    }
+
+    ImageInput* in;
+    // First scanline not decoded yet
+    unsigned nextscanline;
+    unsigned lastuse;
+};
+
+OiioImageIo::OiioImageIo()
+    : clock_(0)
+{
+}
+
+OiioImageIo::~OiioImageIo()
+{
+}
+
 void OiioImageIo::Read(std::string const& name, std::vector<float>& data, ImageDesc& desc)
 {
+    PROFILE_SCOPE("OiioImageIo::Read");
+
     ImageInput* in = ImageInput::open (name);
 
     if (!in)
@@ -39,6 +78,8 @@ void OiioImageIo::Read(std::string const& name, std::vector<float>& data, ImageD
 
 void OiioImageIo::Write(std::string const& name, std::vector<float> const& data, ImageDesc const& desc)
 {
+    PROFILE_SCOPE("OiioImageIo::Write");
+
     ImageOutput* out = ImageOutput::create(name);
 
     if (!out)
@@ -54,3 +95,168 @@ void OiioImageIo::Write(std::string const& name, std::vector<float> const& data,
 
     delete out;
 }
+
+void OiioImageIo::ReadInfo(std::string const& name, ImageDesc& desc)
+{
+    PROFILE_SCOPE("OiioImageIo::ReadInfo");
+
+    ImageInput* in = ImageInput::open (name);
+
+    if (!in)
+    {
+        throw std::runtime_error("Can't load image file");
+    }
+
+    const ImageSpec &spec = in->spec();
+
+    desc.xres = spec.width;
+    desc.yres = spec.height;
+    desc.nchannels = spec.nchannels;
+
+    in->close ();
+
+    delete in;
+}
+
+void OiioImageIo::ReadRegion(std::string const& name, unsigned x0, unsigned y0, unsigned x1, unsigned y1, std::vector<float>& data, ImageDesc& desc)
+{
+    PROFILE_SCOPE("OiioImageIo::ReadRegion");
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    OpenFile& file = GetFile(name, y0);
+
+    const ImageSpec &spec = file.in->spec();
+
+    unsigned xres = spec.width;
+    unsigned yres = spec.height;
+    unsigned channels = spec.nchannels;
+
+    x1 = std::min(x1, xres);
+    y1 = std::min(y1, yres);
+
+    if (x0 >= x1 || y0 >= y1)
+    {
+        throw std::runtime_error("Invalid image region");
+    }
+
+    // Decode only the scanlines covering the region and crop them
+    std::vector<float> scanlines(xres * (y1 - y0) * channels);
+
+    file.in->read_scanlines (spec.y + y0, spec.y + y1, 0, TypeDesc::FLOAT, &scanlines[0]);
+    file.nextscanline = y1;
+
+    desc.xres = x1 - x0;
+    desc.yres = y1 - y0;
+    desc.nchannels = channels;
+
+    data.resize(desc.xres * desc.yres * channels);
+
+    for (unsigned y = 0; y < desc.yres; ++y)
+    {
+        std::copy(scanlines.begin() + (y * xres + x0) * channels, scanlines.begin() + (y * xres + x1) * channels, data.begin() + y * desc.xres * channels);
+    }
+}
+
+OiioImageIo::OpenFile& OiioImageIo::GetFile(std::string const& name, unsigned y0)
+{
+    auto iter = files_.find(name);
+
+    if (iter != files_.end())
+    {
+        OpenFile& file = *iter->second;
+
+        // Tiled images seek freely, scanline ones only forward
+        if (file.in->spec().tile_width > 0 || y0 >= file.nextscanline)
+        {
+            file.lastuse = ++clock_;
+            return file;
+        }
+
+        files_.erase(iter);
+    }
+
+    if ((int)files_.size() >= kMaxOpenFiles)
+    {
+        auto lru = files_.begin();
+
+        for (auto i = files_.begin(); i != files_.end(); ++i)
+        {
+            if (i->second->lastuse < lru->second->lastuse)
+            {
+                lru = i;
+            }
+        }
+
+        files_.erase(lru);
+    }
+
+    ImageInput* in = ImageInput::open (name);
+
+    if (!in)
+    {
+        throw std::runtime_error("Can't load image file");
+    }
+
+    std::unique_ptr<OpenFile> file(new OpenFile(in));
+    file->lastuse = ++clock_;
+
+    OpenFile& result = *file;
+    files_[name] = std::move(file);
+    return result;
+}
+
+void OiioImageIo::WriteLayers(std::string const& name, std::vector<Layer> const& layers, unsigned xres, unsigned yres)
+{
+    PROFILE_SCOPE("OiioImageIo::WriteLayers");
+
+    ImageOutput* out = ImageOutput::create(name);
+
+    if (!out)
+    {
+        throw std::runtime_error("Can't create image file on disk");
+    }
+
+    // Formats limited to RGBA get a file per layer
+    if (!out->supports("nchannels"))
+    {
+        delete out;
+        ImageIo::WriteLayers(name, layers, xres, yres);
+        return;
+    }
+
+    static char const* components[] = { "R", "G", "B", "A" };
+
+    ImageSpec spec(xres, yres, 0, TypeDesc::FLOAT);
+    spec.channelnames.clear();
+
+    for (auto& layer : layers)
+    {
+        for (unsigned c = 0; c < layer.nchannels; ++c)
+        {
+            spec.channelnames.push_back(layer.name + "." + (layer.nchannels == 1 ? "Z" : components[c]));
+        }
+    }
+
+    spec.nchannels = (int)spec.channelnames.size();
+
+    // Interleave the layers
+    std::vector<float> data(xres * yres * spec.nchannels);
+
+    for (unsigned i = 0; i < xres * yres; ++i)
+    {
+        float* pixel = &data[i * spec.nchannels];
+
+        for (auto& layer : layers)
+        {
+            std::copy(layer.data.begin() + i * layer.nchannels, layer.data.begin() + (i + 1) * layer.nchannels, pixel);
+            pixel += layer.nchannels;
+        }
+    }
+
+    out->open(name, spec);
+    out->write_image(TypeDesc::FLOAT, &data[0]);
+    out->close();
+
+    delete out;
+}
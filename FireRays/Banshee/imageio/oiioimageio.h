@@ -33,13 +33,47 @@
 #ifndef OIIOIMAGEIO_H
 #define OIIOIMAGEIO_H
 
+#include <map>
+#include <memory>
+#include <mutex>
+
 #include "imageio.h"
 
 class OiioImageIo : public ImageIo
 {
 public:
+    // Maximum number of images kept open for region reads
+    static int const kMaxOpenFiles = 32;
+
+    OiioImageIo();
+    ~OiioImageIo();
+
     void Read(std::string const& name, std::vector<float>& data, ImageDesc& desc);
     void Write(std::string const& name, std::vector<float> const& data, ImageDesc const& desc);
+    void ReadInfo(std::string const& name, ImageDesc& desc);
+    // Scanline formats (PNG, JPEG) decode from the first row after opening, so images
+    // are kept open between calls and reads further down continue where the previous one ended
+    void ReadRegion(std::string const& name, unsigned x0, unsigned y0, unsigned x1, unsigned y1, std::vector<float>& data, ImageDesc& desc);
+    // Formats with arbitrary number of channels (OpenEXR) get all the layers in one file
+    // as layer.R, layer.G, ... float channels, single channel layers get layer.Z
+    void WriteLayers(std::string const& name, std::vector<Layer> const& layers, unsigned xres, unsigned yres);
+
+private:
+    struct OpenFile;
+
+    // Get image open for reading from scanline y0, reopen it if it has been decoded past y0.
+    // Called under the lock.
+    OpenFile& GetFile(std::string const& name, unsigned y0);
+
+    // Open images by name
+    std::map<std::string, std::unique_ptr<OpenFile> > files_;
+    // Access clock used to close least recently used images
+    unsigned clock_;
+    // Guards open images
+    std::mutex mutex_;
+
+    OiioImageIo(OiioImageIo const&);
+    OiioImageIo& operator = (OiioImageIo const&);
 };
 
 
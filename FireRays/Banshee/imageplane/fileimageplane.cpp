@@ -1,6 +1,8 @@
 #include "fileimageplane.h"
 
 #include "../math/mathutils.h"
+#include "../util/profiler.h"
+#include "../util/memoryreport.h"
 #include <cmath>
 #include <cassert>
 
@@ -10,20 +12,87 @@ void FileImagePlane::Prepare()
 {
 }
 
+void FileImagePlane::GetMemoryUsage(MemoryReport& report) const
+{
+    ImagePlane::GetMemoryUsage(report);
+    report.Add("film.color", m_imgbuf.capacity() * sizeof(float3));
+}
+
 void FileImagePlane::Finalize()
 {
+    PROFILE_SCOPE("FileImagePlane::Finalize");
+
     auto res = resolution();
+
+    // Average the samples, the buffer is stored bottom up
+    std::vector<float3> color(res.x * res.y);
+    for (int y = 0; y < res.y; ++y)
+        for (int x = 0; x < res.x; ++x)
+        {
+            float3 const& value = m_imgbuf[res.x * (res.y - 1 - y) + x];
+            color[res.x * y + x] = value.w > 0.f ? value * (1.f / value.w) : float3();
+        }
+
+    Denoise(color);
+
     std::vector<float> plaindata(res.x * res.y * 3);
 
-    for (int i = 0; i < res.x * res.y; ++i)
+    for (int y = 0; y < res.y; ++y)
+        for (int x = 0; x < res.x; ++x)
+        {
+            int i = res.x * (res.y - 1 - y) + x;
+            float3 const& value = color[res.x * y + x];
+            plaindata[3 * i] = powf(std::max(value.x, 0.f), 1.f / 2.2f);
+            plaindata[3 * i + 1] = powf(std::max(value.y, 0.f), 1.f / 2.2f);
+            plaindata[3 * i + 2] = powf(std::max(value.z, 0.f), 1.f / 2.2f);
+        }
+
+    m_io.Write(m_filename, plaindata, ImageIo::ImageDesc(res.x, res.y, 3));
+
+    if (GetAovMask())
     {
-        float w = m_imgbuf[i].w;
-        plaindata[3 * i] = powf(m_imgbuf[i].x / w, 1.f / 2.2f);
-        plaindata[3 * i + 1] = powf(m_imgbuf[i].y / w, 1.f / 2.2f);
-        plaindata[3 * i + 2] = powf(m_imgbuf[i].z / w, 1.f / 2.2f);
+        WriteAovs(color);
     }
+}
 
-    m_io.Write(m_filename, plaindata, ImageIo::ImageDesc(res.x, res.y, 3));
+void FileImagePlane::WriteAovs(std::vector<float3> const& color) const
+{
+    auto res = resolution();
+
+    std::vector<ImageIo::Layer> layers;
+
+    // Image rows go bottom up
+    auto addlayer = [&](std::string const& name, int nc, std::vector<float3> const& src)
+    {
+        layers.push_back(ImageIo::Layer(name, nc));
+        layers.back().data.resize(res.x * res.y * nc);
+
+        for (int y = 0; y < res.y; ++y)
+            for (int x = 0; x < res.x; ++x)
+            {
+                int i = res.x * (res.y - 1 - y) + x;
+
+                for (int c = 0; c < nc; ++c)
+                {
+                    layers.back().data[nc * i + c] = src[res.x * y + x][c];
+                }
+            }
+    };
+
+    // Linear color goes first
+    addlayer("color", 3, color);
+
+    std::vector<float3> aov;
+    for (int channel = 0; channel < AovSample::kNumChannels; ++channel)
+    {
+        if (GetAovMask() & (1u << channel))
+        {
+            GetAov(channel, aov);
+            addlayer(AovSample::GetName(channel), AovSample::GetNumComponents(channel), aov);
+        }
+    }
+
+    m_io.WriteLayers(m_aovfilename, layers, res.x, res.y);
 }
 
 void FileImagePlane::WriteSample(int2 const& pos, float3 const& value)
@@ -41,7 +41,9 @@
 
 ///< File image plane is designed to 
 ///< collect rendering results and output
-///< those into an image file
+///< those into an image file.
+///< If AOVs are enabled they are written into a separate
+///< multi-layer image along with linear color.
 ///<
 class FileImagePlane : public ImagePlane
 {
@@ -49,6 +51,7 @@ public:
     FileImagePlane(std::string filename, int2 res, ImageIo& io, ImageFilter* filter = nullptr)
         : ImagePlane(res, filter) 
         , m_filename(filename)
+        , m_aovfilename(filename.substr(0, filename.find_last_of('.')) + "_aovs.exr")
         , m_io(io)
         , m_imgbuf(res.x * res.y)
     {
@@ -61,6 +64,12 @@ public:
 
     // This method is called by the renderer after adding all the samples
     void Finalize() override;
+
+    // Set file name for the AOV image, default one is <name>_aovs.exr
+    void SetAovFileName(std::string const& filename) { m_aovfilename = filename; }
+
+    // Report accumulation buffer along with base film buffers
+    void GetMemoryUsage(MemoryReport& report) const override;
     
 protected:
 	// Add sample to the pixel at position pos
@@ -68,8 +77,13 @@ protected:
     void WriteSample(int2 const& pos, float3 const& value) override;
 
 private:
+    // Write linear color and AOVs into the AOV image
+    void WriteAovs(std::vector<float3> const& color) const;
+
     // File name to write to
     std::string m_filename;
+    // File name to write AOVs to
+    std::string m_aovfilename;
     // IO object
     ImageIo& m_io;
     // Intermediate image buffer
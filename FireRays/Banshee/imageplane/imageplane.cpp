@@ -1,5 +1,9 @@
 #include "imageplane.h"
 #include "../filter/imagefilter.h"
+#include "../util/memoryreport.h"
+
+#include <stdexcept>
+#include <algorithm>
 
 ImagePlane::~ImagePlane() = default;
 
@@ -36,3 +40,85 @@ void ImagePlane::AddSample(float2 const& pos, float3 const& value)
 		WriteSample(intpos, value);
 	}
 }
+
+void ImagePlane::SetDenoiser(Denoiser* denoiser)
+{
+	m_denoiser.reset(denoiser);
+	m_features.reset(denoiser ? new FeatureBuffer(m_res) : nullptr);
+}
+
+void ImagePlane::Denoise(std::vector<float3>& color) const
+{
+	if (m_denoiser)
+	{
+		m_denoiser->Apply(*m_features, color);
+	}
+}
+
+void ImagePlane::AddAov(int channel)
+{
+	if (channel < 0 || channel >= AovSample::kNumChannels)
+	{
+		throw std::runtime_error("Invalid AOV channel");
+	}
+
+	m_aovmask |= (1u << channel);
+	m_aovs[channel].resize(m_res.x * m_res.y);
+}
+
+void ImagePlane::AddAovSample(int2 const& pos, AovSample const& aovs)
+{
+	unsigned int mask = m_aovmask & aovs.mask();
+
+	if (!mask || pos.x < 0 || pos.y < 0 || pos.x >= m_res.x || pos.y >= m_res.y)
+		return;
+
+	int idx = pos.y * m_res.x + pos.x;
+
+	for (int channel = 0; mask; ++channel, mask >>= 1)
+	{
+		if (mask & 0x1)
+		{
+			float3& value = m_aovs[channel][idx];
+			value += aovs.Get(channel);
+			value.w += 1.f;
+		}
+	}
+}
+
+void ImagePlane::GetAov(int channel, std::vector<float3>& data) const
+{
+	std::vector<float3> const& aov = m_aovs[channel];
+
+	data.assign(m_res.x * m_res.y, float3());
+
+	for (int i = 0; i < (int)aov.size(); ++i)
+	{
+		data[i] = aov[i].w > 0.f ? aov[i] * (1.f / aov[i].w) : float3();
+		data[i].w = 0.f;
+	}
+}
+
+void ImagePlane::ClearAovs()
+{
+	for (auto& aov : m_aovs)
+	{
+		std::fill(aov.begin(), aov.end(), float3(0.f, 0.f, 0.f, 0.f));
+	}
+}
+
+void ImagePlane::GetMemoryUsage(MemoryReport& report) const
+{
+	std::size_t aovbytes = 0;
+	for (auto& aov : m_aovs)
+	{
+		aovbytes += aov.capacity() * sizeof(float3);
+	}
+
+	report.Add("film.aovs", aovbytes);
+
+	if (m_features)
+	{
+		report.Add("film.features", m_features->GetSizeInBytes());
+	}
+}
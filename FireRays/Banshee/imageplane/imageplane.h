@@ -36,13 +36,22 @@
 #include "../math/float3.h"
 #include "../math/int2.h"
 #include "../filter/imagefilter.h"
+#include "../denoiser/denoiser.h"
+#include "../aov/aov.h"
 #include <memory>
+#include <vector>
 
+class MemoryReport;
 
 ///< ImagePlane class represents an image plane and
 ///< is designed for the Renderer to write its result to.
 ///< Note that default image plane doesn't guarantee
 ///< atomicity of operations.
+///< If a denoiser is attached the image plane also keeps
+///< a feature buffer for the renderer to write primary hit data to,
+///< and the result is denoised when the plane is finalized.
+///< Image plane also accumulates any set of arbitrary output
+///< variables (AOVs) the tracer emits alongside radiance.
 ///<
 class ImagePlane
 {
@@ -67,6 +76,32 @@ public:
 	// 
 	void AddSample(float2 const& pos, float3 const& value);
 
+	// Attach denoiser, image plane takes the ownership
+	// nullptr disables denoising along with the feature buffer
+	void SetDenoiser(Denoiser* denoiser);
+
+	// Feature buffer for the renderer, nullptr if there is no denoiser
+	FeatureBuffer* GetFeatureBuffer() const;
+
+	// Accumulate AOV channel, see AovSample::Channel
+	void AddAov(int channel);
+
+	// Mask of the accumulated channels for the renderer to request from the tracer
+	unsigned int GetAovMask() const;
+
+	// Add accumulated channels of the sample to the pixel at position pos,
+	// AOVs are not filtered and are averaged over pixel samples
+	void AddAovSample(int2 const& pos, AovSample const& aovs);
+
+	// Average value of the channel laid out row by row starting from y = 0
+	void GetAov(int channel, std::vector<float3>& data) const;
+
+	// Drop AOV samples
+	void ClearAovs();
+
+	// Report memory held by film buffers, derived classes add their own
+	virtual void GetMemoryUsage(MemoryReport& report) const;
+
 protected:
 	// Add sample to the pixel at position pos
 	// pos should be in the range of [0..res.x]x[0..res.y]
@@ -75,9 +110,19 @@ protected:
 	// Access to image filter
 	ImageFilter const* GetImageFilter() const;
 
+	// Denoise averaged linear color laid out row by row starting from y = 0,
+	// does nothing if there is no denoiser
+	void Denoise(std::vector<float3>& color) const;
+
 private:
 	// Image filter to use
 	std::unique_ptr<ImageFilter> m_image_filter;
+	// Denoiser and its guide buffers
+	std::unique_ptr<Denoiser> m_denoiser;
+	std::unique_ptr<FeatureBuffer> m_features;
+	// AOV accumulation buffers, sample count goes to w
+	std::vector<std::vector<float3> > m_aovs;
+	unsigned int m_aovmask;
 	// Resolution
 	int2 m_res;
 };
@@ -85,6 +130,8 @@ private:
 inline ImagePlane::ImagePlane(int2 const& res, ImageFilter* imgfilter)
 	: m_res(res)
 	, m_image_filter(imgfilter)
+	, m_aovs(AovSample::kNumChannels)
+	, m_aovmask(0)
 {
 }
 
@@ -98,6 +145,16 @@ inline ImageFilter const* ImagePlane::GetImageFilter() const
 	return m_image_filter.get();
 }
 
+inline FeatureBuffer* ImagePlane::GetFeatureBuffer() const
+{
+	return m_features.get();
+}
+
+inline unsigned int ImagePlane::GetAovMask() const
+{
+	return m_aovmask;
+}
+
 
 
 #endif
@@ -13,22 +13,30 @@
 #include "../material/simplematerial.h"
 #include "../bsdf/lambert.h"
 #include "../primitive/mesh.h"
-#include "../light/arealight.h"
+#include "../light/meshlight.h"
+#include "../util/profiler.h"
+#include "scenecache.h"
 
 using namespace Assimp;
 
 void AssimpAssetImporter::Import()
 {
+    PROFILE_SCOPE("AssimpAssetImporter::Import");
+
     Importer importer;
 
-    const aiScene* scene = importer.ReadFile(
-        filename_,
-        aiProcess_Triangulate |
-        aiProcess_JoinIdenticalVertices |
-        aiProcess_SortByPType |
-        aiProcess_GenNormals |
-        aiProcess_GenUVCoords
-        );
+    const aiScene* scene = nullptr;
+    {
+        PROFILE_SCOPE("Assimp::ReadFile");
+        scene = importer.ReadFile(
+            filename_,
+            aiProcess_Triangulate |
+            aiProcess_JoinIdenticalVertices |
+            aiProcess_SortByPType |
+            aiProcess_GenNormals |
+            aiProcess_GenUVCoords
+            );
+    }
 
     if( !scene)
     {
@@ -43,6 +51,8 @@ void AssimpAssetImporter::Import()
     // their indices when importing geometry
     for (int i = 0; i < (int)scene->mNumMaterials; ++i)
     {
+        PROFILE_SCOPE("AssimpAssetImporter::Material");
+
         aiMaterial* material = scene->mMaterials[i];
 
         std::string kdmap ="";
@@ -78,10 +88,12 @@ void AssimpAssetImporter::Import()
         float3 ke = float3(emission.r, emission.b, emission.g);
 
         Material* m = nullptr;
+        bool emissive = ke.sqnorm() > 0.f || matname == aiString("light");
+        float3 le = 0.6f * float3(60.f,55.f,40.f);
 
-        if (ke.sqnorm() > 0.f || matname == aiString("light"))
+        if (emissive)
         {
-            m = new Emissive(0.6f * float3(60.f,55.f,40.f));
+            m = new Emissive(le);
         }
         else
         {
@@ -94,6 +106,20 @@ void AssimpAssetImporter::Import()
             ai2idx[material] = idx;
             idx2mat[idx] = m;
         }
+
+        if (cache_)
+        {
+            int idx = ai2idx[material];
+
+            if (emissive)
+            {
+                cache_->AddEmissiveMaterial(idx, le);
+            }
+            else
+            {
+                cache_->AddLambertMaterial(idx, kd, kdmap, nmap);
+            }
+        }
     }
 
 
@@ -102,6 +128,8 @@ void AssimpAssetImporter::Import()
     std::vector<int> materials;
     for (int m = 0; m < (int)scene->mNumMeshes; ++m)
     {
+        PROFILE_SCOPE("AssimpAssetImporter::Mesh");
+
         const aiMesh* mesh = scene->mMeshes[m];
 
         // Collect mesh indices
@@ -134,12 +162,17 @@ void AssimpAssetImporter::Import()
             onprimitive_(mymesh);
         }
 
+        int cachemesh = cache_ ? cache_->AddMesh(*mymesh) : -1;
+
         if (onlight_ && idx2mat[mat]->IsEmissive())
         {
-            for (size_t i = 0; i < mymesh->GetNumShapes(); ++i)
+            // The whole mesh is a single light
+            MeshLight* light = new MeshLight(*mymesh, *idx2mat[mat]);
+            onlight_(light);
+
+            if (cache_)
             {
-                AreaLight* light = new AreaLight(i, *mymesh, *idx2mat[mat]);
-                onlight_(light);
+                cache_->AddMeshLight(cachemesh, mat);
             }
         }
     }
@@ -37,6 +37,8 @@
 
 #include "assetimporter.h"
 
+class SceneCacheWriter;
+
 ///< AssetImporter defines a callback interface for various 
 ///< asset file loaders. Set appropriate callbacks and call
 ///< Import() method to start import process
@@ -47,14 +49,21 @@ public:
     AssimpAssetImporter(TextureSystem const& texsys, std::string const& filename)
         : AssetImporter(texsys)
         , filename_(filename)
+        , cache_(nullptr)
     {
     }
 
     void Import();
 
+    // Record materials, meshes and lights imported into scene cache writer,
+    // nullptr disables recording
+    void SetCacheWriter(SceneCacheWriter* cache) { cache_ = cache; }
+
 private:
     // Asset file name
     std::string filename_;
+    // Scene cache recording the import
+    SceneCacheWriter* cache_;
 };
 
 
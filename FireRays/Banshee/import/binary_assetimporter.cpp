@@ -0,0 +1,255 @@
+#include "binary_assetimporter.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+#include "../material/emissive.h"
+#include "../material/simplematerial.h"
+#include "../bsdf/lambert.h"
+#include "../primitive/mesh.h"
+#include "../light/meshlight.h"
+#include "../light/pointlight.h"
+#include "../light/directional_light.h"
+#include "../camera/perspective_camera.h"
+#include "../accelerator/bvh.h"
+#include "../util/profiler.h"
+
+// Check that face indices stay inside the mesh arrays
+static bool IsValidIndex(int idx, std::uint32_t num)
+{
+    return idx >= 0 && idx < (int)num;
+}
+
+static bool IsValidFace(Mesh::Face const& face, SceneCache::MeshRecord const& record, std::uint32_t nummaterials)
+{
+    return IsValidIndex(face.vi0, record.numvertices) && IsValidIndex(face.vi1, record.numvertices) && IsValidIndex(face.vi2, record.numvertices) &&
+           IsValidIndex(face.ni0, record.numnormals) && IsValidIndex(face.ni1, record.numnormals) && IsValidIndex(face.ni2, record.numnormals) &&
+           IsValidIndex(face.ti0, std::max(record.numuvs, 1u)) && IsValidIndex(face.ti1, std::max(record.numuvs, 1u)) && IsValidIndex(face.ti2, std::max(record.numuvs, 1u)) &&
+           IsValidIndex(face.m, nummaterials);
+}
+
+BinaryAssetImporter::BinaryAssetImporter(TextureSystem const& texsys, std::string const& filename, std::string const& source)
+    : AssetImporter(texsys)
+    , filename_(filename)
+    , file_(filename)
+    , header_(nullptr)
+{
+    header_ = GetArray<SceneCache::Header>(0, 1);
+
+    if (std::memcmp(header_->magic, SceneCache::kMagic, sizeof(header_->magic)) != 0)
+    {
+        throw std::runtime_error("BinaryAssetImporter: Not a scene cache " + filename_);
+    }
+
+    if (header_->version != SceneCache::kVersion ||
+        header_->headersize != sizeof(SceneCache::Header) ||
+        header_->facesize != sizeof(Mesh::Face) ||
+        header_->nodesize != sizeof(Bvh::PackedNode))
+    {
+        throw std::runtime_error("BinaryAssetImporter: Scene cache is written by incompatible version " + filename_);
+    }
+
+    if (header_->numcameras > 1)
+    {
+        throw std::runtime_error("BinaryAssetImporter: Corrupted scene cache " + filename_);
+    }
+
+    if (!source.empty())
+    {
+        SceneCache::SourceRecord const* sources = GetArray<SceneCache::SourceRecord>(header_->sources, header_->numsources);
+
+        if (header_->numsources == 0 || GetString(sources[0].path) != source)
+        {
+            throw std::runtime_error("BinaryAssetImporter: Scene cache " + filename_ + " is written for another asset");
+        }
+
+        for (std::uint32_t i = 0; i < header_->numsources; ++i)
+        {
+            std::uint64_t size = 0;
+            std::int64_t mtime = 0;
+
+            if (!SceneCache::GetFileInfo(GetString(sources[i].path), size, mtime) ||
+                size != sources[i].size || mtime != sources[i].mtime)
+            {
+                throw std::runtime_error("BinaryAssetImporter: Scene cache " + filename_ + " is out of date");
+            }
+        }
+    }
+}
+
+template <typename T> T const* BinaryAssetImporter::GetArray(std::uint64_t offset, std::uint64_t count) const
+{
+    if (offset % 16 != 0 || offset > file_.GetSize() || count > (file_.GetSize() - offset) / sizeof(T))
+    {
+        throw std::runtime_error("BinaryAssetImporter: Corrupted scene cache " + filename_);
+    }
+
+    return reinterpret_cast<T const*>(file_.GetData() + offset);
+}
+
+std::string BinaryAssetImporter::GetString(std::uint64_t offset) const
+{
+    char const* strings = GetArray<char>(header_->strings, header_->stringssize);
+
+    if (offset >= header_->stringssize || !std::memchr(strings + offset, 0, header_->stringssize - offset))
+    {
+        throw std::runtime_error("BinaryAssetImporter: Corrupted scene cache " + filename_);
+    }
+
+    return std::string(strings + offset);
+}
+
+void BinaryAssetImporter::Import()
+{
+    PROFILE_SCOPE("BinaryAssetImporter::Import");
+
+    SceneCache::MaterialRecord const* materials = GetArray<SceneCache::MaterialRecord>(header_->materials, header_->nummaterials);
+    SceneCache::MeshRecord const* meshes = GetArray<SceneCache::MeshRecord>(header_->meshes, header_->nummeshes);
+    SceneCache::LightRecord const* lights = GetArray<SceneCache::LightRecord>(header_->lights, header_->numlights);
+    SceneCache::CameraRecord const* cameras = GetArray<SceneCache::CameraRecord>(header_->cameras, header_->numcameras);
+
+    // Indices materials got from the callback, faces are remapped to them
+    std::vector<int> idx(header_->nummaterials, 0);
+    std::vector<Material*> mats(header_->nummaterials, nullptr);
+
+    for (std::uint32_t i = 0; i < header_->nummaterials; ++i)
+    {
+        Material* m = nullptr;
+
+        switch (materials[i].type)
+        {
+        case SceneCache::kEmissive:
+            m = new Emissive(materials[i].color);
+            break;
+        case SceneCache::kLambert:
+            m = new SimpleMaterial(new Lambert(texsys_, materials[i].color, GetString(materials[i].kdmap), GetString(materials[i].nmap)));
+            break;
+        default:
+            throw std::runtime_error("BinaryAssetImporter: Unknown material type in " + filename_);
+        }
+
+        if (onmaterial_)
+        {
+            idx[i] = onmaterial_(m);
+            mats[i] = m;
+        }
+        else
+        {
+            delete m;
+        }
+    }
+
+    std::vector<Mesh*> mymeshes(header_->nummeshes, nullptr);
+    std::vector<Mesh::Face> faces;
+
+    {
+        PROFILE_SCOPE("BinaryAssetImporter::Meshes");
+
+        for (std::uint32_t i = 0; i < header_->nummeshes; ++i)
+        {
+            SceneCache::MeshRecord const& record = meshes[i];
+
+            float3 const* vertices = GetArray<float3>(record.vertices, record.numvertices);
+            float3 const* normals = GetArray<float3>(record.normals, record.numnormals);
+            float2 const* uvs = GetArray<float2>(record.uvs, record.numuvs);
+            Mesh::Face const* recordfaces = GetArray<Mesh::Face>(record.faces, record.numfaces);
+
+            faces.assign(recordfaces, recordfaces + record.numfaces);
+
+            for (auto& face : faces)
+            {
+                if (!IsValidFace(face, record, header_->nummaterials))
+                {
+                    throw std::runtime_error("BinaryAssetImporter: Corrupted scene cache " + filename_);
+                }
+
+                face.m = idx[face.m];
+            }
+
+            Mesh* mesh = new Mesh(vertices, record.numvertices,
+                normals, record.numnormals,
+                uvs, record.numuvs,
+                faces.empty() ? nullptr : &faces[0], (int)faces.size());
+
+            mesh->SetTransform(record.worldmat, record.worldmatinv);
+            mymeshes[i] = mesh;
+
+            if (onprimitive_)
+            {
+                onprimitive_(mesh);
+            }
+        }
+    }
+
+    for (std::uint32_t i = 0; i < header_->numlights; ++i)
+    {
+        SceneCache::LightRecord const& record = lights[i];
+        Light* light = nullptr;
+
+        switch (record.type)
+        {
+        case SceneCache::kMeshLight:
+            if (record.mesh < 0 || record.mesh >= (int)header_->nummeshes ||
+                record.material < 0 || record.material >= (int)header_->nummaterials)
+            {
+                throw std::runtime_error("BinaryAssetImporter: Corrupted scene cache " + filename_);
+            }
+
+            // Material is not there if nobody took it
+            if (mats[record.material])
+            {
+                light = new MeshLight(*mymeshes[record.mesh], *mats[record.material]);
+            }
+            break;
+        case SceneCache::kPointLight:
+            light = new PointLight(record.p, record.e);
+            break;
+        case SceneCache::kDirectionalLight:
+            light = new DirectionalLight(record.p, record.e);
+            break;
+        default:
+            throw std::runtime_error("BinaryAssetImporter: Unknown light type in " + filename_);
+        }
+
+        if (light)
+        {
+            if (onlight_)
+            {
+                onlight_(light);
+            }
+            else
+            {
+                delete light;
+            }
+        }
+    }
+
+    if (header_->numcameras > 0 && oncamera_)
+    {
+        SceneCache::CameraRecord const& record = cameras[0];
+        oncamera_(new PerscpectiveCamera(record.eye, record.at, record.up, record.zcap, record.fovy, record.aspect));
+    }
+}
+
+bool BinaryAssetImporter::HasBvh() const
+{
+    return header_->numnodes > 0;
+}
+
+std::unique_ptr<Bvh> BinaryAssetImporter::CreateBvh(std::vector<std::unique_ptr<ShapeBundle>> const& bundles) const
+{
+    if (!HasBvh())
+    {
+        return nullptr;
+    }
+
+    PROFILE_SCOPE("BinaryAssetImporter::CreateBvh");
+
+    Bvh::PackedNode const* nodes = GetArray<Bvh::PackedNode>(header_->nodes, header_->numnodes);
+    int const* primids = GetArray<int>(header_->primids, header_->numprimids);
+
+    std::unique_ptr<Bvh> bvh(new Bvh(true));
+    bvh->Unpack(bundles, nodes, header_->numnodes, primids, header_->numprimids);
+    return bvh;
+}
@@ -0,0 +1,83 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+
+#ifndef BINARY_ASSETIMPORTER_H
+#define BINARY_ASSETIMPORTER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "assetimporter.h"
+#include "scenecache.h"
+#include "../util/mappedfile.h"
+
+class Bvh;
+
+///< BinaryAssetImporter loads scene cache written by SceneCacheWriter.
+///< The file is mapped into memory and its contents are handed out through
+///< the same callbacks AssimpAssetImporter uses, so the callers can switch
+///< between the two. Materials are recreated from the parameters stored.
+///<
+class BinaryAssetImporter : public AssetImporter
+{
+public:
+    // Throws std::runtime_error if the file is not a valid scene cache.
+    // If source is given the cache must have been written for it and
+    // none of the recorded source files may have changed since.
+    BinaryAssetImporter(TextureSystem const& texsys, std::string const& filename, std::string const& source = "");
+
+    void Import();
+
+    // Check if the cache has BVH embedded
+    bool HasBvh() const;
+
+    // Restore embedded hierarchy, bundles are the meshes imported in the order
+    // they came through onprimitive_. Returns nullptr if there is no BVH.
+    std::unique_ptr<Bvh> CreateBvh(std::vector<std::unique_ptr<ShapeBundle>> const& bundles) const;
+
+private:
+    // Array of count elements at offset in the file, throws if it is out of the file
+    template <typename T> T const* GetArray(std::uint64_t offset, std::uint64_t count) const;
+    // String from the string table
+    std::string GetString(std::uint64_t offset) const;
+
+    // Asset file name
+    std::string filename_;
+    // File contents
+    MappedFile file_;
+    SceneCache::Header const* header_;
+};
+
+
+#endif //BINARY_ASSETIMPORTER_H
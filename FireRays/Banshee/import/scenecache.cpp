@@ -0,0 +1,298 @@
+#include "scenecache.h"
+
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <cstring>
+
+#include "../util/profiler.h"
+
+#include <cstdio>
+#include <sys/stat.h>
+
+#ifdef WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+char const SceneCache::kMagic[8] = { 'B', 'S', 'H', 'S', 'C', 'E', 'N', 'E' };
+
+bool SceneCache::GetFileInfo(std::string const& path, std::uint64_t& size, std::int64_t& mtime)
+{
+    struct stat info;
+
+    if (stat(path.c_str(), &info) != 0)
+    {
+        return false;
+    }
+
+    size = (std::uint64_t)info.st_size;
+    mtime = (std::int64_t)info.st_mtime;
+    return true;
+}
+
+SceneCacheWriter::SceneCacheWriter()
+{
+}
+
+void SceneCacheWriter::AddSource(std::string const& path)
+{
+    Source source;
+    source.path = path;
+
+    if (!SceneCache::GetFileInfo(path, source.size, source.mtime))
+    {
+        throw std::runtime_error("SceneCacheWriter: Cannot find source " + path);
+    }
+
+    sources_.push_back(source);
+}
+
+void SceneCacheWriter::AddEmissiveMaterial(int id, float3 const& e)
+{
+    Material material = { id, SceneCache::kEmissive, e, "", "" };
+    materials_.push_back(material);
+}
+
+void SceneCacheWriter::AddLambertMaterial(int id, float3 const& kd, std::string const& kdmap, std::string const& nmap)
+{
+    Material material = { id, SceneCache::kLambert, kd, kdmap, nmap };
+    materials_.push_back(material);
+}
+
+int SceneCacheWriter::AddMesh(Mesh const& mesh)
+{
+    meshes_.push_back(&mesh);
+    return (int)(meshes_.size() - 1);
+}
+
+void SceneCacheWriter::AddMeshLight(int mesh, int material)
+{
+    SceneCache::LightRecord light;
+    light.type = SceneCache::kMeshLight;
+    light.mesh = mesh;
+    light.material = material;
+    lights_.push_back(light);
+}
+
+void SceneCacheWriter::AddPointLight(float3 const& p, float3 const& e)
+{
+    SceneCache::LightRecord light;
+    light.type = SceneCache::kPointLight;
+    light.mesh = -1;
+    light.material = -1;
+    light.p = p;
+    light.e = e;
+    lights_.push_back(light);
+}
+
+void SceneCacheWriter::AddDirectionalLight(float3 const& d, float3 const& e)
+{
+    SceneCache::LightRecord light;
+    light.type = SceneCache::kDirectionalLight;
+    light.mesh = -1;
+    light.material = -1;
+    light.p = d;
+    light.e = e;
+    lights_.push_back(light);
+}
+
+void SceneCacheWriter::SetCamera(float3 const& eye, float3 const& at, float3 const& up, float2 const& zcap, float fovy, float aspect)
+{
+    SceneCache::CameraRecord camera;
+    camera.eye = eye;
+    camera.at = at;
+    camera.up = up;
+    camera.zcap = zcap;
+    camera.fovy = fovy;
+    camera.aspect = aspect;
+
+    cameras_.assign(1, camera);
+}
+
+void SceneCacheWriter::SetBvh(Bvh const& bvh)
+{
+    bvh.Pack(nodes_, primids_);
+}
+
+// Pad the file to 16 bytes and write the array, returns its offset
+template <typename T> static std::uint64_t WriteArray(std::ofstream& out, T const* data, std::size_t count)
+{
+    static char const zeros[16] = {};
+
+    std::uint64_t offset = (std::uint64_t)out.tellp();
+    std::uint64_t padding = (16 - offset % 16) % 16;
+
+    out.write(zeros, padding);
+
+    if (count > 0)
+    {
+        out.write((char const*)data, count * sizeof(T));
+    }
+
+    return offset + padding;
+}
+
+void SceneCacheWriter::Write(std::string const& filename) const
+{
+    PROFILE_SCOPE("SceneCacheWriter::Write");
+
+    // Temporary name is unique per process, jobs sharing the cache directory
+    // might write the same cache at the same time
+#ifdef WIN32
+    std::string tmpfilename = filename + "." + std::to_string(_getpid()) + ".tmp";
+#else
+    std::string tmpfilename = filename + "." + std::to_string(getpid()) + ".tmp";
+#endif
+
+    std::ofstream out(tmpfilename, std::ios::binary | std::ios::trunc);
+
+    if (!out)
+    {
+        throw std::runtime_error("SceneCacheWriter: Cannot open " + tmpfilename);
+    }
+
+    // Header goes last when all the offsets are known
+    SceneCache::Header header;
+    std::memset(&header, 0, sizeof(header));
+    out.write((char const*)&header, sizeof(header));
+
+    // Materials are referenced by record index in the file
+    std::map<int, int> id2idx;
+    for (int i = (int)materials_.size() - 1; i >= 0; --i)
+    {
+        id2idx[materials_[i].id] = i;
+    }
+
+    auto GetMaterialIndex = [&id2idx](int id)->int
+    {
+        auto iter = id2idx.find(id);
+
+        if (iter == id2idx.end())
+        {
+            throw std::runtime_error("SceneCacheWriter: Reference to unknown material");
+        }
+
+        return iter->second;
+    };
+
+    // Mesh arrays
+    std::vector<SceneCache::MeshRecord> meshes(meshes_.size());
+    std::vector<Mesh::Face> faces;
+
+    for (std::size_t i = 0; i < meshes_.size(); ++i)
+    {
+        Mesh const& mesh = *meshes_[i];
+        SceneCache::MeshRecord& record = meshes[i];
+
+        mesh.GetTransform(record.worldmat, record.worldmatinv);
+
+        faces.assign(mesh.GetFaces(), mesh.GetFaces() + mesh.GetNumFaces());
+        for (auto& face : faces)
+        {
+            face.m = GetMaterialIndex(face.m);
+        }
+
+        record.numvertices = (std::uint32_t)mesh.GetNumVertices();
+        record.numnormals = (std::uint32_t)mesh.GetNumNormals();
+        record.numuvs = (std::uint32_t)mesh.GetNumUvs();
+        record.numfaces = (std::uint32_t)faces.size();
+
+        record.vertices = WriteArray(out, mesh.GetVertices(), record.numvertices);
+        record.normals = WriteArray(out, mesh.GetNormals(), record.numnormals);
+        record.uvs = WriteArray(out, mesh.GetUvs(), record.numuvs);
+        record.faces = WriteArray(out, faces.empty() ? nullptr : &faces[0], faces.size());
+    }
+
+    // Texture names
+    std::string strings;
+    std::vector<SceneCache::MaterialRecord> materials(materials_.size());
+
+    for (std::size_t i = 0; i < materials_.size(); ++i)
+    {
+        materials[i].type = materials_[i].type;
+        materials[i].color = materials_[i].color;
+
+        materials[i].kdmap = strings.size();
+        strings.append(materials_[i].kdmap.c_str(), materials_[i].kdmap.size() + 1);
+
+        materials[i].nmap = strings.size();
+        strings.append(materials_[i].nmap.c_str(), materials_[i].nmap.size() + 1);
+    }
+
+    std::vector<SceneCache::SourceRecord> sources(sources_.size());
+
+    for (std::size_t i = 0; i < sources_.size(); ++i)
+    {
+        sources[i].path = strings.size();
+        strings.append(sources_[i].path.c_str(), sources_[i].path.size() + 1);
+        sources[i].size = sources_[i].size;
+        sources[i].mtime = sources_[i].mtime;
+    }
+
+    // Lights refer to material records as well
+    std::vector<SceneCache::LightRecord> lights(lights_);
+
+    for (auto& light : lights)
+    {
+        if (light.type == SceneCache::kMeshLight)
+        {
+            if (light.mesh < 0 || light.mesh >= (int)meshes_.size())
+            {
+                throw std::runtime_error("SceneCacheWriter: Mesh light refers to unknown mesh");
+            }
+
+            light.material = GetMaterialIndex(light.material);
+        }
+    }
+
+    std::memcpy(header.magic, SceneCache::kMagic, sizeof(header.magic));
+    header.version = SceneCache::kVersion;
+    header.facesize = sizeof(Mesh::Face);
+    header.nodesize = sizeof(Bvh::PackedNode);
+    header.headersize = sizeof(SceneCache::Header);
+
+    header.nummaterials = (std::uint32_t)materials.size();
+    header.nummeshes = (std::uint32_t)meshes.size();
+    header.numlights = (std::uint32_t)lights.size();
+    header.numcameras = (std::uint32_t)cameras_.size();
+    header.numnodes = (std::uint32_t)nodes_.size();
+    header.numprimids = (std::uint32_t)primids_.size();
+    header.numsources = (std::uint32_t)sources.size();
+
+    header.strings = WriteArray(out, strings.c_str(), strings.size());
+    header.stringssize = strings.size();
+    header.materials = WriteArray(out, materials.empty() ? nullptr : &materials[0], materials.size());
+    header.meshes = WriteArray(out, meshes.empty() ? nullptr : &meshes[0], meshes.size());
+    header.lights = WriteArray(out, lights.empty() ? nullptr : &lights[0], lights.size());
+    header.cameras = WriteArray(out, cameras_.empty() ? nullptr : &cameras_[0], cameras_.size());
+    header.nodes = WriteArray(out, nodes_.empty() ? nullptr : &nodes_[0], nodes_.size());
+    header.primids = WriteArray(out, primids_.empty() ? nullptr : &primids_[0], primids_.size());
+    header.sources = WriteArray(out, sources.empty() ? nullptr : &sources[0], sources.size());
+
+    out.seekp(0);
+    out.write((char const*)&header, sizeof(header));
+    out.close();
+
+    if (!out)
+    {
+        std::remove(tmpfilename.c_str());
+        throw std::runtime_error("SceneCacheWriter: Cannot write " + tmpfilename);
+    }
+
+    // Readers keep mapping the old file until they are done with it
+#ifdef WIN32
+    bool renamed = MoveFileExA(tmpfilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool renamed = std::rename(tmpfilename.c_str(), filename.c_str()) == 0;
+#endif
+
+    if (!renamed)
+    {
+        std::remove(tmpfilename.c_str());
+        throw std::runtime_error("SceneCacheWriter: Cannot rename " + tmpfilename + " to " + filename);
+    }
+}
@@ -0,0 +1,229 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+
+#ifndef SCENECACHE_H
+#define SCENECACHE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "../math/float3.h"
+#include "../math/float2.h"
+#include "../math/matrix.h"
+#include "../primitive/mesh.h"
+#include "../accelerator/bvh.h"
+
+///< SceneCache describes compact binary snapshot of an imported scene:
+///< meshes, material parameters with texture references, lights, camera
+///< and optionally the BVH built over the meshes. The file starts with
+///< the header followed by record tables and raw arrays, records point to
+///< their arrays with offsets from the start of the file. Arrays are kept
+///< 16 byte aligned and in the layout Banshee uses in memory, so restoring
+///< them from the mapped file is a plain copy. Cache is meant to be read
+///< by the same build on the same architecture, the header keeps version
+///< and record sizes to reject anything else. Source files the scene was
+///< imported from are listed with their size and modification time, so
+///< the cache is not used after any of them changes.
+///<
+struct SceneCache
+{
+    static char const kMagic[8];
+    static std::uint32_t const kVersion = 2;
+
+    enum MaterialType
+    {
+        kEmissive,
+        kLambert
+    };
+
+    enum LightType
+    {
+        kMeshLight,
+        kPointLight,
+        kDirectionalLight
+    };
+
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        // Sizes of records for compatibility check
+        std::uint32_t facesize;
+        std::uint32_t nodesize;
+        std::uint32_t headersize;
+        // Table sizes, there is either 0 or 1 camera
+        std::uint32_t nummaterials;
+        std::uint32_t nummeshes;
+        std::uint32_t numlights;
+        std::uint32_t numcameras;
+        std::uint32_t numnodes;
+        std::uint32_t numprimids;
+        std::uint32_t numsources;
+        // Table offsets
+        std::uint64_t materials;
+        std::uint64_t meshes;
+        std::uint64_t lights;
+        std::uint64_t cameras;
+        std::uint64_t nodes;
+        std::uint64_t primids;
+        std::uint64_t sources;
+        // Zero terminated strings referenced by offset from the start of the table
+        std::uint64_t strings;
+        std::uint64_t stringssize;
+    };
+
+    // Source file state at the time of import, first one is the asset itself
+    struct SourceRecord
+    {
+        // File name in the string table
+        std::uint64_t path;
+        std::uint64_t size;
+        std::int64_t mtime;
+    };
+
+    // Get size and modification time of the file, false if it is not there
+    static bool GetFileInfo(std::string const& path, std::uint64_t& size, std::int64_t& mtime);
+
+    struct MaterialRecord
+    {
+        std::uint32_t type;
+        // Emission or diffuse color
+        float3 color;
+        // Texture names
+        std::uint64_t kdmap;
+        std::uint64_t nmap;
+    };
+
+    struct MeshRecord
+    {
+        matrix worldmat;
+        matrix worldmatinv;
+        std::uint64_t vertices;
+        std::uint64_t normals;
+        std::uint64_t uvs;
+        // Faces refer to materials by record index
+        std::uint64_t faces;
+        std::uint32_t numvertices;
+        std::uint32_t numnormals;
+        std::uint32_t numuvs;
+        std::uint32_t numfaces;
+    };
+
+    struct LightRecord
+    {
+        std::uint32_t type;
+        // Mesh and material record indices of mesh lights
+        std::int32_t mesh;
+        std::int32_t material;
+        // Position of point lights, direction of directional ones
+        float3 p;
+        // Emitted radiance
+        float3 e;
+    };
+
+    struct CameraRecord
+    {
+        float3 eye;
+        float3 at;
+        float3 up;
+        float2 zcap;
+        float fovy;
+        float aspect;
+    };
+};
+
+///< SceneCacheWriter collects the scene while it is being imported
+///< and writes it into a scene cache file. Meshes are referenced,
+///< not copied, and must stay alive until Write is called.
+///<
+class SceneCacheWriter
+{
+public:
+    SceneCacheWriter();
+
+    // Record source file state, the asset goes first followed by
+    // the files it refers to. Throws std::runtime_error if the file is not there.
+    void AddSource(std::string const& path);
+
+    // id is the index the material got from the importer callback,
+    // faces and mesh lights refer to materials by it
+    void AddEmissiveMaterial(int id, float3 const& e);
+    void AddLambertMaterial(int id, float3 const& kd, std::string const& kdmap, std::string const& nmap);
+
+    // Returns index of the mesh in the cache
+    int AddMesh(Mesh const& mesh);
+
+    // Lights, material is the id passed with the material
+    void AddMeshLight(int mesh, int material);
+    void AddPointLight(float3 const& p, float3 const& e);
+    void AddDirectionalLight(float3 const& d, float3 const& e);
+
+    // Perspective camera, same parameters as PerscpectiveCamera takes
+    void SetCamera(float3 const& eye, float3 const& at, float3 const& up, float2 const& zcap, float fovy, float aspect);
+
+    // Embed hierarchy built over the meshes in the order they were added
+    void SetBvh(Bvh const& bvh);
+
+    // Write the file, throws std::runtime_error on failure.
+    // The file is written next to the destination and renamed into place,
+    // so concurrent readers see either the old cache or the complete new one.
+    void Write(std::string const& filename) const;
+
+private:
+    struct Material
+    {
+        int id;
+        SceneCache::MaterialType type;
+        float3 color;
+        std::string kdmap;
+        std::string nmap;
+    };
+
+    struct Source
+    {
+        std::string path;
+        std::uint64_t size;
+        std::int64_t mtime;
+    };
+
+    std::vector<Source> sources_;
+    std::vector<Material> materials_;
+    std::vector<Mesh const*> meshes_;
+    std::vector<SceneCache::LightRecord> lights_;
+    std::vector<SceneCache::CameraRecord> cameras_;
+    std::vector<Bvh::PackedNode> nodes_;
+    std::vector<int> primids_;
+};
+
+#endif // SCENECACHE_H
@@ -31,18 +31,18 @@ float3 AreaLight::GetSample(ShapeBundle::Hit const& hit, float2 const& sample, f
     
     // Set direction to the light
     d = sampledata.p - hit.p;
+
+    float3 wo = -normalize(d);
+    float cosl = dot(sampledata.n, wo);
     
     // If the object facing the light compute emission
-    if (sampledata.pdf > 0.f && dot(sampledata.n, -normalize(d)) > 0.f)
+    if (sampledata.pdf > 0.f && cosl > 0.f)
     {
-        // Return PDF
-        pdf = sampledata.pdf;
-        
-        // Emissive power with squared fallof
-        float d2inv = 1.f / d.sqnorm();
-
-        // Return emission characteristic of the material
-        return material_.GetLe(sampledata, -normalize(d)) * d2inv;
+        // Convert surface area PDF to solid angle PDF, so it matches GetPdf
+        pdf = d.sqnorm() / (cosl * bundle_.GetShapeSurfaceArea(shapeidx_));
+
+        // Emission characteristic of the material has cosine term in it, so convert it to radiance
+        return material_.GetLe(sampledata, wo) * (1.f / cosl);
     }
 
     
@@ -55,4 +55,57 @@ float3 AreaLight::GetSample(ShapeBundle::Hit const& hit, float2 const& sample, f
 float AreaLight::GetPdf(ShapeBundle::Hit const& hit, float3 const& w) const
 {
     return bundle_.GetPdfOnShape(shapeidx_, hit.p, w);
-}
\ No newline at end of file
+}
+float AreaLight::GetPower() const
+{
+    // Take emission at the center of the shape along the normal
+    ShapeBundle::Sample sampledata;
+    bundle_.GetSampleOnShape(shapeidx_, float2(4.f / 9.f, 0.5f), sampledata);
+
+    float3 le = material_.GetLe(sampledata, sampledata.n);
+
+    // Lambertian emitter radiates PI * Le per unit area
+    return PI * bundle_.GetShapeSurfaceArea(shapeidx_) * (0.2126f * le.x + 0.7152f * le.y + 0.0722f * le.z);
+}
+
+bbox AreaLight::GetBounds() const
+{
+    return bundle_.GetShapeWorldBounds(shapeidx_);
+}
+
+void AreaLight::GetOrientation(float3& axis, float& thetao, float& thetae) const
+{
+    // Interpolated normals might vary across the shape, so take the corners
+    // and bound them with the cone around their average
+    float2 const corners[3] = { float2(0.f, 0.f), float2(1.f, 0.f), float2(1.f, 1.f) };
+
+    float3 n[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        ShapeBundle::Sample sampledata;
+        bundle_.GetSampleOnShape(shapeidx_, corners[i], sampledata);
+        n[i] = normalize(sampledata.n);
+    }
+
+    axis = n[0] + n[1] + n[2];
+
+    // Degenerate normals: emit everywhere
+    if (axis.sqnorm() == 0.f)
+    {
+        axis = n[0];
+        thetao = PI;
+        thetae = 0.5f * PI;
+        return;
+    }
+
+    axis = normalize(axis);
+    thetao = 0.f;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        thetao = std::max(thetao, acosf(clamp(dot(axis, n[i]), -1.f, 1.f)));
+    }
+
+    // Emission is cosine weighted over the hemisphere
+    thetae = 0.5f * PI;
+}
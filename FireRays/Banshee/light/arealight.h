@@ -68,6 +68,15 @@ public:
     
     // Check if the light is singular (represented by delta function or not)
     bool Singular() const { return false; }
+
+    // Estimated total emitted power
+    float GetPower() const;
+
+    // World space bounds of the shape
+    bbox GetBounds() const;
+
+    // Orientation cone of the shape normals
+    void GetOrientation(float3& axis, float& thetao, float& thetae) const;
     
 private:
     // Index within the bundle
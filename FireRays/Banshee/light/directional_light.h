@@ -65,6 +65,27 @@ public:
     {
         return 0.f;
     }
+
+    // Directional light is infinitely far away
+    bool Infinite() const { return true; }
+
+    // World space direction
+    float3 const& GetDirection() const { return d_; }
+
+    // Emissive power
+    float3 const& GetEmission() const { return e_; }
+
+    // Sampling kernel for a light shining along direction dir with power e, LightSet calls it directly
+    static float3 Sample(float3 const& dir, float3 const& e, float3& d, float& pdf)
+    {
+        // Need to return direction opposite to the light which is long enough
+        // TODO: remove the constant
+        d = -dir * 100000000.f;
+        // It's probability density == 1
+        pdf = 1.f;
+        // Emissive power with no falloff
+        return e;
+    }
     
 private:
     // World space direction
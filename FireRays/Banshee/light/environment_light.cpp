@@ -1,10 +1,22 @@
 #include "environment_light.h"
 
-#include "../texture/texturesystem.h"
+#include "../texture/environment_map.h"
 #include "../math/mathutils.h"
 
 #include <cassert>
 
+EnvironmentLight::EnvironmentLight(TextureSystem const& texsys,
+                                   std::string const& texture,
+                                   float scale,
+                                   float gamma)
+    : envmap_(new EnvironmentMap(texsys, texture, scale, gamma))
+{
+}
+
+EnvironmentLight::~EnvironmentLight()
+{
+}
+
 float3 EnvironmentLight::GetSample(ShapeBundle::Hit const& hit, float2 const& sample, float3& d, float& pdf) const
 {
     // Precompute invpi
@@ -17,44 +29,20 @@ float3 EnvironmentLight::GetSample(ShapeBundle::Hit const& hit, float2 const& sa
     // and normalized
     pdf = dot(hit.n, d) * invpi;
 
-    // Convert world d coordinates to spherical representation
-    float r, phi, theta;
-    cartesian_to_spherical(d, r, phi, theta);
-
-    // Compose the textcoord to fetch
-    float2 uv(phi / (2*PI), theta / PI);
+    // Fetch radiance value
+    float3 val = envmap_->Sample(d);
 
     // Make it long
     d *= 10000000.f;
 
-    // Fetch the value
-    float3 val = texsys_.Sample(texture_, uv, float2(0,0));
-    
-    // Apply gamma correction
-    val = float3(pow(val.x, invgamma_), pow(val.y, invgamma_), pow(val.z, invgamma_));
-    
-    // Fetch radiance value and scale it
-    return scale_ * val;
+    return val;
 }
 
 
 float3 EnvironmentLight::GetLe(ray const& r) const
 {
-     // Convert world d coordinates to spherical representation
-    float rr, phi, theta;
-    cartesian_to_spherical(r.d, rr, phi, theta);
-
-    // Compose the textcoord to fetch
-    float2 uv(phi / (2*PI), theta / PI);
-
-    // Fetch the value
-    float3 val = texsys_.Sample(texture_, uv, float2(0,0));
-    
-    // Apply gamma correction
-    val = float3(pow(val.x, invgamma_), pow(val.y, invgamma_), pow(val.z, invgamma_));
-    
-    // Fetch radiance value and scale it
-    return scale_ * val;
+    // Fetch radiance value
+    return envmap_->Sample(r.d);
 }
 
 // PDF of a given direction sampled from isect.p
@@ -34,8 +34,10 @@
 #define ENVIRONMENT_LIGHT_H
 
 #include <string>
+#include <memory>
 
 class TextureSystem;
+class EnvironmentMap;
 
 #include "light.h"
 
@@ -48,13 +50,9 @@ public:
     EnvironmentLight(TextureSystem const& texsys,
                      std::string const& texture,
                      float scale = 1.f,
-                     float gamma = 2.2f)
-                     : texsys_(texsys)
-                     , texture_(texture)
-                     , scale_(scale)
-                     , invgamma_(1.f / gamma)
-    {
-    }
+                     float gamma = 2.2f);
+
+    ~EnvironmentLight();
 
     // Sample method generates a direction to the light(d), calculates pdf in that direction (pdf)
     // and returns radiance emitted(return value) into the direction specified by isect
@@ -72,17 +70,14 @@ public:
     
     // Check if the light is singular (represented by delta function or not)
     bool Singular() const { return false; }
+
+    // Environment surrounds the whole scene
+    bool Infinite() const { return true; }
     
 
 private:
-    // Texture system
-    TextureSystem const& texsys_;
-    // Texture file name
-    std::string texture_;
-    // Radiance scale
-    float scale_;
-    // Gamma
-    float invgamma_;
+    // Linear radiance values baked from the texture
+    std::unique_ptr<EnvironmentMap> envmap_;
 };
 
 #endif // ENVIRONMENT_LIGHT_H
\ No newline at end of file
@@ -1,26 +1,49 @@
 #include "environment_light_is.h"
 
-#include "../texture/texturesystem.h"
+#include "../texture/environment_map.h"
 #include "../math/mathutils.h"
-#include "../math/distribution2d.h"
-
-
-#include "../imageio/oiioimageio.h"
+#include "../math/alias_distribution2d.h"
+#include "../math/hierarchical_distribution2d.h"
+#include "../util/memoryreport.h"
 
 #include <cassert>
 
 static int kDistWidth = 512;
 static int kDistHeight = 256;
+// Maps larger than that use hierarchical distribution
+static int kMaxAliasTexels = 2048 * 1024;
 
 EnvironmentLightIs::EnvironmentLightIs(TextureSystem const& texsys,
                    std::string const& texture,
                    float scale,
                    float gamma)
-: texsys_(texsys)
-, texture_(texture)
-, scale_(scale)
-, invgamma_(1.f / gamma)
+: envmap_(new EnvironmentMap(texsys, texture, scale, gamma))
 {
+    int width = envmap_->GetWidth();
+    int height = envmap_->GetHeight();
+
+    // Very large maps are sampled at their own resolution, hierarchical distribution
+    // keeps memory overhead low there
+    if (width * height > kMaxAliasTexels)
+    {
+        std::vector<float> img(width * height);
+
+        for (int i=0; i<height; ++i)
+        {
+            float sintheta = sinf(PI * (float)(i + 0.5f)/height);
+
+            for (int j=0; j<width; ++j)
+            {
+                float3 v = envmap_->Sample(float2((j + 0.5f)/width, (i + 0.5f)/height));
+
+                img[i*width + j] = (0.2126f * v.x + 0.7152f * v.y + 0.0722f * v.z) * sintheta;
+            }
+        }
+
+        hierarchicaldist_.reset(new HierarchicalDistribution2D(width, height, &img[0]));
+        return;
+    }
+
     // Prepare values for distribution generation
     std::vector<float> img(kDistWidth*kDistHeight);
 
@@ -31,7 +54,7 @@ EnvironmentLightIs::EnvironmentLightIs(TextureSystem const& texsys,
             float2 uv((float)j/kDistWidth, (float)i/kDistHeight);
             float sintheta = sinf(PI * (float)(i + 0.5f)/kDistHeight);
 
-            float3 v = texsys_.Sample(texture_, uv, float2(0,0));
+            float3 v = envmap_->Sample(uv);
             
             float luminance = 0.2126f * v.x + 0.7152f * v.y + 0.0722f * v.z;
             
@@ -39,14 +62,18 @@ EnvironmentLightIs::EnvironmentLightIs(TextureSystem const& texsys,
         }
     }
 
-    radiancedist_.reset(new Distribution2D(kDistWidth, kDistHeight, &img[0]));
+    radiancedist_.reset(new AliasDistribution2D(kDistWidth, kDistHeight, &img[0]));
+}
+
+EnvironmentLightIs::~EnvironmentLightIs()
+{
 }
 
 float3 EnvironmentLightIs::GetSample(ShapeBundle::Hit const& hit, float2 const& sample, float3& d, float& pdf) const
 {
     // Sample according to radiance distribution
     float dpdf = 0.f;
-    float2 uv = radiancedist_->Sample2D(sample, dpdf);
+    float2 uv = radiancedist_ ? radiancedist_->Sample2D(sample, dpdf) : hierarchicaldist_->Sample2D(sample, dpdf);
 
     float theta = uv.y * PI;
     float phi = uv.x * 2.f * PI;
@@ -59,34 +86,15 @@ float3 EnvironmentLightIs::GetSample(ShapeBundle::Hit const& hit, float2 const&
     // Convert PDF to spherical mapping
     pdf = (sintheta == 0.f) ? 0.f : (dpdf / (2.f * PI * PI * sintheta));
     
-    // Fetch the value
-    float3 val = texsys_.Sample(texture_, uv, float2(0,0));
-    
-    // Apply gamma correction
-    val = float3(pow(val.x, invgamma_), pow(val.y, invgamma_), pow(val.z, invgamma_));
-
-    // Fetch radiance value and scale it
-    return scale_ * val;
+    // Fetch radiance value
+    return envmap_->Sample(uv);
 }
 
 
 float3 EnvironmentLightIs::GetLe(ray const& r) const
 {
-    // Convert world d coordinates to spherical representation
-    float rr, phi, theta;
-    cartesian_to_spherical(r.d, rr, phi, theta);
-
-    // Compose the textcoord to fetch
-    float2 uv(phi / (2*PI), theta / PI);
-    
-    // Fetch the value
-    float3 val = texsys_.Sample(texture_, uv, float2(0,0));
-    
-    // Apply gamma correction
-    val = float3(pow(val.x, invgamma_), pow(val.y, invgamma_), pow(val.z, invgamma_));
-
-    // Fetch radiance value and scale it
-    return scale_ * val;
+    // Fetch radiance value
+    return envmap_->Sample(r.d);
 }
 
 // PDF of a given direction sampled from isect.p
@@ -103,5 +111,20 @@ float EnvironmentLightIs::GetPdf(ShapeBundle::Hit const& hit, float3 const& w) c
     float2 uv = float2(phi / (2*PI), theta / (PI));
     
     // Get PDF and convert to spherical
-    return (sintheta == 0.f) ? 0.f : ((radiancedist_->Pdf(uv) / (2.f * PI * PI * sintheta)));
+    float dpdf = radiancedist_ ? radiancedist_->Pdf(uv) : hierarchicaldist_->Pdf(uv);
+    return (sintheta == 0.f) ? 0.f : (dpdf / (2.f * PI * PI * sintheta));
+}
+
+void EnvironmentLightIs::GetMemoryUsage(MemoryReport& report) const
+{
+    report.Add("light.envmap", envmap_->GetSizeInBytes());
+
+    if (radiancedist_)
+    {
+        radiancedist_->GetMemoryUsage(report);
+    }
+    else
+    {
+        hierarchicaldist_->GetMemoryUsage(report);
+    }
 }
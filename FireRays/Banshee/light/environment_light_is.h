@@ -37,10 +37,12 @@
 #include <memory>
 
 class TextureSystem;
+class EnvironmentMap;
 
 #include "light.h"
 
-class Distribution2D;
+class AliasDistribution2D;
+class HierarchicalDistribution2D;
 
 ///< EnvironmentLight represents image based light emitting from the whole sphere around.
 ///< The radiance values are taken from HDR lightprobe provided during construction.
@@ -54,6 +56,8 @@ public:
                        std::string const& texture,
                        float scale = 1.f,
                        float gamma = 2.2f);
+
+    ~EnvironmentLightIs();
     
     // Sample method generates a direction to the light(d), calculates pdf in that direction (pdf)
     // and returns radiance emitted(return value) into the direction specified by isect
@@ -71,19 +75,21 @@ public:
     
     // Check if the light is singular (represented by delta function or not)
     bool Singular() const { return false; }
+
+    // Environment surrounds the whole scene
+    bool Infinite() const { return true; }
+
+    // Report radiance map and its sampling distribution
+    void GetMemoryUsage(MemoryReport& report) const;
     
     
 private:
-    // Texture system
-    TextureSystem const& texsys_;
-    // Texture file name
-    std::string texture_;
-    // Radiance scale
-    float scale_;
-    // Gamma
-    float invgamma_;
+    // Linear radiance values baked from the texture
+    std::unique_ptr<EnvironmentMap> envmap_;
     // Distribution for radiance
-    std::unique_ptr<Distribution2D> radiancedist_;
+    std::unique_ptr<AliasDistribution2D> radiancedist_;
+    // Full resolution distribution used instead for very large maps
+    std::unique_ptr<HierarchicalDistribution2D> hierarchicaldist_;
 };
 
 #endif // ENVIRONMENT_LIGHT_H
\ No newline at end of file
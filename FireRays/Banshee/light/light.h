@@ -35,6 +35,8 @@
 
 #include "../primitive/shapebundle.h"
 #include "../math/float3.h"
+#include "../math/bbox.h"
+#include "../math/mathutils.h"
 
 ///< Light serves as an interface to all light types
 ///< supported by the system.
@@ -57,9 +59,40 @@ public:
     
     // PDF of a given direction sampled from isect.p
     virtual float GetPdf(ShapeBundle::Hit const& hit, float3 const& w) const = 0;
+
+    // PDF of sampling the point lighthit on the light from hit.p (solid angle).
+    // Renderer calls this once it has found the point on the light itself, so
+    // area lights don't need to intersect their shapes again.
+    virtual float GetSurfacePdf(ShapeBundle::Hit const& hit, ShapeBundle::Hit const& lighthit) const
+    {
+        return GetPdf(hit, normalize(lighthit.p - hit.p));
+    }
     
     // Check if the light is singular (represented by delta function or not)
     virtual bool Singular() const { return true; }
+
+    // Check if the light is infinitely far away (environment, directional, etc)
+    // Infinite lights have no meaningful bounds and are not put into light hierarchies
+    virtual bool Infinite() const { return false; }
+
+    // Estimated total emitted power used to importance sample lights
+    virtual float GetPower() const { return 0.f; }
+
+    // World space bounds of the emitter
+    virtual bbox GetBounds() const { return bbox(); }
+
+    // Report memory held by the light (sampling distributions etc)
+    // Default implementation reports nothing
+    virtual void GetMemoryUsage(MemoryReport& report) const {}
+
+    // Orientation cone of the emitter: normals are within thetao of axis
+    // and the light is emitted within thetae around each normal
+    virtual void GetOrientation(float3& axis, float& thetao, float& thetae) const
+    {
+        axis = float3(0.f, 0.f, 1.f);
+        thetao = PI;
+        thetae = 0.5f * PI;
+    }
 };
 
 #endif // LIGHT_H
\ No newline at end of file
@@ -0,0 +1,318 @@
+#include "light_bvh.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "light.h"
+#include "../math/mathutils.h"
+#include "../util/memoryreport.h"
+
+LightBvh::LightBounds::LightBounds()
+    : axis(0.f, 0.f, 1.f)
+    , thetao(0.f)
+    , thetae(0.f)
+    , power(0.f)
+{
+}
+
+LightBvh::LightBvh()
+    : numlights_(0)
+    , infiniteprob_(0.f)
+{
+}
+
+LightBvh::~LightBvh()
+{
+}
+
+void LightBvh::Build(std::vector<std::unique_ptr<Light> > const& lights)
+{
+    numlights_ = lights.size();
+
+    nodes_.clear();
+    infinitelights_.clear();
+    lightnode_.assign(numlights_, -1);
+
+    // Collect bounds for all finite lights
+    std::vector<LightBounds> bounds(numlights_);
+    std::vector<int> finitelights;
+
+    for (int i = 0; i < (int)numlights_; ++i)
+    {
+        Light const& light = *lights[i];
+
+        if (light.Infinite())
+        {
+            infinitelights_.push_back(i);
+            continue;
+        }
+
+        LightBounds& b = bounds[i];
+        b.box = light.GetBounds();
+
+        // Lights not providing the bounds are treated the same way as infinite ones
+        if (b.box.pmin.x > b.box.pmax.x)
+        {
+            infinitelights_.push_back(i);
+            continue;
+        }
+
+        b.power = light.GetPower();
+        light.GetOrientation(b.axis, b.thetao, b.thetae);
+
+        finitelights.push_back(i);
+    }
+
+    if (!finitelights.empty())
+    {
+        nodes_.reserve(2 * finitelights.size() - 1);
+        BuildNode(bounds, finitelights, 0, (int)finitelights.size(), -1);
+    }
+
+    // Each infinite light gets the same chance as the whole hierarchy
+    if (infinitelights_.empty())
+    {
+        infiniteprob_ = 0.f;
+    }
+    else if (finitelights.empty())
+    {
+        infiniteprob_ = 1.f;
+    }
+    else
+    {
+        infiniteprob_ = (float)infinitelights_.size() / (infinitelights_.size() + 1);
+    }
+}
+
+int LightBvh::BuildNode(std::vector<LightBounds> const& bounds, std::vector<int>& lightidx, int begin, int end, int parent)
+{
+    int idx = (int)nodes_.size();
+
+    nodes_.push_back(Node());
+    nodes_[idx].parent = parent;
+    nodes_[idx].rc = -1;
+    nodes_[idx].light = -1;
+
+    // Create a leaf for a single light
+    if (end - begin == 1)
+    {
+        int light = lightidx[begin];
+        nodes_[idx].bounds = bounds[light];
+        nodes_[idx].light = light;
+        lightnode_[light] = idx;
+        return idx;
+    }
+
+    // Split in the middle along the largest extent of light centers.
+    // This keeps the tree balanced, so its depth is bounded by log2(n).
+    bbox centroids;
+    for (int i = begin; i < end; ++i)
+    {
+        centroids.grow(bounds[lightidx[i]].box.center());
+    }
+
+    int axis = centroids.maxdim();
+    int mid = (begin + end) / 2;
+
+    std::nth_element(lightidx.begin() + begin, lightidx.begin() + mid, lightidx.begin() + end,
+                     [&bounds, axis](int l1, int l2)
+                     {
+                         return bounds[l1].box.center()[axis] < bounds[l2].box.center()[axis];
+                     });
+
+    // Left child immediately follows the parent
+    int lc = BuildNode(bounds, lightidx, begin, mid, idx);
+    int rc = BuildNode(bounds, lightidx, mid, end, idx);
+
+    nodes_[idx].rc = rc;
+    nodes_[idx].bounds = Union(nodes_[lc].bounds, nodes_[rc].bounds);
+
+    return idx;
+}
+
+LightBvh::LightBounds LightBvh::Union(LightBounds const& b1, LightBounds const& b2)
+{
+    LightBounds res;
+    res.box = bboxunion(b1.box, b2.box);
+    res.power = b1.power + b2.power;
+    res.thetae = std::max(b1.thetae, b2.thetae);
+
+    // Find the cone bounding both of the cones, a is the wider one
+    LightBounds const& a = b1.thetao >= b2.thetao ? b1 : b2;
+    LightBounds const& b = b1.thetao >= b2.thetao ? b2 : b1;
+
+    // Angle between the axes
+    float thetad = acosf(clamp(dot(a.axis, b.axis), -1.f, 1.f));
+
+    // Check if a already contains b
+    if (std::min(thetad + b.thetao, PI) <= a.thetao)
+    {
+        res.axis = a.axis;
+        res.thetao = a.thetao;
+        return res;
+    }
+
+    // Spread of the union cone
+    float thetao = 0.5f * (a.thetao + thetad + b.thetao);
+
+    float3 wr = cross(a.axis, b.axis);
+
+    if (thetao >= PI || wr.sqnorm() == 0.f)
+    {
+        res.axis = a.axis;
+        res.thetao = PI;
+        return res;
+    }
+
+    // Rotate axis of a towards b
+    float thetar = thetao - a.thetao;
+    wr = normalize(wr);
+
+    res.axis = normalize(a.axis * cosf(thetar) + cross(wr, a.axis) * sinf(thetar));
+    res.thetao = thetao;
+
+    return res;
+}
+
+float LightBvh::Importance(ShapeBundle::Hit const& hit, LightBounds const& b)
+{
+    if (b.power <= 0.f)
+    {
+        return 0.f;
+    }
+
+    // Direction from the shading point to the center of the lights
+    float3 d = b.box.center() - hit.p;
+    float dist2 = d.sqnorm();
+
+    // Radius of the bounding sphere
+    float radius2 = (0.5f * b.box.extents()).sqnorm();
+
+    // Shading point within the bounding sphere, no angular bounds possible
+    if (dist2 <= radius2)
+    {
+        return b.power / std::max(radius2, 1e-8f);
+    }
+
+    float3 wi = d * (1.f / sqrtf(dist2));
+
+    // Angle subtended by the bounding sphere
+    float thetab = asinf(sqrtf(radius2 / dist2));
+
+    // Minimum angle between emitter normals and direction to the shading point
+    float thetaw = acosf(clamp(dot(b.axis, -wi), -1.f, 1.f));
+    float thetap = std::max(0.f, thetaw - b.thetao - thetab);
+
+    // Nothing is emitted towards the shading point
+    if (thetap >= b.thetae)
+    {
+        return 0.f;
+    }
+
+    // Minimum angle between the direction to the lights and shading normal.
+    // Use absolute value here as the BSDF might be transmissive.
+    float thetai = acosf(clamp(fabs(dot(hit.n, wi)), 0.f, 1.f));
+    float costhetai = cosf(std::max(0.f, thetai - thetab));
+
+    return b.power * cosf(thetap) * costhetai / dist2;
+}
+
+int LightBvh::Sample(ShapeBundle::Hit const& hit, float u, float& pdf) const
+{
+    pdf = 0.f;
+
+    if (numlights_ == 0)
+    {
+        return -1;
+    }
+
+    u = std::min(u, 0.99999994f);
+
+    // Pick one of infinite lights uniformly
+    if (u < infiniteprob_)
+    {
+        int numinfinite = (int)infinitelights_.size();
+        int idx = std::min((int)(u / infiniteprob_ * numinfinite), numinfinite - 1);
+        pdf = infiniteprob_ / numinfinite;
+        return infinitelights_[idx];
+    }
+
+    // Remap random number to [0,1) and descend the hierarchy
+    u = std::min((u - infiniteprob_) / (1.f - infiniteprob_), 0.99999994f);
+    pdf = 1.f - infiniteprob_;
+
+    int node = 0;
+    while (nodes_[node].light < 0)
+    {
+        int lc = node + 1;
+        int rc = nodes_[node].rc;
+
+        float il = Importance(hit, nodes_[lc].bounds);
+        float ir = Importance(hit, nodes_[rc].bounds);
+
+        // None of the lights contribute
+        if (il + ir <= 0.f)
+        {
+            pdf = 0.f;
+            return -1;
+        }
+
+        float pl = il / (il + ir);
+
+        if (u < pl)
+        {
+            u = std::min(u / pl, 0.99999994f);
+            pdf *= pl;
+            node = lc;
+        }
+        else
+        {
+            u = std::min((u - pl) / (1.f - pl), 0.99999994f);
+            pdf *= (1.f - pl);
+            node = rc;
+        }
+    }
+
+    return nodes_[node].light;
+}
+
+float LightBvh::GetPdf(ShapeBundle::Hit const& hit, int idx) const
+{
+    assert(idx >= 0 && idx < (int)numlights_);
+
+    int node = lightnode_[idx];
+
+    // Infinite lights are picked uniformly
+    if (node < 0)
+    {
+        return infiniteprob_ / infinitelights_.size();
+    }
+
+    // Walk up the hierarchy accumulating probabilities of the choices
+    float pdf = 1.f - infiniteprob_;
+
+    while (nodes_[node].parent >= 0)
+    {
+        int parent = nodes_[node].parent;
+        int lc = parent + 1;
+        int rc = nodes_[parent].rc;
+
+        float il = Importance(hit, nodes_[lc].bounds);
+        float ir = Importance(hit, nodes_[rc].bounds);
+
+        if (il + ir <= 0.f)
+        {
+            return 0.f;
+        }
+
+        pdf *= (node == lc ? il : ir) / (il + ir);
+        node = parent;
+    }
+
+    return pdf;
+}
+
+void LightBvh::GetMemoryUsage(MemoryReport& report) const
+{
+    report.Add("light.bvh", nodes_.capacity() * sizeof(Node) + (lightnode_.capacity() + infinitelights_.capacity()) * sizeof(int));
+}
@@ -0,0 +1,127 @@
+/*
+    Banshee and all code, documentation, and other materials contained
+    therein are:
+
+        Copyright 2013 Dmitry Kozlov
+        All Rights Reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the software's owners nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+    (This is the Modified BSD License)
+*/
+#ifndef LIGHT_BVH_H
+#define LIGHT_BVH_H
+
+#include <memory>
+#include <vector>
+
+#include "../primitive/shapebundle.h"
+#include "../math/bbox.h"
+#include "../math/float3.h"
+
+class Light;
+
+///< LightBvh is a bounding volume hierarchy over the light sources of the scene.
+///< Every node keeps total power, spatial bounds and orientation cone of the lights
+///< below it, which allows to pick a light in proportion to its estimated contribution
+///< at the shading point in O(log(n)) instead of uniformly or iterating over all of them.
+///< Lights which are infinitely far away are kept aside and picked uniformly.
+///< Selection probabilities only depend on the shading point so they can be safely
+///< combined with light and BSDF PDFs for MIS.
+///<
+class LightBvh
+{
+public:
+    LightBvh();
+    ~LightBvh();
+
+    // Build the hierarchy over the lights
+    void Build(std::vector<std::unique_ptr<Light> > const& lights);
+
+    // Pick the light for the shading point using random number u,
+    // returns light index and selection probability (pdf) or -1 if nothing can be picked
+    int Sample(ShapeBundle::Hit const& hit, float u, float& pdf) const;
+
+    // Probability of picking light idx at the shading point
+    float GetPdf(ShapeBundle::Hit const& hit, int idx) const;
+
+    // Number of lights the hierarchy has been built for
+    std::size_t GetNumLights() const { return numlights_; }
+
+    // Report hierarchy nodes and light lookup tables
+    void GetMemoryUsage(MemoryReport& report) const;
+
+private:
+    // Power, bounds and orientation of a light or a group of lights
+    struct LightBounds
+    {
+        LightBounds();
+
+        // Spatial extent
+        bbox box;
+        // Orientation cone axis
+        float3 axis;
+        // Spread of normals around axis
+        float thetao;
+        // Spread of emission around normals
+        float thetae;
+        // Total power
+        float power;
+    };
+
+    struct Node
+    {
+        // Bounds of all the lights in the subtree
+        LightBounds bounds;
+        // Parent index, -1 for root
+        int parent;
+        // Right child index for interior nodes, left child immediately follows the parent
+        int rc;
+        // Light index for leaves, -1 for interior nodes
+        int light;
+    };
+
+    // Merge two light bounds
+    static LightBounds Union(LightBounds const& b1, LightBounds const& b2);
+    // Estimate contribution of a light group at the shading point
+    static float Importance(ShapeBundle::Hit const& hit, LightBounds const& b);
+    // Build subtree over lights [begin, end) and return its root index
+    int BuildNode(std::vector<LightBounds> const& bounds, std::vector<int>& lightidx, int begin, int end, int parent);
+
+    // Hierarchy nodes
+    std::vector<Node> nodes_;
+    // Leaf node for every light, -1 for infinite lights
+    std::vector<int> lightnode_;
+    // Lights without bounds
+    std::vector<int> infinitelights_;
+    // Number of lights
+    std::size_t numlights_;
+    // Probability of picking one of infinite lights
+    float infiniteprob_;
+
+    LightBvh(LightBvh const&);
+    LightBvh& operator = (LightBvh const&);
+};
+
+#endif // LIGHT_BVH_H
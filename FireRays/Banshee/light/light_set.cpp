@@ -0,0 +1,150 @@
+#include "light_set.h"
+
+#include "light.h"
+#include "pointlight.h"
+#include "directional_light.h"
+
+LightSet::LightSet()
+{
+}
+
+void LightSet::Build(std::vector<std::unique_ptr<Light> > const& lights)
+{
+    types_.resize(lights.size());
+    slots_.resize(lights.size());
+    singular_.resize(lights.size());
+
+    pointpositions_.clear();
+    pointpowers_.clear();
+    dirdirections_.clear();
+    dirpowers_.clear();
+    arealights_.clear();
+    envlights_.clear();
+
+    for (int i = 0; i < (int)lights.size(); ++i)
+    {
+        Light const* light = lights[i].get();
+
+        singular_[i] = light->Singular() ? 1 : 0;
+
+        if (PointLight const* pointlight = dynamic_cast<PointLight const*>(light))
+        {
+            types_[i] = kPoint;
+            slots_[i] = (int)pointpositions_.size();
+            pointpositions_.push_back(pointlight->GetPosition());
+            pointpowers_.push_back(pointlight->GetEmission());
+        }
+        else if (DirectionalLight const* dirlight = dynamic_cast<DirectionalLight const*>(light))
+        {
+            types_[i] = kDirectional;
+            slots_[i] = (int)dirdirections_.size();
+            dirdirections_.push_back(dirlight->GetDirection());
+            dirpowers_.push_back(dirlight->GetEmission());
+        }
+        else if (light->Infinite())
+        {
+            types_[i] = kEnvironment;
+            slots_[i] = (int)envlights_.size();
+            envlights_.push_back(light);
+        }
+        else
+        {
+            types_[i] = kArea;
+            slots_[i] = (int)arealights_.size();
+            arealights_.push_back(light);
+        }
+    }
+}
+
+template <> float3 LightSet::Sample<LightSet::kPoint>(int slot, ShapeBundle::Hit const& hit, float2 const& sample, float3& d, float& pdf) const
+{
+    return PointLight::Sample(pointpositions_[slot], pointpowers_[slot], hit, d, pdf);
+}
+
+template <> float3 LightSet::Sample<LightSet::kDirectional>(int slot, ShapeBundle::Hit const& hit, float2 const& sample, float3& d, float& pdf) const
+{
+    return DirectionalLight::Sample(dirdirections_[slot], dirpowers_[slot], d, pdf);
+}
+
+template <> float3 LightSet::Sample<LightSet::kArea>(int slot, ShapeBundle::Hit const& hit, float2 const& sample, float3& d, float& pdf) const
+{
+    return arealights_[slot]->GetSample(hit, sample, d, pdf);
+}
+
+template <> float3 LightSet::Sample<LightSet::kEnvironment>(int slot, ShapeBundle::Hit const& hit, float2 const& sample, float3& d, float& pdf) const
+{
+    return envlights_[slot]->GetSample(hit, sample, d, pdf);
+}
+
+float3 LightSet::GetSample(int idx, ShapeBundle::Hit const& hit, float2 const& sample, float3& d, float& pdf) const
+{
+    int slot = slots_[idx];
+
+    switch (types_[idx])
+    {
+    case kPoint:
+        return Sample<kPoint>(slot, hit, sample, d, pdf);
+    case kDirectional:
+        return Sample<kDirectional>(slot, hit, sample, d, pdf);
+    case kArea:
+        return Sample<kArea>(slot, hit, sample, d, pdf);
+    case kEnvironment:
+        return Sample<kEnvironment>(slot, hit, sample, d, pdf);
+    }
+
+    pdf = 0.f;
+    return float3(0.f, 0.f, 0.f);
+}
+
+float LightSet::GetPdf(int idx, ShapeBundle::Hit const& hit, float3 const& w) const
+{
+    switch (types_[idx])
+    {
+    case kArea:
+        return arealights_[slots_[idx]]->GetPdf(hit, w);
+    case kEnvironment:
+        return envlights_[slots_[idx]]->GetPdf(hit, w);
+    default:
+        // Delta lights can't be hit by sampled directions
+        return 0.f;
+    }
+}
+
+float LightSet::GetSurfacePdf(int idx, ShapeBundle::Hit const& hit, ShapeBundle::Hit const& lighthit) const
+{
+    switch (types_[idx])
+    {
+    case kArea:
+        return arealights_[slots_[idx]]->GetSurfacePdf(hit, lighthit);
+    case kEnvironment:
+        return envlights_[slots_[idx]]->GetSurfacePdf(hit, lighthit);
+    default:
+        return 0.f;
+    }
+}
+
+float3 LightSet::GetLe(int idx, ray const& r) const
+{
+    switch (types_[idx])
+    {
+    case kArea:
+        return arealights_[slots_[idx]]->GetLe(r);
+    case kEnvironment:
+        return envlights_[slots_[idx]]->GetLe(r);
+    default:
+        // Nothing is emitted along escaped rays by delta lights
+        return float3(0.f, 0.f, 0.f);
+    }
+}
+
+float3 LightSet::GetLe(ray const& r) const
+{
+    float3 le;
+
+    for (int i = 0; i < (int)envlights_.size(); ++i)
+    {
+        le += envlights_[i]->GetLe(r);
+    }
+
+    return le;
+}
@@ -0,0 +1,119 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+#ifndef LIGHT_SET_H
+#define LIGHT_SET_H
+
+#include <memory>
+#include <vector>
+
+#include "../primitive/shapebundle.h"
+#include "../math/float3.h"
+#include "../math/ray.h"
+
+class Light;
+
+///< LightSet keeps scene lights partitioned by type. Point and directional lights are
+///< stored as structure of arrays and sampled by kernels specialized for the type,
+///< area and mesh lights go through the Light interface. Environment lights are kept
+///< in a separate list, so rays escaping the scene only visit them.
+///< Lights are addressed by their index in World::lights_.
+///<
+class LightSet
+{
+public:
+    enum LightType
+    {
+        kPoint,
+        kDirectional,
+        kArea,
+        kEnvironment
+    };
+
+    LightSet();
+
+    // Partition the lights, pointers to non-point, non-directional lights are kept
+    void Build(std::vector<std::unique_ptr<Light> > const& lights);
+
+    // Number of lights the set has been built for
+    std::size_t GetNumLights() const { return types_.size(); }
+
+    // Light type of light idx
+    LightType GetType(int idx) const { return (LightType)types_[idx]; }
+
+    // Check if light idx is singular
+    bool Singular(int idx) const { return singular_[idx] != 0; }
+
+    // Sample light idx, see Light::GetSample
+    float3 GetSample(int idx, ShapeBundle::Hit const& hit, float2 const& sample, float3& d, float& pdf) const;
+
+    // PDF of a direction sampled on light idx, see Light::GetPdf
+    float GetPdf(int idx, ShapeBundle::Hit const& hit, float3 const& w) const;
+
+    // PDF of sampling the point lighthit on light idx, see Light::GetSurfacePdf
+    float GetSurfacePdf(int idx, ShapeBundle::Hit const& hit, ShapeBundle::Hit const& lighthit) const;
+
+    // Radiance of light idx along the ray escaped the scene
+    float3 GetLe(int idx, ray const& r) const;
+
+    // Total radiance along the ray escaped the scene, only environment lights are visited
+    float3 GetLe(ray const& r) const;
+
+private:
+    // Sampling kernels specialized per light type, slot is the index within arrays of the type
+    template <int Type> float3 Sample(int slot, ShapeBundle::Hit const& hit, float2 const& sample, float3& d, float& pdf) const;
+
+    // Type of every light
+    std::vector<int> types_;
+    // Index of every light within arrays of its type
+    std::vector<int> slots_;
+    // Singularity flag of every light
+    std::vector<char> singular_;
+
+    // Point light positions
+    std::vector<float3> pointpositions_;
+    // Point light powers
+    std::vector<float3> pointpowers_;
+    // Directional light directions
+    std::vector<float3> dirdirections_;
+    // Directional light powers
+    std::vector<float3> dirpowers_;
+    // Area, mesh and any other lights with bounds
+    std::vector<Light const*> arealights_;
+    // Lights emitting along escaped rays
+    std::vector<Light const*> envlights_;
+
+    LightSet(LightSet const&);
+    LightSet& operator = (LightSet const&);
+};
+
+#endif // LIGHT_SET_H
@@ -0,0 +1,205 @@
+#include "meshlight.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+#include "../primitive/shapebundle.h"
+#include "../material/material.h"
+#include "../math/mathutils.h"
+#include "../math/alias_distribution1d.h"
+#include "../util/memoryreport.h"
+
+MeshLight::MeshLight(ShapeBundle& bundle, Material const& material)
+    : bundle_(bundle)
+    , material_(material)
+    , power_(0.f)
+{
+    if (!material_.IsEmissive())
+    {
+        throw std::runtime_error("MeshLight: The material passed is not an emissive one");
+    }
+
+    int numshapes = (int)bundle_.GetNumShapes();
+
+    if (numshapes == 0)
+    {
+        throw std::runtime_error("MeshLight: The bundle passed has no shapes");
+    }
+
+    // Weight shapes by their power: area times emission at the center along the normal
+    std::vector<float> shapepower(numshapes);
+    float sum = 0.f;
+
+    for (int i = 0; i < numshapes; ++i)
+    {
+        ShapeBundle::Sample sampledata;
+        bundle_.GetSampleOnShape(i, float2(4.f / 9.f, 0.5f), sampledata);
+
+        float3 le = material_.GetLe(sampledata, sampledata.n);
+
+        shapepower[i] = bundle_.GetShapeSurfaceArea(i) * (0.2126f * le.x + 0.7152f * le.y + 0.0722f * le.z);
+        sum += shapepower[i];
+    }
+
+    // Lambertian emitter radiates PI * Le per unit area
+    power_ = PI * sum;
+
+    // Fall back to uniform choice if nothing is emitted
+    if (sum <= 0.f)
+    {
+        std::fill(shapepower.begin(), shapepower.end(), 1.f);
+    }
+
+    shapedist_.reset(new AliasDistribution1D(numshapes, &shapepower[0]));
+
+    // Set this light for the primitive
+    bundle_.arealight_ = this;
+}
+
+MeshLight::~MeshLight()
+{
+}
+
+float3 MeshLight::GetSample(ShapeBundle::Hit const& hit, float2 const& sample, float3& d, float& pdf) const
+{
+    // Pick the shape reusing the first sample dimension
+    float2 uv = sample;
+    float shapepdf = 0.f;
+    int idx = shapedist_->SampleSegment(sample.x, shapepdf, uv.x);
+
+    // Get the sample point in world space
+    ShapeBundle::Sample sampledata;
+    bundle_.GetSampleOnShape(idx, uv, sampledata);
+
+    // Set direction to the light
+    d = sampledata.p - hit.p;
+
+    float3 wo = -normalize(d);
+    float cosl = dot(sampledata.n, wo);
+
+    // If the object facing the light compute emission
+    if (shapepdf > 0.f && cosl > 0.f)
+    {
+        // Convert surface area PDF to solid angle PDF
+        pdf = shapepdf * d.sqnorm() / (cosl * bundle_.GetShapeSurfaceArea(idx));
+
+        // Emission characteristic of the material has cosine term in it, so convert it to radiance
+        return material_.GetLe(sampledata, wo) * (1.f / cosl);
+    }
+
+    // Otherwise just set probability to 0
+    pdf = 0.f;
+    //
+    return float3();
+}
+
+float MeshLight::GetPdf(ShapeBundle::Hit const& hit, float3 const& w) const
+{
+    // TODO: put this to global settings
+    ray r(hit.p, w, float2(0.001f, 100000.f));
+
+    ShapeBundle::Intersection isect;
+    isect.t = r.t.y;
+
+    // Find closest point on the light
+    bool found = false;
+    for (std::size_t i = 0; i < bundle_.GetNumShapes(); ++i)
+    {
+        found = bundle_.IntersectShape(i, r, isect) || found;
+    }
+
+    if (!found)
+    {
+        return 0.f;
+    }
+
+    // Shading data is only needed for the closest one
+    ShapeBundle::Hit lighthit;
+    bundle_.FillHit(isect, r, lighthit);
+
+    return GetSurfacePdf(hit, lighthit);
+}
+
+float MeshLight::GetSurfacePdf(ShapeBundle::Hit const& hit, ShapeBundle::Hit const& lighthit) const
+{
+    if (lighthit.bundle != &bundle_)
+    {
+        return 0.f;
+    }
+
+    assert(lighthit.shapeidx >= 0 && lighthit.shapeidx < (int)bundle_.GetNumShapes());
+
+    // Construct direction
+    float3 d = lighthit.p - hit.p;
+    float cosl = dot(lighthit.n, -normalize(d));
+
+    if (cosl <= 0.f)
+    {
+        return 0.f;
+    }
+
+    // Convert surface area PDF to solid angle PDF
+    return shapedist_->SegmentPmf(lighthit.shapeidx) * d.sqnorm() / (cosl * bundle_.GetShapeSurfaceArea(lighthit.shapeidx));
+}
+
+float MeshLight::GetPower() const
+{
+    return power_;
+}
+
+bbox MeshLight::GetBounds() const
+{
+    return bundle_.GetWorldBounds();
+}
+
+void MeshLight::GetOrientation(float3& axis, float& thetao, float& thetae) const
+{
+    // Emission is cosine weighted over the hemisphere
+    thetae = 0.5f * PI;
+
+    // Collect corner normals of all the shapes
+    float2 const corners[3] = { float2(0.f, 0.f), float2(1.f, 0.f), float2(1.f, 1.f) };
+
+    std::vector<float3> normals;
+    normals.reserve(3 * bundle_.GetNumShapes());
+
+    axis = float3(0.f, 0.f, 0.f);
+
+    for (std::size_t i = 0; i < bundle_.GetNumShapes(); ++i)
+    {
+        float area = bundle_.GetShapeSurfaceArea(i);
+
+        for (int j = 0; j < 3; ++j)
+        {
+            ShapeBundle::Sample sampledata;
+            bundle_.GetSampleOnShape(i, corners[j], sampledata);
+
+            normals.push_back(normalize(sampledata.n));
+            axis += area * normals.back();
+        }
+    }
+
+    // Normals cancel out: emit everywhere
+    if (axis.sqnorm() == 0.f)
+    {
+        axis = normals[0];
+        thetao = PI;
+        return;
+    }
+
+    // Bound the normals with the cone around area weighted average
+    axis = normalize(axis);
+    thetao = 0.f;
+
+    for (std::size_t i = 0; i < normals.size(); ++i)
+    {
+        thetao = std::max(thetao, acosf(clamp(dot(axis, normals[i]), -1.f, 1.f)));
+    }
+}
+
+void MeshLight::GetMemoryUsage(MemoryReport& report) const
+{
+    report.Add("distribution", shapedist_->GetSizeInBytes());
+}
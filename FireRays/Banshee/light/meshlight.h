@@ -0,0 +1,106 @@
+/*
+    Banshee and all code, documentation, and other materials contained
+    therein are:
+
+        Copyright 2013 Dmitry Kozlov
+        All Rights Reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the software's owners nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+    (This is the Modified BSD License)
+*/
+#ifndef MESHLIGHT_H
+#define MESHLIGHT_H
+
+#include <memory>
+
+class ShapeBundle;
+class Material;
+class AliasDistribution1D;
+
+#include "light.h"
+
+///< The class represents the light formed by all the shapes of a bundle
+///< with an emissive material assigned to it. Shapes are picked in proportion
+///< to their area times emission using alias method, so sampling the point on
+///< the whole emitter takes O(1) regardless of the number of shapes.
+///<
+class MeshLight: public Light
+{
+public:
+    // The callers responsibility to pass only emissive materials.
+    // Shape areas are taken at construction time, so bundle transform should be set before.
+    //
+    MeshLight(ShapeBundle& bundle, Material const& material);
+
+    ~MeshLight();
+
+    // Sample method generates a direction to the light(d), calculates pdf in that direction (pdf)
+    // and returns radiance emitted(return value) into the direction specified by isect
+    // Note that no shadow testing occurs here, the method knows nothing about world's geometry
+    // and it is renderers responsibility to account for visibility term
+    float3 GetSample(ShapeBundle::Hit const& hit, float2 const& sample, float3& d, float& pdf) const;
+
+    // This method is supposed to be called by the renderer when the ray misses the geometry.
+    // It allows implementing IBL, etc.
+    float3 GetLe(ray const& r) const
+    {
+        // Nothing should be emitted here for mesh light
+        return float3(0, 0, 0);
+    }
+
+    // PDF of a given direction sampled from isect.p
+    // This one needs to intersect all the shapes, so GetSurfacePdf is preferred
+    float GetPdf(ShapeBundle::Hit const& hit, float3 const& w) const;
+
+    // PDF of sampling the point lighthit on the light from hit.p
+    float GetSurfacePdf(ShapeBundle::Hit const& hit, ShapeBundle::Hit const& lighthit) const;
+
+    // Check if the light is singular (represented by delta function or not)
+    bool Singular() const { return false; }
+
+    // Estimated total emitted power
+    float GetPower() const;
+
+    // World space bounds of the bundle
+    bbox GetBounds() const;
+
+    // Orientation cone of the shape normals
+    void GetOrientation(float3& axis, float& thetao, float& thetae) const;
+
+    // Report shape selection distribution
+    void GetMemoryUsage(MemoryReport& report) const;
+
+private:
+    // Primitive declaring the shape of the light
+    ShapeBundle& bundle_;
+    // Material
+    Material const& material_;
+    // Distribution of shapes proportional to their power
+    std::unique_ptr<AliasDistribution1D> shapedist_;
+    // Total power
+    float power_;
+};
+
+#endif // MESHLIGHT_H
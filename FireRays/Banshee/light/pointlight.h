@@ -64,6 +64,37 @@ public:
     {
         return 0.f;
     }
+
+    // Point light emits uniformly into the whole sphere
+    float GetPower() const
+    {
+        return 4.f * PI * (0.2126f * e_.x + 0.7152f * e_.y + 0.0722f * e_.z);
+    }
+
+    // The light is bounded by its position
+    bbox GetBounds() const
+    {
+        return bbox(p_);
+    }
+
+    // World space position
+    float3 const& GetPosition() const { return p_; }
+
+    // Emissive power
+    float3 const& GetEmission() const { return e_; }
+
+    // Sampling kernel for a point light at p with power e, LightSet calls it directly
+    static float3 Sample(float3 const& p, float3 const& e, ShapeBundle::Hit const& hit, float3& d, float& pdf)
+    {
+        // Light position is the only possible sample point for a point light
+        d = p - hit.p;
+        // It's probability density == 1
+        pdf = 1.f;
+        // Emissive power with squared fallof
+        float d2inv = 1.f / d.sqnorm();
+        //
+        return e * d2inv;
+    }
     
 private:
     // World space position
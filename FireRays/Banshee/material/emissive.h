@@ -52,24 +52,30 @@ public:
 
 
     // Sample material and return outgoing ray direction along with combined BSDF value
-    float3 Sample(ShapeBundle::Hit& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf, int& type) const
+    float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf, int& type) const
     {
         // Make sure to set PDF to 0, method is not supposed to be called 
         pdf = 0.f;
 
         // This method is not supposed to be called on emissive, but anyway
-        return GetLe(hit, wi);
+        return GetLe(ctx, wi);
     }
 
     // Evaluate combined BSDF value
-    float3 Evaluate(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
     {
         // This method is not supposed to be called on emissive, but anyway
-        return GetLe(hit, wi);
+        return GetLe(ctx, wi);
     }
     
+    // Emitters are not textured, so they do not need to differ in the feature buffer
+    float3 GetAlbedo(ShadingContext const& ctx, float3 const& wi) const
+    {
+        return float3(1.f, 1.f, 1.f);
+    }
+
     // PDF of a given direction sampled from isect.p
-    float GetPdf(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
     {
         return 0.f;
     }
@@ -59,22 +59,44 @@ public:
     , btdf_(new PerfectRefract(texsys, eta, ks, ksmap, "", new FresnelDielectric()))
     , fresnel_(new FresnelDielectric())
     , eta_(eta)
+    , compiled_(false)
     {
+        // Flatten at load time, Fresnel split between the lobes uses the same IOR
+        closure_.SetEta(eta_);
+        compiled_ = brdf_->Compile(closure_) && btdf_->Compile(closure_);
+    }
+    
+    // Fill shading context for the hit
+    void Prepare(ShapeBundle::Hit const& hit, ShadingContext& ctx) const
+    {
+        if (compiled_)
+        {
+            closure_.Prepare(hit, ctx);
+        }
+        else
+        {
+            ctx.Reset(hit);
+            brdf_->Prepare(ctx);
+            btdf_->Prepare(ctx);
+        }
     }
     
     // Sample material and return outgoing ray direction along with combined BSDF value
-    float3 Sample(ShapeBundle::Hit& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf, int& type) const
+    float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf, int& type) const
     {
+        if (compiled_)
+            return closure_.Sample(ctx, sample, wi, wo, pdf, type);
+        
         // Split sampling based on Fresnel
-        float rnd = rand_float();
+        float rnd = thread_rand_float();
         
-        float r = fresnel_->Evaluate(1.f, eta_, dot(hit.n, wi));
+        float r = fresnel_->Evaluate(1.f, eta_, dot(ctx.n, wi));
         
         // Reflective part
         if (rnd < r)
         {
             type = brdf_->GetType();
-            float3 f = brdf_->Sample(hit, sample, wi, wo, pdf);
+            float3 f = brdf_->Sample(ctx, sample, wi, wo, pdf);
             pdf *= r;
             return f;
         }
@@ -82,20 +104,20 @@ public:
         else
         {
             type = btdf_->GetType();
-            float3 f = btdf_->Sample(hit, sample, wi, wo, pdf);
+            float3 f = btdf_->Sample(ctx, sample, wi, wo, pdf);
             pdf *= (1.f - r);
             return f;
         }
     }
     
     // PDF of a given direction sampled from isect.p
-    float GetPdf(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
     {
         return 0.f;
     }
     
     // Evaluate combined BSDF value
-    float3 Evaluate(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
     {
         return float3();
     }
@@ -107,6 +129,10 @@ private:
     std::unique_ptr<Bsdf> btdf_;
     // TODO: need to save space and not spawn Fresnel objects everywhere
     std::unique_ptr<Fresnel> fresnel_;
+    // Flattened BSDFs
+    Closure closure_;
+    // Whether BSDFs have been flattened
+    bool compiled_;
  };
 
 #endif // GLASS_H
@@ -37,6 +37,7 @@
 
 #include "../texture/texturesystem.h"
 #include "../primitive/shapebundle.h"
+#include "../bsdf/shading_context.h"
 
 
 ///< Material is an interface for the renderer to call
@@ -52,19 +53,33 @@ public:
     // Destructor
     virtual ~Material() {}
 
+    // Fill shading context for the hit, called once per hit before any queries
+    virtual void Prepare(ShapeBundle::Hit const& hit, ShadingContext& ctx) const
+    {
+        ctx.Reset(hit);
+    }
+
     // Sample material and return outgoing ray direction along with combined BSDF value and sampled BSDF type
-    virtual float3 Sample(ShapeBundle::Hit& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf, int& type) const = 0;
+    virtual float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf, int& type) const = 0;
 
     // Evaluate combined BSDF value
-    virtual float3 Evaluate(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const = 0;
+    virtual float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const = 0;
     
     // PDF of a given direction sampled from isect.p
-    virtual float GetPdf(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const = 0;
+    virtual float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const = 0;
 
     // Indicate whether the materials has emission component and will be used for direct light evaluation
     virtual bool IsEmissive() const { return false; }
 
     // Emission component of the material
     virtual float3 GetLe(ShapeBundle::Sample const& sampledata, float3 const& wo) const { return float3(0,0,0); }
+
+    // Approximate surface color seen from wi, used as a denoiser feature
+    // Diffuse BSDF times PI is its albedo, specular ones give black
+    virtual float3 GetAlbedo(ShadingContext const& ctx, float3 const& wi) const
+    {
+        float3 n = dot(wi, ctx.n) >= 0.f ? ctx.n : -ctx.n;
+        return Evaluate(ctx, wi, n) * 3.14159265f;
+    }
 };
 #endif // MATERIAL_H
\ No newline at end of file
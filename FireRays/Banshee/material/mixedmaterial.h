@@ -49,25 +49,51 @@ public:
     MixedMaterial(float eta)
     : fresnel_(new FresnelDielectric())
     , eta_(eta)
+    , compiled_(false)
     {
     }
     
+    // Fill shading context for the hit
+    void Prepare(ShapeBundle::Hit const& hit, ShadingContext& ctx) const
+    {
+        if (compiled_)
+        {
+            closure_.Prepare(hit, ctx);
+            return;
+        }
+        
+        ctx.Reset(hit);
+        
+        for (int i=0;i<(int)brdfs_.size();++i)
+        {
+            brdfs_[i]->Prepare(ctx);
+        }
+        
+        for (int i=0;i<(int)btdfs_.size();++i)
+        {
+            btdfs_[i]->Prepare(ctx);
+        }
+    }
+    
     // Sample material and return outgoing ray direction along with combined BSDF value
-    float3 Sample(ShapeBundle::Hit& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf, int& type) const
+    float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf, int& type) const
     {
+        if (compiled_)
+            return closure_.Sample(ctx, sample, wi, wo, pdf, type);
+        
         // Evaluate Fresnel and choose whether BRDFs or BTDFs should be sampled
-        float reflectance = fresnel_->Evaluate(1.f, eta_, dot(hit.n, wi));
+        float reflectance = fresnel_->Evaluate(1.f, eta_, dot(ctx.n, wi));
         
-        float rnd = rand_float();
+        float rnd = thread_rand_float();
         
         if (btdfs_.size() == 0 || rnd < reflectance)
         {
             // Sample BRDFs
             assert(brdfs_.size());
             // Choose which one to sample
-            int idx = rand_uint() % brdfs_.size();
+            int idx = thread_rand_uint() % brdfs_.size();
             // Sample it
-            float3 f = brdfs_[idx]->Sample(hit, sample, wi, wo, pdf);
+            float3 f = brdfs_[idx]->Sample(ctx, sample, wi, wo, pdf);
             // Set type
             type = brdfs_[idx]->GetType();
             // Normalize
@@ -80,9 +106,9 @@ public:
             // Sample BTDFs
             assert(btdfs_.size());
             // Choose which one to sample
-            int idx = rand_uint() % btdfs_.size();
+            int idx = thread_rand_uint() % btdfs_.size();
             // Sample it
-            float3 f = btdfs_[idx]->Sample(hit, sample, wi, wo, pdf);
+            float3 f = btdfs_[idx]->Sample(ctx, sample, wi, wo, pdf);
             // Set type
             type = btdfs_[idx]->GetType();
             // Normalize
@@ -94,17 +120,20 @@ public:
         return float3();
     }
     
-    // PDF of a given direction sampled from hit.p
-    float GetPdf(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    // PDF of a given direction sampled from ctx.p
+    float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
     {
+        if (compiled_)
+            return closure_.GetPdf(ctx, wi, wo);
+        
         float pdf = 0.f;
 
-        if (dot(hit.n, wi) > 0.f)
+        if (dot(ctx.n, wi) > 0.f)
         {
             // Compute PDF
             for (int i=0;i<(int)brdfs_.size();++i)
             {
-                pdf += brdfs_[i]->GetPdf(hit, wi, wo);
+                pdf += brdfs_[i]->GetPdf(ctx, wi, wo);
             }
 
             // Normalize
@@ -115,7 +144,7 @@ public:
             // Compute PDF
             for (int i=0;i<(int)btdfs_.size();++i)
             {
-                pdf += btdfs_[i]->GetPdf(hit, wi, wo);
+                pdf += btdfs_[i]->GetPdf(ctx, wi, wo);
             }
             
             // Normalize
@@ -126,16 +155,19 @@ public:
     }
 
     // Evaluate combined BSDF value
-    float3 Evaluate(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
     {
+        if (compiled_)
+            return closure_.Evaluate(ctx, wi, wo);
+        
         float3 f;
 
-        if (dot(hit.n, wi) > 0.f)
+        if (dot(ctx.n, wi) > 0.f)
         {
             // Compute PDF
             for (int i=0;i<(int)brdfs_.size();++i)
             {
-                f += brdfs_[i]->Evaluate(hit, wi, wo);
+                f += brdfs_[i]->Evaluate(ctx, wi, wo);
             }
         }
         else
@@ -143,7 +175,7 @@ public:
             // Compute BTDF
             for (int i=0;i<(int)btdfs_.size();++i)
             {
-                f += btdfs_[i]->Evaluate(hit, wi, wo);
+                f += btdfs_[i]->Evaluate(ctx, wi, wo);
             }
         }
 
@@ -161,6 +193,22 @@ public:
         {
             btdfs_.push_back(std::unique_ptr<Bsdf>(bsdf));
         }
+        
+        // Flatten the whole set again
+        closure_.Clear();
+        closure_.SetEta(eta_);
+        
+        compiled_ = true;
+        
+        for (int i=0;i<(int)brdfs_.size();++i)
+        {
+            compiled_ = compiled_ && brdfs_[i]->Compile(closure_);
+        }
+        
+        for (int i=0;i<(int)btdfs_.size();++i)
+        {
+            compiled_ = compiled_ && btdfs_[i]->Compile(closure_);
+        }
     }
     
 private:
@@ -171,6 +219,10 @@ private:
     std::unique_ptr<Fresnel> fresnel_;
     // Refractive index
     float eta_;
+    // Flattened BSDFs
+    Closure closure_;
+    // Whether BSDFs have been flattened
+    bool compiled_;
 };
 
 #endif // MIXEDMATERIAL_H
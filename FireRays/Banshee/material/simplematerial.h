@@ -47,31 +47,59 @@ public:
     // If diffuse map is specified it is used as a diffuse color, otherwise diffuse color is used
     SimpleMaterial(Bsdf* bsdf)
     : bsdf_(bsdf)
+    , compiled_(bsdf->Compile(closure_))
     {
     }
 
+    // Fill shading context for the hit
+    void Prepare(ShapeBundle::Hit const& hit, ShadingContext& ctx) const
+    {
+        if (compiled_)
+        {
+            closure_.Prepare(hit, ctx);
+        }
+        else
+        {
+            ctx.Reset(hit);
+            bsdf_->Prepare(ctx);
+        }
+    }
+
     // Sample material and return outgoing ray direction along with combined BSDF value
-    float3 Sample(ShapeBundle::Hit& hit, float2 const& sample, float3 const& wi, float3& wo, float& pdf, int& type) const
+    float3 Sample(ShadingContext const& ctx, float2 const& sample, float3 const& wi, float3& wo, float& pdf, int& type) const
     {
+        if (compiled_)
+            return closure_.Sample(ctx, sample, wi, wo, pdf, type);
+        
         type = bsdf_->GetType();
-        return bsdf_->Sample(hit, sample, wi, wo, pdf);
+        return bsdf_->Sample(ctx, sample, wi, wo, pdf);
     }
     
-    // PDF of a given direction sampled from hit.p
-    float GetPdf(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    // PDF of a given direction sampled from ctx.p
+    float GetPdf(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
     {
-        return bsdf_->GetPdf(hit, wi, wo);
+        if (compiled_)
+            return closure_.GetPdf(ctx, wi, wo);
+        
+        return bsdf_->GetPdf(ctx, wi, wo);
     }
 
     // Evaluate combined BSDF value
-    float3 Evaluate(ShapeBundle::Hit& hit, float3 const& wi, float3 const& wo) const
+    float3 Evaluate(ShadingContext const& ctx, float3 const& wi, float3 const& wo) const
     {
-        return bsdf_->Evaluate(hit, wi, wo);
+        if (compiled_)
+            return closure_.Evaluate(ctx, wi, wo);
+        
+        return bsdf_->Evaluate(ctx, wi, wo);
     }
     
 private:
     // BSDF
     std::unique_ptr<Bsdf> bsdf_;
+    // Flattened BSDF
+    Closure closure_;
+    // Whether BSDF has been flattened, virtual BSDF calls are used otherwise
+    bool compiled_;
 };
 
 #endif // SIMPLEMATERIAL_H
\ No newline at end of file
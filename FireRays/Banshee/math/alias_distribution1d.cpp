@@ -0,0 +1,137 @@
+#include "alias_distribution1d.h"
+#include "mathutils.h"
+
+#include <algorithm>
+#include <cassert>
+
+AliasDistribution1D::AliasDistribution1D(int numsegments, float const* values)
+: funcvals_(numsegments)
+, prob_(numsegments)
+, alias_(numsegments)
+, numsegments_(numsegments)
+, funcint_(0.f)
+{
+    // Copy function values
+    std::copy(values, values + numsegments, funcvals_.begin());
+
+    // Calculate normalizer
+    for (int i=0; i<numsegments; ++i)
+    {
+        funcint_ += funcvals_[i] / numsegments;
+    }
+
+    // Fall back to uniform distribution if the function is zero everywhere
+    if (funcint_ == 0.f)
+    {
+        std::fill(funcvals_.begin(), funcvals_.end(), 1.f);
+        funcint_ = 1.f;
+    }
+
+    // Scale probabilities so the average is 1 and split
+    // segments into underfull and overfull ones
+    std::vector<float> scaled(numsegments);
+    std::vector<int> small;
+    std::vector<int> large;
+
+    for (int i=0; i<numsegments; ++i)
+    {
+        scaled[i] = funcvals_[i] / funcint_;
+
+        if (scaled[i] < 1.f)
+        {
+            small.push_back(i);
+        }
+        else
+        {
+            large.push_back(i);
+        }
+    }
+
+    // Fill underfull segments with overfull ones
+    while (!small.empty() && !large.empty())
+    {
+        int s = small.back();
+        small.pop_back();
+        int l = large.back();
+
+        prob_[s] = scaled[s];
+        alias_[s] = l;
+
+        scaled[l] = (scaled[l] + scaled[s]) - 1.f;
+
+        if (scaled[l] < 1.f)
+        {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+
+    // Whatever remains is full up to round off errors
+    for (size_t i=0; i<large.size(); ++i)
+    {
+        prob_[large[i]] = 1.f;
+        alias_[large[i]] = large[i];
+    }
+
+    for (size_t i=0; i<small.size(); ++i)
+    {
+        prob_[small[i]] = 1.f;
+        alias_[small[i]] = small[i];
+    }
+}
+
+int AliasDistribution1D::SampleSegment(float u, float& pmf, float& du) const
+{
+    // Find the segment here u lies
+    float un = u * numsegments_;
+    int segidx = clamp((int)un, 0, numsegments_-1);
+    float frac = std::min(un - segidx, 0.99999994f);
+
+    // Either keep it or go to its alias
+    if (frac < prob_[segidx])
+    {
+        du = frac / prob_[segidx];
+    }
+    else
+    {
+        du = (frac - prob_[segidx]) / (1.f - prob_[segidx]);
+        segidx = alias_[segidx];
+    }
+
+    du = std::min(du, 0.99999994f);
+    pmf = SegmentPmf(segidx);
+
+    return segidx;
+}
+
+float AliasDistribution1D::SegmentPmf(int idx) const
+{
+    assert(idx >= 0 && idx < numsegments_);
+
+    return funcvals_[idx] / (funcint_ * numsegments_);
+}
+
+float AliasDistribution1D::Sample1D(float u, float& pdf) const
+{
+    float pmf, du;
+    int segidx = SampleSegment(u, pmf, du);
+
+    // Calc pdf
+    pdf = funcvals_[segidx] / funcint_;
+
+    // Return corresponding value
+    return (segidx + du) / numsegments_;
+}
+
+float AliasDistribution1D::Pdf(float u) const
+{
+    int segidx = clamp((int)(u * numsegments_), 0, numsegments_-1);
+
+    // Calc pdf
+    return funcvals_[segidx] / funcint_;
+}
+
+std::size_t AliasDistribution1D::GetSizeInBytes() const
+{
+    return sizeof(AliasDistribution1D) + (funcvals_.capacity() + prob_.capacity()) * sizeof(float) + alias_.capacity() * sizeof(int);
+}
@@ -0,0 +1,79 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+#ifndef ALIAS_DISTRIBUTION1D_H
+#define ALIAS_DISTRIBUTION1D_H
+
+#include <vector>
+
+///< The class represents 1D piecewise constant distribution of random variable
+///< sampled using alias method (Walker, Vose). Both sampling and PDF evaluation take O(1)
+///< compared to O(log(n)) binary search over the CDF of Distribution1D. Note that
+///< the mapping from random numbers to values is not monotonic, so stratification
+///< of input samples is only preserved within segments.
+///<
+class AliasDistribution1D
+{
+public:
+    // values are function values at equal spacing at numsegments points within [0,1] range
+    AliasDistribution1D(int numsegments, float const* values);
+    
+    // Sample one value using this distribution
+    float Sample1D(float u, float& pdf) const;
+    
+    // PDF
+    float Pdf(float u) const;
+    
+    // Memory held by the tables in bytes
+    std::size_t GetSizeInBytes() const;
+
+    // Pick the segment with probability proportional to its value,
+    // returns the segment, its probability and u remapped back to [0,1)
+    int SampleSegment(float u, float& pmf, float& du) const;
+
+    // Probability of picking the segment
+    float SegmentPmf(int idx) const;
+    
+    // Function values
+    std::vector<float> funcvals_;
+    // Probability of keeping the segment
+    std::vector<float> prob_;
+    // Segment to go to otherwise
+    std::vector<int> alias_;
+    // Number of segments
+    int numsegments_;
+    // Integral of the function over the whole range (normalizer)
+    float funcint_;
+};
+
+
+#endif // ALIAS_DISTRIBUTION1D_H
@@ -0,0 +1,76 @@
+#include "alias_distribution2d.h"
+
+#include "mathutils.h"
+#include "../util/memoryreport.h"
+
+#include <algorithm>
+
+AliasDistribution2D::AliasDistribution2D(int n, int m, float const* values)
+: n_(n)
+, m_(m)
+, conddist_(m)
+{
+    // Calculate conditional sampling density given a row is choosen
+    for (int i=0; i<m; ++i)
+    {
+        // For row i
+        conddist_[i].reset(new AliasDistribution1D(n, values + i*n));
+    }
+    
+    // Calculate marginal sampling density for rows, taken from the values
+    // as zero rows fall back to uniform conditional distributions
+    std::vector<float> funcint(m, 0.f);
+    for (int i=0; i<m; ++i)
+    {
+        for (int j=0; j<n; ++j)
+        {
+            funcint[i] += values[i*n + j] / n;
+        }
+    }
+    
+    // Create marginal distribution
+    marginaldist_.reset(new AliasDistribution1D(m, &funcint[0]));
+}
+
+
+float2 AliasDistribution2D::Sample2D(float2 u, float& pdf) const
+{
+    float2 sample;
+    
+    // Row and column pdf
+    float rpdf, cpdf;
+    
+    // Sample marginal distribution for the row
+    sample.y = marginaldist_->Sample1D(u.y, rpdf);
+
+    // Convert to row index
+    int rowidx = clamp((int)(sample.y * m_), 0, m_-1);
+    
+    // Sample conditional density for column
+    sample.x = conddist_[rowidx]->Sample1D(u.x, cpdf);
+
+    // Multiply pdfs
+    pdf = rpdf * cpdf;
+
+    return sample;
+}
+
+float AliasDistribution2D::Pdf(float2 uv) const
+{
+    int rowidx = clamp((int)(uv.y * m_), 0, m_-1);
+    int colidx = clamp((int)(uv.x * n_), 0, n_-1);
+    
+    return conddist_[rowidx]->funcvals_[colidx] * marginaldist_->funcvals_[rowidx] / (conddist_[rowidx]->funcint_ * marginaldist_->funcint_);
+}
+
+void AliasDistribution2D::GetMemoryUsage(MemoryReport& report) const
+{
+    std::size_t bytes = marginaldist_->GetSizeInBytes();
+
+    for (auto& dist : conddist_)
+    {
+        bytes += dist->GetSizeInBytes();
+    }
+
+    report.Add("distribution", bytes);
+}
@@ -60,4 +60,9 @@ float Distribution1D::Pdf(float u)
     
     // Calc pdf
     return funcvals_[segidx-1] / funcint_;
-}
\ No newline at end of file
+}
+
+std::size_t Distribution1D::GetSizeInBytes() const
+{
+    return sizeof(Distribution1D) + (funcvals_.capacity() + cdf_.capacity()) * sizeof(float);
+}
@@ -51,6 +51,9 @@ public:
     // PDF
     float Pdf(float u);
     
+    // Memory held by the tables in bytes
+    std::size_t GetSizeInBytes() const;
+    
     // Function values
     std::vector<float> funcvals_;
     // Cumulative distribution function
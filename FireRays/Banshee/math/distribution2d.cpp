@@ -1,6 +1,7 @@
 #include "distribution2d.h"
 
 #include "mathutils.h"
+#include "../util/memoryreport.h"
 
 #include <algorithm>
 
@@ -58,4 +59,16 @@ float Distribution2D::Pdf(float2 uv)
     if (conddist_[rowidx]->funcint_ * marginaldist_->funcint_ == 0.f) return 0.f;
     
     return conddist_[rowidx]->funcvals_[colidx] * marginaldist_->funcvals_[rowidx] / (conddist_[rowidx]->funcint_ * marginaldist_->funcint_);
-}
\ No newline at end of file
+}
+
+void Distribution2D::GetMemoryUsage(MemoryReport& report) const
+{
+    std::size_t bytes = marginaldist_->GetSizeInBytes();
+
+    for (auto& dist : conddist_)
+    {
+        bytes += dist->GetSizeInBytes();
+    }
+
+    report.Add("distribution", bytes);
+}
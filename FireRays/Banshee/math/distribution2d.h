@@ -38,6 +38,8 @@
 #include "float2.h"
 #include "distribution1d.h"
 
+class MemoryReport;
+
 ///< The class represents 2D piecewise constant distribution of random variable.
 ///< The PDF is proprtional to passed function defined at NxM points in [0,1]x[0,1] interval
 ///<
@@ -53,6 +55,9 @@ public:
     // PDF
     float Pdf(float2 uv);
     
+    // Report conditional and marginal tables
+    void GetMemoryUsage(MemoryReport& report) const;
+    
 private:
     // Dimension of the grid
     int n_, m_;
@@ -0,0 +1,157 @@
+#include "hierarchical_distribution2d.h"
+
+#include "mathutils.h"
+#include "../util/memoryreport.h"
+
+#include <algorithm>
+
+HierarchicalDistribution2D::HierarchicalDistribution2D(int n, int m, float const* values)
+: n_(n)
+, m_(m)
+, funcint_(0.f)
+{
+    // Finest level is padded with zeroes up to power of 2
+    int2 dim((int)upper_power_of_two(n), (int)upper_power_of_two(m));
+
+    levels_.push_back(std::vector<float>(dim.x * dim.y, 0.f));
+    dims_.push_back(dim);
+
+    for (int y=0; y<m; ++y)
+    {
+        for (int x=0; x<n; ++x)
+        {
+            levels_[0][y * dim.x + x] = values[y * n + x];
+            funcint_ += values[y * n + x];
+        }
+    }
+
+    // Fall back to uniform distribution if the function is zero everywhere
+    if (funcint_ == 0.f)
+    {
+        for (int y=0; y<m; ++y)
+        {
+            std::fill(levels_[0].begin() + y * dim.x, levels_[0].begin() + y * dim.x + n, 1.f);
+        }
+
+        funcint_ = (float)(n * m);
+    }
+
+    funcint_ /= (n * m);
+
+    // Sum up 2x2 (or 2x1, 1x2) blocks until we get to a single value
+    while (dim.x > 1 || dim.y > 1)
+    {
+        int2 pdim(std::max(dim.x / 2, 1), std::max(dim.y / 2, 1));
+        int2 step(dim.x / pdim.x, dim.y / pdim.y);
+
+        std::vector<float> const& fine = levels_.back();
+        std::vector<float> coarse(pdim.x * pdim.y, 0.f);
+
+        for (int y=0; y<dim.y; ++y)
+        {
+            for (int x=0; x<dim.x; ++x)
+            {
+                coarse[(y / step.y) * pdim.x + (x / step.x)] += fine[y * dim.x + x];
+            }
+        }
+
+        levels_.push_back(coarse);
+        dims_.push_back(pdim);
+        dim = pdim;
+    }
+}
+
+float2 HierarchicalDistribution2D::Sample2D(float2 u, float& pdf) const
+{
+    u = clamp(u, float2(0.f, 0.f), float2(0.99999994f, 0.99999994f));
+
+    // Start from the top cell
+    int x = 0;
+    int y = 0;
+
+    for (int l = (int)levels_.size() - 2; l >= 0; --l)
+    {
+        std::vector<float> const& level = levels_[l];
+        int2 dim = dims_[l];
+        int2 step(dim.x / dims_[l + 1].x, dim.y / dims_[l + 1].y);
+
+        x *= step.x;
+        y *= step.y;
+
+        // Choose the column first summing up both rows
+        if (step.x > 1)
+        {
+            float left = level[y * dim.x + x];
+            float right = level[y * dim.x + x + 1];
+
+            if (step.y > 1)
+            {
+                left += level[(y + 1) * dim.x + x];
+                right += level[(y + 1) * dim.x + x + 1];
+            }
+
+            float pl = left / (left + right);
+
+            if (u.x < pl)
+            {
+                u.x = u.x / pl;
+            }
+            else
+            {
+                u.x = (u.x - pl) / (1.f - pl);
+                ++x;
+            }
+
+            u.x = std::min(u.x, 0.99999994f);
+        }
+
+        // Then choose the row within the column
+        if (step.y > 1)
+        {
+            float top = level[y * dim.x + x];
+            float bottom = level[(y + 1) * dim.x + x];
+
+            float pt = top / (top + bottom);
+
+            if (u.y < pt)
+            {
+                u.y = u.y / pt;
+            }
+            else
+            {
+                u.y = (u.y - pt) / (1.f - pt);
+                ++y;
+            }
+
+            u.y = std::min(u.y, 0.99999994f);
+        }
+    }
+
+    // Calc pdf
+    pdf = levels_[0][y * dims_[0].x + x] / funcint_;
+
+    // Continuous position within the cell
+    return float2((x + u.x) / n_, (y + u.y) / m_);
+}
+
+float HierarchicalDistribution2D::Pdf(float2 uv) const
+{
+    int rowidx = clamp((int)(uv.y * m_), 0, m_-1);
+    int colidx = clamp((int)(uv.x * n_), 0, n_-1);
+
+    if (funcint_ == 0.f) return 0.f;
+
+    return levels_[0][rowidx * dims_[0].x + colidx] / funcint_;
+}
+
+void HierarchicalDistribution2D::GetMemoryUsage(MemoryReport& report) const
+{
+    std::size_t bytes = 0;
+
+    for (auto& level : levels_)
+    {
+        bytes += level.capacity() * sizeof(float);
+    }
+
+    report.Add("distribution", bytes);
+}
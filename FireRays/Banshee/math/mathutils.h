@@ -64,6 +64,21 @@ inline float rand_float() { return (float)std::rand()/RAND_MAX; }
 /// Genarate random uint value
 inline unsigned	rand_uint() { return (unsigned)std::rand(); }
 
+/// Generate random uint value from the state private to the calling thread.
+/// std::rand takes a lock in most CRTs, render threads should use these instead.
+/// The state is a multiply-with-carry generator seeded from std::rand on first use.
+inline unsigned thread_rand_uint()
+{
+    static thread_local unsigned z = rand_uint() | 1;
+    static thread_local unsigned w = rand_uint() | 1;
+    z = 36969 * (z & 65535) + (z >> 16);
+    w = 18000 * (w & 65535) + (w >> 16);
+    return (z << 16) + w;
+}
+
+/// Generate random float value within [0,1) range from the state private to the calling thread
+inline float thread_rand_float() { return (thread_rand_uint() >> 8) * (1.f / (1 << 24)); }
+
 /// Convert cartesian coordinates to spherical
 inline void	cartesian_to_spherical ( float3 const& cart, float& r, float& phi, float& theta )
 {
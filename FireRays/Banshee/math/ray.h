@@ -47,6 +47,8 @@ public:
         , d(dd)
         , t(rng)
         , id(0)
+        , width(0)
+        , spread(0)
     {
     }
 
@@ -59,6 +61,11 @@ public:
     float3 d;
     float2 t;
     int   id;
+    // Ray cone approximating ray differentials:
+    // footprint width at the origin and spread angle,
+    // both zero if the ray carries no differentials
+    float width;
+    float spread;
 };
 
 #endif // RAY_H
\ No newline at end of file
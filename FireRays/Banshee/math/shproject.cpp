@@ -17,6 +17,9 @@ void ShProjectEnvironmentMap(TextureSystem const& texsys, std::string const& tex
     TextureSystem::TextureDesc texdesc;
     texsys.GetTextureInfo(texture, texdesc);
 
+    // Resolve texture once
+    int handle = texsys.GetHandle(texture);
+
     // Precompute sin and cos for the sphere
     std::vector<float> sintheta(texdesc.height);
     std::vector<float> costheta(texdesc.height);
@@ -40,22 +43,31 @@ void ShProjectEnvironmentMap(TextureSystem const& texsys, std::string const& tex
         costheta[i] = std::cos(theta0 + i * thetastep);
     }
 
+    // Point sample texels
+    TextureSystem::Options opts;
+    opts.wrapmode = TextureSystem::Options::kRepeat;
+    opts.filter= TextureSystem::Options::kPoint;
+
+    // Texel column uvs and values fetched with a single batched call
+    std::vector<float2> uvs(texdesc.height);
+    std::vector<float3> le(texdesc.height);
+
     // Iterate over the pixels calculating Riemann sum
     for (int phi = 0; phi < texdesc.width; ++phi)
     {
+        // Construct uv sample coordinates
         for (int theta = 0; theta < texdesc.height; ++theta)
         {
-            // Construct direction vector
-            float3 w = normalize(float3(sintheta[theta] * cosphi[phi], costheta[theta], sintheta[theta] * sinphi[phi]));
+            uvs[theta] = float2((float)phi / texdesc.width, (float)theta / texdesc.height);
+        }
 
-            // Construct uv sample coordinates
-            float2 uv = float2((float)phi / texdesc.width, (float)theta / texdesc.height);
+        // Sample environment map
+        texsys.SampleBatch(handle, &uvs[0], nullptr, &le[0], texdesc.height, opts);
 
-            // Sample environment map
-            TextureSystem::Options opts;
-            opts.wrapmode = TextureSystem::Options::kRepeat;
-            opts.filter= TextureSystem::Options::kPoint;
-            float3 le = texsys.Sample(texture, uv, float2());
+        for (int theta = 0; theta < texdesc.height; ++theta)
+        {
+            // Construct direction vector
+            float3 w = normalize(float3(sintheta[theta] * cosphi[phi], costheta[theta], sintheta[theta] * sinphi[phi]));
 
             // Evaluate SH functions at w up to lmax band
             ShEvaluate(w, lmax, &ylm[0]);
@@ -63,7 +75,7 @@ void ShProjectEnvironmentMap(TextureSystem const& texsys, std::string const& tex
             // Evaluate Riemann sum accouting for solid angle conversion (sin term)
             for (int i = 0; i < NumShTerms(lmax); ++i)
             {
-                coeffs[i] += le * ylm[i] * sintheta[theta] * (PI / texdesc.height) * (2.f * PI / texdesc.width);
+                coeffs[i] += le[theta] * ylm[i] * sintheta[theta] * (PI / texdesc.height) * (2.f * PI / texdesc.width);
             }
         }
     }
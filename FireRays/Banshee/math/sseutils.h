@@ -0,0 +1,79 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+
+#ifndef SSEUTILS_H
+#define SSEUTILS_H
+
+#include <emmintrin.h>
+
+#include "float2.h"
+
+/// Integer helpers for the code processing 4 values at once,
+/// limited to SSE2 which is the baseline for all the builds
+
+/// Multiply 32 bit integers keeping low 32 bits of the results
+inline __m128i mullo_epi32(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/// Reverse the bits of 32 bit integers
+inline __m128i reverse_bits_epi32(__m128i n)
+{
+    n = _mm_or_si128(_mm_srli_epi32(n, 16), _mm_slli_epi32(n, 16));
+    n = _mm_or_si128(_mm_srli_epi32(_mm_and_si128(n, _mm_set1_epi32(0xff00ff00)), 8), _mm_slli_epi32(_mm_and_si128(n, _mm_set1_epi32(0x00ff00ff)), 8));
+    n = _mm_or_si128(_mm_srli_epi32(_mm_and_si128(n, _mm_set1_epi32(0xf0f0f0f0)), 4), _mm_slli_epi32(_mm_and_si128(n, _mm_set1_epi32(0x0f0f0f0f)), 4));
+    n = _mm_or_si128(_mm_srli_epi32(_mm_and_si128(n, _mm_set1_epi32(0xcccccccc)), 2), _mm_slli_epi32(_mm_and_si128(n, _mm_set1_epi32(0x33333333)), 2));
+    n = _mm_or_si128(_mm_srli_epi32(_mm_and_si128(n, _mm_set1_epi32(0xaaaaaaaa)), 1), _mm_slli_epi32(_mm_and_si128(n, _mm_set1_epi32(0x55555555)), 1));
+    return n;
+}
+
+/// Convert unsigned 32 bit integers to float rounding the same way scalar conversion does
+inline __m128 cvtepu32_ps(__m128i n)
+{
+    __m128 hi = _mm_cvtepi32_ps(_mm_srli_epi32(n, 16));
+    __m128 lo = _mm_cvtepi32_ps(_mm_and_si128(n, _mm_set1_epi32(0xffff)));
+    return _mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.f)), lo);
+}
+
+/// Interleave x and y components and store 4 float2 values
+inline void store_float2x4(float2* out, __m128 x, __m128 y)
+{
+    float* dst = &out[0].x;
+    _mm_storeu_ps(dst, _mm_unpacklo_ps(x, y));
+    _mm_storeu_ps(dst + 4, _mm_unpackhi_ps(x, y));
+}
+
+#endif // SSEUTILS_H
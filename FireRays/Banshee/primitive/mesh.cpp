@@ -1,8 +1,12 @@
 #include "mesh.h"
 
 #include "../math/mathutils.h"
+#include "../util/renderstats.h"
+#include "../util/memoryreport.h"
 
 #include <cassert>
+#include <cmath>
+#include <algorithm>
 
 bool Mesh::IntersectFace(Face const& face, ray const& ro, float tmax, float& t, float& a, float& b) const
 {
@@ -44,7 +48,7 @@ bool Mesh::IntersectFace(Face const& face, ray const& ro, float tmax, float& t,
     return false;
 }
 
-void Mesh::FillHit(Face const& face, float t, float a, float b, Hit& hit) const
+void Mesh::FillHit(Face const& face, ray const& r, float t, float a, float b, Hit& hit) const
 {
     // Get transform
     matrix m, minv;
@@ -82,18 +86,42 @@ void Mesh::FillHit(Face const& face, float t, float a, float b, Hit& hit) const
      if (det != 0.f)
      {
          float invdet = 1.f / det;
-         hit.dpdu = normalize(transform_normal(( dv2 * dp1 - dv1 * dp2) * invdet, minv));
-         hit.dpdv = normalize(transform_normal((-du2 * dp1 + du1 * dp2) * invdet, minv));
+         float3 dpdu = normalize(transform_normal(( dv2 * dp1 - dv1 * dp2) * invdet, minv));
+         float3 dpdv = normalize(transform_normal((-du2 * dp1 + du1 * dp2) * invdet, minv));
+         
+         // Orthogonalize tangent w.r.t. shading normal and keep
+         // UV orientation only, bitangent is derived from them
+         float3 tangent = dpdu - dot(dpdu, hit.n) * hit.n;
+         hit.dpdu = tangent.sqnorm() > 0.f ? normalize(tangent) : orthovector(hit.n);
+         hit.handedness = dot(cross(hit.n, hit.dpdu), dpdv) < 0.f ? -1.f : 1.f;
      }
      else
      {
          hit.dpdu = orthovector(hit.n);
-         hit.dpdv = cross(hit.n, hit.dpdu);
+         hit.handedness = 1.f;
      }
      
      hit.uv = (1.f - a - b) * t1 + a * t2 + b * t3;
      hit.m = face.m;
      hit.bundle = this;
+
+     // UV footprint of the ray cone (Akenine-Moller et al. "Texture Level of Detail Strategies for Real-Time Ray Tracing")
+     // footprint = cone width * sqrt(uv area / world area) / |cos|
+     float width = r.width + r.spread * t * std::sqrt(r.d.sqnorm());
+
+     if (width > 0.f)
+     {
+         float worldarea = std::sqrt(cross(transform_vector(dp1, m), transform_vector(dp2, m)).sqnorm());
+         float uvarea = std::abs(det);
+         // Avoid huge footprints at grazing angles
+         float cosine = std::max(std::abs(dot(normalize(r.d), hit.ng)), 0.1f);
+         float footprint = worldarea > 0.f ? width * std::sqrt(uvarea / worldarea) / cosine : 0.f;
+         hit.duv = float2(footprint, footprint);
+     }
+     else
+     {
+         hit.duv = float2(0.f, 0.f);
+     }
 }
 
 void Mesh::FillSample(Face const& face, float a, float b, Sample& sample) const
@@ -213,7 +241,23 @@ Mesh::Mesh(float const* vertices, int vnum, int vstride,
     }
 }
 
-bool Mesh::IntersectShape(std::size_t idx, ray const& r, Hit& hit) const
+Mesh::Mesh(float3 const* vertices, int vnum,
+           float3 const* normals, int nnum,
+           float2 const* uvs, int unum,
+           Face const* faces, int nfaces)
+    : vertices_(vertices, vertices + vnum)
+    , normals_(normals, normals + nnum)
+    , uvs_(uvs, uvs + unum)
+    , faces_(faces, faces + nfaces)
+{
+    // Same as above, missing UVs are all (0,0)
+    if (uvs_.empty())
+    {
+        uvs_.push_back(float2(0,0));
+    }
+}
+
+bool Mesh::IntersectShape(std::size_t idx, ray const& r, Intersection& isect) const
 {
     assert(idx >= 0 && idx < GetNumShapes());
     
@@ -227,16 +271,28 @@ bool Mesh::IntersectShape(std::size_t idx, ray const& r, Hit& hit) const
     // Transform ray appropriately to object space
     ray ro = transform_ray(r, minv);
     
+    STATS_ADD(kTriangles, 1);
+    
     float t, a, b;
-    if (IntersectFace(face, ro, hit.t, t, a, b))
+    if (IntersectFace(face, ro, isect.t, t, a, b))
     {
-        FillHit(face, t, a, b, hit);
+        isect.t = t;
+        isect.st = float2(a, b);
+        isect.bundle = this;
+        isect.shapeidx = (int)idx;
         return true;
     }
     
     return false;
 }
 
+void Mesh::FillHit(Intersection const& isect, ray const& r, Hit& hit) const
+{
+    assert(isect.bundle == this);
+    
+    FillHit(isect.shapeidx, r, isect.t, isect.st.x, isect.st.y, hit);
+}
+
 bool Mesh::IntersectShape(std::size_t idx, ray const& r) const
 {
     assert(idx >= 0 && idx < GetNumShapes());
@@ -251,6 +307,8 @@ bool Mesh::IntersectShape(std::size_t idx, ray const& r) const
     // Transform ray appropriately to object space
     ray ro = transform_ray(r, minv);
     
+    STATS_ADD(kTriangles, 1);
+    
     float t, a, b;
     if (IntersectFace(face, ro, r.t.y, t, a, b))
     {
@@ -377,7 +435,7 @@ float Mesh::GetPdfOnShape(std::size_t idx, float3 const& p, float3 const& w) con
     }
 }
 
-void Mesh::FillHit(size_t idx, float t, float a, float b, Hit& hit) const
+void Mesh::FillHit(size_t idx, ray const& r, float t, float a, float b, Hit& hit) const
 {
     assert(idx >= 0 && idx < GetNumShapes());
     
@@ -385,7 +443,8 @@ void Mesh::FillHit(size_t idx, float t, float a, float b, Hit& hit) const
     Face const& face(faces_[idx]);
     
     // Fill sample info
-    FillHit(face, t, a, b, hit);
+    FillHit(face, r, t, a, b, hit);
+    hit.shapeidx = (int)idx;
 }
 
 //
@@ -401,6 +460,26 @@ size_t Mesh::GetNumVertices() const
 }
 
 //
+float3 const* Mesh::GetNormals() const
+{
+    return &normals_[0];
+}
+
+size_t Mesh::GetNumNormals() const
+{
+    return normals_.size();
+}
+
+float2 const* Mesh::GetUvs() const
+{
+    return &uvs_[0];
+}
+
+size_t Mesh::GetNumUvs() const
+{
+    return uvs_.size();
+}
+
 Mesh::Face const* Mesh::GetFaces() const
 {
     return &faces_[0];
@@ -412,5 +491,10 @@ size_t Mesh::GetNumFaces() const
     return faces_.size();
 }
 
-
-
+void Mesh::GetMemoryUsage(MemoryReport& report) const
+{
+    report.Add("mesh.vertices", vertices_.capacity() * sizeof(float3));
+    report.Add("mesh.normals", normals_.capacity() * sizeof(float3));
+    report.Add("mesh.uvs", uvs_.capacity() * sizeof(float2));
+    report.Add("mesh.faces", faces_.capacity() * sizeof(Face));
+}
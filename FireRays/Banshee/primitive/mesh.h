@@ -74,16 +74,31 @@ public:
          int const* uidx, int uistride,
          int const* materials, int mstride,
          int nfaces);
+
+    // Constructor from arrays laid out the way mesh keeps them,
+    // used to restore meshes from scene cache with plain copies
+    Mesh(float3 const* vertices, int vnum,
+         float3 const* normals, int nnum,
+         float2 const* uvs, int unum,
+         Face const* faces, int nfaces);
     
-    // Fill hit information (normal. uv, etc)
+    // Fill hit information (normal. uv, etc), r is the world space ray used to get UV footprint
     // REQUIRED: IntersectFace(face, ro, t, a, b) == true
-    void FillHit(size_t idx, float t, float a, float b, Hit& hit) const;
+    void FillHit(size_t idx, ray const& r, float t, float a, float b, Hit& hit) const;
     
     //
     float3 const* GetVertices() const;
     //
     size_t GetNumVertices() const;
     //
+    float3 const* GetNormals() const;
+    //
+    size_t GetNumNormals() const;
+    //
+    float2 const* GetUvs() const;
+    //
+    size_t GetNumUvs() const;
+    //
     Face const* GetFaces() const;
     //
     size_t GetNumFaces() const;
@@ -95,14 +110,22 @@ public:
     // Number of shapes in the bundle
     std::size_t GetNumShapes() const { return faces_.size(); }
     
-    // Test shape number idx against the ray
+    // Full hit version comes from ShapeBundle
+    using ShapeBundle::IntersectShape;
+    
+    // Test shape number idx against the ray, geometric data only
     // REQUIRED: 0 <= idx < GetNumShapes(), otherwise effect undefined
-    // REQUIRED: hit.t initialized for some value which is used as a current closest hit distance
-    // CONTRACT:   true is returned if r intersects shape idx with hit distance closer to hit.t
-    //           hit.t updated accordingly, other data in hit updated accordingly
-    //           false if no hits found, hit is unchanged in this case
+    // REQUIRED: isect.t initialized for some value which is used as a current closest hit distance
+    // CONTRACT:   true is returned if r intersects shape idx with hit distance closer to isect.t
+    //           isect updated accordingly, false if no hits found, isect is unchanged in this case
     //
-    bool IntersectShape(std::size_t idx, ray const& r, Hit& hit) const;
+    bool IntersectShape(std::size_t idx, ray const& r, Intersection& isect) const;
+    
+    // Fill shading data of the intersection
+    // REQUIRED: isect returned by IntersectShape of this mesh for the ray r
+    // CONTRACT: hit is filled in completely
+    //
+    void FillHit(Intersection const& isect, ray const& r, Hit& hit) const;
     
     // Test shape number idx against the ray
     // REQUIRED: 0 <= idx < GetNumShapes(), otherwise effect undefined
@@ -154,13 +177,16 @@ public:
     //
     virtual float GetPdfOnShape(std::size_t idx, float3 const& p, float3 const& w) const;
     
+    // Report vertex attribute and face arrays
+    void GetMemoryUsage(MemoryReport& report) const;
+    
 protected:
     // Test face against a given ray returning barycentric coords of a hit
     // and ray hit distance
     bool IntersectFace(Face const& face, ray const& ro, float tmax, float& t, float& a, float& b) const;
-    // Fill hit information (normal. uv, etc)
+    // Fill hit information (normal. uv, etc), r is the world space ray used to get UV footprint
     // REQUIRED: IntersectFace(face, ro, t, a, b) == true
-    void FillHit(Face const& face, float t, float a, float b, Hit& hit) const;
+    void FillHit(Face const& face, ray const& r, float t, float a, float b, Hit& hit) const;
     // Fill sample information
     void FillSample(Face const& face, float a, float b, Sample& sample) const;
 
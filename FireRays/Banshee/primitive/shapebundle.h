@@ -41,7 +41,8 @@
 #include "../math/bbox.h"
 #include "../math/matrix.h"
 
-class AreaLight;
+class Light;
+class MemoryReport;
 
 ///< ShapeBundle is a container of individual intersectable objects which doesn't make
 ///< sense to devote a separate class to (like a triangle mesh)
@@ -50,8 +51,12 @@ class ShapeBundle
 {
 public:
     
-    // Hit information
+    // Geometric hit information
     // returned by intersection routines
+    struct Intersection;
+
+    // Hit information
+    // shading data of the closest intersection
     struct Hit;
 
     // Sample information
@@ -74,7 +79,23 @@ public:
     //           hit.t updated accordingly, other data in hit updated accordingly
     //           false if no hits found, hit is unchanged in this case
     //
-    virtual bool IntersectShape(std::size_t idx, ray const& r, Hit& hit) const = 0;
+    bool IntersectShape(std::size_t idx, ray const& r, Hit& hit) const;
+    
+    // Test shape number idx against the ray, geometric data only
+    // REQUIRED: 0 <= idx < GetNumShapes(), otherwise effect undefined
+    // REQUIRED: isect.t initialized for some value which is used as a current closest hit distance
+    // CONTRACT:   true is returned if r intersects shape idx with hit distance closer to isect.t
+    //           isect updated accordingly, false if no hits found, isect is unchanged in this case
+    // IMPORTANT: this is what traversal calls for every candidate, shading data is not touched
+    //           and only filled once for the closest intersection by FillHit
+    //
+    virtual bool IntersectShape(std::size_t idx, ray const& r, Intersection& isect) const = 0;
+    
+    // Fill shading data of the intersection
+    // REQUIRED: isect returned by IntersectShape of this bundle for the ray r
+    // CONTRACT: hit is filled in completely
+    //
+    virtual void FillHit(Intersection const& isect, ray const& r, Hit& hit) const = 0;
     
     // Test shape number idx against the ray
     // REQUIRED: 0 <= idx < GetNumShapes(), otherwise effect undefined
@@ -133,7 +154,11 @@ public:
     virtual bbox GetObjectBounds() const;
     
     // If the object is area light return area light interface for it.
-    virtual AreaLight const* GetAreaLight() const;
+    virtual Light const* GetAreaLight() const;
+    
+    // Report memory held by the bundle
+    // Default implementation reports nothing
+    virtual void GetMemoryUsage(MemoryReport& report) const {}
     
     // Set transform on a bundle
     void SetTransform(matrix const& m, matrix const& minv);
@@ -142,37 +167,63 @@ public:
     void GetTransform(matrix& m, matrix& minv) const;
     
 private:
-    // ShapeBundle might be linked to some AreaLight object if it has emissive material
-    AreaLight* arealight_;
+    // ShapeBundle might be linked to some area light object if it has emissive material
+    Light* arealight_;
     // ShapeBundle can have a transform
     matrix worlmat_;
     matrix worldmatinv_;
     
     friend class AreaLight;
+    friend class MeshLight;
 };
 
 
+// Geometric hit information
+struct ShapeBundle::Intersection
+{
+    // Parametric distance
+    float t;
+    // Shape index within the primitive
+    int shapeidx;
+    // Shape parametrization of the hit point (barycentrics for triangles)
+    float2 st;
+    // Primitive
+    ShapeBundle const* bundle;
+};
+
 // Hit information
+// Geometric data goes first, shading frame is stored as
+// a normal and a tangent, bitangent is reconstructed from them
 struct ShapeBundle::Hit
 {
     // Parametric distance
     float t;
+    // Shape index within the primitive
+    int shapeidx;
+    // Primitive
+    ShapeBundle const* bundle;
+    // Material index
+    int m;
+    // Bitangent orientation, -1 for mirrored UV parametrization
+    float handedness;
     // World space position
     float3 p;
-    // World space shading normal
-    float3 n;
     // World space geometric normal
     float3 ng;
-    // Tangent
+    // World space shading normal
+    float3 n;
+    // Tangent, orthogonal to the shading normal
     float3 dpdu;
-    // Bitangent
-    float3 dpdv;
     // UV parametrization
     float2 uv;
-    // Material index
-    int m;
-    // Primitive
-    ShapeBundle const* bundle;
+    // UV footprint of the ray, zero if the ray carries no cone
+    float2 duv;
+    
+    // Bitangent
+    float3 dpdv() const
+    {
+        return handedness * cross(n, dpdu);
+    }
 };
 
 // Sample information
@@ -214,7 +265,21 @@ inline ShapeBundle::~ShapeBundle()
 {
 }
 
-inline AreaLight const* ShapeBundle::GetAreaLight() const
+inline bool ShapeBundle::IntersectShape(std::size_t idx, ray const& r, Hit& hit) const
+{
+    Intersection isect;
+    isect.t = hit.t;
+    
+    if (IntersectShape(idx, r, isect))
+    {
+        FillHit(isect, r, hit);
+        return true;
+    }
+    
+    return false;
+}
+
+inline Light const* ShapeBundle::GetAreaLight() const
 {
     return arealight_;
 }
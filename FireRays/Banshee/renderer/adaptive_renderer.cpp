@@ -4,6 +4,9 @@
 #include "../imageplane/imageplane.h"
 #include "../tracer/tracer.h"
 #include "../util/progressreporter.h"
+#include "../sampler/sample_cursor.h"
+#include "../aov/aov.h"
+#include "../util/renderstats.h"
 #include "../math/mathutils.h"
 
 
@@ -38,25 +41,23 @@ void AdaptiveRenderer::Render(World const& world) const
     // Iterate over all the tiles
     // Note that Sampler objects are not thread safe
     // and not designed for concurrent access.
-    // We are cloning the sampler for each task instead.
+    // Each worker thread clones them once per pass instead.
     //
+    BeginPass();
+
     for (int xtile = 0; xtile < numtiles; ++xtile)
     {
-        // Clone the samplers first
-        Sampler* imgsampler = imgsampler_->Clone();
-        Sampler* lightsampler = lightsampler_->Clone();
-        Sampler* brdfsampler = brdfsampler_->Clone();
-        
         // Submit the task to thread pool
         // Need to capture xtile and ytile by copying since
-        // they are changing, same for sampler objects
+        // they are changing
         futures.push_back(
-                          threadpool_.submit([&, xtile, imgsampler, lightsampler, brdfsampler]()->int
+                          threadpool_.submit([&, xtile]()->int
                                              {
-                                                 // Wrap private samplers w/ memory managing ptr
-                                                 std::unique_ptr<Sampler> private_imgsampler(imgsampler);
-                                                 std::unique_ptr<Sampler> private_lightsampler(lightsampler);
-                                                 std::unique_ptr<Sampler> private_brdfsampler(brdfsampler);
+                                                 // Private samplers and scratch memory of this thread
+                                                 ThreadState& state = GetThreadState();
+                                                 Sampler& private_imgsampler = *state.imgsampler;
+                                                 Sampler& private_lightsampler = *state.lightsampler;
+                                                 Sampler& private_brdfsampler = *state.brdfsampler;
                                                  // Iterate through tile pixels
                                                  for (int x = 0; x < tilesize_; ++x)
                                                      {
@@ -72,22 +73,41 @@ void AdaptiveRenderer::Render(World const& world) const
                                                          
                                                          ray r;
                                                          
-                                                         float sample_weight = 1.f / private_imgsampler->num_samples();
+                                                         // Sample indices continue the ones taken in this pixel before
+                                                         int firstsample = NextPixelSample(p);
+                                                         
+                                                         float sample_weight = 1.f / private_imgsampler.num_samples();
                                                          
-                                                         for (int s = 0; s < private_imgsampler->num_samples(); ++s)
+                                                         for (int s = 0; s < private_imgsampler.num_samples(); ++s)
                                                          {
+                                                             // Dimensions of this pixel sample
+                                                             SampleCursor cursor(p, firstsample + s);
+                                                             
                                                              // Generate sample
-                                                             float2 sample = private_imgsampler->Sample2D();
+                                                             float2 sample = cursor.Next2D(private_imgsampler);
                                                              
                                                              // Calculate image plane sample
                                                              float2 imgsample((float)p.x / imgres.x + (1.f / imgres.x) * sample.x, (float)p.y / imgres.y + (1.f / imgres.y) * sample.y);
                                                              
                                                              // Generate ray
-                                                             cam.GenerateRay(imgsample, r);
+                                                             cam.GenerateRay(imgsample, float2(1.f / imgres.x, 1.f / imgres.y), r);
                                                              
+                                                             STATS_BEGIN_SAMPLE();
+
+                                                             // Arbitrary output variables requested by the image plane
+                                                             AovSample aovs(imgplane_.GetAovMask());
+
                                                              // Estimate radiance and add to image plane
-                                                             imgplane_.AddSample(p, tracer_->GetLi(r, world, *private_lightsampler, *private_brdfsampler));
+                                                             imgplane_.AddSample(p, tracer_->GetLi(r, world, private_lightsampler, private_brdfsampler, cursor, state.arena, aovs));
+                                                             STATS_END_SAMPLE(aovs);
+                                                             imgplane_.AddAovSample(p, aovs);
+
+                                                             // Denoiser guides
+                                                             AddFeatures(p, r, world);
                                                          }
+
+                                                         // Pixel is done, release transient memory
+                                                         state.arena.Reset();
                                                      }
                                                  
                                                  // Update and report progress
@@ -95,7 +115,7 @@ void AdaptiveRenderer::Render(World const& world) const
                                                  {
                                                      std::unique_lock<std::mutex> lock(progressmutex);
                                                      
-                                                     donesamples += tilesize_ * private_imgsampler->num_samples();
+                                                     donesamples += tilesize_ * private_imgsampler.num_samples();
                                                      
                                                      progress_->Report((float)donesamples / totalsamples);
                                                  }
@@ -56,7 +56,8 @@ public:
     // and release in the destructor
     // tilesize parameter determines granularity of a tasks assigned to cores.
     // Each task is supposed to process a single tile, change this parameter to
-    // find a right balance between submission overhead and benefit from parallelization
+    // find a right balance between submission overhead and benefit from parallelization.
+    // numthreads is the number of worker threads, <= 0 uses all hardware threads
     AdaptiveRenderer(ImagePlane& imgplane,
                      Tracer* tracer,
                      Sampler* imgsampler,
@@ -65,11 +66,13 @@ public:
                      int2* const pixelindices,
                      int numindices,
                      ProgressReporter* progress = nullptr,
-                     int tilesize = 64)
+                     int tilesize = 64,
+                     int numthreads = 0)
     : ImageRenderer(imgplane, tracer, imgsampler, lightsampler, brdfsampler, progress)
+    , tilesize_(tilesize)
+    , threadpool_(numthreads)
     , pixelindices_(pixelindices)
     , numindices_(numindices)
-    , tilesize_(tilesize)
     {
     }
     
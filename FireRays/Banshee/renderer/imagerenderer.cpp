@@ -1,10 +1,78 @@
 #include "imagerenderer.h"
 
 #include "../world/world.h"
+#include "../material/material.h"
 #include "../imageplane/imageplane.h"
 #include "../util/progressreporter.h"
+#include "../sampler/sample_cursor.h"
+#include "../aov/aov.h"
+#include "../util/renderstats.h"
 
 #include <cassert>
+#include <atomic>
+
+// Pass identifiers are unique across renderer instances
+// since thread states are shared between them
+static std::atomic<int> g_pass(0);
+
+void ImageRenderer::BeginPass() const
+{
+    pass_ = ++g_pass;
+
+    // Start over if image plane has been resized
+    int2 imgres = imgplane_.resolution();
+    if (samplecounts_.size() != (size_t)(imgres.x * imgres.y))
+    {
+        samplecounts_.assign(imgres.x * imgres.y, 0);
+    }
+}
+
+int ImageRenderer::NextPixelSample(int2 const& pixel) const
+{
+    int& count = samplecounts_[pixel.y * imgplane_.resolution().x + pixel.x];
+    int first = count;
+    count += imgsampler_->num_samples();
+    return first;
+}
+
+void ImageRenderer::AddFeatures(int2 const& pixel, ray const& r, World const& world) const
+{
+    FeatureBuffer* features = imgplane_.GetFeatureBuffer();
+
+    if (!features)
+        return;
+
+    ShapeBundle::Hit hit;
+
+    if (world.Intersect(r, hit))
+    {
+        Material const& mat = *world.materials_[hit.m];
+
+        ShadingContext ctx;
+        mat.Prepare(hit, ctx);
+
+        features->AddSample(pixel, mat.GetAlbedo(ctx, -r.d), ctx.n, hit.t);
+    }
+    else
+    {
+        features->AddSample(pixel, float3(), float3(), 0.f);
+    }
+}
+
+ImageRenderer::ThreadState& ImageRenderer::GetThreadState() const
+{
+    static thread_local ThreadState state;
+
+    if (state.pass != pass_)
+    {
+        state.imgsampler.reset(imgsampler_->Clone());
+        state.lightsampler.reset(lightsampler_->Clone());
+        state.brdfsampler.reset(brdfsampler_->Clone());
+        state.pass = pass_;
+    }
+
+    return state;
+}
 
 void ImageRenderer::Render(World const& world) const
 {
@@ -16,6 +84,10 @@ void ImageRenderer::Render(World const& world) const
     // Prepare image plane
     imgplane_.Prepare();
 
+    // Scratch memory for the tracer
+    BeginPass();
+    Arena& arena = GetThreadState().arena;
+
     // Calculate total number of samples for progress reporting
     int totalsamples = imgsampler_->num_samples() * imgres.y * imgres.x;
     int donesamples = 0;
@@ -25,22 +97,41 @@ void ImageRenderer::Render(World const& world) const
         for(int x = 0; x < imgres.x; ++x)
         {
             ray r;
+            
+            // Sample indices continue the ones taken in this pixel before
+            int firstsample = NextPixelSample(int2(x,y));
 
             for (int s = 0; s < imgsampler_->num_samples(); ++s)
             {
+                // Dimensions of this pixel sample
+                SampleCursor cursor(int2(x,y), firstsample + s);
+
                 // Generate sample
-                float2 sample = imgsampler_->Sample2D();
+                float2 sample = cursor.Next2D(*imgsampler_);
 
                 // Calculate image plane sample
                 float2 imgsample((float)x / imgres.x + (1.f / imgres.x) * sample.x, (float)y / imgres.y + (1.f / imgres.y) * sample.y);
 
                 // Generate ray
-                cam.GenerateRay(imgsample, r);
+                cam.GenerateRay(imgsample, float2(1.f / imgres.x, 1.f / imgres.y), r);
+
+                STATS_BEGIN_SAMPLE();
+
+                // Arbitrary output variables requested by the image plane
+                AovSample aovs(imgplane_.GetAovMask());
 
                 // Estimate radiance and add to image plane
-                imgplane_.AddSample(int2(x,y), tracer_->GetLi(r, world, *lightsampler_, *brdfsampler_));
+                imgplane_.AddSample(int2(x,y), tracer_->GetLi(r, world, *lightsampler_, *brdfsampler_, cursor, arena, aovs));
+                STATS_END_SAMPLE(aovs);
+                imgplane_.AddAovSample(int2(x,y), aovs);
+
+                // Denoiser guides
+                AddFeatures(int2(x,y), r, world);
             }
 
+            // Pixel is done, release transient memory
+            arena.Reset();
+
 			imgsampler_->Reset();
 			lightsampler_->Reset();
 			brdfsampler_->Reset();
@@ -65,6 +156,10 @@ void ImageRenderer::RenderTile(World const& world, int2 const& start, int2 const
     // Get camera 
     Camera const& cam(*world.camera_.get());
 
+    // Scratch memory for the tracer
+    BeginPass();
+    Arena& arena = GetThreadState().arena;
+
     // Calculate total number of samples for progress reporting
     int totalsamples = imgsampler_->num_samples() * dim.y * dim.x;
     int donesamples = 0;
@@ -75,21 +170,40 @@ void ImageRenderer::RenderTile(World const& world, int2 const& start, int2 const
         {
             ray r;
             
+            // Sample indices continue the ones taken in this pixel before
+            int firstsample = NextPixelSample(int2(x,y));
+            
             for (int s = 0; s < imgsampler_->num_samples(); ++s)
             {
+                // Dimensions of this pixel sample
+                SampleCursor cursor(int2(x,y), firstsample + s);
+
                 // Generate sample
-                float2 sample = imgsampler_->Sample2D();
+                float2 sample = cursor.Next2D(*imgsampler_);
 
                 // Calculate image plane sample
                 float2 imgsample((float)x / imgres.x + (1.f / imgres.x) * sample.x, (float)y / imgres.y + (1.f / imgres.y) * sample.y);
 
                 // Generate ray
-                cam.GenerateRay(imgsample, r);
+                cam.GenerateRay(imgsample, float2(1.f / imgres.x, 1.f / imgres.y), r);
+
+                STATS_BEGIN_SAMPLE();
+
+                // Arbitrary output variables requested by the image plane
+                AovSample aovs(imgplane_.GetAovMask());
 
                 // Estimate radiance and add to image plane
-                imgplane_.AddSample(int2(x,y), tracer_->GetLi(r, world, *lightsampler_, *brdfsampler_));
+                imgplane_.AddSample(int2(x,y), tracer_->GetLi(r, world, *lightsampler_, *brdfsampler_, cursor, arena, aovs));
+                STATS_END_SAMPLE(aovs);
+                imgplane_.AddAovSample(int2(x,y), aovs);
+
+                // Denoiser guides
+                AddFeatures(int2(x,y), r, world);
             }
 
+            // Pixel is done, release transient memory
+            arena.Reset();
+
             // Update progress
             donesamples += imgsampler_->num_samples();
             // Report progress
@@ -38,10 +38,12 @@ class ImagePlane;
 class ProgressReporter;
 
 #include <memory>
+#include <vector>
 
 #include "../math/int2.h"
 #include "../tracer/tracer.h"
 #include "../sampler/sampler.h"
+#include "../util/arena.h"
 #include "renderer.h"
 
 ///< Image renderer provides the means to sample and render
@@ -67,6 +69,7 @@ public:
         , lightsampler_(lightsampler)
         , brdfsampler_(brdfsampler)
         , progress_(progress)
+        , pass_(0)
     {
     }
 
@@ -75,6 +78,37 @@ public:
     void RenderTile(World const& world, int2 const& start, int2 const& dim) const;
 
 protected:
+    ///< Per-thread rendering state: scratch arena and private
+    ///< copies of the samplers, which are not thread safe.
+    ///< It lives as long as the thread does, so the samplers
+    ///< are cloned once per pass instead of once per task.
+    ///<
+    struct ThreadState
+    {
+        ThreadState() : pass(-1) {}
+
+        // Transient integrator memory
+        Arena arena;
+        // Private samplers
+        std::unique_ptr<Sampler> imgsampler;
+        std::unique_ptr<Sampler> lightsampler;
+        std::unique_ptr<Sampler> brdfsampler;
+        // Pass the samplers have been cloned for
+        int pass;
+    };
+
+    // Start new rendering pass invalidating sampler copies held by the threads
+    void BeginPass() const;
+    // Index of the first sample to take in a pixel, sample indices continue
+    // the ones taken in the pixel before, no matter how the passes were split
+    // into tiles. Each pixel should be visited by a single thread during the pass.
+    int NextPixelSample(int2 const& pixel) const;
+    // Write primary hit data of the camera ray to the feature buffer of the image plane,
+    // does nothing if the image plane does not keep one
+    void AddFeatures(int2 const& pixel, ray const& r, World const& world) const;
+    // Get calling thread state, (re)clone the samplers if they are stale
+    ThreadState& GetThreadState() const;
+
     // Image plane for an output
     ImagePlane& imgplane_;
     // Ray tracer 
@@ -87,6 +121,10 @@ protected:
     std::unique_ptr<Sampler> brdfsampler_;
     // Progress reporter
     std::unique_ptr<ProgressReporter> progress_;
+    // Current pass identifier
+    mutable int pass_;
+    // Number of samples taken in each pixel so far
+    mutable std::vector<int> samplecounts_;
 };
 
 #endif //IMAGERENDERER_H
@@ -4,6 +4,10 @@
 #include "../imageplane/imageplane.h"
 #include "../tracer/tracer.h"
 #include "../util/progressreporter.h"
+#include "../sampler/sample_cursor.h"
+#include "../aov/aov.h"
+#include "../util/renderstats.h"
+#include "../util/profiler.h"
 #include "../math/mathutils.h"
 
 
@@ -15,6 +19,8 @@
 
 void MtImageRenderer::Render(World const& world) const
 {
+    PROFILE_SCOPE("MtImageRenderer::Render");
+
     int2 imgres = imgplane_.resolution();
 
     // Get camera 
@@ -37,26 +43,26 @@ void MtImageRenderer::Render(World const& world) const
     // Iterate over all the tiles
     // Note that Sampler objects are not thread safe
     // and not designed for concurrent access.
-    // We are cloning the sampler for each task instead.
+    // Each worker thread clones them once per pass instead.
     //
+    BeginPass();
+
     for (int xtile = 0; xtile < numtiles.x; ++xtile)
         for (int ytile = 0; ytile < numtiles.y; ++ytile)
         {
-            // Clone the samplers first
-            Sampler* imgsampler = imgsampler_->Clone();
-            Sampler* lightsampler = lightsampler_->Clone();
-            Sampler* brdfsampler = brdfsampler_->Clone();
-
             // Submit the task to thread pool
             // Need to capture xtile and ytile by copying since
-            // they are changing, same for sampler objects
+            // they are changing
             futures.push_back(
-                threadpool_.submit([&, xtile, ytile, imgres, imgsampler, lightsampler, brdfsampler]()->int
+                threadpool_.submit([&, xtile, ytile, imgres]()->int
             {
-                // Wrap private samplers w/ memory managing ptr
-                std::unique_ptr<Sampler> private_imgsampler(imgsampler);
-                std::unique_ptr<Sampler> private_lightsampler(lightsampler);
-                std::unique_ptr<Sampler> private_brdfsampler(brdfsampler);
+                PROFILE_SCOPE("MtImageRenderer::Tile");
+
+                // Private samplers and scratch memory of this thread
+                ThreadState& state = GetThreadState();
+                Sampler& private_imgsampler = *state.imgsampler;
+                Sampler& private_lightsampler = *state.lightsampler;
+                Sampler& private_brdfsampler = *state.brdfsampler;
                 // Iterate through tile pixels
                 for (int x = 0; x < tilesize_.x; ++x)
                     for (int y = 0; y < tilesize_.y; ++y)
@@ -70,25 +76,44 @@ void MtImageRenderer::Render(World const& world) const
                             continue;
 
                         ray r;
+                        
+                        // Sample indices continue the ones taken in this pixel before
+                        int firstsample = NextPixelSample(int2(xx,yy));
 
-                        for (int s = 0; s < private_imgsampler->num_samples(); ++s)
+                        for (int s = 0; s < private_imgsampler.num_samples(); ++s)
                         {
+                            // Dimensions of this pixel sample
+                            SampleCursor cursor(int2(xx,yy), firstsample + s);
+
                             // Generate sample
-                            float2 sample = private_imgsampler->Sample2D();
+                            float2 sample = cursor.Next2D(private_imgsampler);
 
                             // Calculate image plane sample
                             float2 imgsample((float)xx / imgres.x + (1.f / imgres.x) * sample.x, (float)yy / imgres.y + (1.f / imgres.y) * sample.y);
 
                             // Generate ray
-                            cam.GenerateRay(imgsample, r);
+                            cam.GenerateRay(imgsample, float2(1.f / imgres.x, 1.f / imgres.y), r);
+
+                            STATS_BEGIN_SAMPLE();
+
+                            // Arbitrary output variables requested by the image plane
+                            AovSample aovs(imgplane_.GetAovMask());
 
                             // Estimate radiance and add to image plane
-                            imgplane_.AddSample(int2(xx,yy), tracer_->GetLi(r, world, *private_lightsampler, *private_brdfsampler));
+                            imgplane_.AddSample(int2(xx,yy), tracer_->GetLi(r, world, private_lightsampler, private_brdfsampler, cursor, state.arena, aovs));
+                            STATS_END_SAMPLE(aovs);
+                            imgplane_.AddAovSample(int2(xx,yy), aovs);
+
+                            // Denoiser guides
+                            AddFeatures(int2(xx,yy), r, world);
                         }
 
-						imgsampler->Reset();
-						lightsampler->Reset();
-						brdfsampler->Reset();
+                        // Pixel is done, release transient memory
+                        state.arena.Reset();
+
+						private_imgsampler.Reset();
+						private_lightsampler.Reset();
+						private_brdfsampler.Reset();
                     }
 
 
@@ -98,7 +123,7 @@ void MtImageRenderer::Render(World const& world) const
                     {
                         std::unique_lock<std::mutex> lock(progressmutex);
 
-                        donesamples += tilesize_.x * tilesize_.y * private_imgsampler->num_samples();
+                        donesamples += tilesize_.x * tilesize_.y * private_imgsampler.num_samples();
 
                         progress_->Report((float)donesamples / totalsamples);
                     }
@@ -118,6 +143,8 @@ void MtImageRenderer::Render(World const& world) const
 
 void MtImageRenderer::RenderTile(World const& world, int2 const& start, int2 const& dim) const
 {
+    PROFILE_SCOPE("MtImageRenderer::RenderTile");
+
     int2 imgres = imgplane_.resolution();
 
     // Get camera 
@@ -137,26 +164,26 @@ void MtImageRenderer::RenderTile(World const& world, int2 const& start, int2 con
     // Iterate over all the tiles
     // Note that Sampler objects are not thread safe
     // and not designed for concurrent access.
-    // We are cloning the sampler for each task instead.
+    // Each worker thread clones them once per pass instead.
     //
+    BeginPass();
+
     for (int xtile = 0; xtile < numtiles.x; ++xtile)
         for (int ytile = 0; ytile < numtiles.y; ++ytile)
         {
-            // Clone the samplers first
-            Sampler* imgsampler = imgsampler_->Clone();
-            Sampler* lightsampler = lightsampler_->Clone();
-            Sampler* brdfsampler = brdfsampler_->Clone();
-
             // Submit the task to thread pool
             // Need to capture xtile and ytile by copying since
-            // they are changing, same for sampler objects
+            // they are changing
             futures.push_back(
-                threadpool_.submit([&, xtile, ytile, imgres, imgsampler, lightsampler, brdfsampler, start, dim]()->int
+                threadpool_.submit([&, xtile, ytile, imgres, start, dim]()->int
             {
-                // Wrap private samplers w/ memory managing ptr
-                std::unique_ptr<Sampler> private_imgsampler(imgsampler);
-                std::unique_ptr<Sampler> private_lightsampler(lightsampler);
-                std::unique_ptr<Sampler> private_brdfsampler(brdfsampler);
+                PROFILE_SCOPE("MtImageRenderer::Tile");
+
+                // Private samplers and scratch memory of this thread
+                ThreadState& state = GetThreadState();
+                Sampler& private_imgsampler = *state.imgsampler;
+                Sampler& private_lightsampler = *state.lightsampler;
+                Sampler& private_brdfsampler = *state.brdfsampler;
                 // Iterate through tile pixels
                 for (int x = 0; x < tilesize_.x; ++x)
                     for (int y = 0; y < tilesize_.y; ++y)
@@ -170,21 +197,40 @@ void MtImageRenderer::RenderTile(World const& world, int2 const& start, int2 con
                             continue;
 
                         ray r;
+                        
+                        // Sample indices continue the ones taken in this pixel before
+                        int firstsample = NextPixelSample(int2(xx,yy));
 
-                        for (int s = 0; s < private_imgsampler->num_samples(); ++s)
+                        for (int s = 0; s < private_imgsampler.num_samples(); ++s)
                         {
+                            // Dimensions of this pixel sample
+                            SampleCursor cursor(int2(xx,yy), firstsample + s);
+
                             // Generate sample
-                            float2 sample = private_imgsampler->Sample2D();
+                            float2 sample = cursor.Next2D(private_imgsampler);
 
                             // Calculate image plane sample
                             float2 imgsample((float)xx / imgres.x + (1.f / imgres.x) * sample.x, (float)yy / imgres.y + (1.f / imgres.y) * sample.y);
 
                             // Generate ray
-                            cam.GenerateRay(imgsample, r);
+                            cam.GenerateRay(imgsample, float2(1.f / imgres.x, 1.f / imgres.y), r);
+
+                            STATS_BEGIN_SAMPLE();
+
+                            // Arbitrary output variables requested by the image plane
+                            AovSample aovs(imgplane_.GetAovMask());
 
                             // Estimate radiance and add to image plane
-                            imgplane_.AddSample(int2(xx,yy), tracer_->GetLi(r, world, *private_lightsampler, *private_brdfsampler));
+                            imgplane_.AddSample(int2(xx,yy), tracer_->GetLi(r, world, private_lightsampler, private_brdfsampler, cursor, state.arena, aovs));
+                            STATS_END_SAMPLE(aovs);
+                            imgplane_.AddAovSample(int2(xx,yy), aovs);
+
+                            // Denoiser guides
+                            AddFeatures(int2(xx,yy), r, world);
                         }
+
+                        // Pixel is done, release transient memory
+                        state.arena.Reset();
                     }
 
                     // Update and report progress
@@ -192,7 +238,7 @@ void MtImageRenderer::RenderTile(World const& world, int2 const& start, int2 con
                     {
                         std::unique_lock<std::mutex> lock(progressmutex);
 
-                        donesamples += tilesize_.x * tilesize_.y * private_imgsampler->num_samples();
+                        donesamples += tilesize_.x * tilesize_.y * private_imgsampler.num_samples();
 
                         progress_->Report((float)donesamples / totalsamples);
                     }
@@ -55,16 +55,19 @@ public:
     // and release in the destructor
     // tilesize parameter determines granularity of a tasks assigned to cores.
     // Each task is supposed to process a single tile, change this parameter to
-    // find a right balance between submission overhead and benefit from parallelization
+    // find a right balance between submission overhead and benefit from parallelization.
+    // numthreads is the number of worker threads, <= 0 uses all hardware threads
     MtImageRenderer(ImagePlane& imgplane, 
         Tracer* tracer,
         Sampler* imgsampler,
         Sampler* lightsampler,
         Sampler* brdfsampler,
         ProgressReporter* progress = nullptr,
-        int2 tilesize = int2(16,16))
+        int2 tilesize = int2(16,16),
+        int numthreads = 0)
         : ImageRenderer(imgplane, tracer, imgsampler, lightsampler, brdfsampler, progress)
         , tilesize_(tilesize)
+        , threadpool_(numthreads)
     {
     }
 
@@ -73,6 +76,15 @@ public:
 
     void RenderTile(World const& world, int2 const& start, int2 const& dim) const;
 
+    // Number of worker threads
+    int GetNumThreads() const { return threadpool_.num_threads(); }
+
+    // Seconds the worker spent rendering tiles since creation or ResetBusyTime,
+    // the rest of the wall clock time it waited for tiles at the end of passes
+    double GetBusyTime(int thread) const { return threadpool_.busy_time(thread); }
+
+    void ResetBusyTime() const { threadpool_.reset_busy_time(); }
+
 private:
     // Size of a single tile aka task size
     int2 tilesize_;
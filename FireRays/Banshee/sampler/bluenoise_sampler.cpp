@@ -0,0 +1,196 @@
+#include "bluenoise_sampler.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Rank-1 lattice generators in 32-bit fixed point: golden ratio for 1D and R2 (plastic number) for 2D
+#define PHI1 0x9e3779b9u
+#define PHI2X 0xc13fa9a9u
+#define PHI2Y 0x91e10da5u
+// Void-and-cluster filter width
+#define SIGMA 1.5f
+
+///< Tileable blue noise mask built with void-and-cluster method
+///< R. Ulichney, "The void-and-cluster method for dither array generation", 1993
+///< It is generated once on first use, ranks are converted to values in (0..1).
+///<
+struct BlueNoiseMask
+{
+    BlueNoiseMask()
+    {
+        int const size = BlueNoiseSampler::kMaskSize;
+        int const numpixels = size * size;
+
+        // Toroidal gaussian filter
+        std::vector<float> filter(numpixels);
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+            {
+                int dx = std::min(x, size - x);
+                int dy = std::min(y, size - y);
+                filter[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.f * SIGMA * SIGMA));
+            }
+
+        std::vector<int> pattern(numpixels, 0);
+        std::vector<float> energy(numpixels, 0.f);
+
+        // Update energy of all the pixels when pixel idx is set or cleared
+        auto splat = [&](int idx, float sign)
+        {
+            int px = idx % size;
+            int py = idx / size;
+
+            for (int y = 0; y < size; ++y)
+                for (int x = 0; x < size; ++x)
+                {
+                    energy[y * size + x] += sign * filter[((y - py + size) % size) * size + (x - px + size) % size];
+                }
+        };
+
+        // Tightest cluster among the set pixels or largest void among the empty ones
+        auto find = [&](int value, bool cluster) -> int
+        {
+            int best = -1;
+            for (int i = 0; i < numpixels; ++i)
+            {
+                if (pattern[i] == value && (best < 0 || (cluster ? energy[i] > energy[best] : energy[i] < energy[best])))
+                {
+                    best = i;
+                }
+            }
+            return best;
+        };
+
+        // Deterministic initial pattern with 10% of pixels set
+        unsigned int state = 0x2545f491;
+        int numset = 0;
+        while (numset < numpixels / 10)
+        {
+            state = state * 1664525 + 1013904223;
+            int idx = (state >> 8) % numpixels;
+
+            if (!pattern[idx])
+            {
+                pattern[idx] = 1;
+                splat(idx, 1.f);
+                ++numset;
+            }
+        }
+
+        // Move pixels from tightest clusters into largest voids until it converges
+        for (;;)
+        {
+            int cluster = find(1, true);
+            pattern[cluster] = 0;
+            splat(cluster, -1.f);
+
+            int gap = find(0, false);
+            pattern[gap] = 1;
+            splat(gap, 1.f);
+
+            if (gap == cluster)
+                break;
+        }
+
+        std::vector<int> ranks(numpixels);
+
+        // Rank initial pattern pixels removing tightest clusters first
+        {
+            std::vector<int> initial = pattern;
+            std::vector<float> initialenergy = energy;
+
+            for (int rank = numset - 1; rank >= 0; --rank)
+            {
+                int cluster = find(1, true);
+                pattern[cluster] = 0;
+                splat(cluster, -1.f);
+                ranks[cluster] = rank;
+            }
+
+            pattern = initial;
+            energy = initialenergy;
+        }
+
+        // Rank the rest filling largest voids first, past the half this is
+        // equivalent to removing tightest clusters of empty pixels
+        for (int rank = numset; rank < numpixels; ++rank)
+        {
+            int gap = find(0, false);
+            pattern[gap] = 1;
+            splat(gap, 1.f);
+            ranks[gap] = rank;
+        }
+
+        for (int i = 0; i < numpixels; ++i)
+        {
+            values[i] = (ranks[i] + 0.5f) / numpixels;
+        }
+    }
+
+    float values[BlueNoiseSampler::kMaskSize * BlueNoiseSampler::kMaskSize];
+};
+
+static BlueNoiseMask const& GetBlueNoiseMask()
+{
+    static BlueNoiseMask mask;
+    return mask;
+}
+
+// Mask offset for a given dimension
+static unsigned int Hash(unsigned int a, unsigned int b)
+{
+    unsigned int h = a * 0x9e3779b9 ^ (b + 0x7f4a7c15) * 0x85ebca6b;
+    h ^= h >> 16;
+    h *= 0x7feb352d;
+    h ^= h >> 15;
+    h *= 0x846ca68b;
+    h ^= h >> 16;
+    return h;
+}
+
+// Offset value in [0..1) by idx steps of the generator. Fixed point arithmetic
+// wraps modulo 1 exactly, so precision does not degrade with the sample index.
+static float Rotate(float value, unsigned int idx, unsigned int generator)
+{
+    unsigned int bits = (unsigned int)(value * 4294967296.0) + idx * generator;
+    // Keep 24 bits, the float result is then exact and stays below 1
+    return (bits >> 8) * (1.f / 16777216.f);
+}
+
+float BlueNoiseSampler::GetMaskValue(int x, int y)
+{
+    x = ((x % kMaskSize) + kMaskSize) % kMaskSize;
+    y = ((y % kMaskSize) + kMaskSize) % kMaskSize;
+    return GetBlueNoiseMask().values[y * kMaskSize + x];
+}
+
+float BlueNoiseSampler::Get1D(int2 const& pixel, int sampleidx, int dimension) const
+{
+    unsigned int offset = Hash(seed_, dimension);
+    float mask = GetMaskValue(pixel.x + (offset & 0xffff), pixel.y + (offset >> 16));
+
+    return Rotate(mask, sampleidx, PHI1);
+}
+
+float2 BlueNoiseSampler::Get2D(int2 const& pixel, int sampleidx, int dimension) const
+{
+    unsigned int offsetx = Hash(seed_, dimension);
+    unsigned int offsety = Hash(seed_, dimension + 1);
+    float maskx = GetMaskValue(pixel.x + (offsetx & 0xffff), pixel.y + (offsetx >> 16));
+    float masky = GetMaskValue(pixel.x + (offsety & 0xffff), pixel.y + (offsety >> 16));
+
+    return float2(Rotate(maskx, sampleidx, PHI2X), Rotate(masky, sampleidx, PHI2Y));
+}
+
+float2 BlueNoiseSampler::Sample2D() const
+{
+    int idx = sampleidx_++;
+    return float2(Rotate(offset_.x, idx, PHI2X), Rotate(offset_.y, idx, PHI2Y));
+}
+
+void BlueNoiseSampler::Reset()
+{
+    sampleidx_ = 0;
+    offset_ = float2(rng_->NextFloat(), rng_->NextFloat());
+}
@@ -0,0 +1,108 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+
+#ifndef BLUENOISE_SAMPLER_H
+#define BLUENOISE_SAMPLER_H
+
+#include <memory>
+
+#include "../rng/rng.h"
+#include "sampler.h"
+
+///< Blue noise sampler distributes the error of low sample count
+///< renders as high frequency noise across the screen. Each dimension
+///< reads a tileable blue noise mask at its own toroidal offset and
+///< rotates rank-1 (golden ratio and R2) sequence over sample indices with it,
+///< so neighbouring pixels get well separated values at every sample and
+///< samples of a pixel stay stratified over time.
+///< Blue noise only shows up through dimension-aware Get1D/Get2D calls,
+///< Sample2D falls back to randomly rotated R2 sequence.
+///<
+class BlueNoiseSampler : public Sampler
+{
+public:
+    // Size of the mask
+    static const int kMaskSize = 64;
+
+    BlueNoiseSampler(int numsamples, Rng* rng)
+        : rng_(rng)
+        , numsamples_(numsamples)
+        , sampleidx_(0)
+    {
+        seed_ = rng_->NextUint();
+        Reset();
+    }
+
+    // Calculate 2D sample in [0..1]x[0..1]
+    float2 Sample2D() const;
+
+    // Returns the number of samples in a pattern
+    int num_samples() const
+    {
+        return numsamples_;
+    }
+
+    // Clone keeps the seed, so dimension-aware samples do not depend
+    // on which copy of the sampler has produced them
+    Sampler* Clone() const
+    {
+        BlueNoiseSampler* sampler = new BlueNoiseSampler(numsamples_, rng_->Clone());
+        sampler->seed_ = seed_;
+        return sampler;
+    }
+
+    // Reset the sequence
+    void Reset();
+
+    // Get 1D sample component for a given pixel, sample index and dimension
+    float Get1D(int2 const& pixel, int sampleidx, int dimension) const;
+
+    // Get 2D sample occupying dimensions dimension and dimension + 1
+    float2 Get2D(int2 const& pixel, int sampleidx, int dimension) const;
+
+    // Mask value in (0..1) at a given pixel, wrapped around
+    static float GetMaskValue(int x, int y);
+
+private:
+    // RNG to use
+    std::unique_ptr<Rng> rng_;
+    // Number of samples
+    int numsamples_;
+    // Seed for dimension offsets
+    unsigned int seed_;
+    // Sequence index and rotation for Sample2D
+    mutable int sampleidx_;
+    float2 offset_;
+};
+
+#endif // BLUENOISE_SAMPLER_H
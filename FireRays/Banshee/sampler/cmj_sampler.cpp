@@ -1,4 +1,5 @@
 #include "cmj_sampler.h"
+#include "../math/sseutils.h"
 
 static unsigned int permute(unsigned i, unsigned l, unsigned p)
 {
@@ -71,3 +72,115 @@ float2 CmjSampler::Sample2D() const
     
     return cmj(sampleidx_++, gridsize_, gridsize_, patternidx_);
 }
+
+// 4 lanes version of permute, lanes which are still out of range cycle independently
+static __m128i permute4(__m128i i, unsigned l, unsigned p)
+{
+    unsigned w = l - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+
+    __m128i const vp = _mm_set1_epi32(p);
+    __m128i const vw = _mm_set1_epi32(w);
+    // Indices are below 2^31, so signed comparison is fine
+    __m128i const vl = _mm_set1_epi32(l);
+    __m128i active = _mm_set1_epi32(-1);
+
+    do
+    {
+        __m128i j = i;
+        j = _mm_xor_si128(j, vp);
+        j = mullo_epi32(j, _mm_set1_epi32(0xe170893d));
+        j = _mm_xor_si128(j, _mm_set1_epi32(p >> 16));
+        j = _mm_xor_si128(j, _mm_srli_epi32(_mm_and_si128(j, vw), 4));
+        j = _mm_xor_si128(j, _mm_set1_epi32(p >> 8));
+        j = mullo_epi32(j, _mm_set1_epi32(0x0929eb3f));
+        j = _mm_xor_si128(j, _mm_set1_epi32(p >> 23));
+        j = _mm_xor_si128(j, _mm_srli_epi32(_mm_and_si128(j, vw), 1));
+        j = mullo_epi32(j, _mm_set1_epi32(1 | p >> 27));
+        j = mullo_epi32(j, _mm_set1_epi32(0x6935fa69));
+        j = _mm_xor_si128(j, _mm_srli_epi32(_mm_and_si128(j, vw), 11));
+        j = mullo_epi32(j, _mm_set1_epi32(0x74dcb303));
+        j = _mm_xor_si128(j, _mm_srli_epi32(_mm_and_si128(j, vw), 2));
+        j = mullo_epi32(j, _mm_set1_epi32(0x9e501cc3));
+        j = _mm_xor_si128(j, _mm_srli_epi32(_mm_and_si128(j, vw), 2));
+        j = mullo_epi32(j, _mm_set1_epi32(0xc860a3df));
+        j = _mm_and_si128(j, vw);
+        j = _mm_xor_si128(j, _mm_srli_epi32(j, 5));
+
+        // Only lanes which have not landed in range yet take the new value
+        i = _mm_or_si128(_mm_and_si128(active, j), _mm_andnot_si128(active, i));
+        active = _mm_andnot_si128(_mm_cmplt_epi32(i, vl), active);
+    }
+    while (_mm_movemask_epi8(active));
+
+    // (i + p) % l, no unsigned division in SSE
+    unsigned lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, _mm_add_epi32(i, vp));
+    return _mm_setr_epi32(lanes[0] % l, lanes[1] % l, lanes[2] % l, lanes[3] % l);
+}
+
+static __m128 randfloat4(__m128i i, unsigned p)
+{
+    i = _mm_xor_si128(i, _mm_set1_epi32(p));
+    i = _mm_xor_si128(i, _mm_srli_epi32(i, 17));
+    i = _mm_xor_si128(i, _mm_srli_epi32(i, 10));
+    i = mullo_epi32(i, _mm_set1_epi32(0xb36534e5));
+    i = _mm_xor_si128(i, _mm_srli_epi32(i, 12));
+    i = _mm_xor_si128(i, _mm_srli_epi32(i, 21));
+    i = mullo_epi32(i, _mm_set1_epi32(0x93fc4795));
+    i = _mm_xor_si128(i, _mm_set1_epi32(0xdf6e307f));
+    i = _mm_xor_si128(i, _mm_srli_epi32(i, 17));
+    i = mullo_epi32(i, _mm_set1_epi32(1 | p >> 18));
+    return _mm_mul_ps(cvtepu32_ps(i), _mm_set1_ps(1.0f / 4294967808.0f));
+}
+
+// Samples s ... s + 3 of the pattern
+static void cmj4(int s, int m, int n, int p, float2* out)
+{
+    __m128i vs = _mm_add_epi32(_mm_set1_epi32(s), _mm_setr_epi32(0, 1, 2, 3));
+
+    // s / m and s % m, exact in floating point for the sample counts in use
+    __m128 fm = _mm_set1_ps((float)m);
+    __m128 fn = _mm_set1_ps((float)n);
+    __m128i sdivm = _mm_cvttps_epi32(_mm_div_ps(_mm_add_ps(_mm_cvtepi32_ps(vs), _mm_set1_ps(0.5f)), fm));
+    __m128i smodm = _mm_sub_epi32(vs, mullo_epi32(sdivm, _mm_set1_epi32(m)));
+
+    __m128i sx = permute4(smodm, m, p * 0xa511e9b3);
+    __m128i sy = permute4(sdivm, n, p * 0x63d83595);
+    __m128 jx = randfloat4(vs, p * 0xa399d265);
+    __m128 jy = randfloat4(vs, p * 0x711ad6a5);
+
+    __m128 x = _mm_div_ps(_mm_add_ps(_mm_cvtepi32_ps(smodm), _mm_div_ps(_mm_add_ps(_mm_cvtepi32_ps(sy), jx), fn)), fm);
+    __m128 y = _mm_div_ps(_mm_add_ps(_mm_cvtepi32_ps(sdivm), _mm_div_ps(_mm_add_ps(_mm_cvtepi32_ps(sx), jy), fm)), fn);
+
+    store_float2x4(out, x, y);
+}
+
+void CmjSampler::Generate(float2* samples, int count) const
+{
+    int numsamples = gridsize_ * gridsize_;
+    int i = 0;
+
+    while (i < count)
+    {
+        // Pattern boundaries are handled by Sample2D
+        if (sampleidx_ % numsamples == 0 || sampleidx_ + 4 > numsamples || i + 4 > count)
+        {
+            samples[i++] = Sample2D();
+            continue;
+        }
+
+        cmj4(sampleidx_, gridsize_, gridsize_, patternidx_, samples + i);
+        sampleidx_ += 4;
+        i += 4;
+    }
+}
+
+void CmjSampler::Get2DBlock(int2 const& pixel, int firstsample, int dimension, int count, float2* samples) const
+{
+    Generate(samples, count);
+}
@@ -72,6 +72,12 @@ public:
     {
         return new CmjSampler(gridsize_, rng_->Clone());
     }
+
+    // Fill count subsequent samples of the sequence, 4 at a time within a pattern
+    void Generate(float2* samples, int count) const;
+
+    // Not dimension-aware, so the block is taken from the sequence
+    void Get2DBlock(int2 const& pixel, int firstsample, int dimension, int count, float2* samples) const;
     
 private:
     // RNG to use
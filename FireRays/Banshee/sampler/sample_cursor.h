@@ -0,0 +1,99 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+
+#ifndef SAMPLE_CURSOR_H
+#define SAMPLE_CURSOR_H
+
+#include "sampler.h"
+
+///< SampleCursor walks the dimensions of a dimension-aware sampler
+///< for a single pixel sample. Integrator takes dimensions one after
+///< another, so the same decision along the path ends up in the same
+///< dimension for all the samples of a pixel and is stratified over them.
+///<
+class SampleCursor
+{
+public:
+    // Constructor
+    SampleCursor(int2 const& pixel, int sampleidx, int dimension = 0)
+    : pixel_(pixel)
+    , sampleidx_(sampleidx)
+    , dimension_(dimension)
+    {
+    }
+
+    // Take next dimension
+    float Next1D(Sampler const& sampler)
+    {
+        return sampler.Get1D(pixel_, sampleidx_, dimension_++);
+    }
+
+    // Take next two dimensions
+    float2 Next2D(Sampler const& sampler)
+    {
+        float2 sample = sampler.Get2D(pixel_, sampleidx_, dimension_);
+        dimension_ += 2;
+        return sample;
+    }
+
+    // Take next two dimensions for count sub-samples of this sample,
+    // i-th of them is sample sampleidx * count + i of the sequence
+    void Next2D(Sampler const& sampler, int count, float2* samples)
+    {
+        sampler.Get2DBlock(pixel_, sampleidx_ * count, dimension_, count, samples);
+        dimension_ += 2;
+    }
+
+    // Cursor of idx-th out of count sub-samples starting at current dimension
+    SampleCursor Branch(int idx, int count) const
+    {
+        return SampleCursor(pixel_, sampleidx_ * count + idx, dimension_);
+    }
+
+    // Current dimension
+    int dimension() const { return dimension_; }
+
+    // Jump to a given dimension, used to keep dimensions of the decisions
+    // which might be skipped aligned between the samples
+    void SetDimension(int dimension) { dimension_ = dimension; }
+
+private:
+    // Pixel
+    int2 pixel_;
+    // Sample index within the pixel
+    int sampleidx_;
+    // Next dimension to take
+    int dimension_;
+};
+
+#endif // SAMPLE_CURSOR_H
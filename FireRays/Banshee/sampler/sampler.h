@@ -35,6 +35,7 @@
 #define SAMPLER_H
 
 #include "../math/float2.h"
+#include "../math/int2.h"
 
 ///< Sampler class defines and interface to
 ///< entities capable of providing sample points
@@ -46,6 +47,11 @@
 ///< When Sample2D is called num_samples times the sampler goes to the next pattern.
 ///< For some samplers it is required to Flush the seed (for example low-discrepancy Sobol)
 ///< to start the new sequence when moving from one pixel to another.
+///< Dimension-aware samplers also provide stateless Get1D/Get2D calls addressed
+///< by pixel, sample index within the pixel and dimension, so the integrator
+///< might give every decision along the path its own stratified dimension.
+///< Generate and Get2DBlock produce whole blocks of samples at once, samplers
+///< override them where samples might be computed several at a time.
 ///<
 class Sampler
 {
@@ -64,6 +70,33 @@ public:
 
 	// Reset the sequence
 	virtual void Reset() {}
+
+    // Get 1D sample component for a given pixel, sample index and dimension
+    // Samplers which are not dimension-aware fall back to the sequence
+    virtual float Get1D(int2 const& pixel, int sampleidx, int dimension) const { return Sample2D().x; }
+
+    // Get 2D sample occupying dimensions dimension and dimension + 1
+    // Samplers which are not dimension-aware fall back to the sequence
+    virtual float2 Get2D(int2 const& pixel, int sampleidx, int dimension) const { return Sample2D(); }
+
+    // Fill count subsequent 2D samples of the sequence, same as calling Sample2D count times
+    virtual void Generate(float2* samples, int count) const
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            samples[i] = Sample2D();
+        }
+    }
+
+    // Fill count 2D samples with indices firstsample ... firstsample + count - 1
+    // occupying dimensions dimension and dimension + 1, same as calling Get2D count times
+    virtual void Get2DBlock(int2 const& pixel, int firstsample, int dimension, int count, float2* samples) const
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            samples[i] = Get2D(pixel, firstsample + i, dimension);
+        }
+    }
 };
 
 
@@ -1,5 +1,198 @@
 
 #include "sobol_sampler.h"
+#include "../math/sseutils.h"
+
+#include <cassert>
+
+// Primitive polynomials and initial direction numbers for dimensions 1 and up from
+// S. Joe and F. Y. Kuo, "Constructing Sobol sequences with better two-dimensional projections", 2008
+// (new-joe-kuo-6.21201), dimension 0 is van der Corput sequence. Polynomials are stored with all
+// the coefficients including the leading and the trailing ones.
+static const int kMaxDegree = 9;
+
+static const struct
+{
+	unsigned int polynomial;
+	unsigned int m[kMaxDegree];
+}
+g_directionnumbers[SobolSampler::kNumDimensions - 1] =
+{
+	{ 3, { 1 } },
+	{ 7, { 1, 3 } },
+	{ 11, { 1, 3, 1 } },
+	{ 13, { 1, 1, 1 } },
+	{ 19, { 1, 1, 3, 3 } },
+	{ 25, { 1, 3, 5, 13 } },
+	{ 37, { 1, 1, 5, 5, 17 } },
+	{ 41, { 1, 1, 5, 5, 5 } },
+	{ 47, { 1, 1, 7, 11, 19 } },
+	{ 55, { 1, 1, 5, 1, 1 } },
+	{ 59, { 1, 1, 1, 3, 11 } },
+	{ 61, { 1, 3, 5, 5, 31 } },
+	{ 67, { 1, 3, 3, 9, 7, 49 } },
+	{ 91, { 1, 1, 1, 15, 21, 21 } },
+	{ 97, { 1, 3, 1, 13, 27, 49 } },
+	{ 103, { 1, 1, 1, 15, 7, 5 } },
+	{ 109, { 1, 3, 1, 15, 13, 25 } },
+	{ 115, { 1, 1, 5, 5, 19, 61 } },
+	{ 131, { 1, 3, 7, 11, 23, 15, 103 } },
+	{ 137, { 1, 3, 7, 13, 13, 15, 69 } },
+	{ 143, { 1, 1, 3, 13, 7, 35, 63 } },
+	{ 145, { 1, 3, 5, 9, 1, 25, 53 } },
+	{ 157, { 1, 3, 1, 13, 9, 35, 107 } },
+	{ 167, { 1, 3, 1, 5, 27, 61, 31 } },
+	{ 171, { 1, 1, 5, 11, 19, 41, 61 } },
+	{ 185, { 1, 3, 5, 3, 3, 13, 69 } },
+	{ 191, { 1, 1, 7, 13, 1, 19, 1 } },
+	{ 193, { 1, 3, 7, 5, 13, 19, 59 } },
+	{ 203, { 1, 1, 3, 9, 25, 29, 41 } },
+	{ 211, { 1, 3, 5, 13, 23, 1, 55 } },
+	{ 213, { 1, 3, 7, 3, 13, 59, 17 } },
+	{ 229, { 1, 3, 1, 3, 5, 53, 69 } },
+	{ 239, { 1, 1, 5, 5, 23, 33, 13 } },
+	{ 241, { 1, 1, 7, 7, 1, 61, 123 } },
+	{ 247, { 1, 1, 7, 9, 13, 61, 49 } },
+	{ 253, { 1, 3, 3, 5, 3, 55, 33 } },
+	{ 285, { 1, 3, 1, 15, 31, 13, 49, 245 } },
+	{ 299, { 1, 3, 5, 15, 31, 59, 63, 97 } },
+	{ 301, { 1, 3, 1, 11, 11, 11, 77, 249 } },
+	{ 333, { 1, 3, 1, 11, 27, 43, 71, 9 } },
+	{ 351, { 1, 1, 7, 15, 21, 11, 81, 45 } },
+	{ 355, { 1, 3, 7, 3, 25, 31, 65, 79 } },
+	{ 357, { 1, 3, 1, 1, 19, 11, 3, 205 } },
+	{ 361, { 1, 1, 5, 9, 19, 21, 29, 157 } },
+	{ 369, { 1, 3, 7, 11, 1, 33, 89, 185 } },
+	{ 391, { 1, 3, 3, 3, 15, 9, 79, 71 } },
+	{ 397, { 1, 3, 7, 11, 15, 39, 119, 27 } },
+	{ 425, { 1, 1, 3, 1, 11, 31, 97, 225 } },
+	{ 451, { 1, 1, 1, 3, 23, 43, 57, 177 } },
+	{ 463, { 1, 3, 7, 7, 17, 17, 37, 71 } },
+	{ 487, { 1, 3, 1, 5, 27, 63, 123, 213 } },
+	{ 501, { 1, 1, 3, 5, 11, 43, 53, 133 } },
+	{ 529, { 1, 3, 5, 5, 29, 17, 47, 173, 479 } },
+	{ 539, { 1, 3, 3, 11, 3, 1, 109, 9, 69 } },
+	{ 545, { 1, 1, 1, 5, 17, 39, 23, 5, 343 } },
+	{ 557, { 1, 3, 1, 5, 25, 15, 31, 103, 499 } },
+	{ 563, { 1, 1, 1, 11, 11, 17, 63, 105, 183 } },
+	{ 601, { 1, 1, 5, 11, 9, 29, 97, 231, 363 } },
+	{ 607, { 1, 1, 5, 15, 19, 45, 41, 7, 383 } },
+	{ 617, { 1, 3, 7, 7, 31, 19, 83, 137, 221 } },
+	{ 623, { 1, 1, 1, 3, 23, 15, 111, 223, 83 } },
+	{ 631, { 1, 1, 5, 13, 31, 15, 55, 25, 161 } },
+	{ 637, { 1, 1, 3, 13, 25, 47, 39, 87, 257 } }
+};
+
+///< Sobol generator matrices: column i is direction number for bit i of the sample index
+///<
+struct SobolMatrices
+{
+	SobolMatrices()
+	{
+		for (int i = 0; i < 32; ++i)
+		{
+			v[0][i] = 1u << (31 - i);
+		}
+
+		for (int dim = 1; dim < SobolSampler::kNumDimensions; ++dim)
+		{
+			unsigned int poly = g_directionnumbers[dim - 1].polynomial;
+			unsigned int const* m = g_directionnumbers[dim - 1].m;
+
+			int degree = 0;
+			while (poly >> (degree + 1))
+				++degree;
+
+			for (int i = 0; i < 32; ++i)
+			{
+				if (i < degree)
+				{
+					v[dim][i] = m[i] << (31 - i);
+				}
+				else
+				{
+					// Recurrence defined by the polynomial
+					unsigned int value = v[dim][i - degree] ^ (v[dim][i - degree] >> degree);
+
+					for (int k = 1; k < degree; ++k)
+					{
+						if ((poly >> (degree - k)) & 0x1)
+						{
+							value ^= v[dim][i - k];
+						}
+					}
+
+					v[dim][i] = value;
+				}
+			}
+		}
+	}
+
+	unsigned int v[SobolSampler::kNumDimensions][32];
+};
+
+// Matrices are built once on first use
+static SobolMatrices const& GetSobolMatrices()
+{
+	static SobolMatrices matrices;
+	return matrices;
+}
+
+// Sample idx of dimension dim as 32 bit fixed point value
+static unsigned int SobolSample(unsigned int idx, int dim)
+{
+	unsigned int const* v = GetSobolMatrices().v[dim];
+	unsigned int result = 0;
+
+	for (int i = 0; idx != 0; idx >>= 1, ++i)
+	{
+		if (idx & 0x1)
+		{
+			result ^= v[i];
+		}
+	}
+
+	return result;
+}
+
+static unsigned int ReverseBits(unsigned int n)
+{
+	n = ((n >> 16) | (n << 16));
+	n = (((n & 0xff00ff00) >> 8) | ((n & 0x00ff00ff) << 8));
+	n = (((n & 0xf0f0f0f0) >> 4) | ((n & 0x0f0f0f0f) << 4));
+	n = (((n & 0xcccccccc) >> 2) | ((n & 0x33333333) << 2));
+	n = (((n & 0xaaaaaaaa) >> 1) | ((n & 0x55555555) << 1));
+	return n;
+}
+
+// Owen scrambling: random permutation of each binary digit depending on all the preceding ones,
+// hash based variant by Burley "Practical Hash-based Owen Scrambling", 2020
+static unsigned int OwenScramble(unsigned int n, unsigned int seed)
+{
+	n = ReverseBits(n);
+	n += seed;
+	n ^= n * 0x6c50b47c;
+	n ^= n * 0xb82f1e52;
+	n ^= n * 0xc7afe638;
+	n ^= n * 0x8d22f6e6;
+	return ReverseBits(n);
+}
+
+// Seed for a given pixel and dimension
+static unsigned int Hash(unsigned int a, unsigned int b, unsigned int c)
+{
+	unsigned int h = a * 0x9e3779b9 ^ (b + 0x7f4a7c15) * 0x85ebca6b ^ (c + 0x165667b1) * 0xc2b2ae35;
+	h ^= h >> 16;
+	h *= 0x7feb352d;
+	h ^= h >> 15;
+	h *= 0x846ca68b;
+	h ^= h >> 16;
+	return h;
+}
+
+static float ToFloat(unsigned int n)
+{
+	return ((n >> 8) & 0xffffff) / float(1 << 24);
+}
 
 // Van Der Corput sequence
 static float VanDerCorput(unsigned int n, unsigned int scramble)
@@ -46,4 +239,127 @@ void SobolSampler::Reset()
 	// Generate new sequence of Sobol samples
 	scramble0_ = rng_->NextUint();
 	scramble1_ = rng_->NextUint();
-}
\ No newline at end of file
+}
+
+float SobolSampler::Get1D(int2 const& pixel, int sampleidx, int dimension) const
+{
+	unsigned int seed = Hash(pixel.x, pixel.y, seed_ + dimension);
+
+	if (dimension < kNumDimensions)
+	{
+		return ToFloat(OwenScramble(SobolSample(sampleidx, dimension), seed));
+	}
+
+	// Padding: shuffle sample order within the pattern and reuse the first dimension
+	unsigned int idx = sampleidx ^ (Hash(seed, 0, 0) & (numsamples_ - 1));
+	return ToFloat(OwenScramble(SobolSample(idx, 0), seed));
+}
+
+float2 SobolSampler::Get2D(int2 const& pixel, int sampleidx, int dimension) const
+{
+	if (dimension + 1 < kNumDimensions)
+	{
+		return float2(Get1D(pixel, sampleidx, dimension), Get1D(pixel, sampleidx, dimension + 1));
+	}
+
+	// Padding: first two dimensions form (0,2)-sequence, so shuffled
+	// consistently for both components they keep 2D stratification
+	unsigned int seed = Hash(pixel.x, pixel.y, seed_ + dimension);
+	unsigned int idx = sampleidx ^ (Hash(seed, 0, 0) & (numsamples_ - 1));
+
+	return float2(ToFloat(OwenScramble(SobolSample(idx, 0), seed)),
+				  ToFloat(OwenScramble(SobolSample(idx, 1), Hash(seed, 1, 0))));
+}
+
+// 4 samples of dimension dim at once, maxidx bounds all the indices
+static __m128i SobolSample4(__m128i idx, int dim, unsigned int maxidx)
+{
+	unsigned int const* v = GetSobolMatrices().v[dim];
+	__m128i const one = _mm_set1_epi32(1);
+	__m128i result = _mm_setzero_si128();
+
+	for (int i = 0; maxidx != 0; maxidx >>= 1, idx = _mm_srli_epi32(idx, 1), ++i)
+	{
+		// All ones for the lanes having bit i set
+		__m128i mask = _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(idx, one));
+		result = _mm_xor_si128(result, _mm_and_si128(mask, _mm_set1_epi32(v[i])));
+	}
+
+	return result;
+}
+
+static __m128i OwenScramble4(__m128i n, unsigned int seed)
+{
+	n = reverse_bits_epi32(n);
+	n = _mm_add_epi32(n, _mm_set1_epi32(seed));
+	n = _mm_xor_si128(n, mullo_epi32(n, _mm_set1_epi32(0x6c50b47c)));
+	n = _mm_xor_si128(n, mullo_epi32(n, _mm_set1_epi32(0xb82f1e52)));
+	n = _mm_xor_si128(n, mullo_epi32(n, _mm_set1_epi32(0xc7afe638)));
+	n = _mm_xor_si128(n, mullo_epi32(n, _mm_set1_epi32(0x8d22f6e6)));
+	return reverse_bits_epi32(n);
+}
+
+static __m128 ToFloat4(__m128i n)
+{
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(n, 8)), _mm_set1_ps(1.f / (1 << 24)));
+}
+
+void SobolSampler::Generate(float2* samples, int count) const
+{
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i idx = _mm_add_epi32(_mm_set1_epi32(sequenceidx_), _mm_setr_epi32(0, 1, 2, 3));
+
+		// Second dimension of the sequence is the one of Sobol02
+		__m128i x = _mm_xor_si128(reverse_bits_epi32(idx), _mm_set1_epi32(scramble0_));
+		__m128i y = _mm_xor_si128(SobolSample4(idx, 1, sequenceidx_ + 3), _mm_set1_epi32(scramble1_));
+
+		store_float2x4(samples + i, ToFloat4(x), ToFloat4(y));
+
+		sequenceidx_ += 4;
+	}
+
+	for (; i < count; ++i)
+	{
+		samples[i] = Sample2D();
+	}
+}
+
+void SobolSampler::Get2DBlock(int2 const& pixel, int firstsample, int dimension, int count, float2* samples) const
+{
+	int dimx = dimension;
+	int dimy = dimension + 1;
+	unsigned int seedx = Hash(pixel.x, pixel.y, seed_ + dimension);
+	unsigned int seedy = Hash(pixel.x, pixel.y, seed_ + dimension + 1);
+	unsigned int shuffle = 0;
+
+	// Padding, same as in Get2D
+	if (dimension + 1 >= kNumDimensions)
+	{
+		dimx = 0;
+		dimy = 1;
+		seedy = Hash(seedx, 1, 0);
+		shuffle = Hash(seedx, 0, 0) & (numsamples_ - 1);
+	}
+
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		unsigned int last = firstsample + i + 3;
+		__m128i idx = _mm_add_epi32(_mm_set1_epi32(firstsample + i), _mm_setr_epi32(0, 1, 2, 3));
+		idx = _mm_xor_si128(idx, _mm_set1_epi32(shuffle));
+
+		__m128i x = OwenScramble4(SobolSample4(idx, dimx, last | shuffle), seedx);
+		__m128i y = OwenScramble4(SobolSample4(idx, dimy, last | shuffle), seedy);
+
+		store_float2x4(samples + i, ToFloat4(x), ToFloat4(y));
+	}
+
+	for (; i < count; ++i)
+	{
+		samples[i] = Get2D(pixel, firstsample + i, dimension);
+	}
+}
@@ -37,6 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <memory>
 #include <vector>
 #include <numeric>
+#include <algorithm>
 
 #include "../rng/rng.h"
 #include "../math/mathutils.h"
@@ -44,17 +45,24 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 ///< The implemetation of low-discrepancy Sobol sampler
 ///< https://en.wikipedia.org/wiki/Sobol_sequence
+///< Dimension-aware Get1D/Get2D use kNumDimensions dimensional sequence
+///< with Joe-Kuo direction numbers, Owen scrambled per pixel and dimension.
+///< Dimensions past that are padded with shuffled first two dimensions.
 ///<
 class SobolSampler : public Sampler
 {
 public:
+	// Number of dimensions with proper direction numbers
+	static const int kNumDimensions = 64;
+
 	SobolSampler(int numsamples, Rng* rng)
 		: rng_(rng)
-		, numsamples_((int)upper_power_of_two(numsamples))
+		, numsamples_((int)upper_power_of_two(std::max(numsamples, 1)))
 		, sequenceidx_(0)
 	{
 		scramble0_ = rng_->NextUint();
 		scramble1_ = rng_->NextUint();
+		seed_ = rng_->NextUint();
 	}
 
 	// Calculate 2D sample in [0..1]x[0..1]
@@ -67,22 +75,41 @@ public:
 	}
 
 	// Clone an instance of a sampler
+	// Clone keeps the seed, so dimension-aware samples do not depend
+	// on which copy of the sampler has produced them
 	Sampler* Clone() const
 	{
-		return new SobolSampler(numsamples_, rng_->Clone());
+		SobolSampler* sampler = new SobolSampler(numsamples_, rng_->Clone());
+		sampler->seed_ = seed_;
+		return sampler;
 	}
 
 	// Reset the sequence
 	void Reset();
 
+	// Get 1D sample component for a given pixel, sample index and dimension
+	float Get1D(int2 const& pixel, int sampleidx, int dimension) const;
+
+	// Get 2D sample occupying dimensions dimension and dimension + 1
+	float2 Get2D(int2 const& pixel, int sampleidx, int dimension) const;
+
+	// Fill count subsequent samples of the sequence, 4 at a time
+	void Generate(float2* samples, int count) const;
+
+	// Fill count samples of a pixel, 4 at a time
+	void Get2DBlock(int2 const& pixel, int firstsample, int dimension, int count, float2* samples) const;
+
 private:
 	// RNG to use
 	std::unique_ptr<Rng> rng_;
-	// Number of samples to generate
+	// Number of samples to generate, rounded up to a power of two
+	// so padded dimensions can shuffle sample indices with a mask
 	int numsamples_;
 	// Scramble values
 	unsigned int scramble0_;
 	unsigned int scramble1_;
+	// Seed for dimension-aware samples
+	unsigned int seed_;
 	// Sequence index
 	mutable int sequenceidx_;
 };
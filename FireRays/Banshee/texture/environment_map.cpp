@@ -0,0 +1,148 @@
+#include "environment_map.h"
+
+#include "texturesystem.h"
+#include "../math/mathutils.h"
+
+#include <cmath>
+#include <algorithm>
+
+///< Arctangent over [0..1] tabulated once, direction mapping interpolates it
+///< linearly instead of calling atan2 and acos for every lookup.
+///<
+struct AtanTable
+{
+    static int const kSize = 1024;
+
+    AtanTable()
+    {
+        for (int i = 0; i <= kSize; ++i)
+        {
+            values[i] = std::atan((float)i / kSize);
+        }
+    }
+
+    float values[kSize + 1];
+};
+
+static AtanTable const& GetAtanTable()
+{
+    static AtanTable table;
+    return table;
+}
+
+// atan2 in [-PI..PI] reduced to the first octant and looked up in the table
+static float FastAtan2(AtanTable const& table, float y, float x)
+{
+    float ax = std::abs(x);
+    float ay = std::abs(y);
+    float maxv = std::max(ax, ay);
+
+    if (maxv == 0.f)
+    {
+        return 0.f;
+    }
+
+    float f = std::min(ax, ay) / maxv * AtanTable::kSize;
+    int i = std::min((int)f, AtanTable::kSize - 1);
+    float a = table.values[i] + (table.values[i + 1] - table.values[i]) * (f - i);
+
+    a = ay > ax ? 0.5f * PI - a : a;
+    a = x < 0.f ? PI - a : a;
+    return y < 0.f ? -a : a;
+}
+
+EnvironmentMap::EnvironmentMap(TextureSystem const& texsys,
+                               std::string const& texture,
+                               float scale,
+                               float gamma)
+{
+    TextureSystem::TextureDesc desc;
+    texsys.GetTextureInfo(texture, desc);
+
+    width_ = desc.width;
+    height_ = desc.height;
+
+    texels_.resize(3 * width_ * height_);
+
+    int handle = texsys.GetHandle(texture);
+
+    float invgamma = 1.f / gamma;
+
+    // Fetch texel centers without filtering
+    TextureSystem::Options opts(TextureSystem::Options::kPoint, TextureSystem::Options::kRepeat);
+
+    // Fetch a row at a time
+    std::vector<float2> uvs(width_);
+    std::vector<float3> vals(width_);
+
+    for (int y = 0; y < height_; ++y)
+    {
+        for (int x = 0; x < width_; ++x)
+        {
+            uvs[x] = float2((x + 0.5f) / width_, (y + 0.5f) / height_);
+        }
+
+        texsys.SampleBatch(handle, &uvs[0], nullptr, &vals[0], width_, opts);
+
+        for (int x = 0; x < width_; ++x)
+        {
+            float3 const& val = vals[x];
+
+            // Apply gamma correction and scale once here
+            float* texel = &texels_[3 * (y * width_ + x)];
+            texel[0] = scale * std::pow(val.x, invgamma);
+            texel[1] = scale * std::pow(val.y, invgamma);
+            texel[2] = scale * std::pow(val.z, invgamma);
+        }
+    }
+}
+
+float3 EnvironmentMap::Fetch(int x, int y) const
+{
+    x = x % width_;
+    x = x < 0 ? x + width_ : x;
+    y = clamp(y, 0, height_ - 1);
+
+    float const* texel = &texels_[3 * (y * width_ + x)];
+
+    return float3(texel[0], texel[1], texel[2]);
+}
+
+float3 EnvironmentMap::Sample(float2 const& uv) const
+{
+    // Texel centers are at half integer coordinates
+    float fx = uv.x * width_ - 0.5f;
+    float fy = uv.y * height_ - 0.5f;
+
+    float x0 = std::floor(fx);
+    float y0 = std::floor(fy);
+
+    float sx = fx - x0;
+    float sy = fy - y0;
+
+    int x = (int)x0;
+    int y = (int)y0;
+
+    return lerp(lerp(Fetch(x, y), Fetch(x + 1, y), sx),
+                lerp(Fetch(x, y + 1), Fetch(x + 1, y + 1), sx),
+                sy);
+}
+
+float3 EnvironmentMap::Sample(float3 const& d) const
+{
+    return Sample(GetUv(d));
+}
+
+float2 EnvironmentMap::GetUv(float3 const& d) const
+{
+    AtanTable const& table = GetAtanTable();
+
+    // Same mapping as cartesian_to_spherical: phi / 2PI, theta / PI
+    float phi = FastAtan2(table, d.z, d.x);
+    phi = phi >= 0.f ? phi : phi + 2.f * PI;
+
+    // acos(y / |d|) written as an angle from the Y axis, no need to normalize
+    float theta = FastAtan2(table, std::sqrt(d.x * d.x + d.z * d.z), d.y);
+
+    return float2(phi * (0.5f / PI), theta * (1.f / PI));
+}
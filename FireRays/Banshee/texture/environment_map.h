@@ -0,0 +1,85 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+#ifndef ENVIRONMENT_MAP_H
+#define ENVIRONMENT_MAP_H
+
+#include <string>
+#include <vector>
+
+#include "../math/float2.h"
+#include "../math/float3.h"
+
+class TextureSystem;
+
+///< EnvironmentMap is latitude-longitude radiance map baked into memory.
+///< Texels are fetched once at construction, gamma linearized and scaled,
+///< so lookups during rendering are a direction to texel mapping
+///< and a bilinear blend without going through the texture system.
+///< Direction mapping uses tabulated arctangent instead of atan2 and acos.
+///<
+class EnvironmentMap
+{
+public:
+    EnvironmentMap(TextureSystem const& texsys,
+                   std::string const& texture,
+                   float scale = 1.f,
+                   float gamma = 2.2f);
+
+    // Bilinear lookup by lat-long texture coordinates
+    float3 Sample(float2 const& uv) const;
+
+    // Bilinear lookup by world space direction
+    float3 Sample(float3 const& d) const;
+
+    // Lat-long texture coordinates for world space direction
+    float2 GetUv(float3 const& d) const;
+
+    // Resolution
+    int GetWidth() const { return width_; }
+    int GetHeight() const { return height_; }
+
+    // Memory held by texel data in bytes
+    std::size_t GetSizeInBytes() const { return texels_.capacity() * sizeof(float); }
+
+private:
+    // Fetch single texel wrapping horizontally and clamping vertically
+    float3 Fetch(int x, int y) const;
+
+    // Resolution
+    int width_;
+    int height_;
+    // Linear RGB values
+    std::vector<float> texels_;
+};
+
+#endif // ENVIRONMENT_MAP_H
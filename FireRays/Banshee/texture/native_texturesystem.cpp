@@ -0,0 +1,670 @@
+#include "native_texturesystem.h"
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cstring>
+#include <xmmintrin.h>
+
+#include "../imageio/imageio.h"
+#include "../util/profiler.h"
+#include "../util/memoryreport.h"
+
+struct NativeTextureSystem::Texture
+{
+    // Texture name
+    std::string filename;
+    // Texture handle
+    int handle;
+    // Resolution of each MIP level
+    std::vector<int2> dims;
+    // Number of tiles along x and y for each MIP level
+    std::vector<int2> tiles;
+    // Index of the first tile of each MIP level
+    std::vector<int> firsttile;
+    // Pool slot for each tile, -1 if not resident
+    std::unique_ptr<std::atomic<int>[]> slots;
+    // Serializes tile loads of this texture, held while reading the file
+    mutable std::mutex loadmutex;
+    // Residency statistics, updated under the lock
+    mutable int residenttiles;
+    mutable int loads;
+    mutable int evictions;
+};
+
+struct NativeTextureSystem::Tile
+{
+    // Odd while the tile is being written
+    std::atomic<unsigned> version;
+    // Clock value of the last access
+    std::atomic<unsigned> lastused;
+    // Owning texture handle and tile index
+    int texture;
+    int index;
+    // RGB texels padded with one float so any texel can be read as 4 floats
+    float texels[kTileSize * kTileSize * 3 + 1];
+};
+
+// Halve the resolution averaging existing 2x2 children
+static void Downsample(std::vector<float> const& src, int2 const& srcdim, std::vector<float>& dst, int2 const& dstdim)
+{
+    dst.resize(dstdim.x * dstdim.y * 3);
+
+    for (int y = 0; y < dstdim.y; ++y)
+    {
+        for (int x = 0; x < dstdim.x; ++x)
+        {
+            float3 sum;
+            int count = 0;
+
+            for (int yy = 2 * y; yy < std::min(2 * y + 2, srcdim.y); ++yy)
+            {
+                for (int xx = 2 * x; xx < std::min(2 * x + 2, srcdim.x); ++xx)
+                {
+                    int offset = 3 * (yy * srcdim.x + xx);
+                    sum += float3(src[offset], src[offset + 1], src[offset + 2]);
+                    ++count;
+                }
+            }
+
+            sum *= (1.f / count);
+
+            dst[3 * (y * dstdim.x + x)] = sum.x;
+            dst[3 * (y * dstdim.x + x) + 1] = sum.y;
+            dst[3 * (y * dstdim.x + x) + 2] = sum.z;
+        }
+    }
+}
+
+// Apply address mode to integer texel coordinate
+static int Wrap(int x, int size, TextureSystem::Options::WrapMode wrapmode)
+{
+    switch (wrapmode)
+    {
+    case TextureSystem::Options::kMirror:
+        x %= 2 * size;
+        x = x < 0 ? x + 2 * size : x;
+        return x < size ? x : 2 * size - 1 - x;
+    case TextureSystem::Options::kRepeat:
+    default:
+        x %= size;
+        return x < 0 ? x + size : x;
+    }
+}
+
+// Convert interleaved texels with nc channels to RGB
+static void ToRgb(std::vector<float> const& data, int nc, std::vector<float>& rgb)
+{
+    int count = (int)data.size() / nc;
+    rgb.resize(count * 3);
+
+    for (int i = 0; i < count; ++i)
+    {
+        rgb[3 * i] = data[nc * i];
+        rgb[3 * i + 1] = data[nc * i + (nc > 1 ? 1 : 0)];
+        rgb[3 * i + 2] = data[nc * i + (nc > 2 ? 2 : 0)];
+    }
+}
+
+NativeTextureSystem::NativeTextureSystem(std::string const& searchpath, ImageIo& io, std::size_t poolsize)
+    : searchpath_(searchpath)
+    , io_(io)
+    , textures_(kMaxTextures)
+    , numslots_(0)
+    , clock_(0)
+{
+    AllocatePool(poolsize);
+}
+
+NativeTextureSystem::~NativeTextureSystem()
+{
+}
+
+float3 NativeTextureSystem::Sample(std::string const& filename, float2 const& uv, float2 const& duvdx, Options const& opts) const
+{
+    return Sample(GetHandle(filename), uv, duvdx, opts);
+}
+
+void NativeTextureSystem::GetTextureInfo(std::string const& filename, TextureDesc& texdesc) const
+{
+    int handle = GetHandle(filename);
+
+    if (handle < 0)
+    {
+        throw std::runtime_error("Invalid texture name");
+    }
+
+    texdesc.width = textures_[handle]->dims[0].x;
+    texdesc.height = textures_[handle]->dims[0].y;
+}
+
+int NativeTextureSystem::GetHandle(std::string const& filename) const
+{
+    if (filename.empty())
+    {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto iter = handles_.find(filename);
+
+    if (iter != handles_.end())
+    {
+        return iter->second;
+    }
+
+    int handle = (int)handles_.size();
+
+    if (handle >= kMaxTextures)
+    {
+        throw std::runtime_error("Too many textures");
+    }
+
+    std::unique_ptr<Texture> texture(new Texture());
+    texture->filename = filename;
+    texture->handle = handle;
+    texture->residenttiles = 0;
+    texture->loads = 0;
+    texture->evictions = 0;
+
+    // Only the header is read here, texels are loaded on demand
+    ImageIo::ImageDesc desc;
+    io_.ReadInfo(GetPath(filename), desc);
+
+    int2 dim = int2(desc.xres, desc.yres);
+
+    if (dim.x <= 0 || dim.y <= 0 || desc.nchannels <= 0)
+    {
+        throw std::runtime_error("Invalid texture " + filename);
+    }
+
+    // Lay out tiles level by level
+    int numtiles = 0;
+    for (;;)
+    {
+        int2 tiles = int2((dim.x + kTileSize - 1) / kTileSize, (dim.y + kTileSize - 1) / kTileSize);
+
+        texture->dims.push_back(dim);
+        texture->tiles.push_back(tiles);
+        texture->firsttile.push_back(numtiles);
+        numtiles += tiles.x * tiles.y;
+
+        if (dim.x == 1 && dim.y == 1)
+        {
+            break;
+        }
+
+        dim = int2((dim.x + 1) / 2, (dim.y + 1) / 2);
+    }
+
+    texture->slots.reset(new std::atomic<int>[numtiles]);
+
+    for (int i = 0; i < numtiles; ++i)
+    {
+        texture->slots[i].store(-1);
+    }
+
+    textures_[handle] = std::move(texture);
+    handles_[filename] = handle;
+
+    return handle;
+}
+
+void NativeTextureSystem::SetMemoryBudget(std::size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Drop all resident tiles
+    for (int i = 0; i < (int)handles_.size(); ++i)
+    {
+        Texture const& texture = *textures_[i];
+        int numtiles = texture.firsttile.back() + texture.tiles.back().x * texture.tiles.back().y;
+
+        for (int j = 0; j < numtiles; ++j)
+        {
+            texture.slots[j].store(-1);
+        }
+
+        texture.residenttiles = 0;
+    }
+
+    AllocatePool(bytes);
+}
+
+void NativeTextureSystem::GetStatistics(std::vector<TextureStats>& stats) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    stats.resize(handles_.size());
+
+    for (int i = 0; i < (int)handles_.size(); ++i)
+    {
+        Texture const& texture = *textures_[i];
+
+        stats[i].name = texture.filename;
+        stats[i].width = texture.dims[0].x;
+        stats[i].height = texture.dims[0].y;
+        stats[i].numtiles = texture.firsttile.back() + texture.tiles.back().x * texture.tiles.back().y;
+        stats[i].residenttiles = texture.residenttiles;
+        stats[i].residentbytes = texture.residenttiles * sizeof(Tile);
+        stats[i].loads = texture.loads;
+        stats[i].evictions = texture.evictions;
+    }
+}
+
+void NativeTextureSystem::GetMemoryUsage(MemoryReport& report) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::size_t tables = 0;
+
+    for (int i = 0; i < (int)handles_.size(); ++i)
+    {
+        Texture const& texture = *textures_[i];
+
+        int numtiles = texture.firsttile.back() + texture.tiles.back().x * texture.tiles.back().y;
+        tables += sizeof(Texture) + numtiles * sizeof(std::atomic<int>) +
+            (texture.dims.capacity() + texture.tiles.capacity()) * sizeof(int2) + texture.firsttile.capacity() * sizeof(int);
+    }
+
+    // The pool is allocated upfront, residency is in GetStatistics
+    report.Add("texture.pool", numslots_ * sizeof(Tile));
+    report.Add("texture.tables", tables);
+}
+
+float3 NativeTextureSystem::Sample(int handle, float2 const& uv, float2 const& duvdx, Options const& opts) const
+{
+    if (handle < 0 || handle >= kMaxTextures || !textures_[handle])
+    {
+        throw std::runtime_error("Invalid texture handle");
+    }
+
+    return SampleTexture(*textures_[handle], uv, duvdx, opts);
+}
+
+void NativeTextureSystem::SampleBatch(int handle, float2 const* uv, float2 const* duvdx, float3* out, int n, Options const& opts) const
+{
+    if (handle < 0 || handle >= kMaxTextures || !textures_[handle])
+    {
+        throw std::runtime_error("Invalid texture handle");
+    }
+
+    Texture const& texture = *textures_[handle];
+
+    for (int i = 0; i < n; ++i)
+    {
+        out[i] = SampleTexture(texture, uv[i], duvdx ? duvdx[i] : float2(0,0), opts);
+    }
+}
+
+float3 NativeTextureSystem::SampleTexture(Texture const& texture, float2 const& uv, float2 const& duvdx, Options const& opts) const
+{
+    int maxlevel = (int)texture.dims.size() - 1;
+
+    // Choose MIP level by footprint size in texels
+    float footprint = std::max(std::abs(duvdx.x) * texture.dims[0].x, std::abs(duvdx.y) * texture.dims[0].y);
+    float lod = footprint > 1.f ? std::min(std::log2(footprint), (float)maxlevel) : 0.f;
+
+    if (opts.filter == Options::kPoint)
+    {
+        return SampleLevel(texture, (int)(lod + 0.5f), uv, opts);
+    }
+
+    // Trilinear filtering
+    int level = (int)lod;
+    float t = lod - level;
+
+    float3 res = SampleLevel(texture, level, uv, opts);
+
+    if (t > 0.f && level < maxlevel)
+    {
+        res = (1.f - t) * res + t * SampleLevel(texture, level + 1, uv, opts);
+    }
+
+    return res;
+}
+
+float3 NativeTextureSystem::SampleLevel(Texture const& texture, int level, float2 const& uv, Options const& opts) const
+{
+    int2 dim = texture.dims[level];
+
+    float x = uv.x * dim.x;
+    float y = uv.y * dim.y;
+
+    if (opts.filter == Options::kPoint)
+    {
+        int xx = Wrap((int)std::floor(x), dim.x, opts.wrapmode);
+        int yy = Wrap((int)std::floor(y), dim.y, opts.wrapmode);
+        return Fetch(texture, level, xx, yy);
+    }
+
+    // Bilinear between four nearest texel centers
+    x -= 0.5f;
+    y -= 0.5f;
+
+    float fx = std::floor(x);
+    float fy = std::floor(y);
+    float tx = x - fx;
+    float ty = y - fy;
+
+    int x0 = Wrap((int)fx, dim.x, opts.wrapmode);
+    int x1 = Wrap((int)fx + 1, dim.x, opts.wrapmode);
+    int y0 = Wrap((int)fy, dim.y, opts.wrapmode);
+    int y1 = Wrap((int)fy + 1, dim.y, opts.wrapmode);
+
+    // Filter all channels at once, 4th lane is garbage
+    float texels[4][4];
+    Fetch(texture, level, x0, y0, texels[0]);
+    Fetch(texture, level, x1, y0, texels[1]);
+    Fetch(texture, level, x0, y1, texels[2]);
+    Fetch(texture, level, x1, y1, texels[3]);
+
+    __m128 w0 = _mm_set1_ps((1.f - tx) * (1.f - ty));
+    __m128 w1 = _mm_set1_ps(tx * (1.f - ty));
+    __m128 w2 = _mm_set1_ps((1.f - tx) * ty);
+    __m128 w3 = _mm_set1_ps(tx * ty);
+
+    __m128 res = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_loadu_ps(texels[0])), _mm_mul_ps(w1, _mm_loadu_ps(texels[1]))),
+                            _mm_add_ps(_mm_mul_ps(w2, _mm_loadu_ps(texels[2])), _mm_mul_ps(w3, _mm_loadu_ps(texels[3]))));
+
+    float result[4];
+    _mm_storeu_ps(result, res);
+
+    return float3(result[0], result[1], result[2]);
+}
+
+float3 NativeTextureSystem::Fetch(Texture const& texture, int level, int x, int y) const
+{
+    float texel[4];
+    Fetch(texture, level, x, y, texel);
+    return float3(texel[0], texel[1], texel[2]);
+}
+
+void NativeTextureSystem::Fetch(Texture const& texture, int level, int x, int y, float* texel) const
+{
+    int tileidx = texture.firsttile[level] + (y / kTileSize) * texture.tiles[level].x + x / kTileSize;
+    int slot = texture.slots[tileidx].load(std::memory_order_acquire);
+
+    if (slot >= 0)
+    {
+        Tile& tile = pool_[slot];
+
+        // Optimistic read validated by the tile version
+        unsigned version = tile.version.load(std::memory_order_acquire);
+
+        int offset = 3 * ((y % kTileSize) * kTileSize + x % kTileSize);
+        std::memcpy(texel, tile.texels + offset, 4 * sizeof(float));
+        bool owned = tile.texture == texture.handle && tile.index == tileidx;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (!(version & 1) && owned && tile.version.load(std::memory_order_relaxed) == version)
+        {
+            // Avoid writing shared cache line if already up to date
+            unsigned now = clock_.load(std::memory_order_relaxed);
+            if (tile.lastused.load(std::memory_order_relaxed) != now)
+            {
+                tile.lastused.store(now, std::memory_order_relaxed);
+            }
+
+            return;
+        }
+    }
+
+    FetchSlow(texture, level, x, y, texel);
+}
+
+void NativeTextureSystem::FetchSlow(Texture const& texture, int level, int x, int y, float* texel) const
+{
+    clock_.fetch_add(1, std::memory_order_relaxed);
+
+    if (FetchResident(texture, level, x, y, texel))
+    {
+        return;
+    }
+
+    // Lookups of other textures are not blocked while the file is read
+    std::lock_guard<std::mutex> lock(texture.loadmutex);
+
+    // Tile might have been loaded while we were waiting
+    if (!FetchResident(texture, level, x, y, texel))
+    {
+        LoadTile(texture, level, x, y, texel);
+    }
+}
+
+bool NativeTextureSystem::FetchResident(Texture const& texture, int level, int x, int y, float* texel) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    int tileidx = texture.firsttile[level] + (y / kTileSize) * texture.tiles[level].x + x / kTileSize;
+    int slot = texture.slots[tileidx].load(std::memory_order_relaxed);
+
+    if (slot < 0)
+    {
+        return false;
+    }
+
+    // Writers are serialized by the lock so the tile is stable here
+    Tile const& tile = pool_[slot];
+    int offset = 3 * ((y % kTileSize) * kTileSize + x % kTileSize);
+    std::memcpy(texel, tile.texels + offset, 4 * sizeof(float));
+
+    return true;
+}
+
+void NativeTextureSystem::LoadTile(Texture const& texture, int level, int x, int y, float* texel) const
+{
+    PROFILE_SCOPE("NativeTextureSystem::LoadTile");
+
+    std::string path = GetPath(texture.filename);
+    int2 dim = texture.dims[0];
+    std::vector<float> data;
+    ImageIo::ImageDesc desc;
+
+    if (level == 0)
+    {
+        // Read the whole row of tiles: scanline formats decode full rows anyway
+        int ty = y / kTileSize;
+        int y0 = ty * kTileSize;
+        int y1 = std::min(y0 + kTileSize, dim.y);
+
+        io_.ReadRegion(path, 0, y0, dim.x, y1, data, desc);
+
+        std::vector<float> texels;
+        ToRgb(data, desc.nchannels, texels);
+
+        StoreRow(texture, 0, ty, &texels[0], y1 - y0, x / kTileSize, false);
+
+        // Texel is taken from the row, the tile might be evicted already
+        std::copy(&texels[3 * ((y - y0) * dim.x + x)], &texels[3 * ((y - y0) * dim.x + x)] + 3, texel);
+        texel[3] = 0.f;
+        return;
+    }
+
+    // Coarser levels are built all at once, reading each row of the finest level once:
+    // rows are accumulated into a band of tile height per level, full bands are stored
+    // and downsampled into the band of the next level
+    int numlevels = (int)texture.dims.size();
+    int numtiles = texture.firsttile.back() + texture.tiles.back().x * texture.tiles.back().y;
+
+    // Keep the requested level and coarser ones if they take a small part of the pool
+    bool keepall = numtiles - texture.firsttile[level] <= numslots_ / 4;
+
+    std::vector<std::vector<float> > bands(numlevels);
+    // Rows of each level already stored
+    std::vector<int> done(numlevels, 0);
+
+    for (int y0 = 0; y0 < dim.y; y0 += kTileSize)
+    {
+        int y1 = std::min(y0 + kTileSize, dim.y);
+
+        io_.ReadRegion(path, 0, y0, dim.x, y1, data, desc);
+        ToRgb(data, desc.nchannels, bands[0]);
+
+        for (int l = 0; l < numlevels; ++l)
+        {
+            int2 ldim = texture.dims[l];
+            int rows = (int)bands[l].size() / (3 * ldim.x);
+
+            if (rows < kTileSize && done[l] + rows < ldim.y)
+            {
+                break;
+            }
+
+            // Finest level tiles are not kept, they are loaded a row at a time when needed
+            if (l > 0)
+            {
+                int ty = done[l] / kTileSize;
+                bool requested = l == level && ty == y / kTileSize;
+                StoreRow(texture, l, ty, &bands[l][0], rows, requested ? x / kTileSize : -1, keepall && l >= level);
+
+                if (requested)
+                {
+                    int offset = 3 * ((y - done[l]) * ldim.x + x);
+                    std::copy(&bands[l][offset], &bands[l][offset] + 3, texel);
+                    texel[3] = 0.f;
+                }
+            }
+
+            done[l] += rows;
+
+            if (l + 1 < numlevels)
+            {
+                std::vector<float> half;
+                Downsample(bands[l], int2(ldim.x, rows), half, int2(texture.dims[l + 1].x, (rows + 1) / 2));
+                bands[l + 1].insert(bands[l + 1].end(), half.begin(), half.end());
+            }
+
+            bands[l].clear();
+        }
+    }
+}
+
+void NativeTextureSystem::StoreRow(Texture const& texture, int level, int ty, float const* texels, int h, int tx, bool keepall) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    int2 dim = texture.dims[level];
+
+    for (int x = 0; x < texture.tiles[level].x; ++x)
+    {
+        int idx = texture.firsttile[level] + ty * texture.tiles[level].x + x;
+
+        if (texture.slots[idx].load(std::memory_order_relaxed) >= 0)
+        {
+            continue;
+        }
+
+        // Neighbours are kept only if there is free space unless asked to
+        if (x != tx && !keepall && freeslots_.empty())
+        {
+            continue;
+        }
+
+        int w = std::min(kTileSize, dim.x - x * kTileSize);
+        StoreTile(texture, idx, texels + 3 * x * kTileSize, dim.x, w, h);
+    }
+}
+
+int NativeTextureSystem::StoreTile(Texture const& texture, int tileidx, float const* texels, int stride, int w, int h) const
+{
+    if (freeslots_.empty())
+    {
+        Evict();
+    }
+
+    int slot = freeslots_.back();
+    freeslots_.pop_back();
+
+    Tile& tile = pool_[slot];
+
+    // Mark tile as being written, readers racing with us will retry via slow path
+    unsigned version = tile.version.load(std::memory_order_relaxed);
+    tile.version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    tile.texture = texture.handle;
+    tile.index = tileidx;
+
+    // Texels outside of the level are never fetched, replicate the edge there
+    for (int y = 0; y < kTileSize; ++y)
+    {
+        for (int x = 0; x < kTileSize; ++x)
+        {
+            float const* src = texels + 3 * (std::min(y, h - 1) * stride + std::min(x, w - 1));
+
+            float* dst = tile.texels + 3 * (y * kTileSize + x);
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+    }
+
+    tile.texels[kTileSize * kTileSize * 3] = 0.f;
+
+    tile.version.store(version + 2, std::memory_order_release);
+    tile.lastused.store(clock_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    texture.slots[tileidx].store(slot, std::memory_order_release);
+
+    ++texture.residenttiles;
+    ++texture.loads;
+
+    return slot;
+}
+
+void NativeTextureSystem::Evict() const
+{
+    // Pool is full here, so every slot has an owner
+    std::vector<std::pair<unsigned, int> > lru(numslots_);
+
+    unsigned now = clock_.load(std::memory_order_relaxed);
+    for (int i = 0; i < numslots_; ++i)
+    {
+        // Age is robust to clock wrap around
+        lru[i] = std::make_pair(now - pool_[i].lastused.load(std::memory_order_relaxed), i);
+    }
+
+    // Free 1/8 of the pool at once to amortize the scan
+    int count = std::max(numslots_ / 8, 1);
+    std::nth_element(lru.begin(), lru.begin() + count - 1, lru.end(), std::greater<std::pair<unsigned, int> >());
+
+    for (int i = 0; i < count; ++i)
+    {
+        Tile const& tile = pool_[lru[i].second];
+        Texture const& texture = *textures_[tile.texture];
+
+        // Unpublish the slot, data stays valid until the slot is rewritten
+        texture.slots[tile.index].store(-1, std::memory_order_release);
+        --texture.residenttiles;
+        ++texture.evictions;
+
+        freeslots_.push_back(lru[i].second);
+    }
+}
+
+void NativeTextureSystem::AllocatePool(std::size_t bytes)
+{
+    numslots_ = std::max((int)(bytes / sizeof(Tile)), 16);
+    pool_.reset(new Tile[numslots_]);
+
+    freeslots_.resize(numslots_);
+
+    for (int i = 0; i < numslots_; ++i)
+    {
+        pool_[i].version.store(0);
+        pool_[i].lastused.store(0);
+        pool_[i].texture = -1;
+        pool_[i].index = -1;
+        // Pop lower slots first
+        freeslots_[i] = numslots_ - 1 - i;
+    }
+}
+
+std::string NativeTextureSystem::GetPath(std::string const& filename) const
+{
+    return searchpath_.empty() ? filename : searchpath_ + "/" + filename;
+}
@@ -0,0 +1,145 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+#ifndef NATIVE_TEXTURESYSTEM_H
+#define NATIVE_TEXTURESYSTEM_H
+
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <vector>
+
+#include "texturesystem.h"
+#include "../math/int2.h"
+
+class ImageIo;
+
+///< Texture system keeping textures in its own tiled MIP pyramids.
+///< Pyramid tiles are loaded on demand: finest level tiles are read
+///< from file a tile row at a time with ImageIo::ReadRegion, coarser
+///< levels are built in a single pass over the finest level rows,
+///< downsampling them as they are read. Tiles live in a memory pool of
+///< bounded size, least recently used ones are evicted. Lookups by
+///< handle do not take any locks while tiles are resident, file reads
+///< are done outside of the pool lock.
+///<
+class NativeTextureSystem : public TextureSystem
+{
+public:
+    // Tile resolution in texels
+    static int const kTileSize = 32;
+    // Maximum number of textures
+    static int const kMaxTextures = 4096;
+
+    // Specify a search path, image loader and tile pool size in bytes
+    NativeTextureSystem(std::string const& searchpath, ImageIo& io, std::size_t poolsize = 256 * 1024 * 1024);
+
+    // Destructor
+    ~NativeTextureSystem();
+
+    // Filtered texture lookup
+    float3 Sample(std::string const& filename, float2 const& uv, float2 const& duvdx, Options const& opts = Options()) const;
+
+    // Query texture information
+    void GetTextureInfo(std::string const& filename, TextureDesc& texdesc) const;
+
+    // Resolve texture name into a handle, only texture header is read here
+    int GetHandle(std::string const& filename) const;
+
+    // Filtered texture lookup by handle
+    float3 Sample(int handle, float2 const& uv, float2 const& duvdx, Options const& opts = Options()) const;
+
+    // Batched lookup by handle
+    void SampleBatch(int handle, float2 const* uv, float2 const* duvdx, float3* out, int n, Options const& opts = Options()) const;
+
+    // Resize tile pool dropping all resident tiles
+    // REQUIRED: no lookups are in flight
+    void SetMemoryBudget(std::size_t bytes);
+
+    // Get residency statistics for each resolved texture
+    void GetStatistics(std::vector<TextureStats>& stats) const;
+
+    // Report tile pool and per texture tile tables
+    void GetMemoryUsage(MemoryReport& report) const;
+
+private:
+    struct Texture;
+    struct Tile;
+
+    // Select MIP level(s) and sample
+    float3 SampleTexture(Texture const& texture, float2 const& uv, float2 const& duvdx, Options const& opts) const;
+    // Sample single MIP level
+    float3 SampleLevel(Texture const& texture, int level, float2 const& uv, Options const& opts) const;
+    // Fetch texel of a MIP level, coordinates should be in range
+    float3 Fetch(Texture const& texture, int level, int x, int y) const;
+    // Fetch texel into texel[0..3], texel[3] is undefined
+    void Fetch(Texture const& texture, int level, int x, int y, float* texel) const;
+    // Fetch texel making its tile resident, takes the locks
+    void FetchSlow(Texture const& texture, int level, int x, int y, float* texel) const;
+    // Fetch texel if its tile is resident, takes the lock
+    bool FetchResident(Texture const& texture, int level, int x, int y, float* texel) const;
+    // Load tile holding a texel into the pool and fetch the texel, called under the texture load lock
+    void LoadTile(Texture const& texture, int level, int x, int y, float* texel) const;
+    // Store h rows of a tile row, tile tx is always stored, others if keepall is set or there is free space
+    // Takes the lock
+    void StoreRow(Texture const& texture, int level, int ty, float const* texels, int h, int tx, bool keepall) const;
+    // Copy w x h RGB texels with given row stride into a free slot and publish it, called under the lock
+    int StoreTile(Texture const& texture, int tileidx, float const* texels, int stride, int w, int h) const;
+    // Free least recently used slots, called under the lock
+    void Evict() const;
+    // Allocate pool of a given size in bytes
+    void AllocatePool(std::size_t bytes);
+    // Full path of a texture file
+    std::string GetPath(std::string const& filename) const;
+
+    // Texture search path
+    std::string searchpath_;
+    // Image loader
+    ImageIo& io_;
+    // Textures indexed by handle, never reallocated
+    mutable std::vector<std::unique_ptr<Texture> > textures_;
+    mutable std::map<std::string, int> handles_;
+    // Tile pool
+    std::unique_ptr<Tile[]> pool_;
+    int numslots_;
+    mutable std::vector<int> freeslots_;
+    // Access clock used for LRU
+    mutable std::atomic<unsigned> clock_;
+    // Guards the tile pool and eviction
+    mutable std::mutex mutex_;
+
+    NativeTextureSystem(NativeTextureSystem const&);
+    NativeTextureSystem& operator = (NativeTextureSystem const&);
+};
+
+#endif // NATIVE_TEXTURESYSTEM_H
@@ -1,5 +1,7 @@
 #include "oiio_texturesystem.h"
 
+#include <vector>
+
 OIIO_NAMESPACE_USING
 
 // Translate TextureSystem options to OIIO
@@ -29,6 +31,7 @@ static TextureOpt::Wrap OiioWrapMode(OiioTextureSystem::Options::WrapMode wrapmo
 
 OiioTextureSystem::OiioTextureSystem(std::string const& searchpath)
     : texturesys_(OIIO_NAMESPACE::TextureSystem::create())
+    , names_(kMaxTextures)
 {
     // Set search path to OIIO
     const char *path = searchpath.c_str();
@@ -40,9 +43,58 @@ OiioTextureSystem::~OiioTextureSystem()
     OIIO_NAMESPACE::TextureSystem::destroy(texturesys_);
 }
 
+int OiioTextureSystem::GetHandle(std::string const& filename) const
+{
+    if (filename.empty())
+    {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto iter = handles_.find(filename);
+
+    if (iter != handles_.end())
+    {
+        return iter->second;
+    }
+
+    int handle = (int)handles_.size();
+
+    if (handle >= kMaxTextures)
+    {
+        throw std::runtime_error("Too many textures");
+    }
+
+    names_[handle] = ustring(filename.c_str());
+    handles_[filename] = handle;
+
+    return handle;
+}
+
+ustring OiioTextureSystem::GetName(int handle) const
+{
+    // Handles are resolved before the lookups, no lock is needed to read the name
+    if (handle < 0 || handle >= kMaxTextures || names_[handle].empty())
+    {
+        throw std::runtime_error("Invalid texture handle");
+    }
+
+    return names_[handle];
+}
+
 float3 OiioTextureSystem::Sample(std::string const& filename, float2 const& uv, float2 const& duvdx, Options const& opts) const
 {
-    ustring name = ustring(filename.c_str());
+    return Sample(ustring(filename.c_str()), uv, duvdx, opts);
+}
+
+float3 OiioTextureSystem::Sample(int handle, float2 const& uv, float2 const& duvdx, Options const& opts) const
+{
+    return Sample(GetName(handle), uv, duvdx, opts);
+}
+
+float3 OiioTextureSystem::Sample(ustring name, float2 const& uv, float2 const& duvdx, Options const& opts) const
+{
     TextureOpt options = TextureOpt();
     
 #ifdef USE_OIIO16
@@ -52,8 +104,8 @@ float3 OiioTextureSystem::Sample(std::string const& filename, float2 const& uv,
 
     float3 result;
 
-    // TODO: add support for dudv/dxdy
-    if (texturesys_->texture(name, options, uv.x, uv.y, 0.f, 0.f, 0.f, 0.f, 3, &result.x))
+    // Isotropic footprint: duvdx holds footprint extent along u and v
+    if (texturesys_->texture(name, options, uv.x, uv.y, duvdx.x, 0.f, 0.f, duvdx.y, 3, &result.x))
     {
         return result;
     }
@@ -69,8 +121,8 @@ float3 OiioTextureSystem::Sample(std::string const& filename, float2 const& uv,
     
     float3 result;
     
-    // TODO: add support for dudv/dxdy
-    if (texturesys_->texture(name, options, uv.x, uv.y, 0.f, 0.f, 0.f, 0.f, &result.x))
+    // Isotropic footprint: duvdx holds footprint extent along u and v
+    if (texturesys_->texture(name, options, uv.x, uv.y, duvdx.x, 0.f, 0.f, duvdx.y, &result.x))
     {
         return result;
     }
@@ -81,6 +133,63 @@ float3 OiioTextureSystem::Sample(std::string const& filename, float2 const& uv,
 #endif
 }
 
+void OiioTextureSystem::SampleBatch(int handle, float2 const* uv, float2 const* duvdx, float3* out, int n, Options const& opts) const
+{
+    if (n <= 0)
+    {
+        return;
+    }
+
+    ustring name = GetName(handle);
+    TextureOpt opt = TextureOpt();
+    opt.swrap = OiioWrapMode(opts.wrapmode);
+    opt.twrap = OiioWrapMode(opts.wrapmode);
+    opt.interpmode = OiioFilter(opts.filter);
+#ifndef USE_OIIO16
+    opt.nchannels = 3;
+#endif
+    TextureOptions options(opt);
+
+    // All points are active
+    std::vector<Runflag> runflags(n, RunFlagOn);
+    std::vector<float> result(3 * n);
+    float zero = 0.f;
+
+    // Strided views into uv and footprint arrays, footprints are uniform zero if not provided
+    float* u = const_cast<float*>(&uv[0].x);
+    float* v = const_cast<float*>(&uv[0].y);
+    VaryingRef<float> dsdx = duvdx ? VaryingRef<float>(const_cast<float*>(&duvdx[0].x), sizeof(float2)) : VaryingRef<float>(zero);
+    VaryingRef<float> dtdy = duvdx ? VaryingRef<float>(const_cast<float*>(&duvdx[0].y), sizeof(float2)) : VaryingRef<float>(zero);
+
+#ifdef USE_OIIO16
+    bool ok = texturesys_->texture(name, options, &runflags[0], 0, n,
+                                   VaryingRef<float>(u, sizeof(float2)), VaryingRef<float>(v, sizeof(float2)),
+                                   dsdx, VaryingRef<float>(zero), VaryingRef<float>(zero), dtdy,
+                                   3, &result[0]);
+#else
+    bool ok = texturesys_->texture(name, options, &runflags[0], 0, n,
+                                   VaryingRef<float>(u, sizeof(float2)), VaryingRef<float>(v, sizeof(float2)),
+                                   dsdx, VaryingRef<float>(zero), VaryingRef<float>(zero), dtdy,
+                                   &result[0]);
+#endif
+
+    if (!ok)
+    {
+        throw std::runtime_error("Texture fetch failed");
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        out[i] = float3(result[3 * i], result[3 * i + 1], result[3 * i + 2]);
+    }
+}
+
+void OiioTextureSystem::SetMemoryBudget(std::size_t bytes)
+{
+    float megabytes = (float)bytes / (1024 * 1024);
+    texturesys_->attribute("max_memory_MB", megabytes);
+}
+
 // Query texture information
 void OiioTextureSystem::GetTextureInfo(std::string const& filename, TextureDesc& texdesc) const
 {
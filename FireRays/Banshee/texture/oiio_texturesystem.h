@@ -1,6 +1,10 @@
 #ifndef OIIO_TEXTURESYSTEM_H
 #define OIIO_TEXTURESYSTEM_H
 
+#include <map>
+#include <vector>
+#include <mutex>
+
 #include "texturesystem.h"
 
 #ifndef __linux__
@@ -12,10 +16,15 @@
 #endif
 
 ///< Texture system based on OpenImageIO library
+///< Handles map to OIIO names resolved once in GetHandle,
+///< lookups by handle do not take any locks.
 ///<
 class OiioTextureSystem : public TextureSystem
 {
 public:
+    // Maximum number of textures
+    static int const kMaxTextures = 4096;
+
     // Specify a search path for the textures
     OiioTextureSystem(std::string const& searchpath);
 
@@ -29,8 +38,30 @@ public:
     // Query texture information
     void GetTextureInfo(std::string const& filename, TextureDesc& texdesc) const;
 
+    // Resolve texture name into a handle
+    int GetHandle(std::string const& filename) const;
+
+    // Filtered texture lookup by handle
+    float3 Sample(int handle, float2 const& uv, float2 const& duvdx, Options const& opts = Options()) const;
+
+    // Batched lookup using OIIO multi-point texture call
+    void SampleBatch(int handle, float2 const* uv, float2 const* duvdx, float3* out, int n, Options const& opts = Options()) const;
+
+    // Limit OIIO tile cache size
+    void SetMemoryBudget(std::size_t bytes);
+
 private:
+    // Lookup by OIIO name
+    float3 Sample(OIIO_NAMESPACE::ustring name, float2 const& uv, float2 const& duvdx, Options const& opts) const;
+    // OIIO name of a resolved texture, throws for invalid handles
+    OIIO_NAMESPACE::ustring GetName(int handle) const;
+
     OIIO_NAMESPACE::TextureSystem* texturesys_;
+    // Names indexed by handle, never reallocated
+    mutable std::vector<OIIO_NAMESPACE::ustring> names_;
+    mutable std::map<std::string, int> handles_;
+    // Guards handle resolution
+    mutable std::mutex mutex_;
 };
 
 #endif //TEXTURESYSTEM_H
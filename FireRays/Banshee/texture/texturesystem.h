@@ -2,10 +2,15 @@
 #define TEXTURESYSTEM_H
 
 #include <string>
+#include <vector>
+#include <mutex>
+#include <stdexcept>
 
 #include "../math/float2.h"
 #include "../math/float3.h"
 
+class MemoryReport;
+
 ///< This class defines an interface for all entities
 ///< that require texture lookups in the system.
 ///<
@@ -46,6 +51,23 @@ public:
         int height;
     };
 
+    struct TextureStats
+    {
+        // Texture name
+        std::string name;
+        // Texture resolution
+        int width;
+        int height;
+        // Number of tiles in MIP pyramid and number of resident ones
+        int numtiles;
+        int residenttiles;
+        // Memory taken by resident tiles
+        std::size_t residentbytes;
+        // Number of tile loads and evictions so far
+        int loads;
+        int evictions;
+    };
+
     TextureSystem(){}
     // Destructor
     virtual ~TextureSystem(){}
@@ -58,11 +80,89 @@ public:
     // Query texture information
     virtual void GetTextureInfo(std::string const& filename, TextureDesc& texdesc) const = 0;
 
+    // Resolve texture name into an integer handle once (e.g. at material creation)
+    // Empty name resolves to -1 which means "no texture"
+    virtual int GetHandle(std::string const& filename) const;
+
+    // Filtered texture lookup by handle
+    // Default implementation forwards to lookup by name
+    virtual float3 Sample(int handle, float2 const& uv, float2 const& duvdx, Options const& opts = Options()) const;
+
+    // Filtered lookup of n points of the same texture, duvdx may be nullptr meaning zero footprints
+    // Default implementation calls Sample for each point
+    virtual void SampleBatch(int handle, float2 const* uv, float2 const* duvdx, float3* out, int n, Options const& opts = Options()) const;
+
+    // Limit memory used for texel data, should be called before rendering
+    // Default implementation ignores the budget
+    virtual void SetMemoryBudget(std::size_t bytes) {}
+
+    // Get residency statistics for each resolved texture
+    // Default implementation provides none
+    virtual void GetStatistics(std::vector<TextureStats>& stats) const { stats.clear(); }
+
+    // Report memory held for texel data
+    // Default implementation reports nothing
+    virtual void GetMemoryUsage(MemoryReport& report) const {}
+
 protected:
+    // Name of a texture resolved by GetHandle
+    std::string GetName(int handle) const;
+
     TextureSystem(TextureSystem const&);
     TextureSystem& operator =(TextureSystem const&);
+
+private:
+    // Names of resolved textures indexed by handle
+    mutable std::vector<std::string> names_;
+    mutable std::mutex namesmutex_;
 };
 
+inline int TextureSystem::GetHandle(std::string const& filename) const
+{
+    if (filename.empty())
+    {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(namesmutex_);
+
+    for (int i = 0; i < (int)names_.size(); ++i)
+    {
+        if (names_[i] == filename)
+        {
+            return i;
+        }
+    }
+
+    names_.push_back(filename);
+    return (int)names_.size() - 1;
+}
+
+inline std::string TextureSystem::GetName(int handle) const
+{
+    std::lock_guard<std::mutex> lock(namesmutex_);
+
+    if (handle < 0 || handle >= (int)names_.size())
+    {
+        throw std::runtime_error("Invalid texture handle");
+    }
+
+    return names_[handle];
+}
+
+inline float3 TextureSystem::Sample(int handle, float2 const& uv, float2 const& duvdx, Options const& opts) const
+{
+    return Sample(GetName(handle), uv, duvdx, opts);
+}
+
+inline void TextureSystem::SampleBatch(int handle, float2 const* uv, float2 const* duvdx, float3* out, int n, Options const& opts) const
+{
+    for (int i = 0; i < n; ++i)
+    {
+        out[i] = Sample(handle, uv[i], duvdx ? duvdx[i] : float2(0,0), opts);
+    }
+}
+
 
 
 #endif //TEXTURESYSTEM_H
\ No newline at end of file
@@ -2,11 +2,14 @@
 
 #include "../world/world.h"
 #include "../sampler/sampler.h"
+#include "../sampler/sample_cursor.h"
+#include "../util/arena.h"
 #include "../math/mathutils.h"
+#include "../util/renderstats.h"
 
 #include <algorithm>
 
-float3 AoTracer::GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler) const
+float3 AoTracer::GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler, SampleCursor& cursor, Arena& arena, AovSample& aovs) const
 {
     ShapeBundle::Hit hit;
     // We need to return visibility here, white corresponds to unoccluded black to fully ocluded
@@ -17,11 +20,15 @@ float3 AoTracer::GetLi(ray const& r, World const& world, Sampler const& lightsam
         // Number of times we need to sample occlusion
         int numsamples = lightsampler.num_samples();
         
+        // Generate samples
+        float2* samples = arena.Allocate<float2>(numsamples);
+        cursor.Next2D(lightsampler, numsamples, samples);
+        
         float3 occlusion = float3();
         for (int i=0; i<numsamples; ++i)
         {
             // Get the sample
-            float2 sample = lightsampler.Sample2D();
+            float2 sample = samples[i];
 
             ray r;
             // Map to hemisphere with empirically choosen cosine factor
@@ -31,6 +38,7 @@ float3 AoTracer::GetLi(ray const& r, World const& world, Sampler const& lightsam
             r.t = float2(0.00002f, radius_);
 
             // Check an intersection
+            STATS_ADD(kShadowRays, 1);
             if (world.Intersect(r))
             {
                 occlusion += float3(1.f, 1.f, 1.f);
@@ -38,6 +38,7 @@
 #include "../primitive/shapebundle.h"
 
 class Sampler;
+class SampleCursor;
 
 ///< AoTracer is an implementation of a Tracer interface
 ///< capable of estimating ambient occlusion of a given radius
@@ -52,7 +53,7 @@ public:
     }
 
     // Estimate a radiance coming from r
-    float3 GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler) const;
+    float3 GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler, SampleCursor& cursor, Arena& arena, AovSample& aovs) const;
 
 private:
     // Occlusion radius
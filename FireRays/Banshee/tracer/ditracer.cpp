@@ -3,9 +3,14 @@
 #include "../math/mathutils.h"
 #include "../world/world.h"
 #include "../light/light.h"
+#include "../light/light_set.h"
 #include "../material/material.h"
 #include "../sampler/sampler.h"
+#include "../sampler/sample_cursor.h"
 #include "../bsdf/bsdf.h"
+#include "../util/arena.h"
+#include "../aov/aov.h"
+#include "../util/renderstats.h"
 
 #include <algorithm>
 #include <functional>
@@ -16,13 +21,15 @@
 
 #define MINPDF 0.05f
 
-float3 DiTracer::GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler) const
+float3 DiTracer::GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler, SampleCursor& cursor, Arena& arena, AovSample& aovs) const
 {
     ShapeBundle::Hit hit;
     float3 radiance;
 
     if (world.Intersect(r, hit))
     {
+        STATS_ADD(kPathVertices, 1);
+
         // If we hit emissive object just return its emission characteristic
         Material const& mat = *world.materials_[hit.m];
 
@@ -32,29 +39,40 @@ float3 DiTracer::GetLi(ray const& r, World const& world, Sampler const& lightsam
         }
         else
         {
-            for (int i = 0; i < (int)world.lights_.size(); ++i)
+            // Pick the light in proportion to its contribution
+            float selectionpdf = 0.f;
+            int idx = world.SampleLight(hit, cursor.Next1D(lightsampler), selectionpdf);
+
+            // Resolve material inputs once for all light and BSDF samples
+            ShadingContext ctx;
+            mat.Prepare(hit, ctx);
+
+            AddHitAovs(mat, ctx, -r.d, aovs);
+
+            if (idx >= 0)
             {
-                // TODO: Pass RNG or sampler
-                //int numlights = world.lights_.size();
-                //int idx = rand_uint() % numlights;
-                radiance += GetDi(world, *world.lights_[i], lightsampler, brdfsampler, -r.d, hit);
+                radiance += GetDi(world, idx, lightsampler, brdfsampler, -r.d, ctx, cursor, arena) * (1.f / selectionpdf);
+
+                aovs.Add(AovSample::kDirect, radiance);
+                aovs.Add(AovSample::kLight0 + idx, radiance);
             }
         }
     }
     else
     {
-        radiance = world.bgcolor_;
+        // Only environment lights are visited here
+        radiance = world.bgcolor_ + world.GetLe(r);
 
-        for (int i = 0; i < (int)world.lights_.size(); ++i)
-        {
-            radiance += world.lights_[i]->GetLe(r);
-        }
+        aovs.Add(AovSample::kBackground, radiance);
     }
 
     return radiance;
 }
 
-float3 DiTracer::GetDi(World const& world, Light const& light, Sampler const& lightsampler, Sampler const& bsdfsampler, float3 const& wo, ShapeBundle::Hit& hit) const
+// Both strategies below are conditioned on the light being already picked (BSDF samples only
+// account for hits of this very light), so light selection probability cancels out in MIS weights
+// and the caller only needs to divide the result by it.
+float3 DiTracer::GetDi(World const& world, int lightidx, Sampler const& lightsampler, Sampler const& bsdfsampler, float3 const& wo, ShadingContext const& ctx, SampleCursor& cursor, Arena& arena) const
 {
     float3 radiance;
     // TODO: fix that later with correct heuristic
@@ -70,22 +88,25 @@ float3 DiTracer::GetDi(World const& world, Light const& light, Sampler const& li
         float lightpdf = 0.f;
         // Sample numsamples times
         int numsamples = lightsampler.num_samples();
-        // Allocate samples
-        std::vector<float2> lightsamples(numsamples);
-        std::vector<float2> bsdfsamples(numsamples);
+        // Allocate samples from the thread scratch memory
+        float2* lightsamples = arena.Allocate<float2>(numsamples);
+        float2* bsdfsamples = arena.Allocate<float2>(numsamples);
 
-        // Generate samples
-        for (int i = 0; i < numsamples; ++i)
-        {
-            lightsamples[i] = lightsampler.Sample2D();
-            bsdfsamples[i] = bsdfsampler.Sample2D();
-        }
+        // Generate samples, each strategy takes its own dimensions
+        cursor.Next2D(lightsampler, numsamples, lightsamples);
+        cursor.Next2D(bsdfsampler, numsamples, bsdfsamples);
         
-        // Cache singularity flag to avoid virtual call in the loop below
-        bool singularlight = light.Singular();
+        // Lights partitioned by type, point and directional ones are sampled without virtual calls
+        LightSet const& lights = world.GetLightSet();
+
+        // Cache singularity flag for the loop below
+        bool singularlight = lights.Singular(lightidx);
+
+        // Area light is identified by the light pointer when hit by BSDF sampled rays
+        Light const* light = world.lights_[lightidx].get();
         
         // Fetch the material
-        Material const& mat = *world.materials_[hit.m];
+        Material const& mat = *world.materials_[ctx.m];
 
         // Start sampling
         for (int i=0; i<numsamples; ++i)
@@ -93,11 +114,8 @@ float3 DiTracer::GetDi(World const& world, Light const& light, Sampler const& li
             lightpdf = 0.f;
             bsdfpdf = 0.f;
             
-            // This is needed to support normal mapping.
-            // Original intersection needs to be kept around since bsdf might alter the normal
-            ShapeBundle::Hit hitlocal = hit;
             // Sample light source
-            float3 le = light.GetSample(hitlocal, lightsamples[i], lightdir, lightpdf);
+            float3 le = lights.GetSample(lightidx, ctx, lightsamples[i], lightdir, lightpdf);
             
             // Continue if intensity > 0 and there is non-zero probability of sampling the point
             if (lightpdf > MINPDF && le.sqnorm() > 0.f)
@@ -110,7 +128,7 @@ float3 DiTracer::GetDi(World const& world, Light const& light, Sampler const& li
                 // Spawn shadow ray
                 ray shadowray;
                 // From an intersection point
-                shadowray.o = hitlocal.p;
+                shadowray.o = ctx.p;
                 // Into evaluated direction
                 shadowray.d = wi;
                 
@@ -118,29 +136,30 @@ float3 DiTracer::GetDi(World const& world, Light const& light, Sampler const& li
                 shadowray.t = float2(0.01f, dist - 0.01f);
                 
                 // Check for an occlusion
+                STATS_ADD(kShadowRays, 1);
                 float shadow = world.Intersect(shadowray) ? 0.f : 1.f;
                 
                 // If we are not in shadow
                 if (shadow > 0.f)
                 {
                     // Evaluate BSDF
-                    float3 bsdf = mat.Evaluate(hitlocal, wi, wo);
+                    float3 bsdf = mat.Evaluate(ctx, wi, wo);
                     
                     // We can't apply MIS for singular lights, so use simple estimator
                     if (singularlight)
                     {
                         // Estimate with Monte-Carlo L(wo) = int{ Ld(wi, wo) * fabs(dot(n, wi)) * dwi }
-                        radiance +=  le * bsdf * fabs(dot(hitlocal.n, wi)) * (1.f / lightpdf);
+                        radiance +=  le * bsdf * fabs(dot(ctx.n, wi)) * (1.f / lightpdf);
                         assert(!has_nans(radiance));
                     }
                     else
                     {
                         // Apply MIS
-                        bsdfpdf = mat.GetPdf(hitlocal, wi, wo);
+                        bsdfpdf = mat.GetPdf(ctx, wi, wo);
                         // Evaluate weight
                         float weight = PowerHeuristic(1, lightpdf, 1, bsdfpdf);
                         // Estimate with Monte-Carlo L(wo) = int{ Ld(wi, wo) * fabs(dot(n, wi)) * dwi }
-                        radiance +=  le * bsdf * fabs(dot(hitlocal.n, wi)) * weight * (1.f / lightpdf);
+                        radiance +=  le * bsdf * fabs(dot(ctx.n, wi)) * weight * (1.f / lightpdf);
                         assert(!has_nans(radiance));
                     }
                 }
@@ -153,7 +172,7 @@ float3 DiTracer::GetDi(World const& world, Light const& light, Sampler const& li
                 float3 wi;
 
                 // Sample material
-                float3 bsdf = mat.Sample(hitlocal, bsdfsamples[i], wo, wi, bsdfpdf, bsdftype);
+                float3 bsdf = mat.Sample(ctx, bsdfsamples[i], wo, wi, bsdfpdf, bsdftype);
                 //assert(!has_nans(bsdf));
                 //assert(!has_nans(bsdfpdf < 1000000.f));
 
@@ -163,28 +182,10 @@ float3 DiTracer::GetDi(World const& world, Light const& light, Sampler const& li
                 // If something would be reflected
                 if (bsdf.sqnorm() > 0.f && bsdfpdf > MINPDF)
                 {
-                    float weight = 1.f;
-                
-                    // Apply MIS if BSDF is not specular
-                    if (! (bsdftype & Bsdf::SPECULAR))
-                    {
-                        // Evaluate light PDF
-                        lightpdf = light.GetPdf(hitlocal, wi);
-
-                        // If light PDF is zero skip to next sample
-                        if (lightpdf < MINPDF)
-                        {
-                            continue;
-                        }
-                        
-                        // Apply heuristic
-                        weight = PowerHeuristic(1, bsdfpdf, 1, lightpdf);
-                    }
-
                     // Spawn shadow ray
                     ray shadowray;
                     // From an intersection point
-                    shadowray.o = hitlocal.p;
+                    shadowray.o = ctx.p;
                     // Into evaluated direction
                     shadowray.d = wi;
 
@@ -194,40 +195,57 @@ float3 DiTracer::GetDi(World const& world, Light const& light, Sampler const& li
                     // Cast the ray into the scene
                     ShapeBundle::Hit shadowhit;
                     float3 le(0.f, 0.f, 0.f);
+                    lightpdf = 0.f;
                     // If the ray intersects the scene check if we have intersected this light
-                    // TODO: move that to area light class
+                    STATS_ADD(kShadowRays, 1);
                     if (world.Intersect(shadowray, shadowhit))
                     {
                         // Only sample if this is our light
-                        if ((Light const*)shadowhit.bundle->GetAreaLight() == &light)
+                        if (shadowhit.bundle->GetAreaLight() == light)
                         {
-                            Material const& lightmat = *world.materials_[shadowhit.m];
-                            // Get material emission properties
-                            ShapeBundle::Sample sampledata(shadowhit);
-
-                            float3 d = sampledata.p - hitlocal.p;
+                            float cosl = dot(shadowhit.n, -wi);
 
                             // If the object facing the light compute emission
-                            if (dot(sampledata.n, -wi) > 0.f)
+                            if (cosl > 0.f)
                             {
-                                // Emissive power with squared fallof
-                                float d2inv = 1.f / d.sqnorm();
+                                Material const& lightmat = *world.materials_[shadowhit.m];
+                                // Get material emission properties
+                                ShapeBundle::Sample sampledata(shadowhit);
+
+                                // Emission characteristic of the material has cosine term in it, so convert it to radiance
+                                le = lightmat.GetLe(sampledata, -wi) * (1.f / cosl);
 
-                                // Return emission characteristic of the material
-                                le = lightmat.GetLe(sampledata, -wi) * d2inv;
+                                // The point on the light is known, so the light doesn't need to look for it again
+                                lightpdf = lights.GetSurfacePdf(lightidx, ctx, shadowhit);
                             }
                         }
                     }
                     else
                     {
                         // This is to give a chance for IBL to contribute
-                        le = light.GetLe(shadowray);
+                        le = lights.GetLe(lightidx, shadowray);
+                        lightpdf = lights.GetPdf(lightidx, ctx, wi);
                     }
                     
                     if (le.sqnorm() > 0.f)
                     {
+                        float weight = 1.f;
+
+                        // Apply MIS if BSDF is not specular
+                        if (! (bsdftype & Bsdf::SPECULAR))
+                        {
+                            // If light PDF is zero skip to next sample
+                            if (lightpdf < MINPDF)
+                            {
+                                continue;
+                            }
+
+                            // Apply heuristic
+                            weight = PowerHeuristic(1, bsdfpdf, 1, lightpdf);
+                        }
+
                         // Estimate with Monte-Carlo L(wo) = int{ Ld(wi, wo) * fabs(dot(n, wi)) * dwi }
-                        radiance +=  le * bsdf * fabs(dot(hitlocal.n, wi)) * weight * (1.f / bsdfpdf);
+                        radiance +=  le * bsdf * fabs(dot(ctx.n, wi)) * weight * (1.f / bsdfpdf);
                         //assert(!has_nans(radiance));
                     }
                 }
@@ -36,9 +36,10 @@
 
 #include "tracer.h"
 #include "../primitive/shapebundle.h"
+#include "../bsdf/shading_context.h"
 
-class Light;
 class Sampler;
+class SampleCursor;
 
 ///< DiTracer is an implementation of a Tracer interface capable of estimating only direct illumination from surfaces. This implementation uses
 ///< multiple-importance sampling to reduce variance: https://graphics.stanford.edu/courses/cs348b-03/papers/veach-chapter9.pdf
@@ -50,11 +51,12 @@ public:
     DiTracer(){}
 
     // Estimate a radiance coming from r due to direct illumination
-    float3 GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler) const;
+    float3 GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler, SampleCursor& cursor, Arena& arena, AovSample& aovs) const;
 
 protected:
-    // Estimate direct illimination component due to light contribution reflected along wo
-    virtual float3 GetDi(World const& world, Light const& light, Sampler const& lightsampler, Sampler const& bsdfsampler, float3 const& wo, ShapeBundle::Hit& hit) const;
+    // Estimate direct illimination component due to light lightidx contribution reflected along wo
+    // REQUIRED: ctx prepared by the material of the hit
+    virtual float3 GetDi(World const& world, int lightidx, Sampler const& lightsampler, Sampler const& bsdfsampler, float3 const& wo, ShadingContext const& ctx, SampleCursor& cursor, Arena& arena) const;
 };
 
 #endif // DITRACER_H
\ No newline at end of file
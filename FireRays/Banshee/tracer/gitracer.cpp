@@ -1,16 +1,25 @@
 #include "gitracer.h"
 
 #include <cassert>
+#include <algorithm>
 
 #include "../world/world.h"
 #include "../sampler/sampler.h"
+#include "../sampler/sample_cursor.h"
 #include "../bsdf/bsdf.h"
 #include "../math/mathutils.h"
+#include "../aov/aov.h"
+#include "../util/renderstats.h"
 
 #define MINPDF 0.05f
 #define MAXRADIANCE 4.f
+// Cone spread angle after diffuse or glossy bounce
+#define ROUGHSPREAD 0.1f
+// Sampler dimensions taken by a path vertex: light selection, DI light and BSDF samples,
+// BSDF sample and Russian roulette
+#define VERTEXDIMS 8
 
-float3 GiTracer::GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler) const
+float3 GiTracer::GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler, SampleCursor& cursor, Arena& arena, AovSample& aovs) const
 {
     // Accumulated radiance
     float3 radiance = float3();
@@ -21,24 +30,20 @@ float3 GiTracer::GetLi(ray const& r, World const& world, Sampler const& lightsam
     // Check primary ray
     if (!world.Intersect(r, hitprimary))
     {
-        radiance += world.bgcolor_;
+        // Only environment lights are visited here
+        radiance += world.bgcolor_ + world.GetLe(r);
         
-        for (int i = 0; i < (int)world.lights_.size(); ++i)
-        {
-            radiance += world.lights_[i]->GetLe(r);
-        }
+        aovs.Add(AovSample::kBackground, radiance);
         
         // Bail out as the ray missed geometry
         return radiance;
     }
     
-    // Allocate BRDF samples
+    // Number of paths to trace
     int numsamples = brdfsampler.num_samples();
-    std::vector<float2> samples(numsamples);
-    for (int s=0; s<numsamples; ++s)
-    {
-        samples[s] = brdfsampler.Sample2D();
-    }
+    
+    // Output variables get the average over the paths
+    float pathweight = 1.f / numsamples;
     
     // Start calculating indrect paths
     for (int s=0;s<numsamples;++s)
@@ -49,43 +54,70 @@ float3 GiTracer::GetLi(ray const& r, World const& world, Sampler const& lightsam
         // hit
         ShapeBundle::Hit hit = hitprimary;
         
+        // Shading context of the current path vertex
+        ShadingContext ctx;
+        
+        // Paths are sub-samples of the pixel sample
+        SampleCursor pathcursor = cursor.Branch(s, numsamples);
+        int startdim = pathcursor.dimension();
+        
         // Path throughput
         float3 throughput = float3(1.f, 1.f, 1.f);
         
         // Start calculating bounces
         for (int bounce=0; bounce<maxdepth_; ++bounce)
         {
+            STATS_ADD(kPathVertices, 1);
+
             Material const& mat = *world.materials_[hit.m];
             
             // If we hit emissive object as a first bounce add its contribution
             if (bounce == 0 && mat.IsEmissive())
             {
                 ShapeBundle::Sample sampledata(hit);
-                radiance += mat.GetLe(sampledata, -rr.d);
+                float3 le = mat.GetLe(sampledata, -rr.d);
+                radiance += le;
+                
+                aovs.Add(AovSample::kEmission, le * pathweight);
                 
                 // TODO: implement mixed emissive-bsdf materials
                 break;
             }
             
-            // Evaluate DI component
-            //
-            if (bounce != 0)
+            // Resolve material inputs once for both DI and path continuation
+            mat.Prepare(hit, ctx);
+            
+            // Primary hit variables are taken once
+            if (bounce == 0 && s == 0)
             {
-                int numlights = (int)world.lights_.size();
-                int idx = rand_uint() % numlights;
-                radiance += throughput * GetDi(world, *world.lights_[idx], lightsampler, brdfsampler, -rr.d, hit) * (float)numlights;
+                AddHitAovs(mat, ctx, -rr.d, aovs);
             }
-            else
+            
+            // Every vertex takes the same dimensions regardless of decisions made at previous ones
+            pathcursor.SetDimension(startdim + bounce * VERTEXDIMS);
+            
+            // Evaluate DI component
+            //
+            // Pick the light in proportion to its contribution
+            float selectionpdf = 0.f;
+            int idx = world.SampleLight(hit, pathcursor.Next1D(lightsampler), selectionpdf);
+
+            // DI dimensions are skipped if there is no light to sample
+            SampleCursor dicursor = pathcursor;
+            pathcursor.SetDimension(pathcursor.dimension() + 4);
+
+            if (idx >= 0)
             {
-                for (int i = 0; i < (int)world.lights_.size(); ++i)
-                {
-                    radiance += throughput * GetDi(world, *world.lights_[i], lightsampler, brdfsampler, -rr.d, hit);
-                }
+                float3 di = throughput * GetDi(world, idx, lightsampler, brdfsampler, -rr.d, ctx, dicursor, arena) * (1.f / selectionpdf);
+                radiance += di;
+                
+                aovs.Add(bounce == 0 ? AovSample::kDirect : AovSample::kIndirect, di * pathweight);
+                aovs.Add(AovSample::kLight0 + idx, di * pathweight);
             }
             
             
             // Sample BSDF to continue path
-            float2 bsdfsample = samples[s];
+            float2 bsdfsample = pathcursor.Next2D(brdfsampler);
             // BSDF type
             int bsdftype = 0;
             // BSDF PDF
@@ -94,7 +126,7 @@ float3 GiTracer::GetLi(ray const& r, World const& world, Sampler const& lightsam
             float3 wi;
             
             // Sample material
-            float3 bsdf = mat.Sample(hit, bsdfsample, -rr.d, wi, bsdfpdf, bsdftype);
+            float3 bsdf = mat.Sample(ctx, bsdfsample, -rr.d, wi, bsdfpdf, bsdftype);
             
             // Bail out if zero BSDF sampled
             if (bsdf.sqnorm() == 0.f || bsdfpdf < MINPDF)
@@ -102,22 +134,27 @@ float3 GiTracer::GetLi(ray const& r, World const& world, Sampler const& lightsam
                 break;
             }
             
+            // Propagate ray cone: footprint grows along the traveled segment,
+            // specular bounces keep the spread while rough ones widen it
+            rr.width += rr.spread * hit.t;
+            rr.spread = (bsdftype & Bsdf::SPECULAR) ? rr.spread : std::max(rr.spread, ROUGHSPREAD);
+            
             // Construct ray
-            rr.o = hit.p;
+            rr.o = ctx.p;
             rr.d = normalize(wi);
             rr.t = float2(0.01f, 1000000.f);
             
             // Update througput
-            throughput *= (bsdf * (fabs(dot(hit.n, wi)) / bsdfpdf));
+            throughput *= (bsdf * (fabs(dot(ctx.n, wi)) / bsdfpdf));
             
             //assert(!has_nans(throughput));
             
+            // Russian roulette dimension is taken at every vertex to keep them aligned
+            float rnd = pathcursor.Next1D(brdfsampler);
+            
             // Apply Russian roulette
-            // TODO: pass RNG inside not to have this ugly dep
             if (bounce > 3)
             {
-                float rnd = rand_float();
-                
                 float luminance = 0.2126f * throughput.x + 0.7152f * throughput.y + 0.0722f * throughput.z;
                 
                 float q = std::min(0.5f, luminance);
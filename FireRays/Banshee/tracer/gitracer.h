@@ -50,7 +50,7 @@ public:
     {}
 
     // Estimate a radiance coming from r
-    float3 GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler) const;
+    float3 GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler, SampleCursor& cursor, Arena& arena, AovSample& aovs) const;
 
 private:
     // Max depth to trace the ray to
@@ -36,7 +36,7 @@ float3 ShTracer::GetE(float3 const& n) const
 }
 
 
-float3 ShTracer::GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler) const
+float3 ShTracer::GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler, SampleCursor& cursor, Arena& arena, AovSample& aovs) const
 {
     ShapeBundle::Hit hit;
     float3 radiance;
@@ -47,12 +47,8 @@ float3 ShTracer::GetLi(ray const& r, World const& world, Sampler const& lightsam
     }
     else
     {
-        radiance = world.bgcolor_;
-        
-        for (int i = 0; i < (int)world.lights_.size(); ++i)
-        {
-            radiance += world.lights_[i]->GetLe(r);
-        }
+        // Only environment lights are visited here
+        radiance = world.bgcolor_ + world.GetLe(r);
     }
     
     return radiance;
@@ -39,6 +39,7 @@
 
 class Light;
 class Sampler;
+class SampleCursor;
 
 ///< ShTracer is an implementation of a Tracer interface to quickly visualize
 ///< spherical harmonic lighting
@@ -50,7 +51,7 @@ public:
     ShTracer(int lmax, float3* const shcoeffs);
     
     // Estimate a radiance coming from r due to direct illumination
-    float3 GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler) const;
+    float3 GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler, SampleCursor& cursor, Arena& arena, AovSample& aovs) const;
     
 private:
     float3 GetE(float3 const& n) const;
@@ -38,8 +38,7 @@
 
 #include "tracer.h"
 #include "../primitive/shapebundle.h"
-
-class TextureSystem;
+#include "../texture/texturesystem.h"
 
 ///< TextureTracer is a debug implementation of a Tracer
 ///< supposed to be used in various sampler tests
@@ -50,18 +49,18 @@ public:
     TextureTracer(TextureSystem const& texsys, std::string const& texture);
     
     // Estimate a radiance coming from r due to direct illumination
-    float3 GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler) const;
+    float3 GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler, SampleCursor& cursor, Arena& arena, AovSample& aovs) const;
     
 private:
     //
     TextureSystem const& texsys_;
-    // Texture name
-    std::string texture_;
+    // Texture handle
+    int texture_;
 };
 
 inline TextureTracer::TextureTracer(TextureSystem const& texsys, std::string const& texture)
 : texsys_(texsys)
-, texture_(texture)
+, texture_(texsys.GetHandle(texture))
 {
 }
 
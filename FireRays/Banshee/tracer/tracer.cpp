@@ -0,0 +1,19 @@
+#include "tracer.h"
+
+#include "../material/material.h"
+#include "../aov/aov.h"
+
+void Tracer::AddHitAovs(Material const& mat, ShadingContext const& ctx, float3 const& wi, AovSample& aovs)
+{
+    // Albedo evaluation is not free, so it is skipped if not needed
+    if (!aovs.mask())
+        return;
+
+    aovs.Add(AovSample::kDepth, float3(ctx.t, ctx.t, ctx.t));
+    aovs.Add(AovSample::kNormal, ctx.n);
+
+    if (aovs.IsEnabled(AovSample::kAlbedo))
+    {
+        aovs.Add(AovSample::kAlbedo, mat.GetAlbedo(ctx, wi));
+    }
+}
@@ -36,6 +36,11 @@
 
 class World;
 class Sampler;
+class SampleCursor;
+class Arena;
+class AovSample;
+class Material;
+class ShadingContext;
 
 #include "../math/ray.h"
 
@@ -50,9 +55,17 @@ public:
 
     // Estimate a radiance coming from r
     // countemissives is a workaround before IS is implemented
-    virtual float3 GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler) const = 0;
+    // cursor addresses dimensions of the samplers for the current pixel sample
+    // arena provides transient memory, it is owned by the calling thread
+    // and reset by the renderer once the pixel is done
+    // aovs receives the output variables the tracer is able to provide, the rest stay zero
+    virtual float3 GetLi(ray const& r, World const& world, Sampler const& lightsampler, Sampler const& brdfsampler, SampleCursor& cursor, Arena& arena, AovSample& aovs) const = 0;
 
 protected:
+    // Write depth, normal and albedo of the primary hit seen from wi
+    // REQUIRED: ctx prepared by the material of the hit
+    static void AddHitAovs(Material const& mat, ShadingContext const& ctx, float3 const& wi, AovSample& aovs);
+
     Tracer(Tracer const&);
     Tracer& operator = (Tracer const&);
 };
@@ -0,0 +1,67 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <new>
+
+Arena::Arena(std::size_t blocksize)
+    : current_(0)
+    , offset_(0)
+    , blocksize_(blocksize)
+{
+}
+
+Arena::~Arena()
+{
+    for (std::size_t i = 0; i < blocks_.size(); ++i)
+    {
+        ::operator delete(blocks_[i].data);
+    }
+}
+
+void* Arena::AllocateBytes(std::size_t size, std::size_t alignment)
+{
+    // Try the current block and the ones left from previous pixels
+    for (; current_ < blocks_.size(); ++current_, offset_ = 0)
+    {
+        Block const& block = blocks_[current_];
+
+        std::size_t base = reinterpret_cast<std::size_t>(block.data);
+        std::size_t start = (base + offset_ + alignment - 1) & ~(alignment - 1);
+
+        if (start + size <= base + block.size)
+        {
+            offset_ = start + size - base;
+            return block.data + (start - base);
+        }
+    }
+
+    // None of them fits, so grow. operator new returns memory
+    // aligned for any fundamental type, so the block start is fine.
+    Block block;
+    block.size = std::max(blocksize_, size);
+    block.data = static_cast<char*>(::operator new(block.size));
+    blocks_.push_back(block);
+
+    current_ = blocks_.size() - 1;
+    offset_ = size;
+
+    return block.data;
+}
+
+void Arena::Reset()
+{
+    current_ = 0;
+    offset_ = 0;
+}
+
+std::size_t Arena::GetCapacity() const
+{
+    std::size_t size = 0;
+
+    for (std::size_t i = 0; i < blocks_.size(); ++i)
+    {
+        size += blocks_[i].size;
+    }
+
+    return size;
+}
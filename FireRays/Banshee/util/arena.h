@@ -0,0 +1,104 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <type_traits>
+
+///< Arena is a bump allocator for transient integrator data.
+///< Memory is never released individually: the whole arena
+///< is reset at once (renderers do it per pixel) and its blocks
+///< are reused, so once the arena has grown to the working size
+///< no heap calls happen on the hot path. Arenas are not thread safe,
+///< each rendering thread owns its own one.
+///< Only trivially destructible types might be allocated.
+///<
+class Arena
+{
+public:
+    // blocksize is the granularity of the heap allocations
+    Arena(std::size_t blocksize = 16384);
+    // Destructor
+    ~Arena();
+
+    // Allocate count default initialized objects of type T
+    template <typename T> T* Allocate(std::size_t count);
+
+    // Release all the allocations at once, blocks are kept
+    void Reset();
+
+    // Total amount of memory owned by the arena
+    std::size_t GetCapacity() const;
+
+private:
+    // Allocate size bytes with a given alignment
+    void* AllocateBytes(std::size_t size, std::size_t alignment);
+
+    struct Block
+    {
+        char* data;
+        std::size_t size;
+    };
+
+    // Heap blocks
+    std::vector<Block> blocks_;
+    // Current block index
+    std::size_t current_;
+    // Offset within current block
+    std::size_t offset_;
+    // Default block size
+    std::size_t blocksize_;
+
+    Arena(Arena const&);
+    Arena& operator = (Arena const&);
+};
+
+template <typename T> inline T* Arena::Allocate(std::size_t count)
+{
+    static_assert(std::is_trivially_destructible<T>::value, "Arena doesn't call destructors");
+
+    T* ptr = static_cast<T*>(AllocateBytes(sizeof(T) * count, std::alignment_of<T>::value));
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        new (ptr + i) T();
+    }
+
+    return ptr;
+}
+
+#endif // ARENA_H
@@ -0,0 +1,104 @@
+#include "mappedfile.h"
+
+#include <stdexcept>
+
+#ifdef WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef WIN32
+MappedFile::MappedFile(std::string const& filename)
+    : data_(nullptr)
+    , size_(0)
+    , file_(INVALID_HANDLE_VALUE)
+    , mapping_(nullptr)
+{
+    file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file_ == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("MappedFile: Cannot open " + filename);
+    }
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(file_, &size);
+    size_ = (std::size_t)size.QuadPart;
+
+    // Empty files can't be mapped, leave the data empty
+    if (size_ > 0)
+    {
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        if (mapping_)
+        {
+            data_ = (char const*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+        }
+
+        if (!data_)
+        {
+            if (mapping_) CloseHandle(mapping_);
+            CloseHandle(file_);
+            throw std::runtime_error("MappedFile: Cannot map " + filename);
+        }
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    CloseHandle(file_);
+}
+#else
+MappedFile::MappedFile(std::string const& filename)
+    : data_(nullptr)
+    , size_(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        throw std::runtime_error("MappedFile: Cannot open " + filename);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("MappedFile: Cannot stat " + filename);
+    }
+
+    size_ = (std::size_t)info.st_size;
+
+    // Empty files can't be mapped, leave the data empty
+    if (size_ > 0)
+    {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("MappedFile: Cannot map " + filename);
+        }
+
+        data_ = (char const*)data;
+    }
+
+    // Mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+    {
+        munmap((void*)data_, size_);
+    }
+}
+#endif
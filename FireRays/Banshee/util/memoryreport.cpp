@@ -0,0 +1,169 @@
+#include "memoryreport.h"
+
+#include <algorithm>
+#include <iomanip>
+
+#ifdef WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif __APPLE__
+#include <sys/resource.h>
+#include <mach/mach.h>
+#else
+#include <fstream>
+#include <sstream>
+#endif
+
+// Categories are paths, "bvh" contains "bvh.nodes" but not "bvhx"
+static bool IsInCategory(std::string const& name, std::string const& category)
+{
+    return name.compare(0, category.size(), category) == 0 &&
+        (name.size() == category.size() || name[category.size()] == '.');
+}
+
+static std::string GetSubsystem(std::string const& name)
+{
+    return name.substr(0, name.find('.'));
+}
+
+static double ToMb(std::size_t bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+void MemoryReport::Add(std::string const& category, std::size_t bytes)
+{
+    entries_[category] += bytes;
+}
+
+void MemoryReport::AddPeak(std::string const& category, std::size_t bytes)
+{
+    std::size_t& peak = peaks_[category];
+    peak = std::max(peak, bytes);
+}
+
+std::size_t MemoryReport::Get(std::string const& category) const
+{
+    std::size_t bytes = 0;
+
+    for (auto& entry : entries_)
+    {
+        if (IsInCategory(entry.first, category))
+        {
+            bytes += entry.second;
+        }
+    }
+
+    return bytes;
+}
+
+std::size_t MemoryReport::GetTotal() const
+{
+    std::size_t bytes = 0;
+
+    for (auto& entry : entries_)
+    {
+        bytes += entry.second;
+    }
+
+    return bytes;
+}
+
+std::size_t MemoryReport::GetPeak(std::string const& category) const
+{
+    auto iter = peaks_.find(category);
+    return iter != peaks_.end() ? iter->second : 0;
+}
+
+void MemoryReport::Print(std::ostream& out) const
+{
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(2);
+
+    // Entries are sorted, so categories of a subsystem go together
+    std::string subsystem;
+    for (auto& entry : entries_)
+    {
+        if (GetSubsystem(entry.first) != subsystem)
+        {
+            subsystem = GetSubsystem(entry.first);
+            out << subsystem << ": " << ToMb(Get(subsystem)) << " MB\n";
+        }
+
+        if (entry.first != subsystem)
+        {
+            out << "    " << entry.first << ": " << ToMb(entry.second) << " MB\n";
+        }
+    }
+
+    out << "Total: " << ToMb(GetTotal()) << " MB\n";
+
+    for (auto& peak : peaks_)
+    {
+        out << "Peak " << peak.first << ": " << ToMb(peak.second) << " MB\n";
+    }
+
+    out << "Process: " << ToMb(GetProcessMemory()) << " MB, peak " << ToMb(GetProcessPeakMemory()) << " MB\n";
+
+    out.flags(flags);
+}
+
+#ifdef WIN32
+std::size_t MemoryReport::GetProcessMemory()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+}
+
+std::size_t MemoryReport::GetProcessPeakMemory()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+}
+#elif __APPLE__
+std::size_t MemoryReport::GetProcessMemory()
+{
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    return task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS ? info.resident_size : 0;
+}
+
+std::size_t MemoryReport::GetProcessPeakMemory()
+{
+    // ru_maxrss is in bytes on OS X
+    rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? (std::size_t)usage.ru_maxrss : 0;
+}
+#else
+// Read a field of /proc/self/status given in kB
+static std::size_t ReadProcStatus(std::string const& field)
+{
+    std::ifstream in("/proc/self/status");
+    std::string line;
+
+    while (std::getline(in, line))
+    {
+        if (line.compare(0, field.size(), field) == 0)
+        {
+            std::istringstream value(line.substr(field.size() + 1));
+            std::size_t kb = 0;
+            value >> kb;
+            return kb * 1024;
+        }
+    }
+
+    return 0;
+}
+
+std::size_t MemoryReport::GetProcessMemory()
+{
+    return ReadProcStatus("VmRSS");
+}
+
+std::size_t MemoryReport::GetProcessPeakMemory()
+{
+    return ReadProcStatus("VmHWM");
+}
+#endif
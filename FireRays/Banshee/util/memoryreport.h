@@ -0,0 +1,74 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+
+#ifndef MEMORYREPORT_H
+#define MEMORYREPORT_H
+
+#include <map>
+#include <string>
+#include <ostream>
+#include <cstddef>
+
+///< MemoryReport collects memory held by subsystems under dot separated
+///< categories (bvh.nodes, mesh.vertices, texture.pool...) so the totals can be
+///< rolled up per subsystem. Subsystems fill it in their GetMemoryUsage methods,
+///< transient peaks (like acceleration structure build) are reported separately.
+///<
+class MemoryReport
+{
+public:
+    // Add bytes held under the category
+    void Add(std::string const& category, std::size_t bytes);
+    // Record peak transient usage under the category, maximum is kept
+    void AddPeak(std::string const& category, std::size_t bytes);
+
+    // Bytes held under the category and all its subcategories
+    std::size_t Get(std::string const& category) const;
+    // Bytes held by everything reported
+    std::size_t GetTotal() const;
+    // Peak transient usage of the category, 0 if not reported
+    std::size_t GetPeak(std::string const& category) const;
+
+    // Print per subsystem totals, their categories, peaks and process memory
+    void Print(std::ostream& out) const;
+
+    // Resident memory of the whole process and its high water mark in bytes, 0 if unknown
+    static std::size_t GetProcessMemory();
+    static std::size_t GetProcessPeakMemory();
+
+private:
+    std::map<std::string, std::size_t> entries_;
+    std::map<std::string, std::size_t> peaks_;
+};
+
+#endif // MEMORYREPORT_H
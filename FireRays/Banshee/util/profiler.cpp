@@ -0,0 +1,162 @@
+#include "profiler.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <cstdlib>
+#include <iomanip>
+
+// Completed scope
+struct Event
+{
+    char const* name;
+    std::chrono::high_resolution_clock::time_point start;
+    std::chrono::high_resolution_clock::time_point end;
+};
+
+// Events of a single thread, only the owning thread appends to it
+struct ThreadEvents
+{
+    int tid;
+    std::string name;
+    std::vector<Event> events;
+};
+
+std::atomic<bool> Profiler::enabled_(false);
+
+// Thread buffers are shared with the registry so they survive thread exit
+static std::mutex g_mutex;
+static std::vector<std::shared_ptr<ThreadEvents> > g_threads;
+static std::string g_filename;
+static std::chrono::high_resolution_clock::time_point g_starttime;
+
+static ThreadEvents& GetThreadEvents()
+{
+    static thread_local std::shared_ptr<ThreadEvents> local;
+
+    if (!local)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+
+        local.reset(new ThreadEvents());
+        local->tid = (int)g_threads.size();
+        local->events.reserve(1024);
+        g_threads.push_back(local);
+    }
+
+    return *local;
+}
+
+static void FlushAtExit()
+{
+    Profiler::Flush();
+}
+
+static void WriteString(std::ostream& out, std::string const& s)
+{
+    out << '"';
+    for (auto c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out << '\\';
+        }
+        out << c;
+    }
+    out << '"';
+}
+
+void Profiler::Enable(std::string const& filename)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    static bool registered = false;
+
+    if (!registered)
+    {
+        g_starttime = std::chrono::high_resolution_clock::now();
+        std::atexit(FlushAtExit);
+        registered = true;
+    }
+
+    g_filename = filename;
+    enabled_ = true;
+}
+
+void Profiler::EnableFromEnvironment()
+{
+    char const* filename = std::getenv("BANSHEE_TRACE");
+
+    if (filename && *filename)
+    {
+        Enable(filename);
+    }
+}
+
+void Profiler::Disable()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    enabled_ = false;
+    g_filename.clear();
+
+    for (auto& thread : g_threads)
+    {
+        thread->events.clear();
+    }
+}
+
+void Profiler::SetThreadName(std::string const& name)
+{
+    GetThreadEvents().name = name;
+}
+
+void Profiler::AddEvent(char const* name, std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end)
+{
+    Event event = { name, start, end };
+    GetThreadEvents().events.push_back(event);
+}
+
+void Profiler::Flush()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    if (g_filename.empty())
+    {
+        return;
+    }
+
+    std::ofstream out(g_filename);
+
+    if (!out)
+    {
+        return;
+    }
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+    for (auto& thread : g_threads)
+    {
+        out << (first ? "" : ",\n");
+        first = false;
+
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->tid << ",\"args\":{\"name\":";
+        WriteString(out, thread->name.empty() ? "thread " + std::to_string(thread->tid) : thread->name);
+        out << "}}";
+
+        for (auto& event : thread->events)
+        {
+            auto ts = std::chrono::duration_cast<std::chrono::duration<double, std::micro> >(event.start - g_starttime).count();
+            auto dur = std::chrono::duration_cast<std::chrono::duration<double, std::micro> >(event.end - event.start).count();
+
+            out << ",\n{\"name\":";
+            WriteString(out, event.name);
+            out << ",\"cat\":\"banshee\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->tid << ",\"ts\":" << ts << ",\"dur\":" << dur << "}";
+        }
+    }
+
+    out << "\n]}\n";
+}
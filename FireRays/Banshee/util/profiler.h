@@ -0,0 +1,110 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <chrono>
+#include <atomic>
+
+///< Profiler records named scopes per thread and writes them as
+///< Chrome trace_event JSON (load in chrome://tracing or Perfetto).
+///< Collection is off until Enable() is called or BANSHEE_TRACE
+///< environment variable names the output file, a disabled scope
+///< costs a single flag check.
+///< Usage: PROFILE_SCOPE("Bvh::Build");
+///<
+class Profiler
+{
+public:
+    // Start collecting events to be written into filename
+    static void Enable(std::string const& filename);
+    // Enable if BANSHEE_TRACE environment variable is set
+    static void EnableFromEnvironment();
+    // Stop collecting and drop the events, nothing is written on exit
+    // REQUIRED: no scopes are open on other threads
+    static void Disable();
+    // Check if events are being collected
+    static bool IsEnabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Write events collected so far into the trace file
+    // REQUIRED: no scopes are open on other threads
+    static void Flush();
+
+    // Name the calling thread in the trace
+    static void SetThreadName(std::string const& name);
+
+    // RAII scope, name should be a string literal or otherwise outlive the profiler
+    class Scope
+    {
+    public:
+        explicit Scope(char const* name)
+        : name_(IsEnabled() ? name : nullptr)
+        {
+            if (name_)
+            {
+                start_ = std::chrono::high_resolution_clock::now();
+            }
+        }
+
+        ~Scope()
+        {
+            if (name_)
+            {
+                AddEvent(name_, start_, std::chrono::high_resolution_clock::now());
+            }
+        }
+
+    private:
+        Scope(Scope const&);
+        Scope& operator = (Scope const&);
+
+        char const* name_;
+        std::chrono::high_resolution_clock::time_point start_;
+    };
+
+private:
+    static void AddEvent(char const* name, std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end);
+
+    static std::atomic<bool> enabled_;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCAT(profilescope, __LINE__)(name)
+
+#endif // PROFILER_H
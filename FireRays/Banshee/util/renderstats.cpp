@@ -0,0 +1,83 @@
+#include "renderstats.h"
+
+#ifdef RENDER_STATS
+
+#include "../aov/aov.h"
+
+#include <atomic>
+
+static std::atomic<unsigned long long> g_totals[RenderStats::kNumCounters];
+static std::atomic<unsigned long long> g_numsamples(0);
+static std::atomic<unsigned long long> g_totaltime(0);
+
+RenderStats::Local& RenderStats::GetLocal()
+{
+    static thread_local Local local;
+    return local;
+}
+
+void RenderStats::BeginSample()
+{
+    Local& local = GetLocal();
+
+    for (int i = 0; i < kNumCounters; ++i)
+    {
+        local.counters[i] = 0;
+    }
+
+    local.start = std::chrono::high_resolution_clock::now();
+}
+
+void RenderStats::EndSample(AovSample& aovs)
+{
+    Local& local = GetLocal();
+
+    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - local.start).count();
+
+    for (int i = 0; i < kNumCounters; ++i)
+    {
+        float value = (float)local.counters[i];
+        aovs.Add(AovSample::kStatNodes + i, float3(value, value, value));
+        g_totals[i] += local.counters[i];
+    }
+
+    float us = time * 0.001f;
+    aovs.Add(AovSample::kStatTime, float3(us, us, us));
+
+    g_totaltime += time;
+    ++g_numsamples;
+}
+
+unsigned long long RenderStats::GetTotal(Counter counter)
+{
+    return g_totals[counter];
+}
+
+unsigned long long RenderStats::GetNumSamples()
+{
+    return g_numsamples;
+}
+
+double RenderStats::GetTotalTime()
+{
+    return g_totaltime * 1e-9;
+}
+
+void RenderStats::ResetTotals()
+{
+    for (int i = 0; i < kNumCounters; ++i)
+    {
+        g_totals[i] = 0;
+    }
+
+    g_numsamples = 0;
+    g_totaltime = 0;
+}
+
+char const* RenderStats::GetName(Counter counter)
+{
+    static char const* names[kNumCounters] = { "nodes", "triangles", "shadow rays", "path vertices" };
+    return names[counter];
+}
+
+#endif // RENDER_STATS
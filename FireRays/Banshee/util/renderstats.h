@@ -0,0 +1,116 @@
+/*
+ Banshee and all code, documentation, and other materials contained
+ therein are:
+ 
+ Copyright 2013 Dmitry Kozlov
+ All Rights Reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ * Neither the name of the software's owners nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ (This is the Modified BSD License)
+ */
+
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+///< Render cost instrumentation, compiled in only if RENDER_STATS is defined
+///< (premake --render_stats), otherwise STATS_ macros expand to nothing.
+///< Traversal and tracers bump per-thread counters, the renderer brackets
+///< each camera sample with STATS_BEGIN_SAMPLE/STATS_END_SAMPLE, which writes
+///< sample counters and wall time into stat AOV channels and adds them to the totals.
+///< Usage: STATS_ADD(kNodes, 1);
+///<
+
+#ifdef RENDER_STATS
+
+#include <chrono>
+
+class AovSample;
+
+class RenderStats
+{
+public:
+    // Counters, each one has its AOV channel starting from AovSample::kStatNodes
+    enum Counter
+    {
+        // BVH nodes visited
+        kNodes,
+        // Ray-triangle tests
+        kTriangles,
+        // Shadow and occlusion rays cast
+        kShadowRays,
+        // Path vertices shaded
+        kPathVertices,
+        kNumCounters
+    };
+
+    // Bump the counter of the calling thread
+    static void Add(Counter counter, unsigned long long n)
+    {
+        GetLocal().counters[counter] += n;
+    }
+
+    // Start camera sample on the calling thread
+    static void BeginSample();
+
+    // Finish camera sample: write its counters and time in microseconds
+    // into stat channels of aovs and add them to the totals
+    static void EndSample(AovSample& aovs);
+
+    // Totals over all the samples since the last reset
+    static unsigned long long GetTotal(Counter counter);
+    static unsigned long long GetNumSamples();
+    // Total sample time in seconds summed over the threads
+    static double GetTotalTime();
+
+    // Drop the totals
+    static void ResetTotals();
+
+    // Counter name
+    static char const* GetName(Counter counter);
+
+private:
+    // Counters of the current sample
+    struct Local
+    {
+        unsigned long long counters[kNumCounters];
+        std::chrono::high_resolution_clock::time_point start;
+    };
+
+    static Local& GetLocal();
+};
+
+#define STATS_ADD(counter, n) RenderStats::Add(RenderStats::counter, (n))
+#define STATS_BEGIN_SAMPLE() RenderStats::BeginSample()
+#define STATS_END_SAMPLE(aovs) RenderStats::EndSample(aovs)
+
+#else
+
+#define STATS_ADD(counter, n)
+#define STATS_BEGIN_SAMPLE()
+#define STATS_END_SAMPLE(aovs)
+
+#endif // RENDER_STATS
+
+#endif // RENDERSTATS_H
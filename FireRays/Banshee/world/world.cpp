@@ -1,9 +1,13 @@
 #include "world.h"
 #include "../accelerator/bvh.h"
 #include "../accelerator/embree.h"
+#include "../util/profiler.h"
+#include "../util/memoryreport.h"
 
 void World::Commit()
 {
+    PROFILE_SCOPE("World::Commit");
+
 #ifndef USE_EMBREE
     Bvh* bvh = new Bvh(true);
     bvh->Build(shapebundles_);
@@ -13,6 +17,17 @@ void World::Commit()
     embree->Build(shapebundles_);
     accel_.reset(embree);
 #endif
+
+    // Lights need to be reconsidered
+    lightcache_.store(nullptr, std::memory_order_release);
+}
+
+void World::Commit(std::unique_ptr<Intersectable> accel)
+{
+    accel_ = std::move(accel);
+
+    // Lights need to be reconsidered
+    lightcache_.store(nullptr, std::memory_order_release);
 }
 
 // Intersection test
@@ -26,4 +41,75 @@ bool World::Intersect(ray const& r, ShapeBundle::Hit& hit) const
 bool World::Intersect(ray const& r) const
 {
     return accel_->Intersect(r);
-}
\ No newline at end of file
+}
+
+int World::SampleLight(ShapeBundle::Hit const& hit, float u, float& pdf) const
+{
+    return GetLightCache().bvh.Sample(hit, u, pdf);
+}
+
+LightSet const& World::GetLightSet() const
+{
+    return GetLightCache().set;
+}
+
+float3 World::GetLe(ray const& r) const
+{
+    return GetLightSet().GetLe(r);
+}
+
+void World::GetMemoryUsage(MemoryReport& report) const
+{
+    if (accel_)
+    {
+        accel_->GetMemoryUsage(report);
+    }
+
+    for (auto& bundle : shapebundles_)
+    {
+        bundle->GetMemoryUsage(report);
+    }
+
+    for (auto& light : lights_)
+    {
+        light->GetMemoryUsage(report);
+    }
+
+    LightCache const* lightcache = lightcache_.load(std::memory_order_acquire);
+
+    if (lightcache)
+    {
+        lightcache->bvh.GetMemoryUsage(report);
+    }
+}
+
+World::LightCache const& World::GetLightCache() const
+{
+    LightCache const* lightcache = lightcache_.load(std::memory_order_acquire);
+
+    if (lightcache && lightcache->bvh.GetNumLights() == lights_.size())
+    {
+        return *lightcache;
+    }
+
+    std::lock_guard<std::mutex> lock(lightcachemutex_);
+
+    // Somebody might have done that while we were waiting
+    lightcache = lightcache_.load(std::memory_order_relaxed);
+
+    if (lightcache && lightcache->bvh.GetNumLights() == lights_.size())
+    {
+        return *lightcache;
+    }
+
+    std::unique_ptr<LightCache> newcache(new LightCache());
+    newcache->bvh.Build(lights_);
+    newcache->set.Build(lights_);
+
+    // Previous cache is kept alive, other threads might still be using it
+    lightcache = newcache.get();
+    lightcaches_.push_back(std::move(newcache));
+    lightcache_.store(lightcache, std::memory_order_release);
+
+    return *lightcache;
+}
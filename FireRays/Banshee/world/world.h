@@ -36,10 +36,14 @@
 
 #include <memory>
 #include <vector>
+#include <mutex>
+#include <atomic>
 
 #include "../primitive/shapebundle.h"
 #include "../accelerator/intersectable.h"
 #include "../light/light.h"
+#include "../light/light_bvh.h"
+#include "../light/light_set.h"
 #include "../camera/camera.h"
 #include "../material/material.h"
 
@@ -55,12 +59,15 @@ public:
         : accel_(nullptr)
         , camera_(nullptr)
         , bgcolor_(float3(0,0,0))
+        , lightcache_(nullptr)
     {
     }
 
     virtual ~World(){}
     
     void Commit();
+    // Commit with accelerator built over shapebundles_ beforehand, e.g. restored from scene cache
+    void Commit(std::unique_ptr<Intersectable> accel);
     
     /**
      Intersectable overrides
@@ -70,6 +77,17 @@ public:
     // Intersection check test
     bool Intersect(ray const& r) const;
 
+    // Pick a light for the shading point in proportion to its estimated contribution
+    // using random number u, returns light index and selection probability (pdf) or -1
+    int SampleLight(ShapeBundle::Hit const& hit, float u, float& pdf) const;
+    // Lights partitioned by type, indexed the same way as lights_
+    LightSet const& GetLightSet() const;
+    // Radiance from the lights along the ray escaped the scene
+    float3 GetLe(ray const& r) const;
+
+    // Report memory held by the accelerator, shapes and lights
+    void GetMemoryUsage(MemoryReport& report) const;
+
 
 public:
     // Lights
@@ -85,6 +103,25 @@ public:
     float3 bgcolor_;
     // Materials
     std::vector<std::unique_ptr<Material> > materials_;
+
+private:
+    // Light sampling hierarchy and lights partitioned by type, built over the same lights
+    struct LightCache
+    {
+        LightBvh bvh;
+        LightSet set;
+    };
+
+    // Light cache is built on first use since lights might be added after Commit
+    LightCache const& GetLightCache() const;
+
+    // Up to date light cache or nullptr, readers do not take the lock
+    mutable std::atomic<LightCache const*> lightcache_;
+    // All light caches built so far, outdated ones might still be in use by
+    // other threads so they are only released along with the world
+    mutable std::vector<std::unique_ptr<LightCache> > lightcaches_;
+    // Guards light cache construction
+    mutable std::mutex lightcachemutex_;
 };
 
 
@@ -0,0 +1,705 @@
+/*
+    Banshee and all code, documentation, and other materials contained
+    therein are:
+
+        Copyright 2013 Dmitry Kozlov
+        All Rights Reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the software's owners nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+    "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+    LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+    A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+    (This is the Modified BSD License)
+*/
+#include <chrono>
+#include <cassert>
+#include <vector>
+#include <stdexcept>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <numeric>
+
+#include "math/mathutils.h"
+#include "world/world.h"
+#include "accelerator/bvh.h"
+#include "accelerator/embree.h"
+#include "imageio/oiioimageio.h"
+#include "texture/native_texturesystem.h"
+#include "import/assimp_assetimporter.h"
+#include "imageplane/imageplane.h"
+#include "renderer/mt_imagerenderer.h"
+#include "tracer/gitracer.h"
+#include "sampler/sobol_sampler.h"
+#include "rng/mcrng.h"
+#include "camera/perspective_camera.h"
+#include "light/directional_light.h"
+#include "util/progressreporter.h"
+
+///< Ray tracing kernel benchmark: loads the scenes, builds every
+///< available accelerator over them and measures closest hit and
+///< occlusion throughput for coherent primary rays, incoherent
+///< diffuse bounce rays and shadow rays. Results go out as JSON.
+///< With --scaling it renders the scenes instead on 1, 2, 4... up to
+///< --threads worker threads and reports speedup, parallel efficiency
+///< and the time workers spent idle waiting for the last tiles.
+///<
+
+std::string g_resource_path = "../../../Resources";
+std::string g_output_path = "";
+std::vector<std::string> g_scenes;
+int2 g_imgres = int2(512, 512);
+int  g_num_iterations = 3;
+int  g_num_threads = 0;
+bool g_scaling = false;
+int  g_scaling_spp = 4;
+bool g_scaling_progress = false;
+
+// Scenes shipped in Resources, missing ones are reported and skipped
+char const* g_default_scenes[] =
+{
+    "CornellBox/orig.objm",
+    "Sphere/sphere.obj",
+    "test/sphere.obj"
+};
+
+// Screen tile size, primary rays go tile by tile to stay coherent
+static const int kTileSize = 8;
+// Number of rays taken by a worker at once
+static const int kRayBatchSize = 1024;
+
+// Accelerator under test
+struct Backend
+{
+    std::string name;
+    std::function<std::unique_ptr<Intersectable> (World const&, std::size_t&)> build;
+};
+
+// Rays of one kind, traced with both closest hit and occlusion queries
+struct RaySet
+{
+    std::string name;
+    std::vector<ray> rays;
+};
+
+std::vector<Backend> CreateBackends()
+{
+    std::vector<Backend> backends;
+
+    Backend bvh = { "bvh", [](World const& world, std::size_t& size)->std::unique_ptr<Intersectable>
+    {
+        std::unique_ptr<Bvh> bvh(new Bvh(false));
+        bvh->Build(world.shapebundles_);
+        size = bvh->GetSizeInBytes();
+        return std::move(bvh);
+    }};
+    backends.push_back(bvh);
+
+    Backend bvhsah = { "bvh_sah", [](World const& world, std::size_t& size)->std::unique_ptr<Intersectable>
+    {
+        std::unique_ptr<Bvh> bvh(new Bvh(true));
+        bvh->Build(world.shapebundles_);
+        size = bvh->GetSizeInBytes();
+        return std::move(bvh);
+    }};
+    backends.push_back(bvhsah);
+
+#ifdef USE_EMBREE
+    // Embree keeps its memory to itself, size is not reported
+    Backend embree = { "embree", [](World const& world, std::size_t& size)->std::unique_ptr<Intersectable>
+    {
+        std::unique_ptr<Embree> embree(new Embree());
+        embree->Build(world.shapebundles_);
+        size = 0;
+        return std::move(embree);
+    }};
+    backends.push_back(embree);
+#endif
+
+    return backends;
+}
+
+std::unique_ptr<World> LoadScene(TextureSystem const& texsys, std::string const& filename)
+{
+    std::unique_ptr<World> world(new World());
+
+    AssimpAssetImporter assimp(texsys, filename);
+
+    assimp.onmaterial_ = [&world](Material* mat)->int
+    {
+        world->materials_.push_back(std::unique_ptr<Material>(mat));
+        return (int)(world->materials_.size() - 1);
+    };
+
+    assimp.onprimitive_ = [&world](ShapeBundle* prim)
+    {
+        world->shapebundles_.push_back(std::unique_ptr<ShapeBundle>(prim));
+    };
+
+    assimp.onlight_ = [&world](Light* light)
+    {
+        world->lights_.push_back(std::unique_ptr<Light>(light));
+    };
+
+    assimp.Import();
+
+    if (world->shapebundles_.empty())
+    {
+        throw std::runtime_error("Scene has no geometry");
+    }
+
+    return world;
+}
+
+// Run f over [0..count) in batches on g_num_threads threads
+void ParallelFor(std::size_t count, std::function<void (std::size_t, std::size_t)> const& f)
+{
+    std::atomic<std::size_t> next(0);
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < g_num_threads; ++i)
+    {
+        threads.push_back(std::thread([&]()
+        {
+            for (;;)
+            {
+                std::size_t start = next.fetch_add(kRayBatchSize);
+
+                if (start >= count)
+                {
+                    return;
+                }
+
+                f(start, std::min(start + kRayBatchSize, count));
+            }
+        }));
+    }
+
+    std::for_each(threads.begin(), threads.end(), std::mem_fun_ref(&std::thread::join));
+}
+
+// Pinhole camera looking at the scene from the front of its bounds,
+// rays are ordered by screen tiles
+void GeneratePrimaryRays(bbox const& bounds, std::vector<ray>& rays)
+{
+    float3 center = bounds.center();
+    float radius = 0.5f * sqrtf(bounds.extents().sqnorm());
+
+    float3 eye = center + float3(0.f, 0.f, 2.5f * radius);
+    float3 forward = normalize(center - eye);
+    float3 right = float3(1.f, 0.f, 0.f);
+    float3 up = cross(right, forward);
+    float tanfov = tanf(PI / 8);
+
+    rays.clear();
+    rays.reserve(g_imgres.x * g_imgres.y);
+
+    for (int ty = 0; ty < g_imgres.y; ty += kTileSize)
+        for (int tx = 0; tx < g_imgres.x; tx += kTileSize)
+            for (int y = ty; y < std::min(ty + kTileSize, g_imgres.y); ++y)
+                for (int x = tx; x < std::min(tx + kTileSize, g_imgres.x); ++x)
+                {
+                    float u = (2.f * (x + 0.5f) / g_imgres.x - 1.f) * tanfov;
+                    float v = (2.f * (y + 0.5f) / g_imgres.y - 1.f) * tanfov * g_imgres.y / g_imgres.x;
+
+                    rays.push_back(ray(eye, normalize(forward + u * right + v * up), float2(0.f, 10000000.f)));
+                }
+}
+
+// Secondary rays spawned from primary hits found by accel: cosine weighted
+// diffuse bounces and shadow rays to points on a quad under the scene ceiling,
+// shuffled afterwards the same way a wavefront of paths gets incoherent
+void GenerateSecondaryRays(Intersectable const& accel, bbox const& bounds, std::vector<ray> const& primary, std::vector<ray>& diffuse, std::vector<ray>& shadow)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(0.f, 1.f);
+
+    float3 extents = bounds.extents();
+
+    diffuse.clear();
+    shadow.clear();
+
+    for (auto& r : primary)
+    {
+        ShapeBundle::Hit hit;
+        hit.t = r.t.y;
+
+        if (!accel.Intersect(r, hit))
+        {
+            continue;
+        }
+
+        float3 n = dot(hit.ng, r.d) > 0.f ? -hit.ng : hit.ng;
+
+        diffuse.push_back(ray(hit.p, map_to_hemisphere(n, float2(dist(rng), dist(rng)), 1.f), float2(0.001f, 10000000.f)));
+
+        float3 target = float3(bounds.pmin.x + extents.x * (0.25f + 0.5f * dist(rng)),
+                               bounds.pmax.y - extents.y * 0.01f,
+                               bounds.pmin.z + extents.z * (0.25f + 0.5f * dist(rng)));
+
+        float3 d = target - hit.p;
+        float len = sqrtf(d.sqnorm());
+
+        if (len > 0.f)
+        {
+            shadow.push_back(ray(hit.p, d * (1.f / len), float2(0.001f, len * 0.999f)));
+        }
+    }
+
+    std::shuffle(diffuse.begin(), diffuse.end(), rng);
+    std::shuffle(shadow.begin(), shadow.end(), rng);
+}
+
+// Best of g_num_iterations runs in Mrays/s
+double MeasureClosestHit(Intersectable const& accel, std::vector<ray> const& rays)
+{
+    double best = 0.0;
+
+    for (int i = 0; i < g_num_iterations; ++i)
+    {
+        auto starttime = std::chrono::high_resolution_clock::now();
+
+        ParallelFor(rays.size(), [&](std::size_t start, std::size_t end)
+        {
+            ShapeBundle::Hit hit;
+            for (std::size_t r = start; r < end; ++r)
+            {
+                hit.t = rays[r].t.y;
+                accel.Intersect(rays[r], hit);
+            }
+        });
+
+        auto endtime = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration_cast<std::chrono::duration<double> >(endtime - starttime).count();
+
+        best = std::max(best, seconds > 0.0 ? rays.size() / seconds * 1e-6 : 0.0);
+    }
+
+    return best;
+}
+
+double MeasureOcclusion(Intersectable const& accel, std::vector<ray> const& rays)
+{
+    double best = 0.0;
+
+    for (int i = 0; i < g_num_iterations; ++i)
+    {
+        auto starttime = std::chrono::high_resolution_clock::now();
+
+        ParallelFor(rays.size(), [&](std::size_t start, std::size_t end)
+        {
+            for (std::size_t r = start; r < end; ++r)
+            {
+                accel.Intersect(rays[r]);
+            }
+        });
+
+        auto endtime = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration_cast<std::chrono::duration<double> >(endtime - starttime).count();
+
+        best = std::max(best, seconds > 0.0 ? rays.size() / seconds * 1e-6 : 0.0);
+    }
+
+    return best;
+}
+
+// Quote and escape a string for JSON output
+std::string JsonString(std::string const& s)
+{
+    std::string res = "\"";
+    for (auto c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            res += '\\';
+        }
+        res += c;
+    }
+    return res + "\"";
+}
+
+// Benchmark one scene, write its JSON object into out
+void RunScene(TextureSystem const& texsys, std::string const& filename, std::ostream& out)
+{
+    out << "    {\n";
+    out << "      \"file\": " << JsonString(filename) << ",\n";
+
+    std::unique_ptr<World> world;
+
+    try
+    {
+        world = LoadScene(texsys, filename);
+    }
+    catch (std::runtime_error& e)
+    {
+        std::cerr << "Skipping " << filename << ": " << e.what() << "\n";
+        out << "      \"error\": " << JsonString(e.what()) << "\n";
+        out << "    }";
+        return;
+    }
+
+    bbox bounds;
+    std::size_t numprims = 0;
+    for (auto& bundle : world->shapebundles_)
+    {
+        bounds.grow(bundle->GetWorldBounds());
+        numprims += bundle->GetNumShapes();
+    }
+
+    std::cerr << "Benchmarking " << filename << " (" << numprims << " primitives)\n";
+
+    // Same rays for all the backends, secondary ones come from SAH BVH hits
+    std::vector<RaySet> raysets(3);
+    raysets[0].name = "primary";
+    raysets[1].name = "diffuse";
+    raysets[2].name = "shadow";
+
+    GeneratePrimaryRays(bounds, raysets[0].rays);
+
+    {
+        Bvh bvh(true);
+        bvh.Build(world->shapebundles_);
+        GenerateSecondaryRays(bvh, bounds, raysets[0].rays, raysets[1].rays, raysets[2].rays);
+    }
+
+    out << "      \"primitives\": " << numprims << ",\n";
+    out << "      \"backends\": [\n";
+
+    std::vector<Backend> backends = CreateBackends();
+
+    for (std::size_t b = 0; b < backends.size(); ++b)
+    {
+        std::size_t size = 0;
+
+        auto starttime = std::chrono::high_resolution_clock::now();
+        std::unique_ptr<Intersectable> accel = backends[b].build(*world, size);
+        auto endtime = std::chrono::high_resolution_clock::now();
+        double buildms = std::chrono::duration_cast<std::chrono::duration<double, std::milli> >(endtime - starttime).count();
+
+        out << "        {\n";
+        out << "          \"name\": " << JsonString(backends[b].name) << ",\n";
+        out << "          \"build_ms\": " << buildms << ",\n";
+        out << "          \"memory_bytes\": " << size << ",\n";
+        out << "          \"rays\": {\n";
+
+        for (std::size_t s = 0; s < raysets.size(); ++s)
+        {
+            double closest = MeasureClosestHit(*accel, raysets[s].rays);
+            double occlusion = MeasureOcclusion(*accel, raysets[s].rays);
+
+            std::cerr << "  " << backends[b].name << " " << raysets[s].name << ": "
+                      << closest << " / " << occlusion << " Mrays/s\n";
+
+            out << "            \"" << raysets[s].name << "\": { \"count\": " << raysets[s].rays.size()
+                << ", \"closest_mrays\": " << closest << ", \"occlusion_mrays\": " << occlusion << " }"
+                << (s + 1 < raysets.size() ? ",\n" : "\n");
+        }
+
+        out << "          }\n";
+        out << "        }" << (b + 1 < backends.size() ? ",\n" : "\n");
+    }
+
+    out << "      ]\n";
+    out << "    }";
+}
+
+// Image plane keeping the result in memory, scaling runs only need the timings
+class MemoryImagePlane : public ImagePlane
+{
+public:
+    MemoryImagePlane(int2 const& res)
+        : ImagePlane(res, nullptr)
+        , data_(res.x * res.y)
+    {
+    }
+
+protected:
+    void WriteSample(int2 const& pos, float3 const& value)
+    {
+        data_[resolution().x * pos.y + pos.x] += value;
+    }
+
+private:
+    std::vector<float3> data_;
+};
+
+// Progress reporter doing nothing, attached to measure the cost of progress updates
+class NullProgressReporter : public ProgressReporter
+{
+public:
+    void Report(float progress) {}
+};
+
+// Thread counts to try: powers of two below g_num_threads and g_num_threads itself
+std::vector<int> GetThreadCounts()
+{
+    std::vector<int> counts;
+
+    for (int n = 1; n < g_num_threads; n *= 2)
+    {
+        counts.push_back(n);
+    }
+
+    counts.push_back(g_num_threads);
+    return counts;
+}
+
+// Render the scene with path tracer on increasing number of threads, write its JSON object into out
+void RunScaling(TextureSystem const& texsys, std::string const& filename, std::ostream& out)
+{
+    out << "    {\n";
+    out << "      \"file\": " << JsonString(filename) << ",\n";
+
+    std::unique_ptr<World> world;
+
+    try
+    {
+        world = LoadScene(texsys, filename);
+    }
+    catch (std::runtime_error& e)
+    {
+        std::cerr << "Skipping " << filename << ": " << e.what() << "\n";
+        out << "      \"error\": " << JsonString(e.what()) << "\n";
+        out << "    }";
+        return;
+    }
+
+    bbox bounds;
+    for (auto& bundle : world->shapebundles_)
+    {
+        bounds.grow(bundle->GetWorldBounds());
+    }
+
+    // Same view as primary rays of the kernel benchmark
+    float3 center = bounds.center();
+    float radius = 0.5f * sqrtf(bounds.extents().sqnorm());
+    float3 eye = center + float3(0.f, 0.f, 2.5f * radius);
+
+    world->camera_.reset(new PerscpectiveCamera(eye, center, float3(0.f, 1.f, 0.f), float2(0.01f, 10000000.f), PI / 4, (float)g_imgres.x / g_imgres.y));
+
+    if (world->lights_.empty())
+    {
+        world->lights_.push_back(std::unique_ptr<Light>(new DirectionalLight(float3(-0.3f, -1.f, -0.5f), float3(3.f, 3.f, 3.f))));
+    }
+
+    world->Commit();
+
+    std::cerr << "Scaling " << filename << " (" << g_scaling_spp << " spp)\n";
+
+    out << "      \"spp\": " << g_scaling_spp << ",\n";
+    out << "      \"progress\": " << (g_scaling_progress ? "true" : "false") << ",\n";
+    out << "      \"runs\": [\n";
+
+    std::vector<int> counts = GetThreadCounts();
+    double serialtime = 0.0;
+
+    for (std::size_t c = 0; c < counts.size(); ++c)
+    {
+        MemoryImagePlane plane(g_imgres);
+
+        MtImageRenderer renderer(plane,
+            new GiTracer(3),
+            new SobolSampler(g_scaling_spp, new McRng()),
+            new SobolSampler(1, new McRng()),
+            new SobolSampler(1, new McRng()),
+            g_scaling_progress ? new NullProgressReporter() : nullptr,
+            int2(16, 16),
+            counts[c]);
+
+        // Warm up texture cache and thread local state
+        renderer.Render(*world);
+
+        // Best of g_num_iterations runs, idle time is the one of the best run
+        double best = 0.0;
+        std::vector<double> idle(counts[c]);
+
+        for (int i = 0; i < g_num_iterations; ++i)
+        {
+            renderer.ResetBusyTime();
+
+            auto starttime = std::chrono::high_resolution_clock::now();
+            renderer.Render(*world);
+            auto endtime = std::chrono::high_resolution_clock::now();
+            double seconds = std::chrono::duration_cast<std::chrono::duration<double> >(endtime - starttime).count();
+
+            if (i == 0 || seconds < best)
+            {
+                best = seconds;
+
+                for (int t = 0; t < counts[c]; ++t)
+                {
+                    idle[t] = std::max(seconds - renderer.GetBusyTime(t), 0.0);
+                }
+            }
+        }
+
+        // First run is single threaded
+        if (c == 0)
+        {
+            serialtime = best;
+        }
+
+        double speedup = best > 0.0 ? serialtime / best : 0.0;
+        double efficiency = speedup / counts[c];
+        double idleavg = std::accumulate(idle.begin(), idle.end(), 0.0) / counts[c];
+        double idlemax = *std::max_element(idle.begin(), idle.end());
+
+        std::cerr << "  " << counts[c] << " threads: " << best << " s, speedup " << speedup
+                  << ", efficiency " << efficiency * 100.0 << "%, idle " << idleavg * 1000.0
+                  << " ms avg / " << idlemax * 1000.0 << " ms max\n";
+
+        out << "        { \"threads\": " << counts[c] << ", \"seconds\": " << best
+            << ", \"speedup\": " << speedup << ", \"efficiency\": " << efficiency
+            << ", \"idle_ms_avg\": " << idleavg * 1000.0 << ", \"idle_ms_max\": " << idlemax * 1000.0
+            << ", \"idle_ms\": [";
+
+        for (int t = 0; t < counts[c]; ++t)
+        {
+            out << idle[t] * 1000.0 << (t + 1 < counts[c] ? ", " : "");
+        }
+
+        out << "] }" << (c + 1 < counts.size() ? ",\n" : "\n");
+    }
+
+    out << "      ]\n";
+    out << "    }";
+}
+
+char* GetCmdOption(char ** begin, char ** end, const std::string & option)
+{
+    char ** itr = std::find(begin, end, option);
+    if (itr != end && ++itr != end)
+    {
+        return *itr;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    // Handle command line parameters
+    char* resource_path = GetCmdOption(argv, argv + argc, "--resource_path");
+    g_resource_path = resource_path ? resource_path : g_resource_path;
+
+    char* output_path = GetCmdOption(argv, argv + argc, "--output");
+    g_output_path = output_path ? output_path : g_output_path;
+
+    char* iterations = GetCmdOption(argv, argv + argc, "--iterations");
+    g_num_iterations = iterations ? std::max(atoi(iterations), 1) : g_num_iterations;
+
+    char* threads = GetCmdOption(argv, argv + argc, "--threads");
+    g_num_threads = threads ? atoi(threads) : g_num_threads;
+
+    char* width = GetCmdOption(argv, argv + argc, "--width");
+    g_imgres.x = width ? atoi(width) : g_imgres.x;
+
+    char* height = GetCmdOption(argv, argv + argc, "--height");
+    g_imgres.y = height ? atoi(height) : g_imgres.y;
+
+    char* spp = GetCmdOption(argv, argv + argc, "--spp");
+    g_scaling_spp = spp ? std::max(atoi(spp), 1) : g_scaling_spp;
+
+    g_scaling = std::find(argv, argv + argc, std::string("--scaling")) != argv + argc;
+    g_scaling_progress = std::find(argv, argv + argc, std::string("--progress")) != argv + argc;
+
+    // Scenes are given with --scene <file>, might be repeated
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--scene")
+        {
+            g_scenes.push_back(argv[++i]);
+        }
+    }
+
+    if (g_scenes.empty())
+    {
+        for (auto scene : g_default_scenes)
+        {
+            g_scenes.push_back(g_resource_path + "/" + scene);
+        }
+    }
+
+    if (g_num_threads <= 0)
+    {
+        g_num_threads = std::max((int)std::thread::hardware_concurrency(), 1);
+    }
+
+    try
+    {
+        OiioImageIo io;
+        NativeTextureSystem texsys(g_resource_path + "/Textures", io);
+
+        std::ostringstream out;
+        out << "{\n";
+        out << "  \"mode\": " << (g_scaling ? "\"scaling\"" : "\"kernels\"") << ",\n";
+        out << "  \"threads\": " << g_num_threads << ",\n";
+        out << "  \"iterations\": " << g_num_iterations << ",\n";
+        out << "  \"resolution\": [" << g_imgres.x << ", " << g_imgres.y << "],\n";
+        out << "  \"scenes\": [\n";
+
+        for (std::size_t i = 0; i < g_scenes.size(); ++i)
+        {
+            if (g_scaling)
+            {
+                RunScaling(texsys, g_scenes[i], out);
+            }
+            else
+            {
+                RunScene(texsys, g_scenes[i], out);
+            }
+            out << (i + 1 < g_scenes.size() ? ",\n" : "\n");
+        }
+
+        out << "  ]\n";
+        out << "}\n";
+
+        if (g_output_path.empty())
+        {
+            std::cout << out.str();
+        }
+        else
+        {
+            std::ofstream file(g_output_path);
+
+            if (!file)
+            {
+                throw std::runtime_error("Cannot open " + g_output_path);
+            }
+
+            file << out.str();
+        }
+    }
+    catch (std::runtime_error& e)
+    {
+        std::cerr << e.what() << "\n";
+        return -1;
+    }
+
+    return 0;
+}
@@ -36,6 +36,10 @@
 #include <stdexcept>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
 
 #include "math/mathutils.h"
 #include "world/custom_worldbuilder.h"
@@ -63,6 +67,8 @@
 #include "sampler/stratified_sampler.h"
 #include "sampler/cmj_sampler.h"
 #include "sampler/sobol_sampler.h"
+#include "sampler/bluenoise_sampler.h"
+#include "denoiser/atrous_denoiser.h"
 #include "rng/mcrng.h"
 #include "material/simplematerial.h"
 #include "material/emissive.h"
@@ -74,8 +80,15 @@
 #include "bsdf/perfect_refract.h"
 #include "bsdf/normal_mapping.h"
 #include "texture/oiio_texturesystem.h"
+#include "texture/native_texturesystem.h"
 #include "import/assimp_assetimporter.h"
+#include "import/binary_assetimporter.h"
+#include "import/scenecache.h"
+#include "accelerator/bvh.h"
 #include "util/progressreporter.h"
+#include "util/renderstats.h"
+#include "util/profiler.h"
+#include "util/memoryreport.h"
 #include "math/sh.h"
 #include "math/shproject.h"
 
@@ -137,42 +150,160 @@ public:
 };
 
 
-std::unique_ptr<World> BuildWorld(TextureSystem const& texsys)
+// Scene cache directory, set with -scenecache <dir>. Assets are imported with Assimp
+// on the first run and stored there along with their BVH, later runs map the cache.
+// Cache is keyed on the full asset path and rewritten once the asset or its .mtl change.
+std::string g_scene_cache_path;
+
+// Absolute path of the file, the name itself if it cannot be resolved
+std::string GetFullPath(std::string const& filename)
 {
-    // Create world
-    World* world = new World();
-    // Create camera
-    Camera* camera = new FirstPersonCamera(float3(0.0f, 1.0f, 3.5f), float3(0.0f, 1.0f, 0), float3(0, 1.f, 0), float2(0.01f, 10000.f), PI / 4, 1.f);
-    //Camera* camera = new PerscpectiveCamera(float3(0, 0, 0), float3(1, 0, 0), float3(0, 1, 0), float2(0.01f, 10000.f), PI / 3, 1.f);
-    //Camera* camera = new EnvironmentCamera(float3(0, 0, 0), float3(0,-1,0), float3(0, 0, 1), float2(0.01f, 10000.f));
+#ifdef WIN32
+    char* path = _fullpath(nullptr, filename.c_str(), 0);
+#else
+    char* path = realpath(filename.c_str(), nullptr);
+#endif
+    std::string result = path ? path : filename;
+    std::free(path);
+    return result;
+}
 
-    rand_init();
+// Cache file name, assets with the same name in different directories get different caches
+std::string GetSceneCacheName(std::string const& fullpath)
+{
+    // FNV-1a
+    unsigned long long hash = 14695981039346656037ull;
+    for (auto c : fullpath)
+    {
+        hash = (hash ^ (unsigned char)c) * 1099511628211ull;
+    }
 
-    AssimpAssetImporter assimp(texsys, "../../../Resources/CornellBox/orig.objm");
-    //AssimpAssetImporter assimp(texsys, "../../../Resources/cornell-box/CornellBox-Glossy.obj");
-    //AssimpAssetImporter assimp(texsys, "../../../Resources/crytek-sponza/sponza.obj");
+    char key[17];
+    std::snprintf(key, sizeof(key), "%016llx", hash);
 
-    assimp.onmaterial_ = [&world, &texsys](Material* mat)->int
+    return g_scene_cache_path + "/" + fullpath.substr(fullpath.find_last_of("/\\") + 1) + "." + key + ".bsc";
+}
+
+// Import asset into the empty world and commit it, through the scene cache if enabled
+void ImportAsset(World& world, TextureSystem const& texsys, std::string const& filename)
+{
+    auto onmaterial = [&world](Material* mat)->int
     {
-        world->materials_.push_back(std::unique_ptr<Material>(mat));
-        return (int)(world->materials_.size() - 1);
+        world.materials_.push_back(std::unique_ptr<Material>(mat));
+        return (int)(world.materials_.size() - 1);
     };
 
-    assimp.onprimitive_ = [&world](ShapeBundle* prim)
+    auto onprimitive = [&world](ShapeBundle* prim)
     {
-        world->shapebundles_.push_back(std::unique_ptr<ShapeBundle>(prim));
+        world.shapebundles_.push_back(std::unique_ptr<ShapeBundle>(prim));
     };
 
-    assimp.onlight_ = [&world](Light* light)
+    auto onlight = [&world](Light* light)
     {
-        world->lights_.push_back(std::unique_ptr<Light>(light));
+        world.lights_.push_back(std::unique_ptr<Light>(light));
     };
 
+    std::string cachefilename;
+    std::string fullpath;
+
+    if (!g_scene_cache_path.empty())
+    {
+        fullpath = GetFullPath(filename);
+        cachefilename = GetSceneCacheName(fullpath);
+
+        if (std::ifstream(cachefilename))
+        {
+            try
+            {
+                BinaryAssetImporter cache(texsys, cachefilename, fullpath);
+
+                std::cout << "Loading scene cache " << cachefilename << "\n";
+
+                cache.onmaterial_ = onmaterial;
+                cache.onprimitive_ = onprimitive;
+                cache.onlight_ = onlight;
+                cache.Import();
+
+#ifndef USE_EMBREE
+                if (cache.HasBvh())
+                {
+                    world.Commit(cache.CreateBvh(world.shapebundles_));
+                    return;
+                }
+#endif
+
+                world.Commit();
+                return;
+            }
+            catch (std::runtime_error& e)
+            {
+                // Stale or broken cache, drop whatever made it into the world and write it again
+                std::cout << e.what() << "\n";
+
+                world.accel_.reset();
+                world.lights_.clear();
+                world.shapebundles_.clear();
+                world.materials_.clear();
+            }
+        }
+    }
+
+    AssimpAssetImporter assimp(texsys, filename);
+    assimp.onmaterial_ = onmaterial;
+    assimp.onprimitive_ = onprimitive;
+    assimp.onlight_ = onlight;
+
+    SceneCacheWriter writer;
+
+    if (!cachefilename.empty())
+    {
+        assimp.SetCacheWriter(&writer);
+
+        // Materials are defined in the .mtl next to .obj files
+        std::string mtl = fullpath.substr(0, fullpath.find_last_of('.')) + ".mtl";
+        std::uint64_t size = 0;
+        std::int64_t mtime = 0;
+
+        writer.AddSource(fullpath);
+
+        if (SceneCache::GetFileInfo(mtl, size, mtime))
+        {
+            writer.AddSource(mtl);
+        }
+    }
+
     // Start assets import
     assimp.Import();
 
     // Build acceleration structure
-    world->Commit();
+    world.Commit();
+
+    if (!cachefilename.empty())
+    {
+#ifndef USE_EMBREE
+        writer.SetBvh(static_cast<Bvh const&>(*world.accel_));
+#endif
+        writer.Write(cachefilename);
+        std::cout << "Scene cache written to " << cachefilename << "\n";
+    }
+}
+
+std::unique_ptr<World> BuildWorld(TextureSystem const& texsys)
+{
+    // Create world
+    World* world = new World();
+    // Create camera
+    Camera* camera = new FirstPersonCamera(float3(0.0f, 1.0f, 3.5f), float3(0.0f, 1.0f, 0), float3(0, 1.f, 0), float2(0.01f, 10000.f), PI / 4, 1.f);
+    //Camera* camera = new PerscpectiveCamera(float3(0, 0, 0), float3(1, 0, 0), float3(0, 1, 0), float2(0.01f, 10000.f), PI / 3, 1.f);
+    //Camera* camera = new EnvironmentCamera(float3(0, 0, 0), float3(0,-1,0), float3(0, 0, 1), float2(0.01f, 10000.f));
+
+    rand_init();
+
+    // Import assets and build acceleration structure
+    ImportAsset(*world, texsys, "../../../Resources/CornellBox/orig.objm");
+    //ImportAsset(*world, texsys, "../../../Resources/cornell-box/CornellBox-Glossy.obj");
+    //ImportAsset(*world, texsys, "../../../Resources/crytek-sponza/sponza.obj");
+
     // Attach camera
     world->camera_ = std::unique_ptr<Camera>(camera);
     // Set background
@@ -1662,6 +1793,57 @@ std::unique_ptr<World> BuildWorldSanMiguel(TextureSystem const& texsys)
 //}
 
 
+// Texture memory budget in megabytes, set with -texbudget <MB>
+std::size_t g_texture_budget_mb = 1024;
+
+// Denoise the output, set with -denoise
+bool g_denoise = false;
+
+// AOVs to write along with the image, added with -aov <name>
+std::vector<std::string> g_aovs;
+
+// Number of render threads, set with -threads <N>, 0 uses all hardware threads
+int g_num_threads = 0;
+
+// Print texture residency statistics
+void PrintTextureStats(TextureSystem const& texsys)
+{
+    std::vector<TextureSystem::TextureStats> stats;
+    texsys.GetStatistics(stats);
+
+    std::size_t total = 0;
+    for (auto& s : stats)
+    {
+        std::cout << s.name << " (" << s.width << "x" << s.height << "): "
+                  << s.residenttiles << "/" << s.numtiles << " tiles resident, "
+                  << s.residentbytes / 1024 << " KB, "
+                  << s.loads << " loads, " << s.evictions << " evictions\n";
+        total += s.residentbytes;
+    }
+
+    std::cout << "Texture memory: " << total / (1024 * 1024) << " MB of " << g_texture_budget_mb << " MB budget\n";
+}
+
+#ifdef RENDER_STATS
+// Print render cost totals and per sample averages,
+// per pixel heatmaps are written with -aov stat_nodes etc.
+void PrintRenderStats()
+{
+    unsigned long long numsamples = std::max(RenderStats::GetNumSamples(), 1ULL);
+
+    std::cout << "Render stats over " << RenderStats::GetNumSamples() << " samples:\n";
+
+    for (int i = 0; i < RenderStats::kNumCounters; ++i)
+    {
+        RenderStats::Counter counter = (RenderStats::Counter)i;
+        std::cout << "  " << RenderStats::GetName(counter) << ": " << RenderStats::GetTotal(counter)
+                  << " (" << (double)RenderStats::GetTotal(counter) / numsamples << " per sample)\n";
+    }
+
+    std::cout << "  sample time: " << RenderStats::GetTotalTime() * 1e6 / numsamples << " us per sample\n";
+}
+#endif
+
 int main_1()
 {
     try
@@ -1672,18 +1854,36 @@ int main_1()
         // File name to render
         std::string filename = "result.png";
         int2 imgres = int2(512, 512);
+        // Create OpenImageIO based IO api
+        OiioImageIo io;
+
         // Create texture system
-        OiioTextureSystem texsys("../../../Resources/Textures");
+        NativeTextureSystem texsys("../../../Resources/Textures", io, g_texture_budget_mb * 1024 * 1024);
 
         // Build world
         std::cout << "Constructing world...\n";
         std::unique_ptr<World> world = BuildWorld(texsys);
 
-        // Create OpenImageIO based IO api
-        OiioImageIo io;
         // Create image plane writing to file
         FileImagePlane plane(filename, imgres, io);
 
+        if (g_denoise)
+        {
+            plane.SetDenoiser(new AtrousDenoiser(5, 0.5f, 0.1f, 0.2f, 0.05f, g_num_threads));
+        }
+
+        for (auto& name : g_aovs)
+        {
+            int channel = AovSample::Find(name);
+
+            if (channel < 0)
+            {
+                throw std::runtime_error("Unknown AOV " + name);
+            }
+
+            plane.AddAov(channel);
+        }
+
         // Create progress reporter
         class MyReporter : public ProgressReporter
         {
@@ -1713,11 +1913,13 @@ int main_1()
             new SobolSampler(1, new McRng()), // Image sampler
             new SobolSampler(4, new McRng()), // Light sampler
             new SobolSampler(4, new McRng()), // Brdf sampler
-            new MyReporter() // Progress reporter
+            new MyReporter(), // Progress reporter
+            int2(16, 16), // Tile size
+            g_num_threads // Number of threads
             );
 
         // Measure execution time
-        std::cout << "Starting rendering process...\n";
+        std::cout << "Starting rendering process on " << renderer.GetNumThreads() << " threads...\n";
         auto starttime = std::chrono::high_resolution_clock::now();
         renderer.Render(*world);
         auto endtime = std::chrono::high_resolution_clock::now();
@@ -1725,6 +1927,24 @@ int main_1()
 
         std::cout << "Rendering done\n";
         std::cout << "Image " << filename << " (" << imgres.x << "x" << imgres.y << ") rendered in " << exectime.count() / 1000.f << " s\n";
+
+        // Memory held by the scene, textures and film. Reported after rendering
+        // since light hierarchy and texture tiles are only built on demand.
+        MemoryReport memory;
+        world->GetMemoryUsage(memory);
+        texsys.GetMemoryUsage(memory);
+        plane.GetMemoryUsage(memory);
+
+        std::cout << "Memory usage:\n";
+        memory.Print(std::cout);
+
+        PrintTextureStats(texsys);
+
+#ifdef RENDER_STATS
+        PrintRenderStats();
+#endif
+
+        Profiler::Flush();
     }
     catch(std::runtime_error& e)
     {
@@ -1763,6 +1983,7 @@ int g_tile_count = 0;
 std::unique_ptr<ShaderManager>	g_shader_manager;
 
 std::vector<unsigned char> g_data;
+std::vector<float3> g_color;
 GLuint g_vertex_buffer;
 GLuint g_index_buffer;
 GLuint g_texture;
@@ -1770,6 +1991,7 @@ GLuint g_texture;
 class BufferImagePlane;
 std::unique_ptr<MtImageRenderer> g_renderer;
 std::unique_ptr<BufferImagePlane> g_imgplane;
+std::unique_ptr<ImageIo> g_imageio;
 std::unique_ptr<TextureSystem> g_texsys;
 FirstPersonCamera* g_camera;
 
@@ -1796,6 +2018,85 @@ public:
     void Clear()
     {
         std::fill(m_imgbuf.begin(), m_imgbuf.end(), float3(0.f, 0.f, 0.f, 0.f));
+
+        if (GetFeatureBuffer())
+        {
+            GetFeatureBuffer()->Clear();
+        }
+
+        ClearAovs();
+    }
+    
+    // Average the samples into color laid out the same way as the buffer,
+    // denoise them if denoiser is attached
+    void Resolve(std::vector<float3>& color) const
+    {
+        auto res = resolution();
+        std::vector<float3> image(res.x * res.y);
+
+        // Denoiser expects rows starting from y = 0
+        for (int y = 0; y < res.y; ++y)
+            for (int x = 0; x < res.x; ++x)
+            {
+                float3 const& value = m_imgbuf[res.x * (res.y - 1 - y) + x];
+                image[res.x * y + x] = value.w > 0.f ? value * (1.f / value.w) : float3();
+            }
+
+        Denoise(image);
+
+        color.resize(res.x * res.y);
+        for (int y = 0; y < res.y; ++y)
+            for (int x = 0; x < res.x; ++x)
+            {
+                color[res.x * (res.y - 1 - y) + x] = image[res.x * y + x];
+            }
+    }
+
+    // Write linear color along with AOV layers into a multi-layer image,
+    // rows go bottom up as FileImagePlane writes them
+    void WriteAovs(ImageIo& io, std::string const& filename) const
+    {
+        auto res = resolution();
+
+        std::vector<ImageIo::Layer> layers;
+
+        std::vector<float3> color;
+        Resolve(color);
+
+        layers.push_back(ImageIo::Layer("color", 3));
+        layers.back().data.resize(res.x * res.y * 3);
+
+        for (int i = 0; i < res.x * res.y; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                layers.back().data[3 * i + c] = color[i][c];
+            }
+        }
+
+        std::vector<float3> aov;
+        for (int channel = 0; channel < AovSample::kNumChannels; ++channel)
+        {
+            if (GetAovMask() & (1u << channel))
+            {
+                int nc = AovSample::GetNumComponents(channel);
+                GetAov(channel, aov);
+
+                layers.push_back(ImageIo::Layer(AovSample::GetName(channel), nc));
+                layers.back().data.resize(res.x * res.y * nc);
+
+                for (int y = 0; y < res.y; ++y)
+                    for (int x = 0; x < res.x; ++x)
+                    {
+                        for (int c = 0; c < nc; ++c)
+                        {
+                            layers.back().data[nc * (res.x * (res.y - 1 - y) + x) + c] = aov[res.x * y + x][c];
+                        }
+                    }
+            }
+        }
+
+        io.WriteLayers(filename, layers, res.x, res.y);
     }
     
     
@@ -1867,6 +2168,45 @@ void OnKey(int key, int x, int y)
     }
 }
 
+// AOVs requested with -aov are written to this file with 's' key and on exit
+std::string const g_aov_filename = "result_aovs.exr";
+
+void WriteAovs()
+{
+    if (g_imgplane && g_imgplane->GetAovMask())
+    {
+        g_imgplane->WriteAovs(*g_imageio, g_aov_filename);
+        std::cout << "AOVs written to " << g_aov_filename << "\n";
+    }
+}
+
+void OnChar(unsigned char key, int x, int y)
+{
+    if (key == 's')
+    {
+        try
+        {
+            WriteAovs();
+        }
+        catch (std::runtime_error& e)
+        {
+            std::cout << e.what() << "\n";
+        }
+    }
+}
+
+void OnExit()
+{
+    try
+    {
+        WriteAovs();
+    }
+    catch (std::runtime_error& e)
+    {
+        std::cout << e.what() << "\n";
+    }
+}
+
 void OnKeyUp(int key, int x, int y)
 {
     switch (key)
@@ -1990,7 +2330,8 @@ void InitGraphics()
 
     glBindTexture(GL_TEXTURE_2D, 0);
     
-    g_texsys.reset(new OiioTextureSystem("../../../Resources/Textures"));
+    g_imageio.reset(new OiioImageIo());
+    g_texsys.reset(new NativeTextureSystem("../../../Resources/Textures", *g_imageio, g_texture_budget_mb * 1024 * 1024));
     g_world = std::move(BuildWorld(*g_texsys));
     g_camera = (FirstPersonCamera*)g_world->camera_.get();
     
@@ -2000,16 +2341,35 @@ void InitGraphics()
     std::cout << "Kicking off rendering engine...\n";
     
     g_imgplane.reset(new BufferImagePlane(int2(g_window_width, g_window_height)));
+
+    if (g_denoise)
+    {
+        g_imgplane->SetDenoiser(new AtrousDenoiser(5, 0.5f, 0.1f, 0.2f, 0.05f, g_num_threads));
+    }
+
+    for (auto& name : g_aovs)
+    {
+        int channel = AovSample::Find(name);
+
+        if (channel < 0)
+        {
+            throw std::runtime_error("Unknown AOV " + name);
+        }
+
+        g_imgplane->AddAov(channel);
+    }
     
     g_renderer.reset(new
                      MtImageRenderer(*g_imgplane, // Image plane
                      new GiTracer(5), // Tracer
-                                     new SobolSampler(1, new McRng()), // Image sampler
-                                     new SobolSampler(4, new McRng()), // Light sampler
-                                     new SobolSampler(4, new McRng()), // Brdf sampler
+                                     new BlueNoiseSampler(1, new McRng()), // Image sampler
+                                     new BlueNoiseSampler(4, new McRng()), // Light sampler
+                                     new BlueNoiseSampler(4, new McRng()), // Brdf sampler
                                      //&plane.indices_[0],
                                      //plane.numindices_,
-                                     nullptr // Progress reporter
+                                     nullptr, // Progress reporter
+                                     int2(16, 16), // Tile size
+                                     g_num_threads // Number of threads
                                      ));
 
 
@@ -2096,6 +2456,28 @@ private:
 
 UlamSpiral g_spiral;
 
+// Set once statistics have been printed
+bool g_report_printed = false;
+
+// Print statistics gathered over the first full pass, light hierarchy
+// and texture tiles are built on demand so they are only complete by then
+void PrintReport()
+{
+    MemoryReport memory;
+    g_world->GetMemoryUsage(memory);
+    g_texsys->GetMemoryUsage(memory);
+    g_imgplane->GetMemoryUsage(memory);
+
+    std::cout << "Memory usage:\n";
+    memory.Print(std::cout);
+
+    PrintTextureStats(*g_texsys);
+
+#ifdef RENDER_STATS
+    PrintRenderStats();
+#endif
+}
+
 void Update()
 {
     static auto prevtime = std::chrono::high_resolution_clock::now();
@@ -2159,14 +2541,26 @@ void Update()
 
         g_renderer->RenderTile(*g_world, int2(g_tile_width * tilex, g_tile_height * tiley), int2(g_tile_width, g_tile_height));
         
-        for (int i = 0; i < g_window_width * g_window_height; ++i)
+        // Denoised preview is refreshed once all the tiles have been rendered
+        if (!g_denoise || g_tile_count + 1 == g_tiles_x * g_tiles_y)
         {
-            g_data[3 * i] = (unsigned  char)(255 * clamp(powf(g_imgplane->m_imgbuf[i].x / g_imgplane->m_imgbuf[i].w, 1.f / 2.2f), 0.f, 1.f));
-            g_data[3 * i + 1] = (unsigned char)(255 * clamp(powf(g_imgplane->m_imgbuf[i].y / g_imgplane->m_imgbuf[i].w, 1.f / 2.2f), 0.f, 1.f));
-            g_data[3 * i + 2] = (unsigned char)(255 * clamp(powf(g_imgplane->m_imgbuf[i].z / g_imgplane->m_imgbuf[i].w, 1.f / 2.2f), 0.f, 1.f));
+            g_imgplane->Resolve(g_color);
+
+            for (int i = 0; i < g_window_width * g_window_height; ++i)
+            {
+                g_data[3 * i] = (unsigned  char)(255 * clamp(powf(g_color[i].x, 1.f / 2.2f), 0.f, 1.f));
+                g_data[3 * i + 1] = (unsigned char)(255 * clamp(powf(g_color[i].y, 1.f / 2.2f), 0.f, 1.f));
+                g_data[3 * i + 2] = (unsigned char)(255 * clamp(powf(g_color[i].z, 1.f / 2.2f), 0.f, 1.f));
+            }
         }
 
         g_tile_count++;
+
+        if (!g_report_printed && g_tile_count == g_tiles_x * g_tiles_y)
+        {
+            PrintReport();
+            g_report_printed = true;
+        }
     }
    
     glActiveTexture(GL_TEXTURE0);
@@ -2206,6 +2600,47 @@ void Reshape(GLint w, GLint h)
 
 int main(int argc, char** argv)
 {
+    // Parse command line
+    for (int i = 1; i < argc - 1; ++i)
+    {
+        if (std::string(argv[i]) == "-texbudget")
+        {
+            g_texture_budget_mb = std::stoul(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "-aov")
+        {
+            g_aovs.push_back(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "-scenecache")
+        {
+            g_scene_cache_path = argv[++i];
+        }
+        else if (std::string(argv[i]) == "-threads")
+        {
+            g_num_threads = std::stoi(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "-trace")
+        {
+            Profiler::Enable(argv[++i]);
+        }
+    }
+
+    // Chrome trace is written on exit if -trace or BANSHEE_TRACE is given
+    if (!Profiler::IsEnabled())
+    {
+        Profiler::EnableFromEnvironment();
+    }
+
+    Profiler::SetThreadName("main");
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "-denoise")
+        {
+            g_denoise = true;
+        }
+    }
+
      // GLUT Window Initialization:
     glutInit (&argc, (char**)argv);
     glutInitWindowSize (g_window_width, g_window_height);
@@ -2227,12 +2662,16 @@ int main(int argc, char** argv)
 
         InitGraphics();
 
+        // GLUT leaves the main loop through exit()
+        std::atexit(OnExit);
+
         // Register callbacks:
         glutDisplayFunc (Display);
         glutReshapeFunc (Reshape);
         
         glutSpecialFunc(OnKey);
         glutSpecialUpFunc(OnKeyUp);
+        glutKeyboardFunc(OnChar);
         glutMouseFunc(OnMouseButton);
         glutMotionFunc(OnMouseMove);
         glutIdleFunc (Update);
@@ -32,6 +32,7 @@
 #include "light/pointlight.h"
 #include "light/directional_light.h"
 #include "light/arealight.h"
+#include "light/meshlight.h"
 #include "light/environment_light.h"
 #include "sampler/regular_sampler.h"
 #include "sampler/stratified_sampler.h"
@@ -360,11 +361,8 @@ public:
         world->materials_.push_back(std::unique_ptr<Material>(sm));
         world->materials_.push_back(std::unique_ptr<Material>(emissive));
         
-        for (size_t i = 0; i < lightmesh->GetNumShapes(); ++i)
-        {
-            AreaLight* light = new AreaLight(i, *lightmesh, *emissive);
-            world->lights_.push_back(std::unique_ptr<Light>(light));
-        }
+        MeshLight* light = new MeshLight(*lightmesh, *emissive);
+        world->lights_.push_back(std::unique_ptr<Light>(light));
         
         AssimpAssetImporter assimp(*texsys_, "../../../Resources/test/sphere.obj");
         assimp.onprimitive_ = [&world](ShapeBundle* prim)
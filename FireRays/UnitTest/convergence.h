@@ -0,0 +1,148 @@
+#ifndef CONVERGENCE_H
+#define CONVERGENCE_H
+
+/// Time to quality measurements: renders test scenes with increasing
+/// sample counts and records error against high spp references
+
+#include <gtest/gtest.h>
+
+#include "basic_features.h"
+
+#include <chrono>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <functional>
+#include <cmath>
+
+extern bool g_convergence;
+extern int  g_convergence_spp;
+extern int  g_reference_spp;
+
+class Convergence : public BasicFeatures
+{
+public:
+    // Point of convergence curve
+    struct Point
+    {
+        int spp;
+        float seconds;
+        float rmse;
+        float relmse;
+    };
+
+    // Tracer and sampler factories of a configuration,
+    // samplers get the number of samples per pixel
+    typedef std::function<Tracer* ()> TracerFactory;
+    typedef std::function<Sampler* (int)> SamplerFactory;
+
+    // Render one image and return wall clock time in seconds
+    float Render(std::string const& filename, int spp, TracerFactory const& tracer, SamplerFactory const& sampler)
+    {
+        FileImagePlane imgplane(filename, g_imgres, io_);
+
+        MtImageRenderer imgrenderer(
+                            imgplane, // Image plane
+                            tracer(), // Tracer
+                            sampler(spp), // Image sampler
+                            sampler(1), // Light sampler
+                            sampler(1) // Brdf sampler
+                            );
+
+        auto starttime = std::chrono::high_resolution_clock::now();
+        imgrenderer.Render(*world_);
+        auto endtime = std::chrono::high_resolution_clock::now();
+
+        return std::chrono::duration_cast<std::chrono::duration<float> >(endtime - starttime).count();
+    }
+
+    // Render the sweep of 1, 4, 16... g_convergence_spp samples per pixel, compare
+    // each image to the reference and write the curve into <name>.csv next to the images.
+    // Reference is rendered with g_reference_spp Sobol samples if it is not there yet.
+    void Sweep(std::string const& name, std::string const& reference, TracerFactory const& tracer, SamplerFactory const& sampler, std::vector<Point>& curve)
+    {
+        std::string testcase = ::testing::UnitTest::GetInstance()->current_test_info()->test_case_name();
+        std::string reffilename = g_ref_image_path + "/" + testcase + "." + reference + ".exr";
+
+        if (!std::ifstream(reffilename))
+        {
+            std::cout << "Rendering reference " << reffilename << "\n";
+            Render(reffilename, g_reference_spp, tracer, [](int spp) { return new SobolSampler(spp, new McRng()); });
+        }
+
+        std::string basename = g_output_image_path + "/" + testcase + "." + name;
+        std::ofstream csv(basename + ".csv");
+        csv << "spp,seconds,rmse,relmse\n";
+
+        curve.clear();
+
+        for (int spp = 1; spp <= g_convergence_spp; spp *= 4)
+        {
+            std::ostringstream filename;
+            filename << basename << "." << spp << ".exr";
+
+            Point point;
+            point.spp = spp;
+            point.seconds = Render(filename.str(), spp, tracer, sampler);
+
+            ImgCompare::Statistics stat;
+            imgcmp_->Compare(reffilename, filename.str(), stat);
+
+            ASSERT_EQ(stat.sizediff, false);
+
+            point.rmse = stat.rmse;
+            point.relmse = stat.relmse;
+            curve.push_back(point);
+
+            csv << point.spp << "," << point.seconds << "," << point.rmse << "," << point.relmse << "\n";
+            std::cout << name << ": " << spp << " spp, " << point.seconds << " s, RMSE " << point.rmse << ", relMSE " << point.relmse << "\n";
+        }
+    }
+
+    // Run the sweep on Cornell box and check the error goes down
+    void Run(std::string const& name, std::string const& reference, TracerFactory const& tracer, SamplerFactory const& sampler)
+    {
+        if (!g_convergence)
+        {
+            return;
+        }
+
+        world_ = BuildWorldCornellBox();
+
+        std::vector<Point> curve;
+        ASSERT_NO_THROW(Sweep(name, reference, tracer, sampler, curve));
+
+        ASSERT_GT(curve.size(), 1);
+        ASSERT_LT(curve.back().relmse, curve.front().relmse);
+    }
+};
+
+TEST_F(Convergence, CornellBoxDiSobol)
+{
+    Run("CornellBoxDiSobol", "CornellBoxDi",
+        []() { return new DiTracer(); },
+        [](int spp) { return new SobolSampler(spp, new McRng()); });
+}
+
+TEST_F(Convergence, CornellBoxDiCmj)
+{
+    Run("CornellBoxDiCmj", "CornellBoxDi",
+        []() { return new DiTracer(); },
+        [](int spp) { return new CmjSampler((int)std::sqrt((float)spp), new McRng()); });
+}
+
+TEST_F(Convergence, CornellBoxGiSobol)
+{
+    Run("CornellBoxGiSobol", "CornellBoxGi",
+        []() { return new GiTracer(3); },
+        [](int spp) { return new SobolSampler(spp, new McRng()); });
+}
+
+TEST_F(Convergence, CornellBoxGiCmj)
+{
+    Run("CornellBoxGiCmj", "CornellBoxGi",
+        []() { return new GiTracer(3); },
+        [](int spp) { return new CmjSampler((int)std::sqrt((float)spp), new McRng()); });
+}
+
+#endif // CONVERGENCE_H
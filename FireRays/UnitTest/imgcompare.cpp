@@ -1,6 +1,7 @@
 #include "imgcompare.h"
 
 #include <cmath>
+#include <algorithm>
 
 void ImgCompare::Compare(std::string const& img1, std::string const& img2, Statistics& stat, float eps)
 {
@@ -14,17 +15,32 @@ void ImgCompare::Compare(std::string const& img1, std::string const& img2, Stati
     {
         stat.sizediff = true;
         stat.ndiff = -1;
+        stat.rmse = -1.f;
+        stat.relmse = -1.f;
         return;
     }
     
     stat.sizediff = false;
     stat.ndiff = 0;
     
+    double mse = 0.0;
+    double relmse = 0.0;
+    
     for (int i=0; i<(int)imgdata1.size(); ++i)
     {
-        if (std::abs(imgdata1[i] - imgdata2[i]) > eps)
+        float diff = imgdata1[i] - imgdata2[i];
+        
+        if (std::abs(diff) > eps)
         {
             ++stat.ndiff;
         }
+        
+        mse += diff * diff;
+        // Small bias keeps dark reference pixels from dominating relative error
+        relmse += diff * diff / (imgdata1[i] * imgdata1[i] + 0.01f);
     }
+    
+    std::size_t n = std::max<std::size_t>(imgdata1.size(), 1);
+    stat.rmse = (float)std::sqrt(mse / n);
+    stat.relmse = (float)(relmse / n);
 }
@@ -15,7 +15,7 @@ public:
     // Image comparison statistics
     struct Statistics;
     
-    // Comparator
+    // Comparator, img1 is treated as a reference for error metrics
     virtual void Compare(std::string const& img1, std::string const& img2, Statistics& stat, float eps = 0.f);
     
     // Image I/O
@@ -30,6 +30,10 @@ struct ImgCompare::Statistics
     bool formatdiff;
     // Number of different pixels if sizes are equal
     int ndiff;
+    // Root mean square error over all the channels
+    float rmse;
+    // Relative mean square error: squared error divided by squared reference value
+    float relmse;
 };
 
 
@@ -11,15 +11,58 @@
 #include <stdexcept>
 #include <sstream>
 #include <iostream>
+#include <cstdio>
+#include <map>
+#include <fstream>
+#include <thread>
 
 #include "math/mathutils.h"
 #include "math/distribution1d.h"
 #include "math/distribution2d.h"
+#include "math/alias_distribution1d.h"
+#include "math/alias_distribution2d.h"
+#include "math/hierarchical_distribution2d.h"
 
 #include "primitive/shapebundle.h"
 
 #include "texture/oiio_texturesystem.h"
+#include "texture/environment_map.h"
+#include "texture/native_texturesystem.h"
+#include "imageio/imageio.h"
 #include "light/environment_light_is.h"
+#include "light/pointlight.h"
+#include "light/directional_light.h"
+#include "light/light_bvh.h"
+#include "light/meshlight.h"
+#include "light/light_set.h"
+#include "material/emissive.h"
+#include "material/simplematerial.h"
+#include "bsdf/lambert.h"
+#include "bsdf/normal_mapping.h"
+#include "bsdf/orennayar.h"
+#include "bsdf/microfacet.h"
+#include "bsdf/perfect_reflect.h"
+#include "bsdf/perfect_refract.h"
+#include "bsdf/closure.h"
+#include "material/mixedmaterial.h"
+#include "primitive/mesh.h"
+#include "camera/perspective_camera.h"
+#include "util/arena.h"
+#include "sampler/sobol_sampler.h"
+#include "sampler/bluenoise_sampler.h"
+#include "sampler/cmj_sampler.h"
+#include "denoiser/atrous_denoiser.h"
+#include "imageplane/fileimageplane.h"
+#include "aov/aov.h"
+#include "sampler/sample_cursor.h"
+#include "rng/mcrng.h"
+#include "util/renderstats.h"
+#include "util/profiler.h"
+#include "util/memoryreport.h"
+#include "async/thread_pool.h"
+#include "import/scenecache.h"
+#include "import/binary_assetimporter.h"
+#include "accelerator/bvh.h"
 
 extern std::string g_output_image_path;
 extern std::string g_ref_image_path;
@@ -40,6 +83,48 @@ public:
     {
         
     }
+
+    // Two triangle [-1,1]x[-1,1] quad in z = 0 plane facing -z,
+    // u goes along x and v along y
+    Mesh* CreateQuad(int material) const
+    {
+        float3 vertices[4] = {
+            float3(-1, -1, 0),
+            float3(1, -1, 0),
+            float3(1, 1, 0),
+            float3(-1, 1, 0)
+        };
+
+        float3 normals[4] = {
+            float3(0, 0, -1),
+            float3(0, 0, -1),
+            float3(0, 0, -1),
+            float3(0, 0, -1)
+        };
+
+        float2 uvs[4] = {
+            float2(0, 0),
+            float2(1, 0),
+            float2(1, 1),
+            float2(0, 1)
+        };
+
+        int indices[6] = {
+            0, 1, 2,
+            0, 2, 3
+        };
+
+        int materials[2] = {material, material};
+
+        return new Mesh(&vertices[0].x, 4, sizeof(float3),
+                        &normals[0].x, 4, sizeof(float3),
+                        &uvs[0].x, 4, sizeof(float2),
+                        indices, sizeof(int),
+                        indices, sizeof(int),
+                        indices, sizeof(int),
+                        materials, sizeof(int),
+                        2);
+    }
 };
 
 
@@ -128,11 +213,214 @@ TEST_F(Internals, Distribution2D_Pdf)
     }
 }
 
+///< Alias method distribution should match CDF inversion one
+TEST_F(Internals, AliasDistribution1D)
+{
+    static int kNumSamples = 10000;
+    float pdf[] = {0.1f, 0.9f, 0.0f, 0.3f, 0.1f};
+    
+    Distribution1D dist(5, pdf);
+    AliasDistribution1D aliasdist(5, pdf);
+    
+    int bins[5] = {0, 0, 0, 0, 0};
+    
+    for (int i = 0; i < kNumSamples; ++i)
+    {
+        float vpdf = 0.f;
+        float v = aliasdist.Sample1D(rand_float(), vpdf);
+
+        ASSERT_LE(fabs(vpdf - aliasdist.Pdf(v)), 0.001f);
+        
+        bins[clamp((int)(v * 5), 0, 4)]++;
+    }
+
+    for (int i = 0; i < 5; ++i)
+    {
+        float expected = dist.funcvals_[i] / (dist.funcint_ * 5);
+
+        ASSERT_LE(fabs(aliasdist.SegmentPmf(i) - expected), 0.001f);
+        ASSERT_LE(fabs((float)bins[i] / kNumSamples - expected), 0.02f);
+    }
+}
+
+///< Alias method 2D distribution PDFs should match regular one
+TEST_F(Internals, AliasDistribution2D_Pdf)
+{
+    static int kNumSamples = 10000;
+    float pdf[] = {0.2f, 0.2f, 0.9f, 0.0f, 0.5f, 0.1f};
+    
+    Distribution2D dist(3,2,pdf);
+    AliasDistribution2D aliasdist(3,2,pdf);
+    
+    for (int i = 0; i < kNumSamples; ++i)
+    {
+        float vpdf = 0.f;
+        float2 v = aliasdist.Sample2D(float2(rand_float(), rand_float()), vpdf);
+
+        ASSERT_GT(vpdf, 0.f);
+        ASSERT_LE(fabs(vpdf - aliasdist.Pdf(v)), 0.001f);
+        ASSERT_LE(fabs(vpdf - dist.Pdf(v)), 0.001f);
+    }
+}
+
+///< Hierarchical 2D distribution PDFs should match regular one
+TEST_F(Internals, HierarchicalDistribution2D_Pdf)
+{
+    static int kNumSamples = 10000;
+    float pdf[] = {0.2f, 0.2f, 0.9f, 0.0f, 0.5f, 0.1f};
+    
+    Distribution2D dist(3,2,pdf);
+    HierarchicalDistribution2D hdist(3,2,pdf);
+    
+    int bins[2][3] = {0, 0, 0, 0, 0, 0};
+
+    for (int i = 0; i < kNumSamples; ++i)
+    {
+        float vpdf = 0.f;
+        float2 v = hdist.Sample2D(float2(rand_float(), rand_float()), vpdf);
+
+        ASSERT_GT(vpdf, 0.f);
+        ASSERT_LE(fabs(vpdf - hdist.Pdf(v)), 0.001f);
+        ASSERT_LE(fabs(vpdf - dist.Pdf(v)), 0.001f);
+
+        bins[clamp((int)(v.y * 2), 0, 1)][clamp((int)(v.x * 3), 0, 2)]++;
+    }
+
+    for (int i = 0; i < 6; ++i)
+    {
+        ASSERT_LE(fabs((float)bins[i / 3][i % 3] / kNumSamples - pdf[i] / 1.9f), 0.02f);
+    }
+}
+
+///< Hierarchical 2D distribution of zero function should be uniform
+TEST_F(Internals, HierarchicalDistribution2D_Zero)
+{
+    float pdf[] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+
+    HierarchicalDistribution2D hdist(3,2,pdf);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        float vpdf = 0.f;
+        float2 v = hdist.Sample2D(float2(rand_float(), rand_float()), vpdf);
+
+        ASSERT_LE(fabs(vpdf - 1.f), 0.001f);
+        ASSERT_LE(fabs(hdist.Pdf(v) - 1.f), 0.001f);
+        ASSERT_TRUE(v.x >= 0.f && v.x < 1.f && v.y >= 0.f && v.y < 1.f);
+    }
+}
+
+///< Alias distributions of a zero function should fall back to uniform
+TEST_F(Internals, AliasDistribution1D_Zero)
+{
+    float pdf[] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+
+    AliasDistribution1D dist(6,pdf);
+    AliasDistribution2D dist2d(3,2,pdf);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        float vpdf = 0.f;
+        float v = dist.Sample1D(rand_float(), vpdf);
+
+        ASSERT_LE(fabs(vpdf - 1.f), 0.001f);
+        ASSERT_LE(fabs(dist.Pdf(v) - 1.f), 0.001f);
+        ASSERT_TRUE(v >= 0.f && v < 1.f);
+
+        float2 v2 = dist2d.Sample2D(float2(rand_float(), rand_float()), vpdf);
+
+        ASSERT_LE(fabs(vpdf - 1.f), 0.001f);
+        ASSERT_LE(fabs(dist2d.Pdf(v2) - 1.f), 0.001f);
+        ASSERT_TRUE(v2.x >= 0.f && v2.x < 1.f && v2.y >= 0.f && v2.y < 1.f);
+    }
+
+    // Zero row of a nonzero function is never sampled
+    float pdf1[] = {1.f, 2.f, 3.f, 0.f, 0.f, 0.f};
+    AliasDistribution2D dist2d1(3,2,pdf1);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        float vpdf = 0.f;
+        float2 v2 = dist2d1.Sample2D(float2(rand_float(), rand_float()), vpdf);
+
+        ASSERT_LT(v2.y, 0.5f);
+        ASSERT_LE(fabs(dist2d1.Pdf(v2) - vpdf), 0.001f);
+    }
+
+    ASSERT_EQ(dist2d1.Pdf(float2(0.5f, 0.75f)), 0.f);
+}
+
+///< Procedural texture returning its texture coordinates
+class UvTextureSystem : public TextureSystem
+{
+public:
+    float3 Sample(std::string const& filename, float2 const& uv, float2 const& duvdx, Options const& opts = Options()) const
+    {
+        return float3(uv.x, uv.y, 0.25f);
+    }
+
+    void GetTextureInfo(std::string const& filename, TextureDesc& texdesc) const
+    {
+        texdesc.width = 8;
+        texdesc.height = 4;
+    }
+};
+
+///< Baked environment map should match the texture at texel centers and blend in between
+TEST_F(Internals, EnvironmentMap)
+{
+    UvTextureSystem texsys;
+    EnvironmentMap envmap(texsys, "uv", 2.f, 1.f);
+
+    ASSERT_EQ(envmap.GetWidth(), 8);
+    ASSERT_EQ(envmap.GetHeight(), 4);
+
+    for (int y = 0; y < 4; ++y)
+    {
+        for (int x = 0; x < 8; ++x)
+        {
+            float2 uv((x + 0.5f) / 8, (y + 0.5f) / 4);
+            float3 v = envmap.Sample(uv);
+
+            ASSERT_LE(fabs(v.x - 2.f * uv.x), 0.001f);
+            ASSERT_LE(fabs(v.y - 2.f * uv.y), 0.001f);
+            ASSERT_LE(fabs(v.z - 0.5f), 0.001f);
+        }
+    }
+
+    // Halfway between two texel centers
+    float3 v = envmap.Sample(float2(2.f / 8, 1.5f / 4));
+    ASSERT_LE(fabs(v.x - 2.f * (2.f / 8)), 0.001f);
+
+    // Direction mapping matches spherical coordinates
+    float r, phi, theta;
+    float3 d = normalize(float3(0.3f, -0.5f, 0.8f));
+    cartesian_to_spherical(d, r, phi, theta);
+
+    float2 uv = envmap.GetUv(d);
+    ASSERT_LE(fabs(uv.x - phi / (2 * PI)), 0.001f);
+    ASSERT_LE(fabs(uv.y - theta / PI), 0.001f);
+
+    // Tabulated mapping stays close to atan2 and acos in all octants
+    for (int i = 0; i < 1000; ++i)
+    {
+        d = float3(2.f * rand_float() - 1.f, 2.f * rand_float() - 1.f, 2.f * rand_float() - 1.f);
+
+        float refphi = std::atan2(d.z, d.x);
+        refphi = refphi >= 0.f ? refphi : refphi + 2.f * PI;
+        float reftheta = std::acos(clamp(d.y / std::sqrt(d.sqnorm()), -1.f, 1.f));
+
+        uv = envmap.GetUv(d);
+        ASSERT_LE(fabs(uv.x - refphi / (2 * PI)), 0.0001f);
+        ASSERT_LE(fabs(uv.y - reftheta / PI), 0.0001f);
+    }
+}
+
 
 ///< EnvironmentLight with importance sampling 
 TEST_F(Internals, EnvironmentLightIs)
 {
-    OiioTextureSystem texsys("../../../Resources/Textures");
+    OiioTextureSystem texsys(g_texture_path);
     EnvironmentLightIs* light1 = new EnvironmentLightIs(texsys, "Apartment.hdr", 0.6f);
 
     static int kNumSamples = 10000;
@@ -151,7 +439,1185 @@ TEST_F(Internals, EnvironmentLightIs)
     }
 }
 
+///< Light hierarchy selection probabilities
+TEST_F(Internals, LightBvh)
+{
+    static int kNumLights = 100;
+    static int kNumSamples = 10000;
+
+    std::vector<std::unique_ptr<Light> > lights;
+    for (int i = 0; i < kNumLights; ++i)
+    {
+        float3 p(10.f * rand_float(), 10.f * rand_float(), 10.f * rand_float());
+        float3 e(rand_float(), rand_float(), rand_float());
+        lights.push_back(std::unique_ptr<Light>(new PointLight(p, e)));
+    }
+
+    lights.push_back(std::unique_ptr<Light>(new DirectionalLight(float3(0.f, -1.f, 0.f), float3(1.f, 1.f, 1.f))));
+
+    LightBvh lightbvh;
+    lightbvh.Build(lights);
+
+    ShapeBundle::Hit hit;
+    hit.p = float3(5.f, 5.f, 5.f);
+    hit.n = float3(0.f, 1.f, 0.f);
+
+    // Probabilities should sum up to one
+    float sum = 0.f;
+    for (int i = 0; i < (int)lights.size(); ++i)
+    {
+        sum += lightbvh.GetPdf(hit, i);
+    }
+
+    ASSERT_LE(fabs(sum - 1.f), 0.001f);
+
+    // Sampled probability should match the one evaluated
+    for (int i = 0; i < kNumSamples; ++i)
+    {
+        float pdf = 0.f;
+        int idx = lightbvh.Sample(hit, rand_float(), pdf);
+
+        ASSERT_GE(idx, 0);
+        ASSERT_LE(fabs(pdf - lightbvh.GetPdf(hit, idx)), 0.001f);
+    }
+}
+
+///< Mesh light sampling PDF should match evaluated one
+TEST_F(Internals, MeshLight)
+{
+    static int kNumSamples = 10000;
+
+    std::unique_ptr<Mesh> quad(CreateQuad(0));
+    Mesh& mesh = *quad;
+
+    // Light above the origin facing down
+    matrix worldmat = translation(float3(0, 3.f, 0)) * scale(float3(2.f, 1.f, 0.5f)) * rotation_x(-PI / 2);
+    mesh.SetTransform(worldmat, inverse(worldmat));
+
+    Emissive emissive(float3(20.f, 18.f, 14.f));
+    MeshLight light(mesh, emissive);
+
+    ShapeBundle::Hit hit;
+    hit.p = float3(0.3f, 0.f, 0.1f);
+    hit.n = float3(0.f, 1.f, 0.f);
+
+    for (int i = 0; i < kNumSamples; ++i)
+    {
+        float3 d;
+        float pdf = 0.f;
+        light.GetSample(hit, float2(rand_float(), rand_float()), d, pdf);
+
+        ASSERT_GT(pdf, 0.f);
+
+        float pdf1 = light.GetPdf(hit, normalize(d));
+
+        ASSERT_LE(fabs(pdf - pdf1), 0.001f * pdf);
+    }
+}
+
+
+///< Image loader generating a gradient of requested size, name is "<width>x<height>"
+class GradientImageIo : public ImageIo
+{
+public:
+    void Read(std::string const& name, std::vector<float>& data, ImageDesc& desc)
+    {
+        int width = 0;
+        int height = 0;
+        std::sscanf(name.c_str(), "%dx%d", &width, &height);
+
+        data.resize(width * height * 3);
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                data[3 * (y * width + x)] = (float)x;
+                data[3 * (y * width + x) + 1] = (float)y;
+                data[3 * (y * width + x) + 2] = 1.f;
+            }
+        }
+
+        desc = ImageDesc(width, height, 3);
+    }
+
+    void Write(std::string const& name, std::vector<float> const& data, ImageDesc const& desc)
+    {
+    }
+};
+
+///< Native texture system should return texels through handles,
+///< build MIP pyramid and reload evicted tiles when the pool is small
+TEST_F(Internals, NativeTextureSystem)
+{
+    static int kNumSamples = 10000;
+    GradientImageIo io;
+    // Smallest possible pool to force eviction
+    NativeTextureSystem texsys("", io, 0);
+
+    ASSERT_EQ(texsys.GetHandle(""), -1);
+
+    int handle = texsys.GetHandle("128x64");
+    ASSERT_EQ(texsys.GetHandle("128x64"), handle);
+
+    TextureSystem::TextureDesc desc;
+    texsys.GetTextureInfo("128x64", desc);
+    ASSERT_EQ(desc.width, 128);
+    ASSERT_EQ(desc.height, 64);
+
+    TextureSystem::Options point(TextureSystem::Options::kPoint);
+
+    // Texel centers
+    for (int i = 0; i < kNumSamples; ++i)
+    {
+        int x = rand_uint() % 128;
+        int y = rand_uint() % 64;
+
+        float3 val = texsys.Sample(handle, float2((x + 0.5f) / 128, (y + 0.5f) / 64), float2(), point);
+        ASSERT_EQ(val.x, (float)x);
+        ASSERT_EQ(val.y, (float)y);
+        ASSERT_EQ(val.z, 1.f);
+    }
+
+    // Bilinear halfway between texels
+    float3 val = texsys.Sample(handle, float2(11.f / 128, 33.f / 64), float2());
+    ASSERT_NEAR(val.x, 10.5f, 0.001f);
+    ASSERT_NEAR(val.y, 32.5f, 0.001f);
+
+    // Footprint covering the whole texture hits the coarsest level
+    val = texsys.Sample(handle, float2(0.3f, 0.6f), float2(1.f, 1.f));
+    ASSERT_NEAR(val.x, 63.5f, 0.001f);
+    ASSERT_NEAR(val.y, 31.5f, 0.001f);
+
+    // Second texture does not fit into the pool together with the first one
+    int handle1 = texsys.GetHandle("256x256");
+    ASSERT_NE(handle1, handle);
+
+    for (int i = 0; i < kNumSamples; ++i)
+    {
+        int t = rand_uint() % 2;
+        int w = t ? 256 : 128;
+        int h = t ? 256 : 64;
+        int x = rand_uint() % w;
+        int y = rand_uint() % h;
+
+        val = texsys.Sample(t ? handle1 : handle, float2((x + 0.5f) / w, (y + 0.5f) / h), float2(), point);
+        ASSERT_EQ(val.x, (float)x);
+        ASSERT_EQ(val.y, (float)y);
+    }
+
+    // Residency never exceeds the pool and evicted tiles got reloaded
+    std::vector<TextureSystem::TextureStats> stats;
+    texsys.GetStatistics(stats);
+
+    ASSERT_EQ(stats.size(), 2U);
+    ASSERT_EQ(stats[1].name, "256x256");
+    ASSERT_LE(stats[0].residenttiles + stats[1].residenttiles, 16);
+    ASSERT_GT(stats[1].evictions, 0);
+    ASSERT_EQ(stats[1].loads - stats[1].evictions, stats[1].residenttiles);
+
+    // Changing the budget drops everything
+    texsys.SetMemoryBudget(1024 * 1024);
+    texsys.GetStatistics(stats);
+    ASSERT_EQ(stats[0].residenttiles, 0);
+
+    val = texsys.Sample(handle, float2(0.5f / 128, 0.5f / 64), float2(), point);
+    ASSERT_EQ(val.x, 0.f);
+}
+
+
+///< Image loader counting rows read through ReadRegion
+class CountingImageIo : public GradientImageIo
+{
+public:
+    CountingImageIo() : rows(0) {}
+
+    void ReadRegion(std::string const& name, unsigned x0, unsigned y0, unsigned x1, unsigned y1, std::vector<float>& data, ImageDesc& desc)
+    {
+        rows += y1 - y0;
+        GradientImageIo::ReadRegion(name, x0, y0, x1, y1, data, desc);
+    }
+
+    int rows;
+};
+
+///< Coarse MIP levels should be built reading each row once
+TEST_F(Internals, NativeTextureSystem_Pyramid)
+{
+    CountingImageIo io;
+    NativeTextureSystem texsys("", io);
+
+    int handle = texsys.GetHandle("256x128");
+
+    TextureSystem::Options point(TextureSystem::Options::kPoint);
+
+    // Coarsest level averages the whole texture
+    float3 val = texsys.Sample(handle, float2(0.5f, 0.5f), float2(1.f, 1.f), point);
+    ASSERT_NEAR(val.x, 127.5f, 0.001f);
+    ASSERT_NEAR(val.y, 63.5f, 0.001f);
+    ASSERT_EQ(io.rows, 128);
+
+    // Other coarse levels come from the same pass, level 3 texel averages 8x8 texels
+    val = texsys.Sample(handle, float2(5.5f / 32, 7.5f / 16), float2(8.f / 256, 0.f), point);
+    ASSERT_NEAR(val.x, 43.5f, 0.001f);
+    ASSERT_NEAR(val.y, 59.5f, 0.001f);
+
+    val = texsys.Sample(handle, float2(0.5f / 128, 63.5f / 64), float2(2.f / 256, 0.f), point);
+    ASSERT_NEAR(val.x, 0.5f, 0.001f);
+    ASSERT_NEAR(val.y, 126.5f, 0.001f);
+    ASSERT_EQ(io.rows, 128);
+
+    // Finest level is read a tile row at a time
+    val = texsys.Sample(handle, float2(200.5f / 256, 100.5f / 128), float2(), point);
+    ASSERT_EQ(val.x, 200.f);
+    ASSERT_EQ(val.y, 100.f);
+    ASSERT_EQ(io.rows, 128 + NativeTextureSystem::kTileSize);
+}
+
+///< Batched lookups should match single lookups for all filtering modes
+TEST_F(Internals, NativeTextureSystem_Batch)
+{
+    static int kNumSamples = 1000;
+    GradientImageIo io;
+    NativeTextureSystem texsys("", io);
+
+    int handle = texsys.GetHandle("100x60");
+
+    std::vector<float2> uvs(kNumSamples);
+    std::vector<float2> duvs(kNumSamples);
+    std::vector<float3> vals(kNumSamples);
+
+    for (int i = 0; i < kNumSamples; ++i)
+    {
+        uvs[i] = float2(4.f * rand_float() - 2.f, 4.f * rand_float() - 2.f);
+        duvs[i] = float2(0.1f * rand_float(), 0.1f * rand_float());
+    }
+
+    TextureSystem::Options options[] =
+    {
+        TextureSystem::Options(TextureSystem::Options::kPoint, TextureSystem::Options::kRepeat),
+        TextureSystem::Options(TextureSystem::Options::kBilinear, TextureSystem::Options::kRepeat),
+        TextureSystem::Options(TextureSystem::Options::kBilinear, TextureSystem::Options::kMirror)
+    };
+
+    for (auto& opts : options)
+    {
+        texsys.SampleBatch(handle, &uvs[0], &duvs[0], &vals[0], kNumSamples, opts);
+
+        for (int i = 0; i < kNumSamples; ++i)
+        {
+            float3 val = texsys.Sample(handle, uvs[i], duvs[i], opts);
+            ASSERT_EQ(vals[i].x, val.x);
+            ASSERT_EQ(vals[i].y, val.y);
+            ASSERT_EQ(vals[i].z, val.z);
+        }
+    }
+}
+
+///< Camera ray cone should give UV footprint of a pixel on a textured quad
+TEST_F(Internals, RayCone)
+{
+    std::unique_ptr<Mesh> quad(CreateQuad(0));
+    Mesh& mesh = *quad;
+
+    // 4x4 quad at distance 5, one UV unit spans 4 world units
+    matrix worldmat = translation(float3(0, 0, 5.f)) * scale(float3(2.f, 2.f, 1.f));
+    mesh.SetTransform(worldmat, inverse(worldmat));
+
+    PerscpectiveCamera camera(float3(0, 0, 0), float3(0, 0, 1), float3(0, 1, 0), float2(0.01f, 1000.f), PI / 4, 1.f);
+
+    ray r;
+    camera.GenerateRay(float2(0.5f, 0.5f), float2(1.f / 512, 1.f / 512), r);
+
+    // Pixel angular size at the image center
+    float spread = 2.f * std::tan(PI / 8) / 512;
+    ASSERT_NEAR(r.spread, spread, 0.0001f * spread);
+    ASSERT_EQ(r.width, 0.f);
+
+    ShapeBundle::Hit hit;
+    hit.t = r.t.y;
+
+    bool found = false;
+    for (int i = 0; i < (int)mesh.GetNumShapes(); ++i)
+    {
+        found = mesh.IntersectShape(i, r, hit) || found;
+    }
+
+    ASSERT_TRUE(found);
+    ASSERT_NEAR(hit.duv.x, spread * 5.f * 0.25f, 0.001f * spread);
+    ASSERT_NEAR(hit.duv.y, spread * 5.f * 0.25f, 0.001f * spread);
+}
+
+
+///< Traversal keeps geometric intersection only, shading data is filled for the closest one
+///< and the compact frame should reproduce UV derivatives directions
+TEST_F(Internals, HitFrame)
+{
+    std::unique_ptr<Mesh> quad(CreateQuad(0));
+    Mesh& mesh = *quad;
+
+    ray r(float3(0.3f, 0.2f, -5.f), float3(0, 0, 1), float2(0.01f, 1000.f));
+
+    ShapeBundle::Hit hit;
+    hit.t = r.t.y;
+
+    ShapeBundle::Intersection isect;
+    isect.t = r.t.y;
+
+    bool found = false;
+    bool foundisect = false;
+    for (int i = 0; i < (int)mesh.GetNumShapes(); ++i)
+    {
+        found = mesh.IntersectShape(i, r, hit) || found;
+        foundisect = mesh.IntersectShape(i, r, isect) || foundisect;
+    }
+
+    ASSERT_TRUE(found);
+    ASSERT_TRUE(foundisect);
+    ASSERT_EQ(isect.t, hit.t);
+    ASSERT_EQ(isect.shapeidx, hit.shapeidx);
+    ASSERT_EQ(isect.bundle, &mesh);
+
+    ShapeBundle::Hit deferred;
+    mesh.FillHit(isect, r, deferred);
+
+    ASSERT_LE((deferred.p - hit.p).sqnorm(), 0.000001f);
+    ASSERT_LE((deferred.uv - hit.uv).sqnorm(), 0.000001f);
+    ASSERT_EQ(deferred.shapeidx, hit.shapeidx);
+
+    // u goes along x, v along y, shading normal looks at -z, so the frame is left-handed
+    ASSERT_EQ(hit.handedness, -1.f);
+    ASSERT_NEAR(dot(hit.n, hit.dpdu), 0.f, 0.0001f);
+    ASSERT_NEAR(dot(hit.dpdu, float3(1, 0, 0)), 1.f, 0.0001f);
+    ASSERT_NEAR(dot(hit.dpdv(), float3(0, 1, 0)), 1.f, 0.0001f);
+}
+
+///< Procedural texture counting lookups
+class CountingTextureSystem : public UvTextureSystem
+{
+public:
+    CountingTextureSystem()
+    : numlookups(0)
+    {
+    }
+
+    float3 Sample(std::string const& filename, float2 const& uv, float2 const& duvdx, Options const& opts = Options()) const
+    {
+        ++numlookups;
+        return UvTextureSystem::Sample(filename, uv, duvdx, opts);
+    }
+
+    mutable int numlookups;
+};
+
+///< Material inputs and normal map should be resolved once per hit regardless of the number of BSDF queries
+TEST_F(Internals, ShadingContext)
+{
+    CountingTextureSystem texsys;
+    SimpleMaterial mat(new NormalMapping(new Lambert(texsys, float3(1.f, 1.f, 1.f), "kd"), "nmap"));
+
+    ShapeBundle::Hit hit;
+    hit.p = float3(0, 0, 0);
+    hit.n = hit.ng = float3(0, 0, 1);
+    hit.dpdu = float3(1, 0, 0);
+    hit.handedness = 1.f;
+    hit.uv = float2(0.75f, 0.5f);
+    hit.duv = float2(0, 0);
+
+    ShadingContext ctx;
+    mat.Prepare(hit, ctx);
+
+    ASSERT_EQ(texsys.numlookups, 2);
+
+    // Normal map value (0.75, 0.5, 0.25) decodes into (0.5, 0, -0.5)
+    float3 n = normalize(float3(0.5f, 0.f, -0.5f));
+    ASSERT_LE(std::abs(ctx.n.x - n.x), 0.001f);
+    ASSERT_LE(std::abs(ctx.n.z - n.z), 0.001f);
 
+    float3 wi = normalize(float3(0.f, 1.f, 1.f));
+    float3 wo = normalize(float3(1.f, 0.f, 1.f));
+
+    for (int i = 0; i < 10; ++i)
+    {
+        float3 f = mat.Evaluate(ctx, wi, wo);
+        ASSERT_LE(std::abs(f.x - 0.75f / PI), 0.001f);
+        ASSERT_LE(std::abs(f.z - 0.25f / PI), 0.001f);
+
+        float pdf = mat.GetPdf(ctx, wi, wo);
+        ASSERT_LE(std::abs(pdf - dot(ctx.n, wo) / PI), 0.001f);
+
+        float3 wos;
+        int type = 0;
+        mat.Sample(ctx, float2(rand_float(), rand_float()), wi, wos, pdf, type);
+    }
+
+    // Queries neither re-fetch textures nor re-map the normal
+    ASSERT_EQ(texsys.numlookups, 2);
+    ASSERT_LE(std::abs(ctx.n.x - n.x), 0.001f);
+}
+
+
+///< Flattened closure should match virtual BSDFs it has been compiled from
+TEST_F(Internals, Closure)
+{
+    UvTextureSystem texsys;
+
+    std::vector<std::unique_ptr<Bsdf> > bsdfs;
+    bsdfs.emplace_back(new Lambert(texsys, float3(0.7f, 0.6f, 0.5f), "kd"));
+    bsdfs.emplace_back(new OrenNayar(texsys, float3(0.7f, 0.6f, 0.5f), 0.5f));
+    bsdfs.emplace_back(new Microfacet(texsys, 2.5f, float3(0.7f, 0.6f, 0.5f), "", "", new FresnelDielectric(), new BlinnDistribution(100.f)));
+    bsdfs.emplace_back(new Microfacet(texsys, 2.5f, float3(0.7f, 0.6f, 0.5f), "", "", new FresnelDielectric(), new BeckmannDistribution(0.3f)));
+    bsdfs.emplace_back(new Microfacet(texsys, 2.5f, float3(0.7f, 0.6f, 0.5f), "", "", new FresnelDielectric(), new GgxDistribution(0.3f)));
+    bsdfs.emplace_back(new PerfectReflect(texsys, 1.5f, float3(0.7f, 0.6f, 0.5f), "", "", new FresnelDielectric()));
+    bsdfs.emplace_back(new PerfectRefract(texsys, 1.5f, float3(0.7f, 0.6f, 0.5f), "", "", new FresnelDielectric()));
+
+    ShapeBundle::Hit hit;
+    hit.p = float3(0, 0, 0);
+    hit.n = hit.ng = float3(0, 0, 1);
+    hit.dpdu = float3(1, 0, 0);
+    hit.handedness = 1.f;
+    hit.uv = float2(0.25f, 0.5f);
+    hit.duv = float2(0, 0);
+
+    for (int b = 0; b < (int)bsdfs.size(); ++b)
+    {
+        Closure closure;
+        ASSERT_TRUE(bsdfs[b]->Compile(closure));
+
+        ShadingContext ctx;
+        closure.Prepare(hit, ctx);
+
+        for (int i = 0; i < 100; ++i)
+        {
+            float3 wi = map_to_hemisphere(hit.n, float2(rand_float(), rand_float()), 1.f);
+            float3 wo = map_to_hemisphere(hit.n, float2(rand_float(), rand_float()), 1.f);
+
+            float3 f = closure.Evaluate(ctx, wi, wo);
+            float3 fref = bsdfs[b]->Evaluate(ctx, wi, wo);
+            ASSERT_LE((f - fref).sqnorm(), 0.0001f * std::max(1.f, fref.sqnorm()));
+
+            float pdf = closure.GetPdf(ctx, wi, wo);
+            float pdfref = bsdfs[b]->GetPdf(ctx, wi, wo);
+            ASSERT_LE(std::abs(pdf - pdfref), 0.001f * std::max(1.f, pdfref));
+
+            float2 sample(rand_float() * 0.999f, rand_float());
+            float3 wos, wosref;
+            float pdfs = 0.f, pdfsref = 0.f;
+            int type = 0;
+            f = closure.Sample(ctx, sample, wi, wos, pdfs, type);
+            fref = bsdfs[b]->Sample(ctx, sample, wi, wosref, pdfsref);
+            ASSERT_EQ(type, bsdfs[b]->GetType());
+            ASSERT_LE((wos - wosref).sqnorm(), 0.0001f);
+
+            // Non-delta lobes report PDF of the direction as GetPdf does
+            if (!(type & Bsdf::SPECULAR))
+            {
+                pdfsref = bsdfs[b]->GetPdf(ctx, wi, wosref);
+            }
+
+            ASSERT_LE(std::abs(pdfs - pdfsref), 0.001f * std::max(1.f, pdfsref));
+            ASSERT_LE((f - fref).sqnorm(), 0.0001f * std::max(1.f, fref.sqnorm()));
+        }
+    }
+
+    // Mixed material sums reflection lobes above the surface and averages their PDFs
+    MixedMaterial mixed(1.5f);
+    mixed.AddBsdf(new Lambert(texsys, float3(0.7f, 0.6f, 0.5f), "kd"));
+    mixed.AddBsdf(new Microfacet(texsys, 2.5f, float3(0.7f, 0.6f, 0.5f), "", "", new FresnelDielectric(), new GgxDistribution(0.3f)));
+
+    ShadingContext ctx;
+    mixed.Prepare(hit, ctx);
+
+    float3 wi = normalize(float3(0.3f, 0.1f, 1.f));
+    float3 wo = normalize(float3(-0.2f, 0.2f, 1.f));
+
+    float3 f = mixed.Evaluate(ctx, wi, wo);
+    float3 fref = bsdfs[0]->Evaluate(ctx, wi, wo) + bsdfs[4]->Evaluate(ctx, wi, wo);
+    ASSERT_LE((f - fref).sqnorm(), 0.0001f * fref.sqnorm());
+
+    float pdf = mixed.GetPdf(ctx, wi, wo);
+    float pdfref = 0.5f * (bsdfs[0]->GetPdf(ctx, wi, wo) + bsdfs[4]->GetPdf(ctx, wi, wo));
+    ASSERT_LE(std::abs(pdf - pdfref), 0.001f * pdfref);
+
+    // Sampled directions get PDF and value of the whole mixture
+    for (int i = 0; i < 100; ++i)
+    {
+        float3 wos;
+        float pdfs = 0.f;
+        int type = 0;
+        float3 fs = mixed.Sample(ctx, float2(rand_float() * 0.999f, rand_float()), wi, wos, pdfs, type);
+        ASSERT_LE(std::abs(pdfs - mixed.GetPdf(ctx, wi, wos)), 0.001f * std::max(1.f, pdfs));
+        ASSERT_LE((fs - mixed.Evaluate(ctx, wi, wos)).sqnorm(), 0.0001f * std::max(1.f, fs.sqnorm()));
+    }
+}
+
+
+///< Constant radiance coming from infinity
+class ConstantEnvironmentLight : public Light
+{
+public:
+    float3 GetSample(ShapeBundle::Hit const& hit, float2 const& sample, float3& d, float& pdf) const
+    {
+        d = map_to_hemisphere(hit.n, sample, 0.f) * 100000.f;
+        pdf = 1.f / (2.f * PI);
+        return float3(0.5f, 0.5f, 0.5f);
+    }
+
+    float3 GetLe(ray const& r) const { return float3(0.5f, 0.5f, 0.5f); }
+
+    float GetPdf(ShapeBundle::Hit const& hit, float3 const& w) const { return 1.f / (2.f * PI); }
+
+    bool Singular() const { return false; }
+
+    bool Infinite() const { return true; }
+};
+
+///< Light set should give the same results as the lights it has been built from
+TEST_F(Internals, LightSet)
+{
+    std::unique_ptr<Mesh> quad(CreateQuad(0));
+    Mesh& mesh = *quad;
+
+    // Light above the origin facing down
+    matrix worldmat = translation(float3(0, 3.f, 0)) * rotation_x(-PI / 2);
+    mesh.SetTransform(worldmat, inverse(worldmat));
+
+    Emissive emissive(float3(20.f, 18.f, 14.f));
+
+    std::vector<std::unique_ptr<Light> > lights;
+    lights.emplace_back(new PointLight(float3(1.f, 2.f, 3.f), float3(5.f, 4.f, 3.f)));
+    lights.emplace_back(new ConstantEnvironmentLight());
+    lights.emplace_back(new DirectionalLight(float3(0.f, -1.f, 1.f), float3(2.f, 2.f, 2.f)));
+    lights.emplace_back(new MeshLight(mesh, emissive));
+
+    LightSet lightset;
+    lightset.Build(lights);
+
+    ASSERT_EQ(lightset.GetNumLights(), lights.size());
+    ASSERT_EQ(lightset.GetType(0), LightSet::kPoint);
+    ASSERT_EQ(lightset.GetType(1), LightSet::kEnvironment);
+    ASSERT_EQ(lightset.GetType(2), LightSet::kDirectional);
+    ASSERT_EQ(lightset.GetType(3), LightSet::kArea);
+
+    ShapeBundle::Hit hit;
+    hit.p = float3(0.3f, 0.f, 0.1f);
+    hit.n = float3(0.f, 1.f, 0.f);
+
+    for (int i = 0; i < (int)lights.size(); ++i)
+    {
+        ASSERT_EQ(lightset.Singular(i), lights[i]->Singular());
+
+        float2 sample(0.3f, 0.6f);
+        float3 d, dref;
+        float pdf = 0.f, pdfref = 0.f;
+        float3 le = lightset.GetSample(i, hit, sample, d, pdf);
+        float3 leref = lights[i]->GetSample(hit, sample, dref, pdfref);
+
+        ASSERT_LE((le - leref).sqnorm(), 0.0001f);
+        ASSERT_LE((d - dref).sqnorm(), 0.0001f * dref.sqnorm());
+        ASSERT_EQ(pdf, pdfref);
+        ASSERT_EQ(lightset.GetPdf(i, hit, normalize(d)), lights[i]->GetPdf(hit, normalize(d)));
+    }
+
+    // Escaped rays only get environment contribution
+    ray r(float3(0, 0, 0), float3(0, 1, 0));
+    float3 le = lightset.GetLe(r);
+    ASSERT_EQ(le.x, 0.5f);
+    ASSERT_EQ(le.z, 0.5f);
+}
+
+// Check that arena keeps alignment, grows past block size
+// and reuses its memory after the reset
+TEST_F(Internals, Arena)
+{
+    Arena arena(256);
+
+    char* c = arena.Allocate<char>(3);
+    float2* f = arena.Allocate<float2>(8);
+    double* d = arena.Allocate<double>(4);
+
+    ASSERT_NE(c, nullptr);
+    ASSERT_EQ(reinterpret_cast<std::size_t>(f) % std::alignment_of<float2>::value, 0);
+    ASSERT_EQ(reinterpret_cast<std::size_t>(d) % std::alignment_of<double>::value, 0);
+    ASSERT_EQ(f[7].x, 0.f);
+
+    // Allocation exceeding the block size
+    float3* big = arena.Allocate<float3>(100);
+    ASSERT_NE(big, nullptr);
+
+    std::size_t capacity = arena.GetCapacity();
+    ASSERT_GE(capacity, 100 * sizeof(float3));
+
+    // Same sequence after the reset should not need any new memory
+    arena.Reset();
+
+    ASSERT_EQ(arena.Allocate<char>(3), c);
+    ASSERT_EQ(arena.Allocate<float2>(8), f);
+    arena.Allocate<double>(4);
+    arena.Allocate<float3>(100);
+
+    ASSERT_EQ(arena.GetCapacity(), capacity);
+}
+
+// Check that dimension-aware Sobol samples are stratified in every dimension,
+// including padded ones, and do not depend on sampler copy
+TEST_F(Internals, SobolDimensions)
+{
+    SobolSampler sampler(256, new McRng());
+    std::unique_ptr<Sampler> clone(sampler.Clone());
+
+    int2 pixel(17, 5);
+
+    // 1D stratification of each dimension
+    for (int dim = 0; dim < SobolSampler::kNumDimensions + 8; ++dim)
+    {
+        std::vector<int> strata(64, 0);
+
+        for (int i = 0; i < 64; ++i)
+        {
+            float value = sampler.Get1D(pixel, i, dim);
+            ASSERT_GE(value, 0.f);
+            ASSERT_LT(value, 1.f);
+            ASSERT_EQ(value, clone->Get1D(pixel, i, dim));
+            ++strata[(int)(value * 64)];
+        }
+
+        ASSERT_EQ(std::count(strata.begin(), strata.end(), 1), 64);
+    }
+
+    // 2D stratification of the first and padded dimensions
+    int dims[2] = { 0, SobolSampler::kNumDimensions + 4 };
+    for (int d = 0; d < 2; ++d)
+    {
+        std::vector<int> strata(256, 0);
+
+        for (int i = 0; i < 256; ++i)
+        {
+            float2 value = sampler.Get2D(pixel, i, dims[d]);
+            ++strata[(int)(value.y * 16) * 16 + (int)(value.x * 16)];
+        }
+
+        ASSERT_EQ(std::count(strata.begin(), strata.end(), 1), 256);
+    }
+
+    // Pixels and dimensions are decorrelated
+    ASSERT_NE(sampler.Get1D(pixel, 3, 2), sampler.Get1D(int2(18, 5), 3, 2));
+    ASSERT_NE(sampler.Get1D(pixel, 3, 2), sampler.Get1D(pixel, 3, 3));
+
+    // Cursor takes dimensions one after another
+    SampleCursor cursor(pixel, 7);
+    ASSERT_EQ(cursor.Next1D(sampler), sampler.Get1D(pixel, 7, 0));
+    float2 value = cursor.Next2D(sampler);
+    ASSERT_EQ(value.x, sampler.Get1D(pixel, 7, 1));
+    ASSERT_EQ(value.y, sampler.Get1D(pixel, 7, 2));
+    ASSERT_EQ(cursor.dimension(), 3);
+
+    // Pattern size is a power of two, shuffled padding stays stratified
+    SobolSampler npot(3, new McRng());
+    ASSERT_EQ(npot.num_samples(), 4);
+    ASSERT_EQ(SobolSampler(0, new McRng()).num_samples(), 1);
+
+    std::vector<int> strata(4, 0);
+    for (int i = 0; i < 4; ++i)
+    {
+        ++strata[(int)(npot.Get1D(pixel, i, SobolSampler::kNumDimensions + 1) * 4)];
+    }
+
+    ASSERT_EQ(std::count(strata.begin(), strata.end(), 1), 4);
+}
+
+TEST_F(Internals, BlueNoise)
+{
+    int const size = BlueNoiseSampler::kMaskSize;
+
+    // Mask is a permutation of ranks
+    std::vector<int> strata(size * size, 0);
+    float diff = 0.f;
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+        {
+            float value = BlueNoiseSampler::GetMaskValue(x, y);
+            ++strata[(int)(value * size * size)];
+            // Tiles seamlessly
+            ASSERT_EQ(value, BlueNoiseSampler::GetMaskValue(x + size, y - size));
+            diff += std::abs(value - BlueNoiseSampler::GetMaskValue(x + 1, y));
+        }
+
+    ASSERT_EQ(std::count(strata.begin(), strata.end(), 1), size * size);
+
+    // Neighbours differ more than in white noise where mean difference is 1/3
+    ASSERT_GT(diff / (size * size), 0.36f);
+
+    BlueNoiseSampler sampler(4, new McRng());
+    std::unique_ptr<Sampler> clone(sampler.Clone());
+
+    int2 pixel(70, 3);
+    for (int dim = 0; dim < 16; ++dim)
+    {
+        // Samples of a pixel cover the interval evenly over time
+        std::vector<float> values;
+        for (int i = 0; i < 16; ++i)
+        {
+            float value = sampler.Get1D(pixel, i, dim);
+            ASSERT_GE(value, 0.f);
+            ASSERT_LT(value, 1.f);
+            ASSERT_EQ(value, clone->Get1D(pixel, i, dim));
+            ASSERT_EQ(sampler.Get2D(pixel, i, dim).x, clone->Get2D(pixel, i, dim).x);
+            values.push_back(value);
+        }
+
+        std::sort(values.begin(), values.end());
+        float gap = 1.f - values.back() + values.front();
+        for (int i = 1; i < 16; ++i)
+        {
+            gap = std::max(gap, values[i] - values[i - 1]);
+        }
+
+        ASSERT_LT(gap, 1.5f / 16);
+    }
+
+    ASSERT_NE(sampler.Get1D(pixel, 0, 0), sampler.Get1D(pixel, 0, 1));
+}
+
+TEST_F(Internals, BulkSamples)
+{
+    // Bulk generation produces exactly the samples of the scalar calls,
+    // samplers of each pair are seeded the same way
+    std::srand(7);
+    SobolSampler sobol(64, new McRng());
+    std::srand(7);
+    SobolSampler sobolscalar(64, new McRng());
+    std::srand(11);
+    CmjSampler cmj(4, new McRng());
+    std::srand(11);
+    CmjSampler cmjscalar(4, new McRng());
+
+    std::vector<float2> samples(37);
+    int2 pixel(3, 11);
+
+    // Odd counts exercise the tails, last dimensions the padding
+    int dims[3] = { 0, 17, SobolSampler::kNumDimensions - 1 };
+    for (int d = 0; d < 3; ++d)
+    {
+        sobol.Get2DBlock(pixel, 5, dims[d], 37, &samples[0]);
+
+        for (int i = 0; i < 37; ++i)
+        {
+            float2 expected = sobol.Get2D(pixel, 5 + i, dims[d]);
+            ASSERT_EQ(samples[i].x, expected.x);
+            ASSERT_EQ(samples[i].y, expected.y);
+        }
+    }
+
+    // Sequences continue from one block to another and across CMJ patterns
+    for (int k = 0; k < 3; ++k)
+    {
+        sobol.Generate(&samples[0], 37);
+
+        for (int i = 0; i < 37; ++i)
+        {
+            float2 expected = sobolscalar.Sample2D();
+            ASSERT_EQ(samples[i].x, expected.x);
+            ASSERT_EQ(samples[i].y, expected.y);
+        }
+
+        cmj.Generate(&samples[0], 37);
+
+        for (int i = 0; i < 37; ++i)
+        {
+            float2 expected = cmjscalar.Sample2D();
+            ASSERT_EQ(samples[i].x, expected.x);
+            ASSERT_EQ(samples[i].y, expected.y);
+        }
+    }
+}
+TEST_F(Internals, Denoiser)
+{
+    // Two flat regions split by an albedo and depth edge, color is
+    // their albedo with uniform noise added
+    int2 res(64, 64);
+    FeatureBuffer features(res);
+    std::vector<float3> color(res.x * res.y);
+    std::vector<float3> reference(res.x * res.y);
+
+    std::srand(3);
+    for (int y = 0; y < res.y; ++y)
+        for (int x = 0; x < res.x; ++x)
+        {
+            float3 albedo = x < res.x / 2 ? float3(0.2f, 0.2f, 0.2f) : float3(0.8f, 0.6f, 0.4f);
+            float depth = x < res.x / 2 ? 10.f : 5.f;
+            features.AddSample(int2(x, y), albedo, float3(0.f, 0.f, 1.f), depth);
+
+            float noise = 0.4f * (rand_float() - 0.5f);
+            reference[y * res.x + x] = albedo;
+            color[y * res.x + x] = albedo + float3(noise, noise, noise);
+        }
+
+    auto error = [&](int xmin, int xmax)
+    {
+        float sum = 0.f;
+        for (int y = 0; y < res.y; ++y)
+            for (int x = xmin; x < xmax; ++x)
+            {
+                float3 d = color[y * res.x + x] - reference[y * res.x + x];
+                sum += d.sqnorm();
+            }
+        return std::sqrt(sum / (res.y * (xmax - xmin)));
+    };
+
+    float noisy = error(0, res.x);
+
+    AtrousDenoiser denoiser;
+    denoiser.Apply(features, color);
+
+    // Noise goes away
+    ASSERT_LT(error(0, res.x), 0.25f * noisy);
+    // Edge does not bleed
+    ASSERT_LT(error(res.x / 2 - 1, res.x / 2 + 1), 0.25f * noisy);
+}
+
+///< Image writer keeping written images in memory by name
+class MemoryImageIo : public ImageIo
+{
+public:
+    void Read(std::string const& name, std::vector<float>& data, ImageDesc& desc)
+    {
+        throw std::runtime_error("Not supported");
+    }
+
+    void Write(std::string const& name, std::vector<float> const& data, ImageDesc const& desc)
+    {
+        images[name] = data;
+    }
+
+    std::map<std::string, std::vector<float> > images;
+};
+
+///< AOVs are selected by name, accumulated for enabled channels only
+///< and written as layers along with the image
+TEST_F(Internals, Aov)
+{
+    for (int channel = 0; channel < AovSample::kNumChannels; ++channel)
+    {
+        ASSERT_EQ(AovSample::Find(AovSample::GetName(channel)), channel);
+    }
+
+    ASSERT_EQ(AovSample::Find("light3"), AovSample::kLight0 + 3);
+    ASSERT_EQ(AovSample::Find("unknown"), -1);
+
+    unsigned int mask = (1u << AovSample::kDepth) | (1u << AovSample::kDirect);
+
+    AovSample first(mask);
+    first.Add(AovSample::kDepth, float3(2.f, 2.f, 2.f));
+    first.Add(AovSample::kDirect, float3(1.f, 2.f, 3.f));
+    first.Add(AovSample::kIndirect, float3(1.f, 1.f, 1.f));
+    ASSERT_EQ(first.Get(AovSample::kIndirect).x, 0.f);
+
+    AovSample second(mask);
+    second.Add(AovSample::kDepth, float3(4.f, 4.f, 4.f));
+    second.Add(AovSample::kDirect, float3(3.f, 2.f, 1.f));
+
+    MemoryImageIo io;
+    FileImagePlane plane("image.png", int2(4, 2), io);
+    plane.AddAov(AovSample::kDepth);
+    plane.AddAov(AovSample::kDirect);
+    ASSERT_EQ(plane.GetAovMask(), mask);
+
+    plane.AddSample(float2(1.5f, 0.5f), float3(1.f, 1.f, 1.f));
+    plane.AddAovSample(int2(1, 0), first);
+    plane.AddSample(float2(1.5f, 0.5f), float3(1.f, 1.f, 1.f));
+    plane.AddAovSample(int2(1, 0), second);
+    plane.Finalize();
+
+    // Image itself is written as usual, default writer puts each layer into its own file
+    ASSERT_EQ(io.images.size(), 4);
+    ASSERT_EQ(io.images["image.png"].size(), 4 * 2 * 3);
+    ASSERT_EQ(io.images["image_aovs.color.exr"].size(), 4 * 2 * 3);
+    ASSERT_EQ(io.images["image_aovs.depth.exr"].size(), 4 * 2);
+
+    // Pixel (1, 0) is in the bottom row of the image, values are averaged
+    ASSERT_EQ(io.images["image_aovs.depth.exr"][5], 3.f);
+    ASSERT_EQ(io.images["image_aovs.direct.exr"][3 * 5 + 1], 2.f);
+    ASSERT_EQ(io.images["image_aovs.color.exr"][3 * 5], 1.f);
+    ASSERT_EQ(io.images["image_aovs.color.exr"][0], 0.f);
+}
+
+
+// Scopes from several threads end up in Chrome trace file
+TEST_F(Internals, Profiler)
+{
+    std::string filename = "profiler_test.json";
+
+    Profiler::Enable(filename);
+    ASSERT_TRUE(Profiler::IsEnabled());
+
+    {
+        PROFILE_SCOPE("Outer");
+        PROFILE_SCOPE("Inner");
+    }
+
+    std::thread worker([]()
+    {
+        Profiler::SetThreadName("worker");
+        PROFILE_SCOPE("Worker");
+    });
+    worker.join();
+
+    Profiler::Flush();
+
+    std::ifstream in(filename);
+    std::stringstream trace;
+    trace << in.rdbuf();
+    in.close();
+
+    Profiler::Disable();
+    std::remove(filename.c_str());
+
+    std::string json = trace.str();
+    ASSERT_NE(json.find("\"traceEvents\""), std::string::npos);
+    ASSERT_NE(json.find("\"name\":\"Outer\""), std::string::npos);
+    ASSERT_NE(json.find("\"name\":\"Inner\""), std::string::npos);
+    ASSERT_NE(json.find("\"name\":\"Worker\""), std::string::npos);
+    ASSERT_NE(json.find("\"name\":\"worker\""), std::string::npos);
+    ASSERT_NE(json.find("\"ph\":\"X\""), std::string::npos);
+
+    // Disabled scopes are not recorded
+    ASSERT_FALSE(Profiler::IsEnabled());
+    {
+        PROFILE_SCOPE("Disabled");
+    }
+    Profiler::Enable(filename);
+    Profiler::Flush();
+    Profiler::Disable();
+
+    std::ifstream again(filename);
+    std::stringstream retrace;
+    retrace << again.rdbuf();
+    again.close();
+    std::remove(filename.c_str());
+
+    ASSERT_EQ(retrace.str().find("Disabled"), std::string::npos);
+}
+
+
+// Subsystems report memory into categories which roll up per subsystem
+TEST_F(Internals, MemoryReport)
+{
+    std::unique_ptr<Mesh> quad(CreateQuad(0));
+    Mesh& mesh = *quad;
+
+    float pdf[] = {0.2f, 0.2f, 0.9f, 0.0f};
+    Distribution2D dist(2, 2, pdf);
+
+    MemoryReport report;
+    mesh.GetMemoryUsage(report);
+    dist.GetMemoryUsage(report);
+
+    ASSERT_GE(report.Get("mesh.vertices"), 4 * sizeof(float3));
+    ASSERT_GE(report.Get("mesh.faces"), 2 * sizeof(int) * 3);
+    ASSERT_GT(report.Get("distribution"), 0);
+
+    // Subsystem is the sum of its categories
+    ASSERT_EQ(report.Get("mesh"),
+              report.Get("mesh.vertices") + report.Get("mesh.normals") +
+              report.Get("mesh.uvs") + report.Get("mesh.faces"));
+    ASSERT_EQ(report.GetTotal(), report.Get("mesh") + report.Get("distribution"));
+
+    // Prefix of a name is not a category
+    report.Add("meshx", 16);
+    ASSERT_EQ(report.Get("mesh"), report.GetTotal() - report.Get("distribution") - 16);
+
+    // Peaks keep the maximum and stay out of totals
+    std::size_t total = report.GetTotal();
+    report.AddPeak("bvh.build", 100);
+    report.AddPeak("bvh.build", 50);
+    ASSERT_EQ(report.GetPeak("bvh.build"), 100);
+    ASSERT_EQ(report.GetPeak("texture"), 0);
+    ASSERT_EQ(report.GetTotal(), total);
+
+    std::ostringstream out;
+    report.Print(out);
+    ASSERT_NE(out.str().find("mesh"), std::string::npos);
+}
+
+
+// Pool runs the requested number of workers and accounts their busy time
+TEST_F(Internals, ThreadPool)
+{
+    thread_pool<int> pool(3);
+    ASSERT_EQ(pool.num_threads(), 3);
+
+    std::vector<std::future<int> > futures;
+    for (int i = 0; i < 12; ++i)
+    {
+        futures.push_back(pool.submit([i]()->int
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            return i;
+        }));
+    }
+
+    int sum = 0;
+    for (auto& f : futures)
+    {
+        sum += f.get();
+    }
+    ASSERT_EQ(sum, 66);
+
+    // Busy time is up to date once the futures are ready
+    double busy = 0.0;
+    for (int i = 0; i < pool.num_threads(); ++i)
+    {
+        busy += pool.busy_time(i);
+    }
+    ASSERT_GE(busy, 0.06);
+
+    pool.reset_busy_time();
+    ASSERT_EQ(pool.busy_time(0), 0.0);
+
+    // Default pool uses hardware threads
+    thread_pool<int> defaultpool;
+    ASSERT_GT(defaultpool.num_threads(), 0);
+}
+
+
+// Scene cache restores meshes, materials, lights, camera and BVH written
+TEST_F(Internals, SceneCache)
+{
+    // Material ids are the ones importer callback would return
+    std::vector<std::unique_ptr<ShapeBundle> > bundles;
+    bundles.emplace_back(CreateQuad(7));
+    bundles.emplace_back(CreateQuad(3));
+
+    // Floor facing up and light above it facing down
+    matrix worldmat = rotation_x(PI / 2);
+    bundles[0]->SetTransform(worldmat, inverse(worldmat));
+    worldmat = translation(float3(0, 3.f, 0)) * rotation_x(-PI / 2);
+    bundles[1]->SetTransform(worldmat, inverse(worldmat));
+
+    Bvh bvh(true);
+    bvh.Build(bundles);
+
+    std::string filename = "scenecache_test.bsc";
+    std::string source = "scenecache_test.obj";
+    std::ofstream(source) << "o scenecache_test\n";
+
+    SceneCacheWriter writer;
+    ASSERT_NO_THROW(writer.AddSource(source));
+    writer.AddLambertMaterial(7, float3(0.5f, 0.6f, 0.7f), "4x4", "");
+    writer.AddEmissiveMaterial(3, float3(10.f, 9.f, 8.f));
+    writer.AddMesh(static_cast<Mesh const&>(*bundles[0]));
+    writer.AddMesh(static_cast<Mesh const&>(*bundles[1]));
+    writer.AddMeshLight(1, 3);
+    writer.AddPointLight(float3(1.f, 2.f, 3.f), float3(5.f, 5.f, 5.f));
+    writer.SetCamera(float3(0, 1, 5), float3(0, 1, 0), float3(0, 1, 0), float2(0.01f, 1000.f), PI / 4, 1.f);
+    writer.SetBvh(bvh);
+    ASSERT_NO_THROW(writer.Write(filename));
+
+    GradientImageIo io;
+    NativeTextureSystem texsys("", io);
+
+    std::vector<std::unique_ptr<Material> > mats;
+    std::vector<std::unique_ptr<ShapeBundle> > meshes;
+    std::vector<std::unique_ptr<Light> > lights;
+    std::unique_ptr<Camera> camera;
+    std::unique_ptr<Bvh> restored;
+
+    {
+        BinaryAssetImporter cache(texsys, filename, source);
+
+        // Callback indices differ from the ones written
+        mats.emplace_back(new Emissive(float3(1.f, 1.f, 1.f)));
+        cache.onmaterial_ = [&mats](Material* mat)->int
+        {
+            mats.push_back(std::unique_ptr<Material>(mat));
+            return (int)(mats.size() - 1);
+        };
+        cache.onprimitive_ = [&meshes](ShapeBundle* mesh) { meshes.push_back(std::unique_ptr<ShapeBundle>(mesh)); };
+        cache.onlight_ = [&lights](Light* light) { lights.push_back(std::unique_ptr<Light>(light)); };
+        cache.oncamera_ = [&camera](Camera* cam) { camera.reset(cam); };
+
+        ASSERT_NO_THROW(cache.Import());
+        ASSERT_TRUE(cache.HasBvh());
+        restored = cache.CreateBvh(meshes);
+    }
+
+    // Cache is rejected for another asset or once the asset changes
+    ASSERT_THROW(BinaryAssetImporter(texsys, filename, "other.obj"), std::runtime_error);
+    std::ofstream(source, std::ios::app) << "v 0 0 0\n";
+    ASSERT_THROW(BinaryAssetImporter(texsys, filename, source), std::runtime_error);
+
+    std::remove(filename.c_str());
+    std::remove(source.c_str());
+
+    ASSERT_EQ(mats.size(), 3);
+    ASSERT_FALSE(mats[1]->IsEmissive());
+    ASSERT_TRUE(mats[2]->IsEmissive());
+    ASSERT_EQ(meshes.size(), 2);
+    ASSERT_EQ(lights.size(), 2);
+    ASSERT_TRUE(camera != nullptr);
+    ASSERT_TRUE(restored != nullptr);
+
+    Mesh const& mesh = static_cast<Mesh const&>(*meshes[1]);
+    ASSERT_EQ(mesh.GetNumVertices(), 4);
+    ASSERT_EQ(mesh.GetNumFaces(), 2);
+    ASSERT_EQ(mesh.GetVertices()[2].x, static_cast<Mesh const&>(*bundles[1]).GetVertices()[2].x);
+    ASSERT_EQ(static_cast<Mesh const&>(*meshes[0]).GetFaces()[0].m, 1);
+    ASSERT_EQ(mesh.GetFaces()[1].m, 2);
+
+    // Restored hierarchy finds the same hits
+    ASSERT_EQ(restored->GetNumNodes(), bvh.GetNumNodes());
+
+    for (int i = 0; i < 16; ++i)
+    {
+        ray r(float3(-0.9f + 0.12f * i, 10.f, 0.3f), float3(0.f, -1.f, 0.f), float2(0.f, 100.f));
+
+        ShapeBundle::Hit hit;
+        hit.t = r.t.y;
+        ShapeBundle::Hit restoredhit;
+        restoredhit.t = r.t.y;
+
+        ASSERT_EQ(bvh.Intersect(r, hit), restored->Intersect(r, restoredhit));
+        ASSERT_EQ(hit.t, restoredhit.t);
+        ASSERT_EQ(restored->Intersect(r), true);
+    }
+
+    // Garbage is rejected
+    std::ofstream(filename) << "not a scene cache";
+    ASSERT_THROW(BinaryAssetImporter(texsys, filename), std::runtime_error);
+    std::remove(filename.c_str());
+}
+
+
+#ifdef RENDER_STATS
+// Per sample counters go into stat AOVs and add up into totals
+TEST_F(Internals, RenderStats)
+{
+    RenderStats::ResetTotals();
+
+    for (int s = 0; s < 2; ++s)
+    {
+        AovSample aovs(~0u);
+
+        STATS_BEGIN_SAMPLE();
+        STATS_ADD(kNodes, 10);
+        STATS_ADD(kNodes, 5);
+        STATS_ADD(kShadowRays, 1);
+        STATS_END_SAMPLE(aovs);
+
+        ASSERT_EQ(aovs.Get(AovSample::kStatNodes).x, 15.f);
+        ASSERT_EQ(aovs.Get(AovSample::kStatShadowRays).x, 1.f);
+        ASSERT_EQ(aovs.Get(AovSample::kStatTriangles).x, 0.f);
+        ASSERT_GE(aovs.Get(AovSample::kStatTime).x, 0.f);
+    }
+
+    ASSERT_EQ(RenderStats::GetNumSamples(), 2);
+    ASSERT_EQ(RenderStats::GetTotal(RenderStats::kNodes), 30);
+    ASSERT_EQ(RenderStats::GetTotal(RenderStats::kShadowRays), 2);
+    ASSERT_EQ(AovSample::Find("stat_nodes"), AovSample::kStatNodes);
+    ASSERT_EQ(AovSample::GetNumComponents(AovSample::kStatTime), 1);
+}
+#endif
 
 
 #endif // INTERNALS_H
@@ -1,6 +1,7 @@
 #include "basic_features.h"
+#include "convergence.h"
 //#include "materials.h"
-//#include "internals.h"
+#include "internals.h"
 
 #include <gtest/gtest.h>
 
@@ -15,6 +16,9 @@ std::string g_ref_image_path = "../../../Resources/Reference";
 bool g_compare = false;
 int2 g_imgres = int2(256, 256);
 int  g_num_spp = 4;
+bool g_convergence = false;
+int  g_convergence_spp = 256;
+int  g_reference_spp = 4096;
 
 
 char* GetCmdOption(char ** begin, char ** end, const std::string & option)
@@ -57,5 +61,13 @@ int main(int argc, char** argv)
     
     g_compare = CmdOptionExists(argv, argv + argc, "--compare") ? true : false;
     
+    g_convergence = CmdOptionExists(argv, argv + argc, "--convergence") ? true : false;
+    
+    char* convergence_spp = GetCmdOption(argv, argv + argc, "--convergence_spp");
+    g_convergence_spp = convergence_spp ? atoi(convergence_spp) : g_convergence_spp;
+    
+    char* reference_spp = GetCmdOption(argv, argv + argc, "--reference_spp");
+    g_reference_spp = reference_spp ? atoi(reference_spp) : g_reference_spp;
+    
     return RUN_ALL_TESTS();
 }
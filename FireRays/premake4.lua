@@ -15,6 +15,12 @@ newoption
 	description = "Use OpeImageIO 1.6 version, default one is 1.5"
 }
 
+newoption
+{
+	trigger = "render_stats",
+	description = "Collect per-pixel render cost statistics (stat_* AOVs)"
+}
+
 solution "Banshee"
 	configurations { "Debug", "Release" }    		
 	language "C++"
@@ -46,6 +52,10 @@ solution "Banshee"
 			defines {"USE_OIIO16"}
 	end
 
+	if _OPTIONS["render_stats"] then
+			defines {"RENDER_STATS"}
+	end
+
 	--make configuration specific definitions
     configuration "Debug"
 		defines { "_DEBUG" }
@@ -80,4 +90,8 @@ solution "Banshee"
 	if fileExists("./UnitTest/UnitTest.lua") then
 		dofile("./UnitTest/UnitTest.lua")
 	end
+
+	if fileExists("./Benchmark/Benchmark.lua") then
+		dofile("./Benchmark/Benchmark.lua")
+	end
 	